@@ -3,6 +3,9 @@
 #include <PlaystationCore/AudioQueue.h>
 #include <PlaystationCore/CDRom.h>
 #include <PlaystationCore/ControllerPorts.h>
+#include <PlaystationCore/CPU.h>
+#include <PlaystationCore/EventManager.h>
+#include <PlaystationCore/EventTelemetry.h>
 #include <PlaystationCore/MemoryCard.h>
 #include <PlaystationCore/Renderer.h>
 #include <PlaystationCore/SaveState.h>
@@ -19,6 +22,7 @@
 #include <SDL.h>
 #include <SDL_image.h>
 
+#include <algorithm>
 #include <fstream>
 
 namespace App
@@ -43,6 +47,11 @@ bool IsMemoryCardExtension( const fs::path& extension )
 
 constexpr float FpsSmoothingFactor = 0.9f;
 
+// CPU clock percentages
+constexpr uint32_t MinCpuClock = 25;
+constexpr uint32_t MaxCpuClock = 1000;
+constexpr std::array<uint32_t, 5> CpuClockSteps = { 100, 150, 200, 300, 400 };
+
 SDL_GameController* TryOpenController( int32_t deviceIndex )
 {
 	if ( !SDL_IsGameController( deviceIndex ) )
@@ -122,12 +131,72 @@ bool App::Initialize()
 	// create PSX with controller
 	fs::path biosFilename = cl.GetOption( "bios", fs::path{ "bios.bin" } );
 	m_playstation = std::make_unique<PSX::Playstation>();
+	m_playstation->SetRendererType( cl.HasOption( "softwarerenderer" ) ? PSX::RendererType::Software : PSX::RendererType::OpenGL );
+	m_playstation->SetThreadedRenderer( cl.HasOption( "threadedrenderer" ) );
+
+	if ( cl.HasOption( "gpucapture" ) )
+	{
+		// a bare gpucapture option has an empty value
+		m_gpuCaptureFilename = cl.GetOption( "gpucapture", fs::path{} );
+		if ( m_gpuCaptureFilename.empty() )
+			m_gpuCaptureFilename = "capture.psxgpu";
+
+		m_gpuCaptureFrames = std::max( cl.GetOption( "gpucaptureframes", 1u ), 1u );
+		m_playstation->SetGpuCapture( true );
+	}
+
 	if ( !m_playstation->Initialize( m_window, biosFilename ) )
 	{
 		LogError( "Failed to initialize emulator core" );
 		return false;
 	}
 
+	auto& cpu = m_playstation->GetCpu();
+	cpu.EnableCachedInterpreter = cl.HasOption( "cachedinterpreter" );
+	cpu.EnableRecompiler = cl.HasOption( "recompiler" );
+	cpu.EnableRecompilerLockstep = cl.HasOption( "lockstep" );
+	cpu.EnableIdleLoopSkip = !cl.HasOption( "noidleskip" );
+	cpu.EnableBiosHle = !cl.HasOption( "nobioshle" );
+
+	// the signature database in the working directory is used if it's there
+	fs::path signaturesFilename = cl.GetOption( "libsignatures", fs::path{} );
+	if ( signaturesFilename.empty() )
+		signaturesFilename = "libsignatures.txt";
+
+	if ( !cl.HasOption( "nolibhle" ) && ( cl.HasOption( "libsignatures" ) || fs::exists( signaturesFilename ) ) )
+	{
+		auto& libraryHle = cpu.GetLibraryHle();
+		if ( !libraryHle.LoadSignatures( signaturesFilename ) )
+			LogWarning( "Failed to load library signatures" );
+
+		// comma separated signature names
+		std::string_view disabled = cl.GetOption( "libhledisable", std::string_view{} );
+		while ( !disabled.empty() )
+		{
+			const size_t end = std::min( disabled.find( ',' ), disabled.size() );
+			const auto name = disabled.substr( 0, end );
+			if ( !libraryHle.SetEnabled( name, false ) )
+				LogWarning( "Unknown library signature %.*s", static_cast<int>( name.size() ), name.data() );
+
+			disabled.remove_prefix( std::min( end + 1, disabled.size() ) );
+		}
+	}
+
+	if ( cl.HasOption( "profile" ) )
+		cpu.StartProfiler();
+
+	if ( cl.HasOption( "eventtelemetry" ) )
+	{
+		m_eventTelemetryFilename = cl.GetOption( "eventtelemetry", fs::path{ "event_telemetry.csv" } );
+		m_playstation->GetEventManager().EnableTelemetry( true );
+		cpu.GetGte().EnableHostTiming = true;
+	}
+
+	m_playstation->SetFastBoot( cl.HasOption( "fastboot" ) );
+
+	if ( const auto cpuClock = cl.FindOption<uint32_t>( "cpuclock" ); cpuClock.has_value() )
+		SetCpuClock( *cpuClock );
+
 	if ( const auto romFilename = cl.FindOption( "rom" ); romFilename.has_value() )
 	{
 		LoadRom( *romFilename );
@@ -198,6 +267,20 @@ void App::Shutdown()
 	}
 
 	m_playstation->GetControllerPorts().SaveMemoryCardsToDisk();
+	m_playstation->GetCpu().GetBiosHle().LogCallCounts();
+	m_playstation->GetCpu().GetLibraryHle().LogReport();
+
+	if ( m_playstation->GetCpu().GetProfiler().IsRunning() )
+		WriteProfile();
+
+	if ( auto* telemetry = m_playstation->GetEventManager().GetTelemetry() )
+	{
+		if ( m_eventTelemetryFilename.extension() == ".json" )
+			telemetry->WriteJson( m_eventTelemetryFilename );
+		else
+			telemetry->WriteCsv( m_eventTelemetryFilename );
+	}
+
 	m_playstation.reset();
 
 	SDL_GL_DeleteContext( m_glContext );
@@ -474,7 +557,12 @@ void App::PollEvents()
 
 				if ( extension == ExecutableExtension )
 				{
-					m_playstation->HookExe( std::move( filename ) );
+					if ( !m_playstation->HookExe( filename ) )
+					{
+						LogError( "Cannot open executable %s", event.drop.file );
+						break;
+					}
+
 					m_playstation->Reset();
 					SDL_SetWindowTitle( m_window, event.drop.file );
 					m_paused = false;
@@ -535,6 +623,14 @@ fs::path App::GetQuicksaveFilename() const
 	return filename;
 }
 
+void App::WriteProfile()
+{
+	auto& profiler = m_playstation->GetCpu().GetProfiler();
+	Log( "Writing profile with %u samples", profiler.GetSampleCount() );
+	profiler.WriteCollapsedStacks( "profile.folded" );
+	profiler.WriteHotAddresses( "profile_hot.txt", 100 );
+}
+
 bool App::SetResolutionScale( uint32_t scale )
 {
 	auto& renderer = m_playstation->GetRenderer();
@@ -551,6 +647,19 @@ bool App::SetResolutionScale( uint32_t scale )
 	return true;
 }
 
+bool App::SetCpuClock( uint32_t percent )
+{
+	if ( percent < MinCpuClock || percent > MaxCpuClock )
+	{
+		LogError( "Cannot set CPU clock to %u%%", percent );
+		return false;
+	}
+
+	m_playstation->GetEventManager().SetCpuClock( percent );
+	Log( "Set CPU clock to %u%%", percent );
+	return true;
+}
+
 bool App::HandleHotkeyPress( SDL_Keycode key )
 {
 	switch ( key )
@@ -567,6 +676,15 @@ bool App::HandleHotkeyPress( SDL_Keycode key )
 			SetMuted( !IsMuted() );
 			return true;
 
+		case SDLK_F4:
+		{
+			// cycle CPU overclock
+			const uint32_t cpuClock = m_playstation->GetEventManager().GetCpuClock();
+			const auto it = std::upper_bound( CpuClockSteps.begin(), CpuClockSteps.end(), cpuClock );
+			SetCpuClock( it != CpuClockSteps.end() ? *it : CpuClockSteps.front() );
+			return true;
+		}
+
 		case SDLK_F5:
 			SaveState( GetQuicksaveFilename() );
 			return true;
@@ -589,10 +707,32 @@ bool App::HandleHotkeyPress( SDL_Keycode key )
 			return true;
 		}
 
+		case SDLK_F8:
+		{
+			// toggle guest profiler. Stopping writes the profile
+			auto& cpu = m_playstation->GetCpu();
+			if ( cpu.GetProfiler().IsRunning() )
+			{
+				cpu.StopProfiler();
+				WriteProfile();
+				cpu.GetProfiler().Clear();
+			}
+			else
+			{
+				cpu.StartProfiler();
+			}
+			return true;
+		}
+
 		case SDLK_F9:
 			LoadState( GetQuicksaveFilename() );
 			return true;
 
+		case SDLK_F10:
+			if ( !m_gpuCaptureFilename.empty() )
+				m_playstation->StartGpuCapture( m_gpuCaptureFilename, m_gpuCaptureFrames );
+			return true;
+
 		case SDLK_F11:
 			SetFullscreen( !IsFullscreen() );
 			return true;
@@ -59,8 +59,13 @@ private:
 
 	bool SetResolutionScale( uint32_t scale );
 
+	// percent of the stock clock
+	bool SetCpuClock( uint32_t percent );
+
 	bool SaveScreenshot();
 
+	void WriteProfile();
+
 private:
 	SDL_Window* m_window = nullptr;
 	SDL_GLContext m_glContext = nullptr;
@@ -76,6 +81,12 @@ private:
 
 	float m_smoothedAverageFPS = 60.0f;
 
+	fs::path m_eventTelemetryFilename; // written at shutdown
+
+	// F10 starts a GPU capture when set
+	fs::path m_gpuCaptureFilename;
+	uint32_t m_gpuCaptureFrames = 1;
+
 	bool m_paused = true;
 	bool m_stepFrame = false;
 	bool m_muted = false;
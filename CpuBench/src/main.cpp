@@ -0,0 +1,190 @@
+// runs a synthetic program on the CPU and reports the host time per guest instruction. The program is loaded with
+// LoadExecutable in place of the BIOS shell, so the time is mostly instruction dispatch and execution.
+// Compare runs with and without profile to measure the guest profiler's overhead
+//
+// CpuBench [bios=filename] [frames=N] [cachedinterpreter] [recompiler] [profile]
+
+#include <PlaystationCore/CPU.h>
+#include <PlaystationCore/File.h>
+#include <PlaystationCore/Playstation.h>
+#include <PlaystationCore/RAM.h>
+
+#include <Util/CommandLine.h>
+
+#include <stdx/log.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t LoadAddress = 0x80010000;
+constexpr uint32_t DataAddress = 0x80020000;
+constexpr uint32_t CounterOffset = 0x100; // loop iterations, stored after the data word
+
+// frames run before timing so the code cache and recompiler are warm
+constexpr uint32_t WarmupFrames = 10;
+
+enum Register : uint32_t
+{
+	Zero = 0,
+	V0 = 2,
+	A0 = 4,
+	T0 = 8, T1, T2, T3, T4, T5, T6, T7,
+	S0 = 16,
+	RA = 31
+};
+
+constexpr uint32_t Nop = 0;
+
+constexpr uint32_t Special( uint32_t funct, uint32_t rs, uint32_t rt, uint32_t rd, uint32_t shamt = 0 ) noexcept
+{
+	return ( rs << 21 ) | ( rt << 16 ) | ( rd << 11 ) | ( shamt << 6 ) | funct;
+}
+
+constexpr uint32_t Immediate( uint32_t opcode, uint32_t rs, uint32_t rt, uint32_t immediate ) noexcept
+{
+	return ( opcode << 26 ) | ( rs << 21 ) | ( rt << 16 ) | ( immediate & 0xffff );
+}
+
+constexpr uint32_t Jump( uint32_t opcode, uint32_t address ) noexcept
+{
+	return ( opcode << 26 ) | ( ( address >> 2 ) & 0x03ffffff );
+}
+
+struct Program
+{
+	std::vector<uint8_t> exe;
+	uint32_t instructionsPerIteration = 0;
+};
+
+// a loop mixing ALU, shift, load/store, REGIMM branch and call/return instructions. Every iteration stores its count
+Program BuildProgram()
+{
+	std::vector<uint32_t> code
+	{
+		// function: v0 = a0 + t1
+		Special( 0x21, A0, T1, V0 ),				// addu v0, a0, t1
+		Special( 0x08, RA, Zero, Zero ),			// jr ra
+		Nop,
+	};
+	const uint32_t functionSize = static_cast<uint32_t>( code.size() );
+
+	const uint32_t entryAddress = LoadAddress + static_cast<uint32_t>( code.size() ) * 4;
+	code.push_back( Immediate( 0x0f, Zero, T0, DataAddress >> 16 ) );	// lui t0, data
+	code.push_back( Immediate( 0x09, Zero, T1, 1 ) );					// addiu t1, zero, 1
+
+	const size_t loopStart = code.size();
+	const uint32_t loopAddress = LoadAddress + static_cast<uint32_t>( loopStart ) * 4;
+	code.insert( code.end(),
+	{
+		Special( 0x21, T1, T2, T2 ),				// addu t2, t1, t2
+		Special( 0x24, T2, T1, T3 ),				// and t3, t2, t1
+		Special( 0x00, Zero, T2, T4, 3 ),			// sll t4, t2, 3
+		Special( 0x2a, T4, T3, T5 ),				// slt t5, t4, t3
+		Immediate( 0x0d, T5, T6, 0x55 ),			// ori t6, t5, 0x55
+		Immediate( 0x2b, T0, T2, 0 ),				// sw t2, 0(t0)
+		Immediate( 0x23, T0, T7, 0 ),				// lw t7, 0(t0)
+		Immediate( 0x01, T7, 1, 1 ),				// bgez t7, +1. Both paths continue after the delay slot
+		Nop,
+		Special( 0x26, T7, T5, T6 ),				// xor t6, t7, t5
+		Jump( 0x03, LoadAddress ),					// jal function
+		Special( 0x21, T2, Zero, A0 ),				// addu a0, t2, zero
+		Immediate( 0x09, S0, S0, 1 ),				// addiu s0, s0, 1
+		Immediate( 0x2b, T0, S0, CounterOffset ),	// sw s0, counter(t0)
+		Jump( 0x02, loopAddress ),					// j loop
+		Nop,
+	} );
+
+	Program program;
+	program.instructionsPerIteration = static_cast<uint32_t>( code.size() - loopStart ) + functionSize;
+
+	const uint32_t codeSize = static_cast<uint32_t>( code.size() ) * 4;
+	program.exe.resize( sizeof( PSX::ExeHeader ) + ( ( codeSize + 0x7ff ) & ~0x7ffu ) );
+
+	PSX::ExeHeader header{};
+	std::memcpy( header.id, PSX::ExeHeader::Id.data(), PSX::ExeHeader::Id.size() );
+	header.programCounter = entryAddress;
+	header.ramDestination = LoadAddress;
+	header.fileSize = static_cast<uint32_t>( program.exe.size() - sizeof( header ) );
+
+	std::memcpy( program.exe.data(), &header, sizeof( header ) );
+	std::memcpy( program.exe.data() + sizeof( header ), code.data(), codeSize );
+	return program;
+}
+
+}
+
+int main( int argc, char** argv )
+{
+	Util::CommandLine::Initialize( argc, argv );
+	const auto& cl = Util::CommandLine::Get();
+
+	const fs::path biosFilename = cl.GetOption( "bios", fs::path{ "bios.bin" } );
+	const uint32_t frames = std::max( cl.GetOption( "frames", 600u ), 1u );
+
+	PSX::Playstation playstation;
+	if ( !playstation.InitializeHeadless( PSX::RendererType::Null, biosFilename ) )
+		return 1;
+
+	auto& cpu = playstation.GetCpu();
+	cpu.EnableCachedInterpreter = cl.HasOption( "cachedinterpreter" );
+	cpu.EnableRecompiler = cl.HasOption( "recompiler" );
+
+	const char* modeName = cpu.EnableRecompiler ? "recompiler" : cpu.EnableCachedInterpreter ? "cached interpreter" : "interpreter";
+
+	playstation.Reset();
+
+	const Program program = BuildProgram();
+	auto& ram = playstation.GetRam();
+	if ( !PSX::LoadExecutable( program.exe.data(), program.exe.size(), cpu, ram ) )
+	{
+		LogError( "Failed to load benchmark program" );
+		return 1;
+	}
+
+	// the loop makes a call every iteration, so call tracking is included
+	const bool profile = cl.HasOption( "profile" );
+	if ( profile )
+		cpu.StartProfiler();
+
+	auto readIterations = [ &ram ]
+	{
+		return ram.Read<uint32_t>( ( DataAddress & PSX::RamAddressMask ) + CounterOffset );
+	};
+
+	for ( uint32_t i = 0; i < WarmupFrames; ++i )
+		playstation.RunFrame();
+
+	const uint32_t startIterations = readIterations();
+	const auto start = Clock::now();
+	for ( uint32_t i = 0; i < frames; ++i )
+		playstation.RunFrame();
+	const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	const uint64_t instructions = static_cast<uint64_t>( readIterations() - startIterations ) * program.instructionsPerIteration;
+	if ( instructions == 0 )
+	{
+		LogError( "Benchmark program did not run" );
+		return 1;
+	}
+
+	Log( "%s%s: %llu instructions in %u frames, %.3f s, %.2f ns/instruction, %.1f MIPS",
+		modeName,
+		profile ? " with profiler" : "",
+		static_cast<unsigned long long>( instructions ),
+		frames,
+		seconds,
+		seconds * 1e9 / instructions,
+		instructions / seconds / 1e6 );
+
+	return 0;
+}
\ No newline at end of file
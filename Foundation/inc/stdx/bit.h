@@ -144,4 +144,41 @@ constexpr int countl_one( T x ) noexcept
 	return countl_zero<T>( ~x );
 }
 
+template <typename T, STDX_requires( std::is_integral_v<T> )
+inline int countr_zero( T x ) noexcept
+{
+#ifdef _MSC_VER
+	if ( x == 0 )
+		return (int)bitsizeof<T>();
+
+	unsigned long index;
+	if constexpr ( sizeof( T ) <= 4 )
+	{
+		_BitScanForward( &index, static_cast<uint32_t>( x ) );
+		return (int)index;
+	}
+	else
+	{
+		const uint32_t low = static_cast<uint32_t>( x & 0xffffffff );
+		if ( low != 0 )
+		{
+			_BitScanForward( &index, low );
+			return (int)index;
+		}
+
+		_BitScanForward( &index, static_cast<uint32_t>( ( x >> 32 ) & 0xffffffff ) );
+		return 32 + (int)index;
+	}
+
+#else
+	static_assert( false ); // unimplemented
+#endif
+}
+
+template <typename T>
+constexpr int countr_one( T x ) noexcept
+{
+	return countr_zero<T>( ~x );
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,242 @@
+// replays a GPU capture through a renderer backend as fast as possible and reports the frame rate and time spent per command type.
+// Record a capture by running the emulator with gpucapture[=filename] [gpucaptureframes=N] and pressing F10
+//
+// GpuReplay capture=filename [renderer=opengl|software|null] [scale=N] [loops=N] [finish] [headless] [dumpvram=filename]
+
+#include <PlaystationCore/GpuCapture.h>
+#include <PlaystationCore/NullRenderer.h>
+#include <PlaystationCore/OpenGLRenderer.h>
+#include <PlaystationCore/SoftwareRenderer.h>
+
+#include <Util/CommandLine.h>
+
+#include <stdx/log.h>
+
+#include <glad/glad.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct CommandStats
+{
+	uint64_t count = 0;
+	Clock::duration time{};
+};
+
+struct Window
+{
+	SDL_Window* window = nullptr;
+	SDL_GLContext glContext = nullptr;
+
+	~Window()
+	{
+		if ( glContext )
+			SDL_GL_DeleteContext( glContext );
+
+		if ( window )
+			SDL_DestroyWindow( window );
+	}
+};
+
+bool OpenWindow( Window& window )
+{
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
+
+	window.window = SDL_CreateWindow( "GPU Replay", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 480, SDL_WINDOW_SHOWN | SDL_WINDOW_OPENGL );
+	if ( window.window == nullptr )
+	{
+		LogError( "Failed to create SDL window [%s]", SDL_GetError() );
+		return false;
+	}
+
+	window.glContext = SDL_GL_CreateContext( window.window );
+	if ( window.glContext == nullptr )
+	{
+		LogError( "Failed to create OpenGL context [%s]", SDL_GetError() );
+		return false;
+	}
+
+	if ( !gladLoadGLLoader( SDL_GL_GetProcAddress ) )
+	{
+		LogError( "Failed to initialize OpenGL context" );
+		return false;
+	}
+
+	// present as fast as possible
+	SDL_GL_SetSwapInterval( 0 );
+	return true;
+}
+
+std::unique_ptr<PSX::Renderer> CreateRenderer( std::string_view name, SDL_Window* window )
+{
+	if ( name == "null" )
+		return std::make_unique<PSX::NullRenderer>();
+
+	if ( name == "software" )
+	{
+		auto renderer = std::make_unique<PSX::SoftwareRenderer>();
+		return renderer->Initialize( window ) ? std::move( renderer ) : nullptr;
+	}
+
+	if ( name == "opengl" )
+	{
+		auto renderer = std::make_unique<PSX::OpenGLRenderer>();
+		return renderer->Initialize( window ) ? std::move( renderer ) : nullptr;
+	}
+
+	LogError( "Unknown renderer %.*s", static_cast<int>( name.size() ), name.data() );
+	return nullptr;
+}
+
+bool DumpVRam( PSX::Renderer& renderer, const fs::path& filename )
+{
+	auto vram = std::make_unique<uint16_t[]>( PSX::VRamWidth * PSX::VRamHeight );
+	renderer.ReadVRam( 0, 0, PSX::VRamWidth, PSX::VRamHeight, vram.get() );
+
+	std::ofstream fout( filename, std::ios::binary );
+	if ( !fout.is_open() )
+	{
+		LogError( "Cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	fout.write( reinterpret_cast<const char*>( vram.get() ), PSX::VRamWidth * PSX::VRamHeight * sizeof( uint16_t ) );
+	return true;
+}
+
+double ToMilliseconds( Clock::duration duration )
+{
+	return std::chrono::duration<double, std::milli>( duration ).count();
+}
+
+bool Replay( PSX::GpuCaptureReader& capture, const Util::CommandLine::CommandLineOptions& cl, std::string_view rendererName, bool headless )
+{
+	Window window;
+	if ( !headless && !OpenWindow( window ) )
+		return false;
+
+	auto renderer = CreateRenderer( rendererName, window.window );
+	if ( !renderer )
+		return false;
+
+	if ( const auto scale = cl.FindOption<uint32_t>( "scale" ); scale.has_value() && !renderer->SetResolutionScale( *scale ) )
+		LogWarning( "Cannot set resolution scale to x%u", *scale );
+
+	const uint32_t loops = std::max( cl.GetOption( "loops", 1u ), 1u );
+
+	// waits for the GPU at the end of each frame so DisplayFrame includes the draw time
+	const bool finish = !headless && cl.HasOption( "finish" );
+
+	std::array<CommandStats, static_cast<size_t>( PSX::RenderCommand::Count )> stats;
+	uint64_t frames = 0;
+
+	const auto start = Clock::now();
+	for ( uint32_t loop = 0; loop < loops; ++loop )
+	{
+		// each pass starts from the captured VRAM
+		capture.Rewind();
+
+		PSX::RenderCommand command;
+		const void* payload;
+		while ( capture.Next( command, payload ) )
+		{
+			const auto commandStart = Clock::now();
+
+			PSX::ExecuteRenderCommand( *renderer, command, payload );
+
+			if ( command == PSX::RenderCommand::DisplayFrame )
+			{
+				if ( finish )
+					glFinish();
+
+				++frames;
+			}
+
+			auto& commandStats = stats[ static_cast<size_t>( command ) ];
+			++commandStats.count;
+			commandStats.time += Clock::now() - commandStart;
+
+			if ( command == PSX::RenderCommand::DisplayFrame && !headless )
+				SDL_PumpEvents();
+		}
+	}
+	const double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+
+	Log( "%.*s: %llu frames in %.3f s, %.1f fps",
+		static_cast<int>( rendererName.size() ), rendererName.data(),
+		static_cast<unsigned long long>( frames ),
+		seconds,
+		seconds > 0 ? frames / seconds : 0.0 );
+
+	// OpenGL draws are batched and run on the GPU asynchronously, so their cost lands in whichever command flushes
+	Log( "%-24s %10s %12s %10s", "command", "count", "total ms", "avg us" );
+	for ( size_t i = 0; i < stats.size(); ++i )
+	{
+		const auto& commandStats = stats[ i ];
+		if ( commandStats.count == 0 )
+			continue;
+
+		const double totalMs = ToMilliseconds( commandStats.time );
+		Log( "%-24s %10llu %12.3f %10.3f",
+			PSX::GetRenderCommandName( static_cast<PSX::RenderCommand>( i ) ),
+			static_cast<unsigned long long>( commandStats.count ),
+			totalMs,
+			totalMs * 1000.0 / commandStats.count );
+	}
+
+	// raw 16 bit VRAM for comparing backends or builds
+	if ( const auto dumpFilename = cl.FindOption<fs::path>( "dumpvram" ); dumpFilename.has_value() )
+		return DumpVRam( *renderer, *dumpFilename );
+
+	return true;
+}
+
+}
+
+int main( int argc, char** argv )
+{
+	Util::CommandLine::Initialize( argc, argv );
+	const auto& cl = Util::CommandLine::Get();
+
+	const auto captureFilename = cl.FindOption<fs::path>( "capture" );
+	if ( !captureFilename.has_value() )
+	{
+		LogError( "usage: GpuReplay capture=filename [renderer=opengl|software|null] [scale=N] [loops=N] [finish] [headless] [dumpvram=filename]" );
+		return 1;
+	}
+
+	PSX::GpuCaptureReader capture;
+	if ( !capture.Load( *captureFilename ) )
+		return 1;
+
+	const std::string_view rendererName = cl.GetOption( "renderer", "opengl" );
+
+	// the software renderer can run without presenting
+	const bool headless = rendererName == "null" || ( rendererName == "software" && cl.HasOption( "headless" ) );
+
+	if ( SDL_Init( headless ? 0 : SDL_INIT_VIDEO ) < 0 )
+	{
+		LogError( "Failed to initialize SDL [%s]", SDL_GetError() );
+		return 1;
+	}
+
+	const bool success = Replay( capture, cl, rendererName, headless );
+
+	SDL_Quit();
+	return success ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+// runs random GTE commands on random register files with every instruction set the host supports and checks the
+// results against the scalar kernels. Every data and control register, including FLAG, must match after every command
+//
+// GteFuzz [seed=N] [iterations=N]
+
+#include <PlaystationCore/GTE.h>
+
+#include <Util/CommandLine.h>
+
+#include <stdx/log.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using PSX::GteKernels::InstructionSet;
+
+constexpr uint32_t RegisterCount = 64;
+
+// opcodes that do something, including the ones that use the matrix kernels
+constexpr std::array<uint32_t, 22> Opcodes
+{
+	0x01, 0x06, 0x0c, 0x10, 0x11, 0x12, 0x13, 0x14, 0x16, 0x1b, 0x1c,
+	0x1e, 0x20, 0x28, 0x29, 0x2a, 0x2d, 0x2e, 0x30, 0x3d, 0x3e, 0x3f
+};
+
+class RandomValues
+{
+public:
+	explicit RandomValues( uint32_t seed ) : m_random{ seed } {}
+
+	uint32_t Next() noexcept { return m_random(); }
+
+	// biased towards values near the saturation and overflow limits
+	uint32_t NextRegister() noexcept
+	{
+		switch ( m_random() % 6 )
+		{
+			case 0:		return m_random();
+			case 1:		return ( m_random() % 0x2000 ) - 0x1000;
+			case 2:		return ( ( m_random() % 2 ) ? 0x7fff7fffu : 0x80008000u ) ^ ( m_random() % 4 );
+			case 3:		return m_random() & 0x00ff00ff;
+			case 4:		return ( m_random() % 2 ) ? 0x7fffffffu - m_random() % 16 : 0x80000000u + m_random() % 16;
+			default:	return ( m_random() % 0x20000 ) - 0x10000;
+		}
+	}
+
+	// random opcode with random sf, lm, matrix, vector and translation fields
+	uint32_t NextCommand() noexcept
+	{
+		const uint32_t opcode = Opcodes[ m_random() % Opcodes.size() ];
+		return opcode | ( ( m_random() & 0x1f ) << 10 ) | ( ( m_random() & 0x3f ) << 15 ) | ( 0x25u << 25 );
+	}
+
+private:
+	std::mt19937 m_random;
+};
+
+// compares the matrix kernels directly, with translations that put the sums close to the 44 bit MAC limits.
+// Returns the number of mismatches
+uint32_t FuzzKernels( InstructionSet instructionSet, uint32_t seed, uint32_t iterations )
+{
+	const auto reference = PSX::GteKernels::GetMultiplyMatrixVectors( InstructionSet::Scalar );
+	const auto test = PSX::GteKernels::GetMultiplyMatrixVectors( instructionSet );
+
+	std::mt19937 random{ seed };
+	auto randomInt16 = [ &random ] { return static_cast<int16_t>( random() ); };
+
+	// padded for the vector loads
+	std::array<int16_t, 12> matrix{};
+	std::array<int16_t, 12> vectors{};
+	std::array<int32_t, 4> translation{};
+	std::array<int64_t, 9> referenceResults{};
+	std::array<int64_t, 9> testResults{};
+
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		for ( size_t e = 0; e < 9; ++e )
+		{
+			matrix[ e ] = randomInt16();
+			vectors[ e ] = randomInt16();
+		}
+
+		for ( size_t row = 0; row < 3; ++row )
+		{
+			const int32_t nearLimit = std::numeric_limits<int32_t>::max() - static_cast<int32_t>( random() % ( 1u << 20 ) );
+			switch ( random() % 3 )
+			{
+				case 0:		translation[ row ] = static_cast<int32_t>( random() );	break;
+				case 1:		translation[ row ] = nearLimit;							break;
+				default:	translation[ row ] = -nearLimit;						break;
+			}
+		}
+
+		const size_t count = 1 + random() % 3;
+		const uint32_t referenceFlags = reference( matrix.data(), vectors.data(), translation.data(), referenceResults.data(), count );
+		const uint32_t testFlags = test( matrix.data(), vectors.data(), translation.data(), testResults.data(), count );
+
+		if ( testFlags != referenceFlags || !std::equal( testResults.begin(), testResults.begin() + count * 3, referenceResults.begin() ) )
+		{
+			LogError( "%s: kernel results or flags differ at iteration %u. Flags are %02X instead of %02X",
+				PSX::GteKernels::GetInstructionSetName( instructionSet ), i, testFlags, referenceFlags );
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// runs the same commands on GTEs using scalar and SIMD kernels. Returns the number of mismatches
+uint32_t Fuzz( InstructionSet instructionSet, uint32_t seed, uint32_t iterations )
+{
+	PSX::GTE reference;
+	PSX::GTE test;
+	reference.Reset();
+	test.Reset();
+	reference.SetInstructionSet( InstructionSet::Scalar );
+	test.SetInstructionSet( instructionSet );
+
+	RandomValues random{ seed };
+	uint32_t mismatches = 0;
+
+	for ( uint32_t i = 0; i < iterations; ++i )
+	{
+		// usually change a few registers, sometimes all of them
+		const bool writeAll = random.Next() % 4 == 0;
+		const uint32_t writes = writeAll ? RegisterCount : 8;
+		for ( uint32_t w = 0; w < writes; ++w )
+		{
+			const uint32_t index = writeAll ? w : random.Next() % RegisterCount;
+			const uint32_t value = random.NextRegister();
+			reference.Write( index, value );
+			test.Write( index, value );
+		}
+
+		const uint32_t command = random.NextCommand();
+		const auto referenceCycles = reference.ExecuteCommand( command );
+		const auto testCycles = test.ExecuteCommand( command );
+		if ( referenceCycles != testCycles )
+		{
+			LogError( "%s: command %08X at iteration %u took %i cycles instead of %i",
+				PSX::GteKernels::GetInstructionSetName( instructionSet ), command, i, static_cast<int>( testCycles ), static_cast<int>( referenceCycles ) );
+			++mismatches;
+		}
+
+		for ( uint32_t r = 0; r < RegisterCount; ++r )
+		{
+			const uint32_t expected = reference.Read( r );
+			const uint32_t actual = test.Read( r );
+			if ( actual != expected )
+			{
+				LogError( "%s: command %08X at iteration %u wrote %08X to register %u instead of %08X",
+					PSX::GteKernels::GetInstructionSetName( instructionSet ), command, i, actual, r, expected );
+				++mismatches;
+			}
+		}
+
+		// the register files differ from here on
+		if ( mismatches > 0 )
+			break;
+	}
+
+	return mismatches;
+}
+
+}
+
+int main( int argc, char** argv )
+{
+	Util::CommandLine::Initialize( argc, argv );
+	const auto& cl = Util::CommandLine::Get();
+
+	const uint32_t seed = cl.GetOption( "seed", std::random_device{}() );
+	const uint32_t iterations = cl.GetOption( "iterations", 1000000u );
+
+	const InstructionSet hostInstructionSet = PSX::GteKernels::GetHostInstructionSet();
+
+	std::vector<InstructionSet> instructionSets;
+	if ( hostInstructionSet >= InstructionSet::Sse41 )
+		instructionSets.push_back( InstructionSet::Sse41 );
+	if ( hostInstructionSet >= InstructionSet::Avx2 )
+		instructionSets.push_back( InstructionSet::Avx2 );
+
+	if ( instructionSets.empty() )
+	{
+		LogWarning( "The host only supports the scalar kernels. Nothing to compare" );
+		return 0;
+	}
+
+	Log( "GTE fuzz with seed %u and %u commands", seed, iterations );
+
+	bool success = true;
+	for ( const auto instructionSet : instructionSets )
+	{
+		const uint32_t mismatches = FuzzKernels( instructionSet, seed, iterations ) + Fuzz( instructionSet, seed, iterations );
+		Log( "%s: %s", PSX::GteKernels::GetInstructionSetName( instructionSet ), mismatches == 0 ? "matches scalar" : "MISMATCH" );
+		success = success && mismatches == 0;
+	}
+
+	return success ? 0 : 1;
+}
\ No newline at end of file
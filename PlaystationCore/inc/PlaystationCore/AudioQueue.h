@@ -4,6 +4,7 @@
 
 #include <SDL.h>
 
+#include <functional>
 #include <memory>
 #include <mutex>
 
@@ -42,6 +43,9 @@ public:
 public:
 	using SampleType = int16_t;
 
+	// receives interleaved samples as they are pushed when there is no audio device
+	using Sink = std::function<void( const SampleType* samples, size_t count )>;
+
 	static constexpr int DefaultSampleRate = 44100;
 	static constexpr uint16_t DefaultBufferSize = 2048;
 	static constexpr uint8_t DefaultChannelCount = 2;
@@ -64,6 +68,15 @@ public:
 
 	bool Initialize( int frequency = DefaultSampleRate, uint8_t channels = DefaultChannelCount, uint16_t bufferSize = DefaultBufferSize );
 
+	// outputs to the sink instead of an audio device. Samples are discarded until a sink is set
+	bool InitializeWithoutDevice( int frequency = DefaultSampleRate, uint8_t channels = DefaultChannelCount, uint16_t bufferSize = DefaultBufferSize );
+
+	void SetSink( Sink sink )
+	{
+		std::unique_lock lock{ m_queueMutex };
+		m_sink = std::move( sink );
+	}
+
 	void SetPaused( bool pause );
 	bool GetPaused() const { return m_paused; }
 
@@ -111,6 +124,9 @@ private:
 
 	void CheckFullBuffer();
 
+	// pops all samples into the sink when there is no device
+	void DrainToSink();
+
 	void ClearInternal();
 
 	// pop samples from queue to output iterator
@@ -123,6 +139,8 @@ private:
 private:
 	SDL_AudioDeviceID m_deviceId = 0;
 	SDL_AudioSpec m_settings = {};
+	Sink m_sink;
+	bool m_withoutDevice = false;
 	bool m_paused = false;
 	bool m_waitForFullBuffer = true;
 
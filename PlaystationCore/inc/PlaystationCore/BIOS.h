@@ -20,4 +20,7 @@ void LogKernalCallB( uint32_t call, uint32_t pc );
 void LogKernalCallC( uint32_t call, uint32_t pc );
 void LogSystemCall( uint32_t arg0, uint32_t pc );
 
+// name of a kernel function called through the A, B or C vector. Null if unknown
+const char* GetKernelFunctionName( uint32_t vector, uint32_t call );
+
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Defs.h"
+
+#include <array>
+#include <optional>
+#include <utility>
+
+namespace PSX
+{
+
+// runs hot kernel functions natively on guest memory instead of interpreting the BIOS.
+// Calls that hit an edge case the BIOS handles differently (null pointers, ranges outside RAM, patched function tables) fall back to the BIOS
+class BiosHle
+{
+public:
+	enum class Function : uint8_t
+	{
+		Memcpy, // A(2Ah)
+		Memset, // A(2Bh)
+		Bzero, // A(28h)
+		Strcmp, // A(17h)
+		Strlen, // A(1Bh)
+		Strcpy, // A(19h)
+		Rand, // A(2Fh) rand and A(30h) srand. The seed isn't shared with the BIOS
+		Heap, // A(39h) InitHeap, A(33h) malloc, A(34h) free, A(37h) calloc, A(38h) realloc. Takes effect at the next InitHeap
+		TestEvent, // B(0Bh)
+		WaitEvent, // B(0Ah). Only when the event is already ready
+
+		Count
+	};
+
+	static constexpr size_t FunctionCount = static_cast<size_t>( Function::Count );
+
+	using CallCounts = std::array<uint32_t, FunctionCount>;
+
+	struct Result
+	{
+		uint32_t value; // for $v0
+		cycles_t cycles; // time the BIOS code takes, including the call
+	};
+
+	BiosHle( MemoryMap& memoryMap, CodeCache& codeCache );
+
+	void Reset();
+
+	// vector is the physical address of the kernel call vector and call is the function number in $t1.
+	// Returns the value for $v0 and the cycles to charge if the call was handled
+	std::optional<Result> Call( uint32_t vector, uint32_t call, const std::array<uint32_t, 4>& args ) noexcept;
+
+	// runs a function for a statically linked library replacement. call is the kernel call number, which picks rand or srand,
+	// and seedAddress is where the library keeps its rand seed. Returns the value for $v0 and its cycles if it was handled
+	std::optional<Result> CallLibraryFunction( Function function, uint32_t call, uint32_t seedAddress, const std::array<uint32_t, 4>& args ) noexcept;
+
+	// memory, string and random number functions can replace library code
+	static bool IsLibraryFunction( Function function ) noexcept;
+
+	void SetEnabled( Function function, bool enable ) noexcept { m_enabled[ static_cast<size_t>( function ) ] = enable; }
+
+	bool IsEnabled( Function function ) const noexcept { return m_enabled[ static_cast<size_t>( function ) ]; }
+
+	const CallCounts& GetCallCounts() const noexcept { return m_callCounts; }
+
+	void LogCallCounts() const;
+
+	static const char* GetFunctionName( Function function ) noexcept;
+
+	void Serialize( SaveStateSerializer& serializer );
+
+private:
+	// function handled by the call, if any
+	static std::optional<Function> GetFunction( uint32_t vector, uint32_t call ) noexcept;
+
+	std::optional<Result> CallFunction( Function function, uint32_t call, const std::array<uint32_t, 4>& args ) noexcept;
+
+	// games can install their own functions in the kernel tables
+	bool IsKernelFunction( uint32_t vector, uint32_t call ) const noexcept;
+
+	// host pointer to guest memory and the number of contiguous bytes after it
+	std::pair<const uint8_t*, uint32_t> GetReadRegion( uint32_t address ) const noexcept;
+
+	// host pointers to guest memory. Null unless the whole range is contiguous
+	const uint8_t* GetReadPointer( uint32_t address, uint32_t size ) const noexcept;
+	uint8_t* GetWritePointer( uint32_t address, uint32_t size ) noexcept; // RAM only. Invalidates code
+
+	std::optional<Result> Memcpy( uint32_t dest, uint32_t src, uint32_t size ) noexcept;
+	std::optional<Result> Memset( uint32_t dest, uint8_t value, uint32_t size ) noexcept;
+	std::optional<Result> Strcmp( uint32_t lhs, uint32_t rhs ) noexcept;
+	std::optional<Result> Strlen( uint32_t str ) noexcept;
+	std::optional<Result> Strcpy( uint32_t dest, uint32_t src ) noexcept;
+
+	// rand and srand on a seed in guest RAM
+	std::optional<Result> LibraryRand( uint32_t call, uint32_t seedAddress, uint32_t seed ) noexcept;
+
+	std::optional<uint32_t> InitHeap( uint32_t address, uint32_t size ) noexcept;
+	Result Malloc( uint32_t size ) noexcept;
+	void Free( uint32_t address ) noexcept;
+	Result Calloc( uint32_t count, uint32_t size ) noexcept;
+	Result Realloc( uint32_t address, uint32_t size ) noexcept;
+
+	// RAM offset of the block header for an allocation
+	std::optional<uint32_t> GetHeapBlock( uint32_t address ) const noexcept;
+
+	void WriteHeapHeader( uint32_t offset, uint32_t header ) noexcept;
+
+	std::optional<uint32_t> TestEvent( uint32_t event, bool wait ) noexcept;
+
+private:
+	MemoryMap& m_memoryMap;
+	CodeCache& m_codeCache;
+
+	std::array<bool, FunctionCount> m_enabled;
+	CallCounts m_callCounts{};
+
+	uint32_t m_randomSeed = 0;
+
+	// heap blocks are a 4 byte header holding the payload size and a used bit, followed by the payload
+	uint32_t m_heapBase = 0; // virtual address of RAM offset 0 in the mirror passed to InitHeap
+	uint32_t m_heapStart = 0; // RAM offsets
+	uint32_t m_heapEnd = 0; // zero if the BIOS owns the heap
+};
+
+}
\ No newline at end of file
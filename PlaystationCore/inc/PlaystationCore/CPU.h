@@ -2,40 +2,70 @@
 
 #include "Defs.h"
 
+#include "BiosHle.h"
+#include "CodeCache.h"
 #include "Cop0.h"
 #include "GTE.h"
 #include "Instruction.h"
+#include "LibraryHle.h"
 #include "MemoryMap.h"
+#include "Profiler.h"
+#include "Recompiler.h"
 
 #include <array>
-#include <filesystem>
 #include <optional>
 #include <string>
-
-namespace fs = std::filesystem;
+#include <utility>
+#include <vector>
 
 namespace PSX
 {
 
 class MipsR3000Cpu
 {
+	friend class Profiler;
+	friend class Recompiler;
+
 public:
 
 	bool EnableKernelLogging = false;
 	bool EnableCpuLogging = false;
 	bool EnableBiosIntercept = true;
+	bool EnableBiosHle = true; // run hot kernel functions natively. Disabled by kernel logging so every call is logged
+	bool EnableLibraryHle = true; // run library functions matching loaded signatures natively. Only used by cached and recompiled blocks
+	bool EnableCachedInterpreter = false;
+	bool EnableRecompiler = false; // falls back to the cached interpreter if the host isn't supported
+	bool EnableRecompilerLockstep = false; // check recompiled instructions against the interpreter. Very slow
+	bool EnableIdleLoopSkip = true; // fast forward loops that poll memory until the next event. Only used by cached and recompiled blocks
+
+	struct IdleLoopStats
+	{
+		uint32_t loopsDetected = 0; // blocks compiled as idle loops
+		uint32_t loopsSkipped = 0;
+		cycles_t cyclesSkipped = 0;
+	};
 
-	MipsR3000Cpu( MemoryMap& memoryMap, InterruptControl& interruptControl, EventManager& eventManager )
+	MipsR3000Cpu( MemoryMap& memoryMap, InterruptControl& interruptControl, EventManager& eventManager, CodeCache& codeCache )
 		: m_memoryMap{ memoryMap }
 		, m_interruptControl{ interruptControl }
 		, m_eventManager{ eventManager }
+		, m_codeCache{ codeCache }
 		, m_cop0{ interruptControl }
+		, m_recompiler{ *this, codeCache, eventManager }
+		, m_biosHle{ memoryMap, codeCache }
+		, m_libraryHle{ memoryMap, m_biosHle }
+		, m_profiler{ *this, eventManager }
 	{}
 
 	void Reset();
 
 	void RunUntilEvent() noexcept;
 
+	void EndFrame() noexcept;
+
+	// idle loop stats from the last completed frame
+	const IdleLoopStats& GetIdleLoopStats() const noexcept { return m_lastFrameIdleLoopStats; }
+
 	void DebugSetProgramCounter( uint32_t address )
 	{
 		SetProgramCounter( address );
@@ -52,11 +82,36 @@ public:
 
 	uint32_t GetPC() const noexcept { return m_pc; }
 
-	void SetHookExecutable( fs::path filename )
+	// drop decoded blocks after RAM is modified behind the memory map's back
+	void InvalidateCodeCache() noexcept;
+
+	BiosHle& GetBiosHle() noexcept { return m_biosHle; }
+
+	LibraryHle& GetLibraryHle() noexcept { return m_libraryHle; }
+
+	GTE& GetGte() noexcept { return m_gte; }
+
+	// sample guest code and track calls until stopped. Flushes compiled code so blocks are rebuilt with call tracking.
+	// Must not be called while the CPU is running
+	void StartProfiler( cycles_t sampleInterval = Profiler::DefaultSampleInterval );
+	void StopProfiler();
+
+	Profiler& GetProfiler() noexcept { return m_profiler; }
+
+	// recompiled loads and stores access RAM through the fastmem window when set
+	void SetFastmem( Fastmem* fastmem ) noexcept
+	{
+		m_recompiler.SetFastmem( fastmem );
+	}
+
+	// load executable in place of the shell once the BIOS has initialized the kernel. Survives reset
+	void SetBootExecutable( std::vector<uint8_t> exe ) noexcept
 	{
-		m_exeFilename = std::move( filename );
+		m_bootExecutable = std::move( exe );
 	}
 
+	bool HasBootExecutable() const noexcept { return !m_bootExecutable.empty(); }
+
 	void Serialize( SaveStateSerializer& serializer );
 
 private:
@@ -64,10 +119,12 @@ private:
 	static constexpr uint32_t ResetVector = 0xbfc00000;
 	static constexpr uint32_t DebugBreakVector = 0x80000040; // COP0 break
 	static constexpr uint32_t InterruptVector = 0x80000080; // used for general interrupts and exceptions
-	static constexpr uint32_t HookAddress = 0x80030000; // address at which an exe can be loaded
+	static constexpr uint32_t HookAddress = 0x80030000; // shell entry point. The boot executable is loaded here
 
 	class Registers
 	{
+		friend class Recompiler;
+
 	public:
 		enum : uint32_t
 		{
@@ -166,6 +223,10 @@ private:
 		LoadDelay					m_newLoadDelay;
 	};
 
+private:
+
+	using InstructionFunction = void( MipsR3000Cpu::* )( Instruction ) noexcept;
+
 private:
 	// skip instruction in branch delay slot and flush pipeline
 	void SetProgramCounter( uint32_t address )
@@ -179,10 +240,134 @@ private:
 		m_registers.Flush();
 	}
 
+	static constexpr bool IsKernelCallVector( uint32_t address ) noexcept
+	{
+		address &= 0x1fffffff;
+		return address == 0xa0 || address == 0xb0 || address == 0xc0;
+	}
+
 	void InterceptBios( uint32_t pc );
 
+	// run the kernel function at the current PC natively and return to $ra. Returns false if the BIOS must run it
+	bool TryBiosHle() noexcept;
+
+	// the PC reached a kernel call vector. Returns true if the call ran natively
+	template <uint32_t Features>
+	bool OnKernelCall() noexcept;
+
+	// the PC reached a library function found by its signature. Returns true if the call ran natively
+	template <uint32_t Features>
+	bool OnLibraryCall( uint32_t signatureIndex ) noexcept;
+
+	// arguments must not be waiting on a load and native functions bypass the cache
+	bool CanCallNatively() const noexcept;
+
+	std::array<uint32_t, 4> GetCallArguments() const noexcept
+	{
+		return { m_registers[ Registers::Arg0 ], m_registers[ Registers::Arg1 ], m_registers[ Registers::Arg2 ], m_registers[ Registers::Arg3 ] };
+	}
+
+	// sets $v0, returns to $ra and charges the cycles the guest code would have taken
+	void ReturnFromNativeCall( const BiosHle::Result& result ) noexcept;
+
+	// jump to the boot executable instead of the shell
+	void LoadBootExecutable() noexcept;
+
+	// run loops are specialized on the execution mode and debug features so disabled features cost nothing per instruction
+	struct RunFeature
+	{
+		enum : uint32_t
+		{
+			CachedInterpreter = 1 << 0,
+			Recompiler = 1 << 1,
+			CpuLogging = 1 << 2, // interpreter only. Blocks don't log instructions
+			BiosIntercept = 1 << 3,
+			BootExecutable = 1 << 4,
+			Profiler = 1 << 5,
+
+			All = ( 1 << 6 ) - 1
+		};
+	};
+
+	using RunFunction = void ( MipsR3000Cpu::* )() noexcept;
+
+	// features selected by the Enable flags and pending executable
+	uint32_t GetRunFeatures() const noexcept;
+
+	static RunFunction GetRunFunction( uint32_t features ) noexcept;
+
+	template <uint32_t Features>
+	static constexpr RunFunction SelectRunFunction() noexcept;
+
+	template <size_t... Features>
+	static constexpr std::array<RunFunction, sizeof...( Features )> MakeRunFunctionTable( std::index_sequence<Features...> ) noexcept;
+
+	// raises a pending interrupt before the run. Interrupt sources stop the run when an interrupt becomes pending
+	template <uint32_t Features>
+	void CheckInterrupts() noexcept;
+
+	template <uint32_t Features>
+	void RunInterpreter() noexcept;
+
+	template <uint32_t Features>
+	void RunCachedInterpreter() noexcept;
+
+	template <uint32_t Features>
+	void RunRecompiler() noexcept;
+
+	// fetch and execute the next instruction through the interpreter
+	template <uint32_t Features>
+	void StepInstruction() noexcept;
+
+	template <uint32_t Features>
 	void ExecuteInstruction( Instruction instr ) noexcept;
 
+	// pipeline update and ExecuteInstruction without fetching. Used to verify the recompiler
+	void ExecuteReferenceInstruction( Instruction instr ) noexcept;
+
+	// decode a basic block starting at pc. Returns null if the first instruction can't be fetched
+	CodeBlock* CompileBlock( uint32_t pc );
+
+	void ExecuteBlock( const CodeBlock& block ) noexcept;
+
+	static CachedInstructionHandler DecodeCachedHandler( Instruction instr ) noexcept;
+
+	// calls and register jumps also update the profiler's call stack
+	static CachedInstructionHandler DecodeProfiledHandler( Instruction instr ) noexcept;
+
+	// handler table layout. SPECIAL and REGIMM instructions have their own ranges indexed by funct and rt so every instruction is a single lookup
+	static constexpr size_t SpecialHandlerOffset = 64;
+	static constexpr size_t RegImmHandlerOffset = SpecialHandlerOffset + 64;
+	static constexpr size_t HandlerTableSize = RegImmHandlerOffset + 32;
+
+	using HandlerTable = std::array<CachedInstructionHandler, HandlerTableSize>;
+
+	static constexpr HandlerTable MakeHandlerTable() noexcept;
+
+	static size_t GetHandlerIndex( Instruction instr ) noexcept;
+
+	enum class BlockEnd
+	{
+		None,
+		AfterInstruction,
+		AfterDelaySlot
+	};
+
+	static BlockEnd GetBlockEnd( Instruction instr ) noexcept;
+
+	// block is a short backwards loop to its own start. Loops may only load, do simple ALU operations and branch.
+	// Registers they write can't be read before being written in the same iteration, so every iteration is the same until memory changes
+	static bool IsIdleLoop( const CodeBlock& block ) noexcept;
+
+	// called when an idle loop block just branched back to itself. Skips to the next event if the loop only reads RAM or interrupt status
+	bool TrySkipIdleLoop( const CodeBlock& block ) noexcept;
+
+	template <InstructionFunction Function>
+	static void CachedHandler( MipsR3000Cpu& cpu, Instruction instr ) noexcept
+	{
+		( cpu.*Function )( instr );
+	}
+
 	void AddTrap( uint32_t x, uint32_t y, uint32_t destRegister ) noexcept;
 
 	void SubtractTrap( uint32_t x, uint32_t y, uint32_t destRegister ) noexcept;
@@ -211,12 +396,6 @@ private:
 
 private: // instructions
 
-	// SPECIAL
-	void Special( Instruction ) noexcept;
-
-	// REGIMM
-	void RegisterImmediate( Instruction ) noexcept;
-
 	// COPz
 	void CoprocessorUnit( Instruction ) noexcept;
 
@@ -417,18 +596,27 @@ private: // instructions
 
 	void IllegalInstruction( Instruction ) noexcept;
 
-private:
-
-	using InstructionFunction = void( MipsR3000Cpu::* )( Instruction ) noexcept;
+	// JAL, JALR and JR with call tracking
+	void ProfiledJumpAndLink( Instruction ) noexcept;
+	void ProfiledJumpAndLinkRegister( Instruction ) noexcept;
+	void ProfiledJumpRegister( Instruction ) noexcept;
 
 private:
 	MemoryMap& m_memoryMap;
 	InterruptControl& m_interruptControl;
 	EventManager& m_eventManager;
+	CodeCache& m_codeCache;
 
 	Cop0 m_cop0;
 	GTE m_gte;
 
+	Recompiler m_recompiler;
+
+	BiosHle m_biosHle;
+	LibraryHle m_libraryHle;
+
+	Profiler m_profiler;
+
 	Registers m_registers;
 
 	uint32_t m_currentPC = 0; // pc of instruction being executed
@@ -443,8 +631,14 @@ private:
 
 	std::string m_consoleOutput; // flushes on newline character
 
+	IdleLoopStats m_idleLoopStats;
+	IdleLoopStats m_lastFrameIdleLoopStats;
+
 	// not serialized
-	fs::path m_exeFilename;
+	std::vector<uint8_t> m_bootExecutable;
+
+	uint32_t m_runFeatures = ~0u; // features m_runFunction is specialized for
+	RunFunction m_runFunction = nullptr;
 };
 
 inline void MipsR3000Cpu::CheckProgramCounterAlignment() noexcept
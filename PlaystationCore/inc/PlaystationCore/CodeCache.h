@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Defs.h"
+#include "Instruction.h"
+#include "MemoryMap.h"
+#include "RAM.h"
+
+#include <stdx/assert.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace PSX
+{
+
+using CachedInstructionHandler = void( * )( MipsR3000Cpu&, Instruction ) noexcept;
+
+struct CachedInstruction
+{
+	CachedInstructionHandler handler = nullptr;
+	Instruction instruction;
+};
+
+// exit from a recompiled block that can be patched to jump directly into the next block
+struct CodeBlockLink
+{
+	CodeBlock* source = nullptr; // null once the source block is invalidated
+	CodeBlock* target = nullptr; // null while unlinked
+	uint32_t targetPC = 0;
+	uint8_t* jumpOperand = nullptr; // rel32 operand of the patchable jump
+	const uint8_t* unlinkedTarget = nullptr; // returns the link to the dispatcher
+};
+
+// basic block decoded once and executed many times by the cached interpreter
+struct CodeBlock
+{
+	uint32_t key = 0; // physical address of first instruction (RAM mirrors folded)
+	std::vector<CachedInstruction> instructions;
+
+	// short loop that branches back to its own start and only polls memory. See MipsR3000Cpu::IsIdleLoop
+	bool idleLoop = false;
+
+	// signature of the library function starting at this block, run natively by the dispatcher. See LibraryHle
+	std::optional<uint32_t> libraryFunction;
+
+	// filled in by the recompiler
+	const uint8_t* hostCode = nullptr;
+	uint32_t hostPC = 0; // virtual address the native code was generated for
+	std::vector<std::unique_ptr<CodeBlockLink>> exitLinks;
+	std::vector<CodeBlockLink*> incomingLinks;
+
+	uint32_t GetInstructionCount() const noexcept { return static_cast<uint32_t>( instructions.size() ); }
+
+	uint32_t GetByteSize() const noexcept { return GetInstructionCount() * 4; }
+};
+
+using InvalidateBlockCallback = std::function<void( CodeBlock& )>;
+
+class CodeCache
+{
+public:
+	static constexpr uint32_t PageSize = 4 * 1024;
+	static constexpr uint32_t RamPageCount = RamSize / PageSize;
+
+	// blocks normally end at a branch, but straight-line code still needs a limit
+	static constexpr uint32_t MaxBlockInstructions = 128;
+
+	// KUSEG, KSEG0, KSEG1 and the RAM mirrors all share the same blocks
+	static constexpr uint32_t GetBlockKey( uint32_t address ) noexcept
+	{
+		address &= 0x1fffffff;
+		return ( address < MemoryMap::RamMirrorSize ) ? ( address & RamAddressMask ) : address;
+	}
+
+	static constexpr bool IsRamKey( uint32_t key ) noexcept
+	{
+		return key < RamSize;
+	}
+
+	CodeCache() = default;
+	CodeCache( const CodeCache& ) = delete;
+	CodeCache& operator=( const CodeCache& ) = delete;
+
+	// called before a block is retired so native code can stop jumping into it
+	void SetInvalidateBlockCallback( InvalidateBlockCallback callback )
+	{
+		m_invalidateBlockCallback = std::move( callback );
+	}
+
+	// destroy all blocks. Must not be called while a block is executing
+	void Reset();
+
+	CodeBlock* FindBlock( uint32_t key ) noexcept
+	{
+		auto it = m_blocks.find( key );
+		return ( it != m_blocks.end() ) ? it->second.get() : nullptr;
+	}
+
+	CodeBlock* InsertBlock( std::unique_ptr<CodeBlock> block );
+
+	// invalidate blocks overlapping written RAM. Offset is relative to the start of RAM
+	void InvalidateRam( uint32_t offset, uint32_t size ) noexcept
+	{
+		dbExpects( size > 0 );
+		const uint32_t firstPage = offset / PageSize;
+		const uint32_t lastPage = ( offset + size - 1 ) / PageSize;
+		for ( uint32_t page = firstPage; page <= lastPage; ++page )
+		{
+			if ( STDX_unlikely( m_pageHasCode[ page % RamPageCount ] ) )
+				InvalidatePage( page % RamPageCount );
+		}
+	}
+
+	// used when the instruction cache is flushed
+	void InvalidateAllRam();
+
+	// invalidated blocks are kept alive until the CPU is no longer executing them
+	void ReleaseInvalidatedBlocks() noexcept
+	{
+		if ( !m_invalidatedBlocks.empty() )
+			m_invalidatedBlocks.clear();
+	}
+
+	size_t GetBlockCount() const noexcept { return m_blocks.size(); }
+
+	// non-zero for RAM pages that contain code. Native stores check this before bypassing InvalidateRam
+	const uint8_t* GetRamPageCodeFlags() const noexcept { return m_pageHasCode.data(); }
+
+private:
+	void InvalidatePage( uint32_t page );
+
+	void RemoveFromPages( const CodeBlock* block, uint32_t skipPage );
+
+	static uint32_t GetFirstPage( const CodeBlock& block ) noexcept { return block.key / PageSize; }
+
+	static uint32_t GetLastPage( const CodeBlock& block ) noexcept { return ( block.key + block.GetByteSize() - 1 ) / PageSize; }
+
+private:
+	std::unordered_map<uint32_t, std::unique_ptr<CodeBlock>> m_blocks;
+
+	// blocks that contain code from each RAM page. BIOS blocks are never invalidated
+	std::array<std::vector<CodeBlock*>, RamPageCount> m_pageBlocks;
+	std::array<uint8_t, RamPageCount> m_pageHasCode{};
+
+	std::vector<std::unique_ptr<CodeBlock>> m_invalidatedBlocks;
+
+	InvalidateBlockCallback m_invalidateBlockCallback;
+};
+
+}
\ No newline at end of file
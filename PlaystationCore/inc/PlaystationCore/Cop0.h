@@ -14,6 +14,8 @@ class SaveStateSerializer;
 
 class Cop0
 {
+	friend class Recompiler;
+
 public:
 	enum class Register : uint32_t
 	{
@@ -137,7 +139,6 @@ public:
 
 	STDX_forceinline bool ShouldTriggerInterrupt() const noexcept
 	{
-		// TODO: cache result when state changes
 		return GetInterruptEnable() && ( m_systemStatus & GetExceptionCause() & SystemStatus::InterruptMask );
 	}
 
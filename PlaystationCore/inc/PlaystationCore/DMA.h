@@ -36,6 +36,7 @@ public:
 
 public:
 	Dma( Ram& ram,
+		CodeCache& codeCache,
 		Gpu& gpu,
 		CDRomDrive& cdromDRive,
 		MacroblockDecoder& mdec,
@@ -208,6 +209,7 @@ private:
 
 private:
 	Ram& m_ram;
+	CodeCache& m_codeCache;
 	Gpu& m_gpu;
 	CDRomDrive& m_cdromDrive;
 	MacroblockDecoder& m_mdec;
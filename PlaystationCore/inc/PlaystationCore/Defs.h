@@ -6,10 +6,6 @@
 #include <limits>
 #include <memory>
 
-#ifndef STDX_SHIPPING
-#define PSX_HOOK_EXE
-#endif
-
 #ifndef STDX_SHIPPING
 #define PSX_HOOK_BIOS
 #endif
@@ -21,13 +17,18 @@ namespace PSX
 
 using cycles_t = int32_t;
 
+// absolute cycle count since the event manager was created. Never wraps
+using timestamp_t = int64_t;
+
 constexpr cycles_t InfiniteCycles = std::numeric_limits<cycles_t>::max();
 
 constexpr cycles_t CpuCyclesPerSecond = 44100 * 0x300; // 33868800
 
+class BiosHle;
 class Event;
 class EventManager;
 class CDRom;
+class CodeCache;
 class CDRomDrive;
 class Controller;
 class ControllerPorts;
@@ -35,7 +36,10 @@ class Dma;
 class DualSerialPort;
 class Event;
 class EventManager;
+class EventTelemetry;
+class Fastmem;
 class Gpu;
+class GpuCaptureRenderer;
 class InterruptControl;
 class MacroblockDecoder;
 class MemoryCard;
@@ -43,6 +47,7 @@ class MemoryControl;
 class MemoryMap;
 class MipsR3000Cpu;
 class Playstation;
+class Recompiler;
 class Renderer;
 class SaveStateSerializer;
 class SerialPort;
@@ -55,6 +60,7 @@ using Bios = Memory<512 * 1024>;
 using Ram = Memory<2 * 1024 * 1024>;
 using Scratchpad = Memory<1024>;
 
+struct CodeBlock;
 struct Instruction;
 
 using EventHandle = std::unique_ptr<Event>;
@@ -66,6 +72,13 @@ enum class ControllerType
 	Analog
 };
 
+enum class RendererType
+{
+	OpenGL,
+	Software, // CPU rasterizer at native resolution
+	Null // keeps VRAM transfers for reads back, draws nothing
+};
+
 template <size_t N, typename To, typename From>
 inline constexpr To SignExtend( From value ) noexcept
 {
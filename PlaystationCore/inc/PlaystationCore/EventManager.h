@@ -3,17 +3,44 @@
 #include "Defs.h"
 
 #include <algorithm>
-#include <functional>
 #include <memory>
+#include <new>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace PSX
 {
 
 using EventHandle = std::unique_ptr<Event>;
 
-using EventUpdateCallback = std::function<void( cycles_t )>;
+// non-allocating callback for event updates. Holds callables up to two pointers in size, like lambdas capturing this
+class EventUpdateCallback
+{
+public:
+	template <typename F>
+	EventUpdateCallback( F function ) noexcept
+	{
+		static_assert( sizeof( F ) <= sizeof( m_storage ) && alignof( F ) <= alignof( Storage ) );
+		static_assert( std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F> );
+
+		new ( &m_storage ) F( function );
+		m_invoke = []( void* storage, cycles_t cycles ) { ( *static_cast<F*>( storage ) )( cycles ); };
+	}
+
+	void operator()( cycles_t cycles )
+	{
+		m_invoke( &m_storage, cycles );
+	}
+
+private:
+	using Storage = std::aligned_storage_t<2 * sizeof( void* ), alignof( void* )>;
+	using InvokeFunction = void( * )( void*, cycles_t );
+
+	Storage m_storage;
+	InvokeFunction m_invoke;
+};
 
 class EventManager;
 
@@ -72,45 +99,46 @@ public:
 	void Serialize( SaveStateSerializer& serializer );
 
 private:
-	Event( EventManager& manager, std::string name, EventUpdateCallback onUpdate )
+	static constexpr uint32_t NoTelemetryId = std::numeric_limits<uint32_t>::max();
+
+	Event( EventManager& manager, std::string name, EventUpdateCallback onUpdate, size_t index )
 		: m_manager{ manager }
 		, m_name{ std::move( name ) }
-		, m_onUpdate{ std::move( onUpdate ) }
+		, m_onUpdate{ onUpdate }
+		, m_index{ index }
 	{}
 
-	// Adds pending cycles, but doesn't invoke update callbacks
-	void AddPendingCycles( cycles_t cycles )
-	{
-		if ( m_active )
-			m_pendingCycles += cycles;
-	}
-
 	// Update event with given cycles. Called by EventManager
 	void Update( cycles_t cycles );
 
+	timestamp_t GetDueTime() const noexcept { return m_lastUpdateTime + m_cyclesUntilEvent; }
+
 	// Get remaining cycles until event triggers (will be negative if event is late) (does not include pending cycles in event manager)
-	cycles_t GetLocalRemainingCycles() const noexcept
-	{
-		dbExpects( ( m_cyclesUntilEvent >= m_pendingCycles ) == ( m_cyclesUntilEvent - m_pendingCycles >= 0 ) );
-		return m_cyclesUntilEvent - m_pendingCycles;
-	}
+	cycles_t GetLocalRemainingCycles() const noexcept;
 
 private:
 	EventManager& m_manager;
 	std::string m_name;
 	EventUpdateCallback m_onUpdate;
 
-	cycles_t m_cyclesUntilEvent = 0;
-	cycles_t m_pendingCycles = 0;
+	timestamp_t m_lastUpdateTime = 0; // valid while active
+	cycles_t m_cyclesUntilEvent = 0; // from the last update
+	cycles_t m_pausedCycles = 0; // cycles since the last update while paused
+
+	size_t m_index; // in the event manager
+	uint32_t m_telemetryId = NoTelemetryId; // assigned on the first update with telemetry enabled
 	bool m_active = false;
 };
 
 class EventManager
 {
 	friend class Event;
+	friend class Recompiler; // native code updates pending cycles directly
 
 public:
-	EventManager() = default;
+	static constexpr uint32_t StockCpuClock = 100; // percent
+
+	EventManager();
 	~EventManager();
 
 	void Reset();
@@ -132,51 +160,132 @@ public:
 		m_pendingCycles += cycles;
 	}
 
-	void AddCyclesAndUpdateEvents( cycles_t cycles ) noexcept
+	// stalls the CPU for cycles at the stock clock, like a DMA transfer
+	void AddSystemCyclesAndUpdateEvents( cycles_t cycles ) noexcept
 	{
-		AddCycles( cycles );
+		AddCycles( GetCpuCyclesUntil( GetPendingSystemCycles() + cycles ) - m_pendingCycles );
 		if ( ReadyForNextEvent() )
 			UpdateNextEvent();
 	}
 
+	// CPU cycles run since the last event update
 	inline cycles_t GetPendingCycles() const noexcept
 	{
 		return m_pendingCycles;
 	}
 
+	// in system cycles
+	inline timestamp_t GetCurrentTime() const noexcept
+	{
+		return m_currentTime + GetPendingSystemCycles();
+	}
+
+	// fast forward to the next event. Returns the number of cycles skipped
+	inline cycles_t SkipToNextEvent() noexcept
+	{
+		const cycles_t cycles = std::max<cycles_t>( m_cyclesUntilNextEvent - m_pendingCycles, 0 );
+		m_pendingCycles += cycles;
+		return cycles;
+	}
+
+	// ends the CPU run before the next event. The CPU checks for interrupts before every run
+	void StopRun() noexcept
+	{
+		m_stopRun = true;
+		m_cyclesUntilNextEvent = 0;
+	}
+
+	void StartRun() noexcept
+	{
+		if ( m_stopRun )
+		{
+			m_stopRun = false;
+			UpdateCyclesUntilNextEvent();
+		}
+	}
+
 	inline void AddGteCycles( cycles_t cycles ) noexcept
 	{
 		m_cyclesUntilGteComplete = m_pendingCycles + cycles;
 	}
 
-	inline void StallUntilGteComplete() noexcept
+	// returns the cycles stalled
+	inline cycles_t StallUntilGteComplete() noexcept
 	{
-		m_pendingCycles = std::max( m_pendingCycles, m_cyclesUntilGteComplete );
+		const cycles_t stallCycles = std::max<cycles_t>( m_cyclesUntilGteComplete - m_pendingCycles, 0 );
+		m_pendingCycles += stallCycles;
+		return stallCycles;
 	}
 
+	// CPU clock as a percentage of the stock clock. Other devices keep stock timing, so the CPU runs more instructions between events
+	void SetCpuClock( uint32_t percent ) noexcept;
+
+	uint32_t GetCpuClock() const noexcept { return m_cpuClock; }
+
 	void EndFrame();
 
 	void Serialize( SaveStateSerializer& serializer );
 
+	// record per frame statistics for each event. Costs a clock read around every event update while enabled. Disabling drops the statistics
+	void EnableTelemetry( bool enable );
+
+	EventTelemetry* GetTelemetry() noexcept { return m_telemetry.get(); }
+
 private:
-	void ScheduleNextEvent( const Event* event );
+	// records the due time of the changed event and caches the next event
+	void ScheduleNextEvent( Event* changedEvent );
 
 	void UpdateEvent( Event* event, cycles_t cycles );
 
+	void UpdateEventWithTelemetry( Event* event, cycles_t cycles );
+
 	void RemoveEvent( Event* event );
 
-	std::pair<size_t, cycles_t> FindNextEvent() const;
+	// full scan for the earliest due time. Ties go to the oldest event
+	void FindNextEvent();
+
+	// ignores stopped runs
+	bool NextEventDue() const noexcept;
+
+	void UpdateCyclesUntilNextEvent() noexcept;
+
+	// moves pending CPU cycles to the current time
+	void CommitPendingCycles() noexcept;
+
+	// pending CPU cycles converted to system cycles. Rounds down, the remainder is kept in the fraction
+	cycles_t GetPendingSystemCycles() const noexcept
+	{
+		return static_cast<cycles_t>( ( static_cast<int64_t>( m_pendingCycles ) * m_systemCyclesPerCpuCycle + m_systemCycleFraction ) >> SystemCycleFractionBits );
+	}
+
+	// CPU cycles from the current time until the given system cycles have passed. Rounds up
+	cycles_t GetCpuCyclesUntil( cycles_t systemCycles ) const noexcept;
+
+	void UpdateSystemCyclesPerCpuCycle() noexcept;
 
 private:
-	cycles_t m_cyclesUntilNextEvent = 0; // cached from event
-	cycles_t m_pendingCycles = 0;
+	static constexpr uint32_t SystemCycleFractionBits = 16;
+
+	cycles_t m_cyclesUntilNextEvent = 0; // CPU cycles cached from event, 0 while the run is stopped
+	cycles_t m_pendingCycles = 0; // CPU cycles run since m_currentTime
 	cycles_t m_cyclesUntilGteComplete = 0; // need to stall CPU until GTE commands are complete. Events are too much for this
-	cycles_t m_cyclesThisFrame = 0;
+	cycles_t m_cyclesThisFrame = 0; // CPU cycles
+
+	timestamp_t m_currentTime = 0; // system cycles, advanced when events are updated
+
+	uint32_t m_cpuClock = StockCpuClock;
+	int64_t m_systemCyclesPerCpuCycle = int64_t( 1 ) << SystemCycleFractionBits; // fixed point
+	int64_t m_systemCycleFraction = 0; // of committed CPU cycles
 
 	std::vector<Event*> m_events;
+	std::vector<timestamp_t> m_dueTimes; // per event in m_events, MaxTimestamp when inactive
 	Event* m_nextEvent = nullptr;
+	bool m_nextEventChanged = false; // the cached next event is stale after an event changed during an update
 
 	bool m_updating = false;
+	bool m_stopRun = false;
+
+	std::unique_ptr<EventTelemetry> m_telemetry; // null when disabled
 };
 
 }
\ No newline at end of file
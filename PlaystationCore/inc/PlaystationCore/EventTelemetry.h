@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Defs.h"
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace PSX
+{
+
+// per frame scheduler statistics for each event name, plus named counters from other systems. Owned by the event manager while enabled
+class EventTelemetry
+{
+public:
+	// lateness buckets are powers of two: 0, 1, 2-3, 4-7 ... 1024+
+	static constexpr size_t LatenessBucketCount = 12;
+
+	static constexpr size_t DefaultMaxFrames = 60 * 60;
+
+	struct EventStats
+	{
+		uint32_t fires = 0; // callbacks at the scheduled time
+		uint32_t earlyUpdates = 0; // callbacks from Event::UpdateEarly before the scheduled time
+		cycles_t maxLateness = 0;
+		int64_t totalLateness = 0; // cycles between the scheduled time and the callback, summed over fires
+		int64_t hostNanoseconds = 0; // time spent in callbacks
+		std::array<uint32_t, LatenessBucketCount> latenessHistogram{};
+
+		EventStats& operator+=( const EventStats& other ) noexcept;
+	};
+
+	struct FrameStats
+	{
+		uint64_t frame = 0; // counted from when telemetry was enabled
+		cycles_t cycles = 0;
+		std::vector<EventStats> events; // indexed by event ID
+		std::vector<int64_t> counters; // indexed by counter ID
+	};
+
+	explicit EventTelemetry( size_t maxFrames = DefaultMaxFrames );
+
+	// IDs are stable. Events recreated with the same name share an ID
+	uint32_t RegisterEvent( const std::string& name );
+
+	void RecordFire( uint32_t eventId, cycles_t lateness, std::chrono::nanoseconds hostTime ) noexcept;
+	void RecordEarlyUpdate( uint32_t eventId, std::chrono::nanoseconds hostTime ) noexcept;
+
+	// adds to a named counter in the frame in progress. Counters are registered on first use with stable IDs like events
+	void AddCounter( std::string_view name, int64_t value );
+
+	void EndFrame( cycles_t cycles );
+
+	void Clear();
+
+	const std::vector<std::string>& GetEventNames() const noexcept { return m_eventNames; }
+	std::optional<uint32_t> FindEventId( std::string_view name ) const;
+
+	const std::vector<std::string>& GetCounterNames() const noexcept { return m_counterNames; }
+
+	// completed frames, oldest first. Only the last maxFrames are kept
+	size_t GetFrameCount() const noexcept { return m_frames.size(); }
+	const FrameStats& GetFrame( size_t index ) const noexcept { return m_frames[ index ]; }
+
+	// the frame in progress
+	const FrameStats& GetCurrentFrame() const noexcept { return m_currentFrame; }
+
+	// sum over the kept frames
+	EventStats GetTotals( uint32_t eventId ) const noexcept;
+
+	// one row per frame and event that updated in it, then one row per frame and non-zero counter
+	bool WriteCsv( const fs::path& filename ) const;
+
+	bool WriteJson( const fs::path& filename ) const;
+
+	static size_t GetLatenessBucket( cycles_t lateness ) noexcept;
+
+	// smallest lateness in the bucket
+	static cycles_t GetLatenessBucketStart( size_t bucket ) noexcept;
+
+private:
+	EventStats& GetStats( uint32_t eventId ) noexcept;
+
+private:
+	size_t m_maxFrames;
+
+	std::vector<std::string> m_eventNames;
+	std::unordered_map<std::string, uint32_t> m_eventIds;
+
+	std::vector<std::string> m_counterNames;
+	std::unordered_map<std::string, uint32_t> m_counterIds;
+
+	std::deque<FrameStats> m_frames;
+	FrameStats m_currentFrame;
+};
+
+}
\ No newline at end of file
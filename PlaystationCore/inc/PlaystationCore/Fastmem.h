@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Defs.h"
+
+#include <unordered_map>
+
+#if defined( __linux__ ) && ( defined( _M_X64 ) || defined( __x86_64__ ) )
+#define PSX_FASTMEM
+#endif
+
+namespace PSX
+{
+
+// reserves a 4GB host window that mirrors the guest address space.
+// RAM is backed by a memfd mapped at every mirror in KUSEG, KSEG0 and KSEG1, so native code can access it with base + address.
+// Everything else is left inaccessible. Faulting accesses from registered sites are redirected to a slow path that goes through the MemoryMap
+class Fastmem
+{
+public:
+#ifdef PSX_FASTMEM
+	static constexpr bool IsSupported = true;
+#else
+	static constexpr bool IsSupported = false;
+#endif
+
+	static constexpr uint64_t WindowSize = uint64_t( 1 ) << 32;
+
+	// bytes at an access site that can be overwritten with a jump to its slow path
+	static constexpr size_t AccessSiteSize = 5;
+
+	Fastmem() = default;
+	~Fastmem();
+
+	Fastmem( const Fastmem& ) = delete;
+	Fastmem& operator=( const Fastmem& ) = delete;
+
+	bool Initialize();
+
+	// RAM lives in the shared mapping so writes through the window and through Ram are the same memory
+	Ram& GetRam() noexcept { dbExpects( m_ram ); return *m_ram; }
+
+	uint8_t* GetBase() const noexcept { return m_base; }
+
+	// native code at site accesses the window. A fault there is patched into a jump to slowPath
+	void AddAccessSite( uint8_t* site, const uint8_t* slowPath );
+
+	// called when the code buffer is reset
+	void ClearAccessSites() noexcept { m_accessSites.clear(); }
+
+	// called from the fault handler. Returns true if the site at pc was patched and can be resumed
+	bool HandleFault( uintptr_t faultAddress, uintptr_t pc ) noexcept;
+
+private:
+	void Destroy() noexcept;
+
+private:
+	int m_ramFile = -1;
+	Ram* m_ram = nullptr; // host view of the RAM file
+	uint8_t* m_base = nullptr;
+
+	std::unordered_map<uintptr_t, const uint8_t*> m_accessSites;
+};
+
+}
\ No newline at end of file
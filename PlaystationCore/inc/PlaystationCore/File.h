@@ -5,7 +5,9 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string_view>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -40,6 +42,9 @@ struct ExeHeader
 };
 static_assert( sizeof( ExeHeader ) == 0x800 );
 
-bool LoadExecutable( const fs::path& filename, PSX::MipsR3000Cpu& cpu, PSX::Ram& ram );
+std::optional<std::vector<uint8_t>> ReadExecutableFile( const fs::path& filename );
+
+// copy the executable image into RAM and jump to its entry point
+bool LoadExecutable( const uint8_t* data, size_t size, PSX::MipsR3000Cpu& cpu, PSX::Ram& ram );
 
 }
\ No newline at end of file
@@ -64,6 +64,9 @@ public:
 
 	void Serialize( SaveStateSerializer& serializer );
 
+	// sends the drawing and display state to the renderer, which keeps its VRAM
+	void SyncRendererState();
+
 private:
 	struct CrtConstants
 	{
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Defs.h"
+#include "GteKernels.h"
 
 #include <Math/Color.h>
 #include <Math/Matrix.h>
@@ -15,6 +16,18 @@ namespace PSX
 class GTE
 {
 public:
+	static constexpr size_t OpcodeCount = 64;
+
+	struct Stats
+	{
+		std::array<uint32_t, OpcodeCount> commands{}; // executed commands indexed by opcode
+		cycles_t commandCycles = 0; // cycles to complete the executed commands
+		cycles_t stallCycles = 0; // CPU cycles spent waiting for commands to complete
+		int64_t hostNanoseconds = 0; // time spent in ExecuteCommand. Only recorded with host timing enabled
+	};
+
+	bool EnableHostTiming = false; // costs a clock read around every command
+
 	void Reset();
 
 	uint32_t Read( uint32_t index ) const noexcept;
@@ -34,6 +47,25 @@ public:
 	// returns cycles to complete command
 	cycles_t ExecuteCommand( uint32_t command ) noexcept;
 
+	void AddStallCycles( cycles_t cycles ) noexcept
+	{
+		m_stats.stallCycles += cycles;
+	}
+
+	void EndFrame() noexcept;
+
+	// command stats from the last completed frame
+	const Stats& GetStats() const noexcept { return m_lastFrameStats; }
+
+	// mnemonic like RTPS, or null for invalid opcodes
+	static const char* GetOpcodeName( uint32_t opcode ) noexcept;
+
+	// matrix multiplications use the best instruction set the host supports by default. All instruction sets give identical results
+	void SetInstructionSet( GteKernels::InstructionSet instructionSet ) noexcept
+	{
+		m_multiplyMatrixVectors = GteKernels::GetMultiplyMatrixVectors( instructionSet );
+	}
+
 	void Serialize( SaveStateSerializer& serializer );
 
 private:
@@ -308,11 +340,17 @@ private:
 
 	void SetOrderTableZ( int32_t z ) noexcept;
 
+	// unshifted results for each vector. Sets MAC1-3 overflow flags
+	void MultiplyMatrixVectors( const Matrix& matrix, const Vector16* vectors, const Vector32& translation, int64_t* results, size_t count ) noexcept;
+
+	// sets MAC1-3 and IR1-3 from unshifted matrix multiplication results
+	void SetTransformResult( const int64_t result[ 3 ], shift_t sf, bool lm ) noexcept;
+
 	void Transform( const Matrix& matrix, const Vector16& vector, shift_t sf, bool lm ) noexcept;
 	void Transform( const Matrix& matrix, const Vector16& vector, const Vector32& translation, shift_t sf, bool lm ) noexcept;
 
-	// returns unshifted Z result
-	int64_t TransformRTP( const Matrix& matrix, const Vector16& vector, const Vector32& translation, shift_t sf, bool lm ) noexcept;
+	// sets MAC1-3 and IR1-3 from unshifted rotation results. Returns unshifted Z result
+	int64_t SetTransformResultRTP( const int64_t result[ 3 ], shift_t sf, bool lm ) noexcept;
 
 	void MultiplyColorWithIR( ColorRGBC color ) noexcept;
 	void LerpFarColorWithMAC( shift_t sf ) noexcept;
@@ -321,12 +359,16 @@ private:
 
 	// command functions
 
-	void RotateTranslatePerspectiveTransformation( const Vector16& vector, shift_t sf, bool lm, bool setMAC0 ) noexcept;
+	// transforms the first count vectors. The last one sets MAC0 and IR0
+	void RotateTranslatePerspectiveTransformation( size_t count, shift_t sf, bool lm ) noexcept;
+
+	cycles_t ExecuteCommandImp( Command command ) noexcept;
 
 	void MultiplyVectorMatrixVectorAdd( Command command, shift_t sf, bool lm ) noexcept;
 
+	// lights the first count vectors
 	template <bool MultiplyColorIR, bool LerpFarColor, bool ShiftMAC>
-	void NormalizeColor( const Vector16& vector, shift_t sf, bool lm ) noexcept;
+	void NormalizeColor( size_t count, shift_t sf, bool lm ) noexcept;
 
 	template <bool LerpFarColor>
 	void Color( shift_t sf, bool lm ) noexcept;
@@ -406,6 +448,11 @@ private:
 	int16_t m_zScaleFactor4 = 0;
 
 	uint32_t m_errorFlags = 0;
+
+	GteKernels::MultiplyMatrixVectorsFunction m_multiplyMatrixVectors = GteKernels::GetMultiplyMatrixVectors( GteKernels::GetHostInstructionSet() );
+
+	Stats m_stats;
+	Stats m_lastFrameStats;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "RenderCommands.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace PSX
+{
+
+// a GPU capture is the renderer calls of a number of frames, starting with a reset, the full VRAM and the GPU's drawing and display state.
+// Each frame ends with a DisplayFrame command
+struct GpuCaptureHeader
+{
+	static constexpr uint32_t Magic = 0x43475350; // "PSGC"
+	static constexpr uint32_t CurrentVersion = 1;
+
+	uint32_t magic = Magic;
+	uint32_t version = CurrentVersion;
+	uint32_t frameCount = 0;
+	uint32_t commandCount = 0;
+};
+
+// followed by the payload, padded to 4 bytes
+struct GpuCaptureRecord
+{
+	RenderCommand command;
+	uint16_t reserved = 0;
+	uint32_t payloadSize = 0;
+};
+
+// forwards to another renderer, writing the calls to a capture file while capturing
+class GpuCaptureRenderer final : public RenderCommandEncoder
+{
+public:
+	explicit GpuCaptureRenderer( std::unique_ptr<Renderer> renderer );
+
+	GpuCaptureRenderer( const GpuCaptureRenderer& ) = delete;
+	GpuCaptureRenderer& operator=( const GpuCaptureRenderer& ) = delete;
+
+	~GpuCaptureRenderer();
+
+	// records the renderer's VRAM, then the next frameCount frames. The caller sends the GPU state after starting
+	bool StartCapture( const fs::path& filename, uint32_t frameCount );
+	void StopCapture();
+
+	bool IsCapturing() const noexcept { return m_file.is_open(); }
+
+	void EnableVRamView( bool enable ) override { m_renderer->EnableVRamView( enable ); }
+	bool IsVRamViewEnabled() const override { return m_renderer->IsVRamViewEnabled(); }
+
+	bool GetRealColor() const override { return m_renderer->GetRealColor(); }
+
+	void ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram ) override
+	{
+		m_renderer->ReadVRam( left, top, width, height, vram );
+	}
+
+	void DisplayFrame() override;
+
+	uint32_t GetResolutionScale() const noexcept override { return m_renderer->GetResolutionScale(); }
+	bool SetResolutionScale( uint32_t scale ) override { return m_renderer->SetResolutionScale( scale ); }
+
+	uint32_t GetTargetTextureWidth() const noexcept override { return m_renderer->GetTargetTextureWidth(); }
+	uint32_t GetTargetTextureHeight() const noexcept override { return m_renderer->GetTargetTextureHeight(); }
+
+	Surface ReadDisplayTexture() override { return m_renderer->ReadDisplayTexture(); }
+
+private:
+	void* BeginCommand( RenderCommand command, size_t payloadSize ) override;
+	void EndCommand() override;
+
+	void WriteRecord( RenderCommand command, const void* payload, size_t payloadSize );
+
+private:
+	std::unique_ptr<Renderer> m_renderer;
+
+	// the command between BeginCommand and EndCommand
+	std::vector<char> m_payload;
+	RenderCommand m_command = RenderCommand::Reset;
+	bool m_recordOnly = false; // while recording state the renderer already has
+
+	std::ofstream m_file;
+	GpuCaptureHeader m_header;
+	uint32_t m_framesRemaining = 0;
+};
+
+// reads a whole capture file and steps through its commands
+class GpuCaptureReader
+{
+public:
+	bool Load( const fs::path& filename );
+
+	const GpuCaptureHeader& GetHeader() const noexcept { return m_header; }
+
+	// returns false at the end of the capture
+	bool Next( RenderCommand& command, const void*& payload ) noexcept;
+
+	// back to the first command
+	void Rewind() noexcept { m_position = 0; }
+
+private:
+	GpuCaptureHeader m_header;
+	std::vector<char> m_data; // records after the header
+	size_t m_position = 0;
+};
+
+}
\ No newline at end of file
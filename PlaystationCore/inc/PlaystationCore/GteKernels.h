@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define PSX_GTE_SIMD
+#endif
+
+namespace PSX::GteKernels
+{
+
+enum class InstructionSet
+{
+	Scalar,
+	Sse41,
+	Avx2
+};
+
+// overflow flags of MAC1-3 in bits 0-2 and underflow flags in bits 3-5
+constexpr uint32_t OverflowShift = 0;
+constexpr uint32_t UnderflowShift = 3;
+
+// results[ v * 3 + row ] = ( translation[ row ] << 12 ) + matrix row * vectors[ v ] for the 44 bit MAC1-3 accumulators.
+// The matrix is 3x3 row major and each vector is 3 elements. Rows sum their terms in order and are checked and sign extended from 44 bits after every addition.
+// Returns the overflow and underflow flags of all additions for all vectors
+using MultiplyMatrixVectorsFunction = uint32_t( * )( const int16_t* matrix, const int16_t* vectors, const int32_t* translation, int64_t* results, size_t count ) noexcept;
+
+// best instruction set supported by the host CPU and OS. Detected once
+InstructionSet GetHostInstructionSet() noexcept;
+
+// falls back to scalar when the instruction set is not supported by the host
+MultiplyMatrixVectorsFunction GetMultiplyMatrixVectors( InstructionSet instructionSet ) noexcept;
+
+const char* GetInstructionSetName( InstructionSet instructionSet ) noexcept;
+
+}
\ No newline at end of file
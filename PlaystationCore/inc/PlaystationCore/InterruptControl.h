@@ -7,6 +7,7 @@
 namespace PSX
 {
 
+class EventManager;
 class SaveStateSerializer;
 
 enum class Interrupt : uint32_t
@@ -32,6 +33,8 @@ public:
 
 	static constexpr uint32_t WriteMask = 0xffff07ffu;
 
+	explicit InterruptControl( EventManager& eventManager ) : m_eventManager{ eventManager } {}
+
 	void Reset()
 	{
 		m_status = 0;
@@ -41,7 +44,12 @@ public:
 	void SetInterrupt( Interrupt interrupt ) noexcept
 	{
 		dbLogDebug( "InterruptControl::SetInterrupt() -- [%X]", static_cast<uint32_t>( interrupt ) );
+
+		const bool wasPending = PendingInterrupt();
 		m_status |= static_cast<uint32_t>( interrupt );
+
+		if ( !wasPending && PendingInterrupt() )
+			OnInterruptPending();
 	}
 
 	bool PendingInterrupt() const noexcept
@@ -56,6 +64,12 @@ public:
 	void Serialize( SaveStateSerializer& serializer );
 
 private:
+	// the CPU only checks for interrupts between runs
+	void OnInterruptPending() noexcept;
+
+private:
+	EventManager& m_eventManager;
+
 	uint32_t m_status = 0;
 	uint32_t m_mask = 0;
 };
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Defs.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace PSX
+{
+
+// read a file from the ISO9660 filesystem on the first data track. Path components are separated by '\' or '/' and the ";1" version is optional.
+// The disc seek position is restored afterwards
+std::optional<std::vector<uint8_t>> ReadIsoFile( CDRom& cdrom, std::string_view path );
+
+// read the executable named by BOOT in SYSTEM.CNF, or PSX.EXE on discs without SYSTEM.CNF
+std::optional<std::vector<uint8_t>> ReadBootExecutable( CDRom& cdrom );
+
+}
\ No newline at end of file
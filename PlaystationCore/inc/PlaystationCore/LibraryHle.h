@@ -0,0 +1,88 @@
+#pragma once
+
+#include "BiosHle.h"
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace PSX
+{
+
+// runs library functions statically linked into games, like Psy-Q's memcpy and strlen, natively.
+// Functions are recognized by their code when a block is compiled at their entry point, so only the cached interpreter and recompiler use them.
+//
+// Signature files have one function per line: name, replacement and the code as 32 bit hex words. '.' matches any nibble, for relocated addresses.
+// The first word may only wildcard the immediate of a lui. Replacements are the BIOS HLE memory and string functions, named like memcpy,
+// and rand and srand. Those find their seed through the first relocated lui and the load, store or addiu that uses it. '#' starts a comment
+class LibraryHle
+{
+public:
+	static constexpr size_t MaxSignatureWords = 256;
+
+	LibraryHle( MemoryMap& memoryMap, BiosHle& biosHle );
+
+	void Reset();
+
+	// adds to the loaded signatures. Returns false if the file can't be read or has an invalid line
+	bool LoadSignatures( const fs::path& filename );
+
+	size_t GetSignatureCount() const noexcept { return m_signatures.size(); }
+
+	// index of the signature of the library function starting at the address, if any. Found functions are added to the report
+	std::optional<uint32_t> FindFunction( uint32_t address ) noexcept;
+
+	// calls a function found at the address. Returns the value for $v0 and its cycles if it was handled
+	std::optional<BiosHle::Result> Call( uint32_t signatureIndex, uint32_t address, const std::array<uint32_t, 4>& args ) noexcept;
+
+	// disabled signatures are still found so they show in the report. Returns false if no signature has the name
+	bool SetEnabled( std::string_view name, bool enable ) noexcept;
+
+	// functions found in the running game with their addresses and call counts
+	void LogReport() const;
+
+private:
+	struct Signature
+	{
+		std::string name;
+		BiosHle::Function function;
+		uint32_t call = 0; // kernel call number of the replacement
+		std::vector<uint32_t> words;
+		std::vector<uint32_t> masks; // bits that must match
+		bool enabled = true;
+
+		// words relocating the address of rand's seed. Zero if it has none
+		uint32_t seedHighIndex = 0;
+		uint32_t seedLowIndex = 0;
+	};
+
+	struct FoundFunction
+	{
+		uint32_t signature;
+		uint32_t calls = 0;
+	};
+
+	bool ParseSignature( std::string_view line, Signature& signature ) const;
+
+	static bool FindSeedRelocation( Signature& signature ) noexcept;
+
+	bool Matches( const Signature& signature, uint32_t address ) const noexcept;
+
+private:
+	MemoryMap& m_memoryMap;
+	BiosHle& m_biosHle;
+
+	std::vector<Signature> m_signatures;
+	std::unordered_multimap<uint32_t, uint32_t> m_signaturesByFirstWord;
+
+	// by RAM offset of the entry point
+	std::unordered_map<uint32_t, FoundFunction> m_foundFunctions;
+};
+
+}
\ No newline at end of file
@@ -71,11 +71,14 @@ public:
 		CacheControlSize = 4
 	};
 
+	static constexpr cycles_t RamReadCycles = 4;
+
 public:
 	MemoryMap(
 		EventManager& eventManager,
 		Bios& bios,
 		CDRomDrive& cdRomDrive,
+		CodeCache& codeCache,
 		ControllerPorts& controllerPorts,
 		Dma& dma,
 		Gpu& gpu,
@@ -89,6 +92,7 @@ public:
 		: m_eventManager{ eventManager }
 		, m_bios{ bios }
 		, m_cdRomDrive{ cdRomDrive }
+		, m_codeCache{ codeCache }
 		, m_controllerPorts{ controllerPorts }
 		, m_dma{ dma }
 		, m_gpu{ gpu }
@@ -99,7 +103,9 @@ public:
 		, m_serialPort{ serialPort }
 		, m_spu{ spu }
 		, m_timers{ timers }
-	{}
+	{
+		MapPages();
+	}
 
 	void Reset();
 
@@ -127,12 +133,7 @@ public:
 
 	std::optional<Instruction> FetchInstruction( uint32_t address ) noexcept;
 
-	void WriteICache( uint32_t address, uint32_t ) noexcept
-	{
-		dbExpects( address / 16 < m_icacheFlags.size() );
-		m_icacheFlags[ address / 16 ].valid = 0;
-		// TODO: write to icache
-	}
+	void WriteICache( uint32_t address, uint32_t ) noexcept;
 
 	// convert PSX address to physical address
 	const uint8_t* GetRealAddress( uint32_t address ) const noexcept;
@@ -142,8 +143,12 @@ public:
 	void Serialize( SaveStateSerializer& serializer );
 
 private:
-	static constexpr cycles_t RamReadCycles = 4;
 	static constexpr cycles_t DeviceReadCycles = 2;
+	static constexpr cycles_t ScratchpadReadCycles = 1;
+
+	// the page table covers the physical address space left after applying the region masks
+	static constexpr uint32_t PageSize = 4 * 1024;
+	static constexpr uint32_t PageCount = 0x20000000 / PageSize;
 
 	// masks help strip region bits from virtual address to make a physical address
 	// KSEG2 doesn't mirror the other regions so it's essentially ignored
@@ -171,7 +176,29 @@ private:
 	};
 	static_assert( sizeof( ICacheFlags ) == 4 );
 
+	// guest page backed directly by host memory. Pages without memory are handled by the I/O devices
+	struct Page
+	{
+		enum Flags : uint8_t
+		{
+			Writable = 1 << 0,
+			Ram = 1 << 1 // writes invalidate the code cache
+		};
+
+		uint8_t* memory = nullptr;
+		uint16_t size = 0; // bytes accessible from the start of the page
+		uint8_t flags = 0;
+		std::array<uint8_t, 3> readCycles{}; // 8bit, 16bit, 32bit
+	};
+
 private:
+	void MapPages() noexcept;
+
+	void MapPages( uint32_t start, uint32_t size, uint8_t* memory, uint8_t flags, cycles_t readCycles ) noexcept;
+
+	// BIOS read cycles depend on the memory control delay registers
+	void UpdatePageCycles() noexcept;
+
 	template <typename T, bool ReadMode>
 	void Access( uint32_t address, T& value ) noexcept;
 
@@ -232,6 +259,7 @@ private:
 	EventManager& m_eventManager;
 	Bios& m_bios;
 	CDRomDrive& m_cdRomDrive;
+	CodeCache& m_codeCache;
 	ControllerPorts& m_controllerPorts;
 	Dma& m_dma;
 	Gpu& m_gpu;
@@ -248,6 +276,8 @@ private:
 	MemoryControl m_memoryControl;
 
 	std::array<ICacheFlags, 256> m_icacheFlags;
+
+	std::array<Page, PageCount> m_pages;
 };
 
 }
\ No newline at end of file
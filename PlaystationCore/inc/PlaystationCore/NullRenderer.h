@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Renderer.h"
+
+#include <memory>
+
+namespace PSX
+{
+
+// skips drawing and presentation for runs that only need CPU, SPU and memory state.
+// VRAM uploads, fills and copies are kept so the CPU can still read VRAM back
+class NullRenderer final : public Renderer
+{
+public:
+	NullRenderer();
+
+	void Reset() override;
+
+	void EnableVRamView( bool enable ) override { m_viewVRam = enable; }
+	bool IsVRamViewEnabled() const override { return m_viewVRam; }
+
+	void SetTextureWindow( uint32_t, uint32_t, uint32_t, uint32_t ) override {}
+	void SetDrawArea( int32_t, int32_t, int32_t, int32_t ) override {}
+	void SetSemiTransparencyMode( SemiTransparencyMode ) override {}
+	void SetMaskBits( bool setMask, bool checkMask ) override;
+	void SetDrawMode( TexPage, ClutAttribute, bool ) override {}
+
+	void SetColorDepth( DisplayAreaColorDepth ) override {}
+	void SetDisplayEnable( bool ) override {}
+
+	bool GetRealColor() const override { return false; }
+	void SetRealColor( bool ) override {}
+
+	void SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio ) override;
+
+	void UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels ) override;
+
+	void ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram ) override;
+
+	void FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b ) override;
+
+	void CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height ) override;
+
+	void PushTriangle( Vertex[ 3 ], bool ) override {}
+	void PushQuad( Vertex[ 4 ], bool ) override {}
+
+	void DisplayFrame() override {}
+
+	uint32_t GetResolutionScale() const noexcept override { return 1; }
+	bool SetResolutionScale( uint32_t scale ) override { return scale == 1; }
+
+	uint32_t GetTargetTextureWidth() const noexcept override { return m_targetDisplayArea.width; }
+	uint32_t GetTargetTextureHeight() const noexcept override { return static_cast<uint32_t>( GetTargetTextureWidth() / m_aspectRatio ); }
+
+	// empty surface
+	Surface ReadDisplayTexture() override { return {}; }
+
+private:
+	static constexpr uint16_t MaskBit = 0x8000;
+
+	uint16_t& VRamPixel( uint32_t x, uint32_t y ) noexcept
+	{
+		return m_vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ];
+	}
+
+	void WritePixel( uint32_t x, uint32_t y, uint16_t color ) noexcept
+	{
+		uint16_t& pixel = VRamPixel( x, y );
+		if ( !m_checkMaskBit || !( pixel & MaskBit ) )
+			pixel = color | m_forceMaskBit;
+	}
+
+private:
+	std::unique_ptr<uint16_t[]> m_vram;
+
+	DisplayArea m_targetDisplayArea;
+	float m_aspectRatio = 0.0f;
+
+	uint16_t m_forceMaskBit = 0;
+	bool m_checkMaskBit = false;
+
+	bool m_viewVRam = false;
+};
+
+}
\ No newline at end of file
@@ -14,8 +14,22 @@ public:
 	Playstation();
 	~Playstation();
 
+	// Must be set before Initialize
+	void SetRendererType( RendererType type ) noexcept { m_rendererType = type; }
+	RendererType GetRendererType() const noexcept { return m_rendererType; }
+
+	// run the renderer on its own thread, overlapping rendering with emulation. Must be set before Initialize
+	void SetThreadedRenderer( bool enable ) noexcept { m_useThreadedRenderer = enable; }
+
+	// wrap the renderer so GPU captures can be started. Must be set before Initialize
+	void SetGpuCapture( bool enable ) noexcept { m_useGpuCapture = enable; }
+
+	// window may be null with the software and null renderers
 	bool Initialize( SDL_Window* window, const fs::path& biosFilename );
 
+	// without a window or audio device, for batch runs. Audio goes to the audio queue's sink
+	bool InitializeHeadless( RendererType rendererType, const fs::path& biosFilename );
+
 	void Reset();
 
 	void SetController( size_t slot, Controller* controller );
@@ -26,10 +40,17 @@ public:
 	void SetCDRom( std::unique_ptr<CDRom> cdrom );
 	CDRom* GetCDRom();
 
-	void HookExe( fs::path filename );
+	// load executable in place of the BIOS shell at the next reset
+	bool HookExe( const fs::path& filename );
+
+	// skip the BIOS intro and boot the disc's executable directly. Takes effect at the next reset
+	void SetFastBoot( bool enable ) noexcept { m_fastBoot = enable; }
 
 	float GetRefreshRate() const;
 
+	// records the renderer calls of the next frames for offline replay. Call between frames
+	bool StartGpuCapture( const fs::path& filename, uint32_t frameCount );
+
 	bool Serialize( SaveStateSerializer& serializer );
 
 public:
@@ -51,11 +72,16 @@ public:
 	Spu&				GetSpu()				{ dbAssert( m_spu ); return *m_spu; }
 	Timers&				GetTimers()				{ dbAssert( m_timers ); return *m_timers; }
 
+private:
+	bool InitializeInternal( SDL_Window* window, const fs::path& biosFilename, bool openAudioDevice );
+
 private:
 	std::unique_ptr<EventManager> m_eventManager; // must be destroyed last
+	std::unique_ptr<Fastmem> m_fastmem; // optional. Owns RAM when available
 	std::unique_ptr<AudioQueue> m_audioQueue;
 	std::unique_ptr<Bios> m_bios;
 	std::unique_ptr<CDRomDrive> m_cdromDrive;
+	std::unique_ptr<CodeCache> m_codeCache;
 	std::unique_ptr<ControllerPorts> m_controllerPorts;
 	std::unique_ptr<Dma> m_dma;
 	std::unique_ptr<DualSerialPort> m_dualSerialPort; // optional
@@ -64,12 +90,19 @@ private:
 	std::unique_ptr<MacroblockDecoder> m_mdec;
 	std::unique_ptr<MemoryMap> m_memoryMap;
 	std::unique_ptr<MipsR3000Cpu> m_cpu;
-	std::unique_ptr<Ram> m_ram;
+	std::unique_ptr<Ram> m_ramStorage; // used when fastmem isn't available
+	Ram* m_ram = nullptr;
 	std::unique_ptr<Renderer> m_renderer;
+	GpuCaptureRenderer* m_gpuCapture = nullptr; // owned by m_renderer when enabled
 	std::unique_ptr<Scratchpad> m_scratchpad;
 	std::unique_ptr<SerialPort> m_serialPort;
 	std::unique_ptr<Spu> m_spu;
 	std::unique_ptr<Timers> m_timers;
+
+	bool m_fastBoot = false;
+	RendererType m_rendererType = RendererType::OpenGL;
+	bool m_useThreadedRenderer = false;
+	bool m_useGpuCapture = false;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Defs.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace PSX
+{
+
+// sampling profiler for guest code. Samples the PC on a timer event and keeps a shadow call stack from JAL, JALR and JR,
+// so it costs nothing between samples except on calls and returns. Only the CPU should start and stop it
+class Profiler
+{
+	friend class Recompiler;
+
+public:
+	static constexpr cycles_t DefaultSampleInterval = 10000; // about 3.4kHz
+	static constexpr size_t MaxCallDepth = 256;
+
+	Profiler( MipsR3000Cpu& cpu, EventManager& eventManager );
+	~Profiler();
+
+	void Start( cycles_t sampleInterval );
+	void Stop();
+
+	bool IsRunning() const noexcept { return m_sampleEvent != nullptr; }
+
+	// call stacks don't survive a reset. Keeps samples
+	void Reset();
+
+	void Clear();
+
+	uint32_t GetSampleCount() const noexcept { return m_sampleCount; }
+
+	// a call to target that returns to returnAddress. Recompiled code pushes frames itself
+	void OnCall( uint32_t target, uint32_t returnAddress ) noexcept
+	{
+		if ( m_callDepth == MaxCallDepth )
+		{
+			++m_droppedCalls;
+			return;
+		}
+
+		m_callStack[ m_callDepth++ ] = { target, returnAddress };
+	}
+
+	// a register jump. Pops frames if it returns to one of them
+	void OnJump( uint32_t target ) noexcept
+	{
+		// returns can skip frames (longjmp, exceptions). Jumps that return to no frame are jump tables and tail calls
+		for ( uint32_t i = m_callDepth; i-- > 0; )
+		{
+			if ( m_callStack[ i ].returnAddress == target )
+			{
+				m_callDepth = i;
+				return;
+			}
+		}
+	}
+
+	// the PC reached a kernel call vector. Names the innermost frame after the kernel function
+	void OnKernelCall( uint32_t vector, uint32_t call ) noexcept;
+
+	// one line per unique stack in the collapsed format read by flamegraph.pl and speedscope
+	bool WriteCollapsedStacks( const fs::path& filename ) const;
+
+	// the most sampled addresses with the function they were sampled in
+	bool WriteHotAddresses( const fs::path& filename, size_t count ) const;
+
+private:
+	// frame IDs are function addresses, or an odd value for a kernel function
+	static uint32_t MakeKernelFrame( uint32_t vector, uint32_t call ) noexcept;
+
+	static std::string GetFrameName( uint32_t frame );
+
+	void Sample();
+
+private:
+	struct Frame
+	{
+		uint32_t id;
+		uint32_t returnAddress;
+	};
+
+	struct AddressSamples
+	{
+		uint32_t count = 0;
+		uint32_t frame = 0; // innermost frame of the last sample
+	};
+
+	MipsR3000Cpu& m_cpu;
+	EventManager& m_eventManager;
+
+	EventHandle m_sampleEvent; // null when stopped
+	cycles_t m_sampleInterval = DefaultSampleInterval;
+
+	// MaxCallDepth frames allocated once, so recompiled code can address them directly. The first m_callDepth are in use
+	std::vector<Frame> m_callStack;
+	uint32_t m_callDepth = 0;
+	uint32_t m_droppedCalls = 0; // calls deeper than MaxCallDepth. Their returns are ignored
+
+	std::map<std::vector<uint32_t>, uint32_t> m_stackSamples;
+	std::unordered_map<uint32_t, AddressSamples> m_addressSamples;
+	std::vector<uint32_t> m_sampleStack; // reused to avoid allocating on every sample
+	uint32_t m_sampleCount = 0;
+};
+
+}
\ No newline at end of file
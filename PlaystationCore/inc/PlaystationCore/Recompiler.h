@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Defs.h"
+
+#include "CodeCache.h"
+#include "Instruction.h"
+
+#include <array>
+
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define PSX_RECOMPILER_X64
+#endif
+
+namespace PSX
+{
+
+class X64Emitter;
+
+// translates cached code blocks to x86-64.
+// Common ALU and branch instructions are emitted inline, everything else calls the cached interpreter handler.
+// Block exits with a known target jump directly into the next block once it has been compiled
+class Recompiler
+{
+public:
+#ifdef PSX_RECOMPILER_X64
+	static constexpr bool IsSupported = true;
+#else
+	static constexpr bool IsSupported = false;
+#endif
+
+	static constexpr size_t CodeBufferSize = 32 * 1024 * 1024;
+
+	Recompiler( MipsR3000Cpu& cpu, CodeCache& codeCache, EventManager& eventManager );
+	~Recompiler();
+
+	Recompiler( const Recompiler& ) = delete;
+	Recompiler& operator=( const Recompiler& ) = delete;
+
+	// drop all blocks and native code. Must not be called while a block is executing
+	void Flush();
+
+	// generate native code for block starting at pc. Returns false if the code buffer is full
+	bool Compile( CodeBlock& block, uint32_t pc );
+
+	// run native code for block and any blocks linked to it.
+	// Returns an exit that can be linked to the block at the current PC, or null
+	CodeBlockLink* Execute( const CodeBlock& block ) noexcept;
+
+	// patch the exit to jump directly into the target block
+	void Link( CodeBlockLink& link, CodeBlock& target ) noexcept;
+
+	// loads and stores are emitted inline when fastmem is available. Flushes all blocks
+	void SetFastmem( Fastmem* fastmem );
+
+private:
+	struct CpuState
+	{
+		std::array<uint32_t, 32> registers;
+		uint32_t loadDelayIndex;
+		uint32_t loadDelayValue;
+		uint32_t newLoadDelayIndex;
+		uint32_t newLoadDelayValue;
+		uint32_t hi;
+		uint32_t lo;
+		uint32_t currentPC;
+		uint32_t pc;
+		uint32_t nextPC;
+		bool inBranch;
+		bool inDelaySlot;
+	};
+
+	class BlockCompiler;
+
+	using EnterFunction = CodeBlockLink* ( * )( MipsR3000Cpu*, const uint8_t* );
+
+private:
+	void EmitThunks();
+
+	// revert links into and out of a block that is about to be destroyed
+	void Unlink( CodeBlock& block ) noexcept;
+
+	static void Unpatch( CodeBlockLink& link ) noexcept;
+
+	CpuState CaptureState() const noexcept;
+
+	void RestoreState( const CpuState& state ) noexcept;
+
+	static bool StatesMatch( const CpuState& lhs, const CpuState& rhs ) noexcept;
+
+	// slow paths for accesses that can't go through the fastmem window
+	template <typename T>
+	static uint32_t ReadMemory( MipsR3000Cpu& cpu, uint32_t address ) noexcept;
+
+	template <typename T>
+	static void WriteMemory( MipsR3000Cpu& cpu, uint32_t address, uint32_t value ) noexcept;
+
+	// returns that don't match the top frame of the profiler's call stack
+	static void ProfileJump( MipsR3000Cpu& cpu, uint32_t target ) noexcept;
+
+	static void LockstepBegin( Recompiler& recompiler ) noexcept;
+	static void LockstepVerify( Recompiler& recompiler, uint32_t instruction ) noexcept;
+
+private:
+	MipsR3000Cpu& m_cpu;
+	CodeCache& m_codeCache;
+	EventManager& m_eventManager;
+	Fastmem* m_fastmem = nullptr;
+
+	uint8_t* m_codeBuffer = nullptr;
+	uint8_t* m_codeCursor = nullptr; // start of unused code
+	uint8_t* m_codeEnd = nullptr;
+
+	EnterFunction m_enter = nullptr;
+	const uint8_t* m_exit = nullptr; // restores the host stack and returns the link in rax
+
+	CpuState m_lockstepState{};
+};
+
+}
\ No newline at end of file
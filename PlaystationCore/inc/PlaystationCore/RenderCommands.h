@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Renderer.h"
+
+#include <cstdint>
+
+namespace PSX
+{
+
+// renderer calls that don't return anything, encoded so they can be queued or written to a file
+enum class RenderCommand : uint16_t
+{
+	Reset,
+	SetTextureWindow,
+	SetDrawArea,
+	SetSemiTransparencyMode,
+	SetMaskBits,
+	SetDrawMode,
+	SetColorDepth,
+	SetDisplayEnable,
+	SetRealColor,
+	SetDisplayArea,
+	UpdateVRam, // followed by pixels
+	FillVRam,
+	CopyVRam,
+	PushTriangle,
+	PushQuad,
+	DisplayFrame,
+
+	Count
+};
+
+const char* GetRenderCommandName( RenderCommand command ) noexcept;
+
+// checks the command and payload size before executing data from a file
+bool IsValidRenderCommand( RenderCommand command, const void* payload, size_t payloadSize ) noexcept;
+
+// calls the renderer with a payload written by RenderCommandEncoder
+void ExecuteRenderCommand( Renderer& renderer, RenderCommand command, const void* payload );
+
+// encodes the calls that don't return anything as commands. Derived renderers store or forward them and implement the rest
+class RenderCommandEncoder : public Renderer
+{
+public:
+	void Reset() override;
+
+	void SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY ) override;
+	void SetDrawArea( int32_t left, int32_t top, int32_t right, int32_t bottom ) override;
+	void SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMode ) override;
+	void SetMaskBits( bool setMask, bool checkMask ) override;
+	void SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither ) override;
+
+	void SetColorDepth( DisplayAreaColorDepth colorDepth ) override;
+	void SetDisplayEnable( bool enable ) override;
+
+	void SetRealColor( bool realColor ) override;
+
+	void SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio ) override;
+
+	void UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels ) override;
+
+	void FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b ) override;
+
+	void CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height ) override;
+
+	void PushTriangle( Vertex vertices[ 3 ], bool semiTransparent ) override;
+	void PushQuad( Vertex vertices[ 4 ], bool semiTransparent ) override;
+
+protected:
+	// returns space for the payload
+	virtual void* BeginCommand( RenderCommand command, size_t payloadSize ) = 0;
+
+	// the payload is written
+	virtual void EndCommand() = 0;
+
+private:
+	template <typename T>
+	void PushCommand( RenderCommand command, const T& payload );
+};
+
+}
\ No newline at end of file
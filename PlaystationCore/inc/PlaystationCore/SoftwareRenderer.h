@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Defs.h"
+#include "Renderer.h"
+
+#include <Render/Shader.h>
+#include <Render/Texture.h>
+#include <Render/VertexArrayObject.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace PSX
+{
+
+// rasterizes into a 16 bit copy of VRAM on the CPU at native resolution, following the GPU's fill rules, dithering and blending.
+// Presents through OpenGL when created with a window
+class SoftwareRenderer final : public Renderer
+{
+public:
+	SoftwareRenderer();
+
+	// window may be null to render without presenting
+	bool Initialize( SDL_Window* window );
+
+	void Reset() override;
+
+	void EnableVRamView( bool enable ) override;
+	bool IsVRamViewEnabled() const override { return m_viewVRam; }
+
+	void SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY ) override;
+	void SetDrawArea( int32_t left, int32_t top, int32_t right, int32_t bottom ) override;
+	void SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMode ) override { m_semiTransparencyMode = semiTransparencyMode; }
+	void SetMaskBits( bool setMask, bool checkMask ) override;
+	void SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither ) override;
+
+	void SetColorDepth( DisplayAreaColorDepth colorDepth ) override { m_colorDepth = colorDepth; }
+	void SetDisplayEnable( bool enable ) override { m_displayEnable = enable; }
+
+	// always draws 15 bit color
+	bool GetRealColor() const override { return false; }
+	void SetRealColor( bool ) override {}
+
+	void SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio ) override;
+
+	void UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels ) override;
+
+	void ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram ) override;
+
+	void FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b ) override;
+
+	void CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height ) override;
+
+	void PushTriangle( Vertex vertices[ 3 ], bool semiTransparent ) override;
+	void PushQuad( Vertex vertices[ 4 ], bool semiTransparent ) override;
+
+	void DisplayFrame() override;
+
+	// native resolution only
+	uint32_t GetResolutionScale() const noexcept override { return 1; }
+	bool SetResolutionScale( uint32_t scale ) override { return scale == 1; }
+
+	uint32_t GetTargetTextureWidth() const noexcept override { return m_targetDisplayArea.width; }
+	uint32_t GetTargetTextureHeight() const noexcept override { return static_cast<uint32_t>( GetTargetTextureWidth() / m_aspectRatio ); }
+
+	Surface ReadDisplayTexture() override;
+
+	const uint16_t* GetVRam() const noexcept { return m_vram.get(); }
+
+private:
+	static constexpr uint16_t MaskBit = 0x8000;
+
+	uint16_t& VRamPixel( uint32_t x, uint32_t y ) noexcept
+	{
+		return m_vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ];
+	}
+
+	// writes a 15 bit color with the mask settings
+	void WritePixel( uint32_t x, uint32_t y, uint16_t color ) noexcept
+	{
+		uint16_t& pixel = VRamPixel( x, y );
+		if ( !m_checkMaskBit || !( pixel & MaskBit ) )
+			pixel = color | m_forceMaskBit;
+	}
+
+	template <bool Textured, bool SemiTransparent, bool Dither>
+	void DrawTriangle( const Vertex& v0, const Vertex& v1, const Vertex& v2 ) noexcept;
+
+	// texel at 8 bit texture coordinates after the texture window
+	uint16_t SampleTexture( uint32_t u, uint32_t v ) const noexcept;
+
+	uint16_t Blend( uint16_t back, uint16_t front ) const noexcept;
+
+	// display area as 24 bit RGB rows from the top
+	std::vector<uint8_t> ConvertDisplayArea( uint32_t& width, uint32_t& height ) const;
+
+private:
+	SDL_Window* m_window = nullptr;
+
+	std::unique_ptr<uint16_t[]> m_vram;
+
+	Render::Texture2D m_displayTexture;
+	Render::VertexArrayObject m_noAttributeVAO;
+	Render::Shader m_displayShader;
+
+	DisplayArea m_vramDisplayArea;
+	DisplayArea m_targetDisplayArea;
+	float m_aspectRatio = 0.0f;
+
+	DisplayAreaColorDepth m_colorDepth = DisplayAreaColorDepth::B15;
+	bool m_displayEnable = false;
+
+	// inclusive
+	int32_t m_drawAreaLeft = 0;
+	int32_t m_drawAreaTop = 0;
+	int32_t m_drawAreaRight = 0;
+	int32_t m_drawAreaBottom = 0;
+
+	SemiTransparencyMode m_semiTransparencyMode = SemiTransparencyMode::Blend;
+
+	uint16_t m_forceMaskBit = 0;
+	bool m_checkMaskBit = false;
+	bool m_dither = false;
+
+	TexPage m_texPage;
+	ClutAttribute m_clut;
+
+	uint32_t m_texWindowAndX = 0xff;
+	uint32_t m_texWindowAndY = 0xff;
+	uint32_t m_texWindowOrX = 0;
+	uint32_t m_texWindowOrY = 0;
+
+	// not serialized
+	int m_cachedWindowWidth = 0;
+	int m_cachedWindowHeight = 0;
+	bool m_stretchToFit = true;
+	bool m_viewVRam = false;
+};
+
+}
\ No newline at end of file
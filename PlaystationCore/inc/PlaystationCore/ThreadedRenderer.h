@@ -0,0 +1,108 @@
+#pragma once
+
+#include "RenderCommands.h"
+
+#include <SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace PSX
+{
+
+// runs another renderer on a render thread that owns it and the window's GL context.
+// Draw calls are copied into a single producer single consumer ring and return immediately.
+// VRAM reads, presentation and queries wait for the render thread to catch up
+class ThreadedRenderer final : public RenderCommandEncoder
+{
+public:
+	static constexpr size_t BufferSize = 4 * 1024 * 1024; // fits a full VRAM upload
+
+	ThreadedRenderer() = default;
+
+	ThreadedRenderer( const ThreadedRenderer& ) = delete;
+	ThreadedRenderer& operator=( const ThreadedRenderer& ) = delete;
+
+	~ThreadedRenderer();
+
+	// takes the GL context current on the calling thread, if any, until destroyed
+	bool Initialize( std::unique_ptr<Renderer> renderer, SDL_Window* window );
+
+	void EnableVRamView( bool enable ) override;
+	bool IsVRamViewEnabled() const override;
+
+	bool GetRealColor() const override;
+
+	void ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram ) override;
+
+	void DisplayFrame() override;
+
+	uint32_t GetResolutionScale() const noexcept override;
+	bool SetResolutionScale( uint32_t scale ) override;
+
+	uint32_t GetTargetTextureWidth() const noexcept override;
+	uint32_t GetTargetTextureHeight() const noexcept override;
+
+	Surface ReadDisplayTexture() override;
+
+private:
+	enum class Control : uint16_t;
+
+	struct CommandHeader
+	{
+		Control control;
+		RenderCommand command; // when rendering
+		uint32_t size; // including header and padding
+	};
+
+	void* BeginCommand( RenderCommand command, size_t payloadSize ) override;
+
+	// publishes the command
+	void EndCommand() noexcept override;
+
+	// reserves space for a command and its payload, waiting for the render thread if the buffer is full. Returns the payload
+	void* ReserveCommand( Control control, RenderCommand command, size_t payloadSize );
+
+	// runs the function on the render thread and waits for it
+	template <typename F>
+	void RunOnRenderThread( F&& function );
+
+	template <typename Predicate>
+	void WaitForRenderThread( Predicate done ) const;
+
+	// waits until the render thread executed all commands
+	void Flush() const;
+
+	void RenderThreadMain();
+
+	// returns false when stopped
+	bool ExecuteCommand( const CommandHeader& header, const void* payload );
+
+private:
+	std::unique_ptr<Renderer> m_renderer;
+
+	SDL_Window* m_window = nullptr;
+	SDL_GLContext m_glContext = nullptr;
+
+	std::unique_ptr<uint64_t[]> m_buffer;
+
+	// total bytes written and read. Positions in the buffer wrap
+	alignas( 64 ) std::atomic<size_t> m_writePosition = 0;
+	alignas( 64 ) std::atomic<size_t> m_readPosition = 0;
+	size_t m_pendingWritePosition = 0; // between BeginCommand and EndCommand
+
+	// sleeping threads are woken through the mutex
+	alignas( 64 ) mutable std::mutex m_mutex;
+	mutable std::condition_variable m_commandsAvailable;
+	mutable std::condition_variable m_commandsExecuted;
+	mutable std::atomic<bool> m_renderThreadWaiting = false;
+	mutable std::atomic<bool> m_producerWaiting = false;
+
+	std::thread m_renderThread;
+};
+
+}
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include <array>
 #include <cstdint>
+#include <optional>
 
 namespace PSX
 {
@@ -47,9 +48,12 @@ public:
 	// update hblank and vblank for timers 0 and 1
 	void UpdateBlank( bool blanked ) noexcept;
 
-	// returns number of ticks to target, max, or infinity depending on the mode
+	// returns number of ticks to target, max, or infinity depending on the mode. Infinity when no IRQ can be signalled
 	uint32_t GetTicksUntilIrq() const noexcept;
 
+	// counter value after ticks without updating flags or signalling. Ticks must not pass an IRQ
+	uint32_t PeekCounter( uint32_t ticks ) const noexcept;
+
 	// returns true if IRQ was signalled
 	bool Update( uint32_t ticks ) noexcept;
 
@@ -102,6 +106,12 @@ private:
 	void UpdatePaused() noexcept;
 	bool TrySignalIrq() noexcept;
 
+	// false after a one-shot IRQ until the mode is written
+	bool CanSignalIrq() const noexcept;
+
+	// counter after ticks and whether it reached the target or max on the way
+	uint32_t AdvanceCounter( uint32_t ticks, bool& reachedTarget, bool& reachedMax ) const noexcept;
+
 private:
 	const uint32_t m_index;
 
@@ -134,6 +144,8 @@ public:
 	void Write( uint32_t offset, uint32_t value ) noexcept;
 
 	void AddCycles( cycles_t cycles ) noexcept;
+
+	// the timer event only fires for IRQs. Counters are brought up to date when read
 	void ScheduleNextIrq() noexcept;
 
 	void Serialize( SaveStateSerializer& serializer );
@@ -154,6 +166,9 @@ private:
 private:
 	void UpdateEventsEarly( uint32_t timerIndex );
 
+	// counter value without updating the timers. Returns nothing if the timer must be updated first
+	std::optional<uint32_t> TryPeekCounter( uint32_t timerIndex ) const noexcept;
+
 private:
 	InterruptControl& m_interruptControl;
 	Gpu* m_gpu = nullptr; // circular dependency
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "GpuDefs.h"
+
+#include <Math/Rectangle.h>
+
+#include <stdx/bit.h>
+
+#include <array>
+#include <cstdint>
+
+namespace PSX
+{
+
+// one bit per 16x16 tile of VRAM. Areas wrap around the edges of VRAM
+class VRamTileMask
+{
+public:
+	using Rect = Math::Rectangle<int32_t>;
+
+	static constexpr int32_t TileWidth = 16;
+	static constexpr int32_t TileHeight = 16;
+	static constexpr int32_t Columns = VRamWidth / TileWidth;
+	static constexpr int32_t Rows = VRamHeight / TileHeight;
+
+	// a row of tiles is one word
+	using RowMask = uint64_t;
+	static_assert( Columns == stdx::bitsizeof<RowMask>() );
+	static_assert( Rows <= 32 );
+
+	void Clear() noexcept { m_rows.fill( 0 ); }
+
+	bool Empty() const noexcept
+	{
+		RowMask tiles = 0;
+		for ( auto row : m_rows )
+			tiles |= row;
+
+		return tiles == 0;
+	}
+
+	void Add( const Rect& area ) noexcept
+	{
+		const RowMask columns = GetColumnMask( area );
+		for ( uint32_t rows = GetRowMask( area ); rows != 0; rows &= rows - 1 )
+			m_rows[ stdx::countr_zero( rows ) ] |= columns;
+	}
+
+	bool Intersects( const Rect& area ) const noexcept
+	{
+		const RowMask columns = GetColumnMask( area );
+		for ( uint32_t rows = GetRowMask( area ); rows != 0; rows &= rows - 1 )
+		{
+			if ( m_rows[ stdx::countr_zero( rows ) ] & columns )
+				return true;
+		}
+
+		return false;
+	}
+
+	// clears the tiles overlapping the area and calls function with rectangles covering them.
+	// Vertically adjacent rows with the same tiles are merged
+	template <typename F>
+	void Extract( const Rect& area, F&& function )
+	{
+		const RowMask columns = GetColumnMask( area );
+		const uint32_t rows = GetRowMask( area );
+
+		RowMask runTiles = 0;
+		int32_t runTop = 0;
+		for ( int32_t row = 0; row <= Rows; ++row )
+		{
+			RowMask tiles = 0;
+			if ( row < Rows && ( rows & ( 1u << row ) ) )
+			{
+				tiles = m_rows[ row ] & columns;
+				m_rows[ row ] &= ~tiles;
+			}
+
+			if ( tiles != runTiles )
+			{
+				ForEachSpan( runTiles, runTop, row, function );
+				runTiles = tiles;
+				runTop = row;
+			}
+		}
+	}
+
+private:
+	// tile bits covering [start, end) wrapped to size
+	template <typename Mask, int32_t Size, int32_t TileSize>
+	static constexpr Mask GetTileMask( int32_t start, int32_t end ) noexcept
+	{
+		constexpr Mask AllTiles = static_cast<Mask>( ~Mask( 0 ) );
+		constexpr int32_t Tiles = Size / TileSize;
+
+		if ( end <= start )
+			return 0;
+
+		if ( end - start >= Size )
+			return AllTiles;
+
+		const int32_t first = ( start & ( Size - 1 ) ) / TileSize;
+		const int32_t last = ( ( end - 1 ) & ( Size - 1 ) ) / TileSize;
+		const Mask fromFirst = static_cast<Mask>( AllTiles << first );
+		const Mask toLast = static_cast<Mask>( AllTiles >> ( Tiles - 1 - last ) );
+
+		const bool wraps = ( start & ~( Size - 1 ) ) != ( ( end - 1 ) & ~( Size - 1 ) );
+		return wraps ? ( fromFirst | toLast ) : ( fromFirst & toLast );
+	}
+
+	static constexpr RowMask GetColumnMask( const Rect& area ) noexcept
+	{
+		return GetTileMask<RowMask, VRamWidth, TileWidth>( area.left, area.right );
+	}
+
+	static constexpr uint32_t GetRowMask( const Rect& area ) noexcept
+	{
+		return GetTileMask<uint32_t, VRamHeight, TileHeight>( area.top, area.bottom );
+	}
+
+	template <typename F>
+	static void ForEachSpan( RowMask tiles, int32_t top, int32_t bottom, F& function )
+	{
+		while ( tiles != 0 )
+		{
+			const int32_t first = stdx::countr_zero( tiles );
+			const int32_t count = stdx::countr_one( tiles >> first );
+			const RowMask span = ( count == Columns ) ? ~RowMask( 0 ) : ( ( RowMask( 1 ) << count ) - 1 ) << first;
+			tiles &= ~span;
+
+			function( Rect( first * TileWidth, top * TileHeight, ( first + count ) * TileWidth, bottom * TileHeight ) );
+		}
+	}
+
+private:
+	std::array<RowMask, Rows> m_rows{};
+};
+
+}
\ No newline at end of file
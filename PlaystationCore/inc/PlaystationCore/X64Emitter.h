@@ -0,0 +1,631 @@
+#pragma once
+
+#include <stdx/assert.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace PSX
+{
+
+// minimal x86-64 encoder for the recompiler. Only the forms the recompiler needs are supported
+class X64Emitter
+{
+public:
+	enum Reg : uint8_t
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+		R8, R9, R10, R11, R12, R13, R14, R15
+	};
+
+	enum Condition : uint8_t
+	{
+		Overflow,
+		NoOverflow,
+		Below,
+		AboveEqual,
+		Equal,
+		NotEqual,
+		BelowEqual,
+		Above,
+		Sign,
+		NoSign,
+		Parity,
+		NoParity,
+		Less,
+		GreaterEqual,
+		LessEqual,
+		Greater
+	};
+
+	enum AluOp : uint8_t
+	{
+		Add = 0,
+		Or = 1,
+		And = 4,
+		Sub = 5,
+		Xor = 6,
+		Cmp = 7
+	};
+
+	enum ShiftOp : uint8_t
+	{
+		Shl = 4,
+		Shr = 5,
+		Sar = 7
+	};
+
+#ifdef _WIN32
+	static constexpr Reg Arg0 = RCX;
+	static constexpr Reg Arg1 = RDX;
+	static constexpr Reg Arg2 = R8;
+#else
+	static constexpr Reg Arg0 = RDI;
+	static constexpr Reg Arg1 = RSI;
+	static constexpr Reg Arg2 = RDX;
+#endif
+
+	class Label
+	{
+		friend class X64Emitter;
+
+	public:
+		bool IsBound() const noexcept { return m_position != nullptr; }
+
+	private:
+		uint8_t* m_position = nullptr;
+		std::vector<uint8_t*> m_fixups; // rel32 operands waiting for the label to be bound
+	};
+
+	X64Emitter( uint8_t* code, size_t size ) noexcept : m_start{ code }, m_cursor{ code }, m_end{ code + size } {}
+
+	uint8_t* GetCursor() const noexcept { return m_cursor; }
+
+	size_t GetSize() const noexcept { return static_cast<size_t>( m_cursor - m_start ); }
+
+	// emitting stops writing at the end of the buffer
+	bool HasOverflowed() const noexcept { return m_cursor > m_end; }
+
+	void Bind( Label& label ) noexcept
+	{
+		dbExpects( !label.IsBound() );
+		label.m_position = m_cursor;
+		for ( uint8_t* fixup : label.m_fixups )
+			PatchRel32( fixup, m_cursor );
+
+		label.m_fixups.clear();
+	}
+
+	// point an already emitted rel32 operand at a new target
+	static void PatchRel32( uint8_t* operand, const uint8_t* target ) noexcept
+	{
+		const auto rel = static_cast<int32_t>( target - ( operand + 4 ) );
+		std::memcpy( operand, &rel, 4 );
+	}
+
+	// mov r32, [base + disp]
+	void MovRegMem32( Reg dest, Reg base, int32_t disp ) noexcept
+	{
+		Rex( false, dest, base );
+		Emit8( 0x8b );
+		ModRmDisp( dest, base, disp );
+	}
+
+	// mov [base + disp], r32
+	void MovMemReg32( Reg base, int32_t disp, Reg src ) noexcept
+	{
+		Rex( false, src, base );
+		Emit8( 0x89 );
+		ModRmDisp( src, base, disp );
+	}
+
+	// mov r64, [base + disp]
+	void MovRegMem64( Reg dest, Reg base, int32_t disp ) noexcept
+	{
+		Rex( true, dest, base );
+		Emit8( 0x8b );
+		ModRmDisp( dest, base, disp );
+	}
+
+	// mov [base + disp], r64
+	void MovMemReg64( Reg base, int32_t disp, Reg src ) noexcept
+	{
+		Rex( true, src, base );
+		Emit8( 0x89 );
+		ModRmDisp( src, base, disp );
+	}
+
+	// mov [base + index * 4 + disp], r32
+	void MovMemIndexReg32( Reg base, Reg index, int32_t disp, Reg src ) noexcept
+	{
+		dbExpects( index != RSP );
+		const uint8_t rex = 0x40 | ( ( src & 8 ) >> 1 ) | ( ( index & 8 ) >> 2 ) | ( ( base & 8 ) >> 3 );
+		if ( rex != 0x40 )
+			Emit8( rex );
+
+		Emit8( 0x89 );
+		Emit8( static_cast<uint8_t>( 0x84 | ( ( src & 7 ) << 3 ) ) );
+		Emit8( static_cast<uint8_t>( 0x80 | ( ( index & 7 ) << 3 ) | ( base & 7 ) ) );
+		Emit32( static_cast<uint32_t>( disp ) );
+	}
+
+	// mov [base + index * 8 + disp], r64
+	void MovMemIndexReg64( Reg base, Reg index, int32_t disp, Reg src ) noexcept
+	{
+		dbExpects( index != RSP );
+		Emit8( static_cast<uint8_t>( 0x48 | ( ( src & 8 ) >> 1 ) | ( ( index & 8 ) >> 2 ) | ( ( base & 8 ) >> 3 ) ) );
+		Emit8( 0x89 );
+		Emit8( static_cast<uint8_t>( 0x84 | ( ( src & 7 ) << 3 ) ) );
+		Emit8( static_cast<uint8_t>( 0xc0 | ( ( index & 7 ) << 3 ) | ( base & 7 ) ) );
+		Emit32( static_cast<uint32_t>( disp ) );
+	}
+
+	// cmp r32, [base + index * 8 + disp]
+	void CmpRegMemIndex32( Reg lhs, Reg base, Reg index, int32_t disp ) noexcept
+	{
+		dbExpects( index != RSP );
+		const uint8_t rex = 0x40 | ( ( lhs & 8 ) >> 1 ) | ( ( index & 8 ) >> 2 ) | ( ( base & 8 ) >> 3 );
+		if ( rex != 0x40 )
+			Emit8( rex );
+
+		Emit8( 0x3b );
+		Emit8( static_cast<uint8_t>( 0x84 | ( ( lhs & 7 ) << 3 ) ) );
+		Emit8( static_cast<uint8_t>( 0xc0 | ( ( index & 7 ) << 3 ) | ( base & 7 ) ) );
+		Emit32( static_cast<uint32_t>( disp ) );
+	}
+
+	// mov r32, [base + index]
+	void MovRegMemIndex32( Reg dest, Reg base, Reg index ) noexcept
+	{
+		RexIndex( dest, base, index );
+		Emit8( 0x8b );
+		SibIndex( dest, base, index );
+	}
+
+	// movzx/movsx r32, byte [base + index]
+	void MovxRegMemIndex8( Reg dest, Reg base, Reg index, bool signExtend ) noexcept
+	{
+		RexIndex( dest, base, index );
+		Emit8( 0x0f );
+		Emit8( static_cast<uint8_t>( signExtend ? 0xbe : 0xb6 ) );
+		SibIndex( dest, base, index );
+	}
+
+	// movzx/movsx r32, word [base + index]
+	void MovxRegMemIndex16( Reg dest, Reg base, Reg index, bool signExtend ) noexcept
+	{
+		RexIndex( dest, base, index );
+		Emit8( 0x0f );
+		Emit8( static_cast<uint8_t>( signExtend ? 0xbf : 0xb7 ) );
+		SibIndex( dest, base, index );
+	}
+
+	// mov [base + index], r32
+	void MovMemIndexReg32( Reg base, Reg index, Reg src ) noexcept
+	{
+		RexIndex( src, base, index );
+		Emit8( 0x89 );
+		SibIndex( src, base, index );
+	}
+
+	// mov [base + index], r16
+	void MovMemIndexReg16( Reg base, Reg index, Reg src ) noexcept
+	{
+		Emit8( 0x66 );
+		RexIndex( src, base, index );
+		Emit8( 0x89 );
+		SibIndex( src, base, index );
+	}
+
+	// mov [base + index], r8
+	void MovMemIndexReg8( Reg base, Reg index, Reg src ) noexcept
+	{
+		dbExpects( src < RSP ); // no REX prefix needed for al, cl, dl, bl
+		RexIndex( src, base, index );
+		Emit8( 0x88 );
+		SibIndex( src, base, index );
+	}
+
+	// mov dword [base + disp], imm32
+	void MovMemImm32( Reg base, int32_t disp, uint32_t imm ) noexcept
+	{
+		Rex( false, RAX, base );
+		Emit8( 0xc7 );
+		ModRmDisp( RAX, base, disp );
+		Emit32( imm );
+	}
+
+	// mov byte [base + disp], imm8
+	void MovMemImm8( Reg base, int32_t disp, uint8_t imm ) noexcept
+	{
+		Rex( false, RAX, base );
+		Emit8( 0xc6 );
+		ModRmDisp( RAX, base, disp );
+		Emit8( imm );
+	}
+
+	// movzx r32, byte [base + disp]
+	void MovzxRegMem8( Reg dest, Reg base, int32_t disp ) noexcept
+	{
+		Rex( false, dest, base );
+		Emit8( 0x0f );
+		Emit8( 0xb6 );
+		ModRmDisp( dest, base, disp );
+	}
+
+	// mov [base + disp], r8
+	void MovMemReg8( Reg base, int32_t disp, Reg src ) noexcept
+	{
+		dbExpects( src < RSP ); // no REX prefix needed for al, cl, dl, bl
+		Rex( false, src, base );
+		Emit8( 0x88 );
+		ModRmDisp( src, base, disp );
+	}
+
+	// mov r32, imm32 (zero extended)
+	void MovRegImm32( Reg dest, uint32_t imm ) noexcept
+	{
+		if ( dest & 8 )
+			Emit8( 0x41 );
+
+		Emit8( static_cast<uint8_t>( 0xb8 | ( dest & 7 ) ) );
+		Emit32( imm );
+	}
+
+	// mov r64, imm64
+	void MovRegImm64( Reg dest, uint64_t imm ) noexcept
+	{
+		Emit8( static_cast<uint8_t>( 0x48 | ( ( dest & 8 ) >> 3 ) ) );
+		Emit8( static_cast<uint8_t>( 0xb8 | ( dest & 7 ) ) );
+		Emit64( imm );
+	}
+
+	void MovRegPtr( Reg dest, const void* ptr ) noexcept
+	{
+		MovRegImm64( dest, reinterpret_cast<uintptr_t>( ptr ) );
+	}
+
+	// mov r32, r32
+	void MovRegReg32( Reg dest, Reg src ) noexcept
+	{
+		Rex( false, src, dest );
+		Emit8( 0x89 );
+		ModRmReg( src, dest );
+	}
+
+	// mov r64, r64
+	void MovRegReg64( Reg dest, Reg src ) noexcept
+	{
+		Rex( true, src, dest );
+		Emit8( 0x89 );
+		ModRmReg( src, dest );
+	}
+
+	// op r32, r32
+	void AluRegReg32( AluOp op, Reg dest, Reg src ) noexcept
+	{
+		Rex( false, src, dest );
+		Emit8( static_cast<uint8_t>( ( op << 3 ) | 0x01 ) );
+		ModRmReg( src, dest );
+	}
+
+	// op r32, imm32
+	void AluRegImm32( AluOp op, Reg dest, uint32_t imm ) noexcept
+	{
+		Rex( false, RAX, dest );
+		if ( FitsInt8( imm ) )
+		{
+			Emit8( 0x83 );
+			ModRmReg( static_cast<Reg>( op ), dest );
+			Emit8( static_cast<uint8_t>( imm ) );
+		}
+		else
+		{
+			Emit8( 0x81 );
+			ModRmReg( static_cast<Reg>( op ), dest );
+			Emit32( imm );
+		}
+	}
+
+	// op dword [base + disp], imm32
+	void AluMemImm32( AluOp op, Reg base, int32_t disp, uint32_t imm ) noexcept
+	{
+		Rex( false, RAX, base );
+		if ( FitsInt8( imm ) )
+		{
+			Emit8( 0x83 );
+			ModRmDisp( static_cast<Reg>( op ), base, disp );
+			Emit8( static_cast<uint8_t>( imm ) );
+		}
+		else
+		{
+			Emit8( 0x81 );
+			ModRmDisp( static_cast<Reg>( op ), base, disp );
+			Emit32( imm );
+		}
+	}
+
+	// op r32, [base + disp]
+	void AluRegMem32( AluOp op, Reg dest, Reg base, int32_t disp ) noexcept
+	{
+		Rex( false, dest, base );
+		Emit8( static_cast<uint8_t>( ( op << 3 ) | 0x03 ) );
+		ModRmDisp( dest, base, disp );
+	}
+
+	// op r64, imm32 (sign extended)
+	void AluRegImm64( AluOp op, Reg dest, int32_t imm ) noexcept
+	{
+		Rex( true, RAX, dest );
+		if ( FitsInt8( static_cast<uint32_t>( imm ) ) )
+		{
+			Emit8( 0x83 );
+			ModRmReg( static_cast<Reg>( op ), dest );
+			Emit8( static_cast<uint8_t>( imm ) );
+		}
+		else
+		{
+			Emit8( 0x81 );
+			ModRmReg( static_cast<Reg>( op ), dest );
+			Emit32( static_cast<uint32_t>( imm ) );
+		}
+	}
+
+	// test r32, r32
+	void TestRegReg32( Reg lhs, Reg rhs ) noexcept
+	{
+		Rex( false, rhs, lhs );
+		Emit8( 0x85 );
+		ModRmReg( rhs, lhs );
+	}
+
+	// test r32, imm32
+	void TestRegImm32( Reg reg, uint32_t imm ) noexcept
+	{
+		Rex( false, RAX, reg );
+		Emit8( 0xf7 );
+		ModRmReg( RAX, reg );
+		Emit32( imm );
+	}
+
+	// test byte [base + disp], imm8
+	void TestMemImm8( Reg base, int32_t disp, uint8_t imm ) noexcept
+	{
+		Rex( false, RAX, base );
+		Emit8( 0xf6 );
+		ModRmDisp( RAX, base, disp );
+		Emit8( imm );
+	}
+
+	// cmp byte [base + index], imm8
+	void CmpMemIndexImm8( Reg base, Reg index, uint8_t imm ) noexcept
+	{
+		RexIndex( RAX, base, index );
+		Emit8( 0x80 );
+		SibIndex( static_cast<Reg>( Cmp ), base, index );
+		Emit8( imm );
+	}
+
+	// test r8, r8
+	void TestRegReg8( Reg lhs, Reg rhs ) noexcept
+	{
+		dbExpects( lhs < RSP && rhs < RSP );
+		Emit8( 0x84 );
+		ModRmReg( rhs, lhs );
+	}
+
+	// not r32
+	void NotReg32( Reg reg ) noexcept
+	{
+		Rex( false, RAX, reg );
+		Emit8( 0xf7 );
+		ModRmReg( static_cast<Reg>( 2 ), reg );
+	}
+
+	// shift r32 by imm8
+	void ShiftRegImm32( ShiftOp op, Reg reg, uint8_t amount ) noexcept
+	{
+		dbExpects( amount < 32 );
+		if ( amount == 0 )
+			return;
+
+		Rex( false, RAX, reg );
+		Emit8( 0xc1 );
+		ModRmReg( static_cast<Reg>( op ), reg );
+		Emit8( amount );
+	}
+
+	// shift r32 by cl
+	void ShiftRegCl32( ShiftOp op, Reg reg ) noexcept
+	{
+		Rex( false, RAX, reg );
+		Emit8( 0xd3 );
+		ModRmReg( static_cast<Reg>( op ), reg );
+	}
+
+	// setcc r8; movzx r32, r8
+	void SetRegCondition32( Condition condition, Reg reg ) noexcept
+	{
+		dbExpects( reg < RSP );
+		Emit8( 0x0f );
+		Emit8( static_cast<uint8_t>( 0x90 | condition ) );
+		ModRmReg( RAX, reg );
+		Emit8( 0x0f );
+		Emit8( 0xb6 );
+		ModRmReg( reg, reg );
+	}
+
+	// cmovcc r32, r32
+	void CmovRegReg32( Condition condition, Reg dest, Reg src ) noexcept
+	{
+		Rex( false, dest, src );
+		Emit8( 0x0f );
+		Emit8( static_cast<uint8_t>( 0x40 | condition ) );
+		ModRmReg( dest, src );
+	}
+
+	void Jump( Label& label ) noexcept
+	{
+		Emit8( 0xe9 );
+		Rel32( label );
+	}
+
+	void Jump( Condition condition, Label& label ) noexcept
+	{
+		Emit8( 0x0f );
+		Emit8( static_cast<uint8_t>( 0x80 | condition ) );
+		Rel32( label );
+	}
+
+	// jmp rel32 to an address outside the current block. Returns the location of the rel32 operand
+	uint8_t* Jump( const uint8_t* target ) noexcept
+	{
+		Emit8( 0xe9 );
+		uint8_t* operand = m_cursor;
+		Emit32( 0 );
+		if ( !HasOverflowed() )
+			PatchRel32( operand, target );
+
+		return operand;
+	}
+
+	// jmp r64
+	void JumpReg( Reg target ) noexcept
+	{
+		Rex( false, RAX, target );
+		Emit8( 0xff );
+		ModRmReg( static_cast<Reg>( 4 ), target );
+	}
+
+	// calls through rax so the target may be anywhere in the address space
+	void Call( const void* function ) noexcept
+	{
+		MovRegPtr( RAX, function );
+		Emit8( 0xff );
+		Emit8( 0xd0 );
+	}
+
+	void Push( Reg reg ) noexcept
+	{
+		if ( reg & 8 )
+			Emit8( 0x41 );
+
+		Emit8( static_cast<uint8_t>( 0x50 | ( reg & 7 ) ) );
+	}
+
+	void Pop( Reg reg ) noexcept
+	{
+		if ( reg & 8 )
+			Emit8( 0x41 );
+
+		Emit8( static_cast<uint8_t>( 0x58 | ( reg & 7 ) ) );
+	}
+
+	void Ret() noexcept
+	{
+		Emit8( 0xc3 );
+	}
+
+	void Nop( size_t count ) noexcept
+	{
+		for ( size_t i = 0; i < count; ++i )
+			Emit8( 0x90 );
+	}
+
+private:
+	static constexpr bool FitsInt8( uint32_t imm ) noexcept
+	{
+		return static_cast<int32_t>( imm ) >= -128 && static_cast<int32_t>( imm ) <= 127;
+	}
+
+	void Emit8( uint8_t value ) noexcept
+	{
+		if ( m_cursor < m_end )
+			*m_cursor = value;
+
+		++m_cursor;
+	}
+
+	void Emit32( uint32_t value ) noexcept
+	{
+		for ( int i = 0; i < 4; ++i )
+			Emit8( static_cast<uint8_t>( value >> ( i * 8 ) ) );
+	}
+
+	void Emit64( uint64_t value ) noexcept
+	{
+		for ( int i = 0; i < 8; ++i )
+			Emit8( static_cast<uint8_t>( value >> ( i * 8 ) ) );
+	}
+
+	void Rel32( Label& label ) noexcept
+	{
+		uint8_t* operand = m_cursor;
+		Emit32( 0 );
+		if ( HasOverflowed() )
+			return;
+
+		if ( label.IsBound() )
+			PatchRel32( operand, label.m_position );
+		else
+			label.m_fixups.push_back( operand );
+	}
+
+	void Rex( bool wide, Reg reg, Reg rm ) noexcept
+	{
+		const uint8_t rex = static_cast<uint8_t>( 0x40 | ( wide ? 8 : 0 ) | ( ( reg & 8 ) >> 1 ) | ( ( rm & 8 ) >> 3 ) );
+		if ( rex != 0x40 )
+			Emit8( rex );
+	}
+
+	void RexIndex( Reg reg, Reg base, Reg index ) noexcept
+	{
+		const uint8_t rex = static_cast<uint8_t>( 0x40 | ( ( reg & 8 ) >> 1 ) | ( ( index & 8 ) >> 2 ) | ( ( base & 8 ) >> 3 ) );
+		if ( rex != 0x40 )
+			Emit8( rex );
+	}
+
+	// [base + index]. rbp and r13 as a base would need a displacement
+	void SibIndex( Reg reg, Reg base, Reg index ) noexcept
+	{
+		dbExpects( ( base & 7 ) != RBP );
+		dbExpects( index != RSP );
+		Emit8( static_cast<uint8_t>( 0x04 | ( ( reg & 7 ) << 3 ) ) );
+		Emit8( static_cast<uint8_t>( ( ( index & 7 ) << 3 ) | ( base & 7 ) ) );
+	}
+
+	void ModRmReg( Reg reg, Reg rm ) noexcept
+	{
+		Emit8( static_cast<uint8_t>( 0xc0 | ( ( reg & 7 ) << 3 ) | ( rm & 7 ) ) );
+	}
+
+	// [base + disp]. rsp and r12 as a base need a SIB byte
+	void ModRmDisp( Reg reg, Reg base, int32_t disp ) noexcept
+	{
+		const bool needsSib = ( base & 7 ) == RSP;
+		const bool noDisp = disp == 0 && ( base & 7 ) != RBP;
+		const bool disp8 = disp >= -128 && disp <= 127;
+
+		const uint8_t mod = noDisp ? 0x00 : ( disp8 ? 0x40 : 0x80 );
+		Emit8( static_cast<uint8_t>( mod | ( ( reg & 7 ) << 3 ) | ( base & 7 ) ) );
+
+		if ( needsSib )
+			Emit8( 0x24 );
+
+		if ( noDisp )
+			return;
+
+		if ( disp8 )
+			Emit8( static_cast<uint8_t>( disp ) );
+		else
+			Emit32( static_cast<uint32_t>( disp ) );
+	}
+
+private:
+	uint8_t* m_start;
+	uint8_t* m_cursor;
+	uint8_t* m_end;
+};
+
+}
\ No newline at end of file
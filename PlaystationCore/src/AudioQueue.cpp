@@ -22,6 +22,7 @@ AudioQueue::BatchWriter::~BatchWriter()
 		m_queue.m_size += count;
 
 		m_queue.CheckFullBuffer();
+		m_queue.DrainToSink();
 	}
 
 	// release lock
@@ -82,9 +83,34 @@ bool AudioQueue::Initialize( int frequency, uint8_t channels, uint16_t bufferSiz
 	return true;
 }
 
+bool AudioQueue::InitializeWithoutDevice( int frequency, uint8_t channels, uint16_t bufferSize )
+{
+	if ( channels != 1 && channels != 2 )
+	{
+		dbLogError( "AudioQueue::InitializeWithoutDevice -- Invalid number of channels [%u]", (uint32_t)channels );
+		return false;
+	}
+
+	// same batching as with a device
+	m_settings = {};
+	m_settings.freq = frequency;
+	m_settings.format = AUDIO_S16;
+	m_settings.channels = channels;
+	m_settings.samples = bufferSize;
+
+	m_withoutDevice = true;
+
+	m_bufferSize = static_cast<size_t>( m_settings.freq * m_settings.channels );
+	m_queue = std::make_unique<int16_t[]>( m_bufferSize );
+
+	ClearInternal();
+
+	return true;
+}
+
 void AudioQueue::SetPaused( bool pause )
 {
-	dbAssert( m_deviceId > 0 );
+	dbAssert( m_deviceId > 0 || m_withoutDevice );
 	if ( m_paused != pause )
 	{
 		std::unique_lock lock{ m_queueMutex };
@@ -167,6 +193,7 @@ void AudioQueue::PushSamples( const int16_t* samples, size_t count )
 	m_last = ( m_last + count ) % m_bufferSize;
 
 	CheckFullBuffer();
+	DrainToSink();
 }
 
 void AudioQueue::PushSilenceFrames( size_t count )
@@ -195,6 +222,7 @@ void AudioQueue::PushSilenceFrames( size_t count )
 	m_last = ( m_last + count ) % m_bufferSize;
 
 	CheckFullBuffer();
+	DrainToSink();
 }
 
 void AudioQueue::IgnoreSamples( size_t count )
@@ -212,7 +240,9 @@ void AudioQueue::ClearInternal()
 	m_first = 0;
 	m_last = 0;
 	m_waitForFullBuffer = true;
-	SDL_PauseAudioDevice( m_deviceId, true );
+
+	if ( m_deviceId != 0 )
+		SDL_PauseAudioDevice( m_deviceId, true );
 }
 
 void AudioQueue::CheckFullBuffer()
@@ -221,11 +251,30 @@ void AudioQueue::CheckFullBuffer()
 	{
 		m_waitForFullBuffer = false;
 
-		if ( !m_paused )
+		if ( !m_paused && m_deviceId != 0 )
 			SDL_PauseAudioDevice( m_deviceId, false );
 	}
 }
 
+void AudioQueue::DrainToSink()
+{
+	if ( !m_withoutDevice || m_size == 0 )
+		return;
+
+	const size_t seg1Size = std::min( m_size, m_bufferSize - m_first );
+	const size_t seg2Size = m_size - seg1Size;
+
+	if ( m_sink )
+	{
+		m_sink( m_queue.get() + m_first, seg1Size );
+		if ( seg2Size > 0 )
+			m_sink( m_queue.get(), seg2Size );
+	}
+
+	m_size = 0;
+	m_first = m_last;
+}
+
 template <typename T>
 void AudioQueue::PopSamples( T* dest, size_t count )
 {
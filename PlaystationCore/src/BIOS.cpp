@@ -409,6 +409,19 @@ void LogKernalCallC( uint32_t call, uint32_t pc )
 		std::printf( "C(%02X): %s from %08X\n", call, str, pc );
 }
 
+const char* GetKernelFunctionName( uint32_t vector, uint32_t call )
+{
+	auto Find = [call]( const auto& names ) { return ( call < std::size( names ) ) ? names[ call ] : nullptr; };
+
+	switch ( vector & 0x1fffffff )
+	{
+		case 0xa0:	return Find( FunctionNamesA );
+		case 0xb0:	return Find( FunctionNamesB );
+		case 0xc0:	return Find( FunctionNamesC );
+		default:	return nullptr;
+	}
+}
+
 const char* const SystemCallNames[]
 {
 	"NoFunction",
@@ -0,0 +1,635 @@
+#include "BiosHle.h"
+
+#include "CodeCache.h"
+#include "MemoryMap.h"
+#include "RAM.h"
+#include "SaveState.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace PSX
+{
+
+namespace
+{
+
+// kernel function tables in RAM
+constexpr uint32_t TableA = 0x200;
+constexpr uint32_t TableB = 0x874;
+constexpr uint32_t TableC = 0x674;
+
+// functions installed by games live above the kernel area
+constexpr uint32_t KernelRamEnd = 0x10000;
+
+// pointer to the event control blocks and the size of the table in bytes
+constexpr uint32_t EventTablePointer = 0x120;
+constexpr uint32_t EventTableSize = 0x124;
+
+constexpr uint32_t EventControlBlockSize = 0x1c;
+constexpr uint32_t EventStatusOffset = 0x04;
+constexpr uint32_t EventHandleMask = 0xffff0000;
+constexpr uint32_t EventHandleBase = 0xf1000000;
+
+constexpr uint32_t EventStatusBusy = 0x2000;
+constexpr uint32_t EventStatusReady = 0x4000;
+
+constexpr uint32_t HeapBlockUsed = 1;
+constexpr uint32_t HeapHeaderSize = 4;
+
+// guest cycles of the BIOS code, about one per instruction. Every call pays for the A0h/B0h dispatcher, entry and return
+constexpr cycles_t CallCycles = 20;
+
+// instructions per iteration of the BIOS loops
+constexpr cycles_t MemcpyByteCycles = 6;
+constexpr cycles_t MemsetByteCycles = 4;
+constexpr cycles_t StrcmpCharCycles = 8;
+constexpr cycles_t StrlenCharCycles = 4;
+constexpr cycles_t StrcpyCharCycles = 5;
+constexpr cycles_t HeapBlockCycles = 10; // per block malloc walks past
+constexpr cycles_t RandCycles = 12; // includes the multiply
+
+// iterations are bounded by the size of guest memory, so this doesn't overflow
+constexpr cycles_t LoopCycles( cycles_t iterationCycles, uint32_t iterations ) noexcept
+{
+	return CallCycles + iterationCycles * static_cast<cycles_t>( iterations );
+}
+
+const char* const FunctionNames[]
+{
+	"memcpy",
+	"memset",
+	"bzero",
+	"strcmp",
+	"strlen",
+	"strcpy",
+	"rand",
+	"heap",
+	"TestEvent",
+	"WaitEvent"
+};
+
+static_assert( std::size( FunctionNames ) == BiosHle::FunctionCount );
+
+uint32_t Read32( const uint8_t* data ) noexcept
+{
+	uint32_t value;
+	std::memcpy( &value, data, sizeof( value ) );
+	return value;
+}
+
+// the linear congruential generator of the BIOS and Psy-Q rand
+constexpr uint32_t NextRandomSeed( uint32_t seed ) noexcept
+{
+	return seed * 0x41c64e6d + 0x3039;
+}
+
+constexpr uint32_t GetRandomValue( uint32_t seed ) noexcept
+{
+	return ( seed >> 16 ) & 0x7fff;
+}
+
+}
+
+BiosHle::BiosHle( MemoryMap& memoryMap, CodeCache& codeCache )
+	: m_memoryMap{ memoryMap }
+	, m_codeCache{ codeCache }
+{
+	m_enabled.fill( true );
+}
+
+void BiosHle::Reset()
+{
+	m_callCounts.fill( 0 );
+	m_randomSeed = 0;
+	m_heapBase = 0;
+	m_heapStart = 0;
+	m_heapEnd = 0;
+}
+
+std::optional<BiosHle::Result> BiosHle::Call( uint32_t vector, uint32_t call, const std::array<uint32_t, 4>& args ) noexcept
+{
+	const auto function = GetFunction( vector, call );
+	if ( !function.has_value() || !IsEnabled( *function ) || !IsKernelFunction( vector, call ) )
+		return std::nullopt;
+
+	const auto result = CallFunction( *function, call, args );
+	if ( result.has_value() )
+		++m_callCounts[ static_cast<size_t>( *function ) ];
+
+	return result;
+}
+
+std::optional<BiosHle::Function> BiosHle::GetFunction( uint32_t vector, uint32_t call ) noexcept
+{
+	if ( vector == 0xa0 )
+	{
+		switch ( call )
+		{
+			case 0x17:	return Function::Strcmp;
+			case 0x19:	return Function::Strcpy;
+			case 0x1b:	return Function::Strlen;
+			case 0x28:	return Function::Bzero;
+			case 0x2a:	return Function::Memcpy;
+			case 0x2b:	return Function::Memset;
+			case 0x2f:
+			case 0x30:	return Function::Rand;
+			case 0x33:
+			case 0x34:
+			case 0x37:
+			case 0x38:
+			case 0x39:	return Function::Heap;
+		}
+	}
+	else if ( vector == 0xb0 )
+	{
+		switch ( call )
+		{
+			case 0x0a:	return Function::WaitEvent;
+			case 0x0b:	return Function::TestEvent;
+		}
+	}
+
+	return std::nullopt;
+}
+
+std::optional<BiosHle::Result> BiosHle::CallFunction( Function function, uint32_t call, const std::array<uint32_t, 4>& args ) noexcept
+{
+	switch ( function )
+	{
+		case Function::Memcpy:	return Memcpy( args[ 0 ], args[ 1 ], args[ 2 ] );
+		case Function::Memset:	return Memset( args[ 0 ], static_cast<uint8_t>( args[ 1 ] ), args[ 2 ] );
+		case Function::Bzero:	return Memset( args[ 0 ], 0, args[ 1 ] );
+		case Function::Strcmp:	return Strcmp( args[ 0 ], args[ 1 ] );
+		case Function::Strlen:	return Strlen( args[ 0 ] );
+		case Function::Strcpy:	return Strcpy( args[ 0 ], args[ 1 ] );
+
+		case Function::Rand:
+		{
+			if ( call == 0x30 )
+			{
+				m_randomSeed = args[ 0 ];
+				return Result{ 0, CallCycles };
+			}
+
+			m_randomSeed = NextRandomSeed( m_randomSeed );
+			return Result{ GetRandomValue( m_randomSeed ), CallCycles + RandCycles };
+		}
+
+		case Function::Heap:
+		{
+			if ( call == 0x39 )
+			{
+				const auto result = InitHeap( args[ 0 ], args[ 1 ] );
+				if ( !result.has_value() )
+					return std::nullopt;
+
+				return Result{ *result, CallCycles };
+			}
+
+			// the BIOS owns a heap that wasn't initialized through HLE
+			if ( m_heapEnd == 0 )
+				return std::nullopt;
+
+			switch ( call )
+			{
+				case 0x33:	return Malloc( args[ 0 ] );
+				case 0x34:	Free( args[ 0 ] );	return Result{ 0, CallCycles };
+				case 0x37:	return Calloc( args[ 0 ], args[ 1 ] );
+				case 0x38:	return Realloc( args[ 0 ], args[ 1 ] );
+			}
+			break;
+		}
+
+		case Function::TestEvent:
+		case Function::WaitEvent:
+		{
+			const auto result = TestEvent( args[ 0 ], function == Function::WaitEvent );
+			if ( !result.has_value() )
+				return std::nullopt;
+
+			return Result{ *result, CallCycles };
+		}
+
+		case Function::Count:
+			break;
+	}
+
+	dbBreak();
+	return std::nullopt;
+}
+
+std::optional<BiosHle::Result> BiosHle::CallLibraryFunction( Function function, uint32_t call, uint32_t seedAddress, const std::array<uint32_t, 4>& args ) noexcept
+{
+	dbExpects( IsLibraryFunction( function ) );
+
+	// the library's seed isn't the kernel's
+	if ( function == Function::Rand )
+		return LibraryRand( call, seedAddress, args[ 0 ] );
+
+	return CallFunction( function, call, args );
+}
+
+bool BiosHle::IsLibraryFunction( Function function ) noexcept
+{
+	switch ( function )
+	{
+		case Function::Memcpy:
+		case Function::Memset:
+		case Function::Bzero:
+		case Function::Strcmp:
+		case Function::Strlen:
+		case Function::Strcpy:
+		case Function::Rand:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+bool BiosHle::IsKernelFunction( uint32_t vector, uint32_t call ) const noexcept
+{
+	const uint32_t table = ( vector == 0xa0 ) ? TableA : ( vector == 0xb0 ) ? TableB : TableC;
+	const uint32_t function = m_memoryMap.GetRam().Read<uint32_t>( table + call * 4 ) & 0x1fffffff;
+	return function < KernelRamEnd || ( function - MemoryMap::BiosStart ) < MemoryMap::BiosSize;
+}
+
+std::pair<const uint8_t*, uint32_t> BiosHle::GetReadRegion( uint32_t address ) const noexcept
+{
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( physicalAddress < MemoryMap::RamMirrorSize )
+	{
+		const uint32_t offset = physicalAddress % RamSize;
+		return { m_memoryMap.GetRam().Data() + offset, RamSize - offset };
+	}
+
+	if ( physicalAddress - MemoryMap::BiosStart < MemoryMap::BiosSize )
+	{
+		const uint32_t offset = physicalAddress - MemoryMap::BiosStart;
+		return { m_memoryMap.GetRealAddress( address ), MemoryMap::BiosSize - offset };
+	}
+
+	// the scratchpad isn't accessible from KSEG1
+	if ( physicalAddress - MemoryMap::ScratchpadStart < MemoryMap::ScratchpadSize && ( address & 0xe0000000 ) != 0xa0000000 )
+	{
+		const uint32_t offset = physicalAddress - MemoryMap::ScratchpadStart;
+		return { m_memoryMap.GetRealAddress( address ), MemoryMap::ScratchpadSize - offset };
+	}
+
+	return { nullptr, 0 };
+}
+
+const uint8_t* BiosHle::GetReadPointer( uint32_t address, uint32_t size ) const noexcept
+{
+	const auto [ data, available ] = GetReadRegion( address );
+	return ( size <= available ) ? data : nullptr;
+}
+
+uint8_t* BiosHle::GetWritePointer( uint32_t address, uint32_t size ) noexcept
+{
+	dbExpects( size > 0 );
+
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( physicalAddress >= MemoryMap::RamMirrorSize )
+		return nullptr;
+
+	const uint32_t offset = physicalAddress % RamSize;
+	if ( size > RamSize - offset )
+		return nullptr;
+
+	m_codeCache.InvalidateRam( offset, size );
+	return m_memoryMap.GetRam().Data() + offset;
+}
+
+std::optional<BiosHle::Result> BiosHle::Memcpy( uint32_t dest, uint32_t src, uint32_t size ) noexcept
+{
+	if ( dest == 0 || src == 0 || static_cast<int32_t>( size ) <= 0 )
+		return std::nullopt;
+
+	const uint8_t* srcData = GetReadPointer( src, size );
+	if ( !srcData )
+		return std::nullopt;
+
+	uint8_t* destData = GetWritePointer( dest, size );
+	if ( !destData )
+		return std::nullopt;
+
+	// the BIOS copies forwards one byte at a time, which repeats data when the destination overlaps the end of the source
+	for ( uint32_t i = 0; i < size; ++i )
+		destData[ i ] = srcData[ i ];
+
+	return Result{ dest, LoopCycles( MemcpyByteCycles, size ) };
+}
+
+std::optional<BiosHle::Result> BiosHle::Memset( uint32_t dest, uint8_t value, uint32_t size ) noexcept
+{
+	if ( dest == 0 || static_cast<int32_t>( size ) <= 0 )
+		return std::nullopt;
+
+	uint8_t* destData = GetWritePointer( dest, size );
+	if ( !destData )
+		return std::nullopt;
+
+	std::memset( destData, value, size );
+	return Result{ dest, LoopCycles( MemsetByteCycles, size ) };
+}
+
+std::optional<BiosHle::Result> BiosHle::Strcmp( uint32_t lhs, uint32_t rhs ) noexcept
+{
+	if ( lhs == 0 || rhs == 0 )
+		return std::nullopt;
+
+	const auto [ lhsData, lhsAvailable ] = GetReadRegion( lhs );
+	const auto [ rhsData, rhsAvailable ] = GetReadRegion( rhs );
+	const uint32_t available = std::min( lhsAvailable, rhsAvailable );
+
+	for ( uint32_t i = 0; i < available; ++i )
+	{
+		// characters are loaded signed
+		const auto l = static_cast<int8_t>( lhsData[ i ] );
+		const auto r = static_cast<int8_t>( rhsData[ i ] );
+		if ( l != r )
+			return Result{ static_cast<uint32_t>( l - r ), LoopCycles( StrcmpCharCycles, i + 1 ) };
+
+		if ( l == 0 )
+			return Result{ 0, LoopCycles( StrcmpCharCycles, i + 1 ) };
+	}
+
+	return std::nullopt;
+}
+
+std::optional<BiosHle::Result> BiosHle::Strlen( uint32_t str ) noexcept
+{
+	if ( str == 0 )
+		return std::nullopt;
+
+	const auto [ data, available ] = GetReadRegion( str );
+	if ( !data )
+		return std::nullopt;
+
+	const auto* end = static_cast<const uint8_t*>( std::memchr( data, 0, available ) );
+	if ( !end )
+		return std::nullopt;
+
+	// the terminator is read too
+	const auto length = static_cast<uint32_t>( end - data );
+	return Result{ length, LoopCycles( StrlenCharCycles, length + 1 ) };
+}
+
+std::optional<BiosHle::Result> BiosHle::Strcpy( uint32_t dest, uint32_t src ) noexcept
+{
+	const auto length = Strlen( src );
+	if ( !length.has_value() || dest == 0 )
+		return std::nullopt;
+
+	// include the terminator
+	const uint32_t size = length->value + 1;
+	const uint8_t* srcData = GetReadPointer( src, size );
+	uint8_t* destData = GetWritePointer( dest, size );
+	if ( !destData )
+		return std::nullopt;
+
+	// the guest copies until it reads the terminator, which a destination inside the string overwrites
+	if ( srcData < destData && destData < srcData + size )
+		return std::nullopt;
+
+	std::memmove( destData, srcData, size );
+
+	return Result{ dest, LoopCycles( StrcpyCharCycles, size ) };
+}
+
+std::optional<BiosHle::Result> BiosHle::LibraryRand( uint32_t call, uint32_t seedAddress, uint32_t seed ) noexcept
+{
+	if ( seedAddress % 4 != 0 )
+		return std::nullopt;
+
+	uint8_t* seedData = GetWritePointer( seedAddress, 4 );
+	if ( !seedData )
+		return std::nullopt;
+
+	if ( call == 0x30 )
+	{
+		std::memcpy( seedData, &seed, sizeof( seed ) );
+		return Result{ 0, CallCycles };
+	}
+
+	seed = NextRandomSeed( Read32( seedData ) );
+	std::memcpy( seedData, &seed, sizeof( seed ) );
+	return Result{ GetRandomValue( seed ), CallCycles + RandCycles };
+}
+
+std::optional<uint32_t> BiosHle::InitHeap( uint32_t address, uint32_t size ) noexcept
+{
+	m_heapBase = 0;
+	m_heapStart = 0;
+	m_heapEnd = 0;
+
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( physicalAddress >= MemoryMap::RamMirrorSize )
+		return std::nullopt;
+
+	const uint32_t start = ( physicalAddress % RamSize + 3 ) & ~3u;
+	const uint32_t alignment = start - physicalAddress % RamSize;
+	if ( size <= alignment + HeapHeaderSize || start + ( size - alignment ) > RamSize )
+		return std::nullopt;
+
+	m_heapBase = address - physicalAddress % RamSize;
+	m_heapStart = start;
+	m_heapEnd = start + ( ( size - alignment ) & ~3u );
+
+	WriteHeapHeader( m_heapStart, m_heapEnd - m_heapStart - HeapHeaderSize );
+	return 0;
+}
+
+BiosHle::Result BiosHle::Malloc( uint32_t size ) noexcept
+{
+	const Ram& ram = m_memoryMap.GetRam();
+
+	if ( size > m_heapEnd - m_heapStart )
+		return Result{ 0, CallCycles };
+
+	size = std::max( ( size + 3 ) & ~3u, 4u );
+
+	uint32_t blocks = 0;
+	for ( uint32_t offset = m_heapStart; offset + HeapHeaderSize <= m_heapEnd; ++blocks )
+	{
+		const uint32_t header = ram.Read<uint32_t>( offset );
+		uint32_t blockSize = header & ~3u;
+
+		if ( !( header & HeapBlockUsed ) )
+		{
+			// merge with following free blocks
+			for ( uint32_t next = offset + HeapHeaderSize + blockSize; next + HeapHeaderSize <= m_heapEnd; next = offset + HeapHeaderSize + blockSize )
+			{
+				const uint32_t nextHeader = ram.Read<uint32_t>( next );
+				if ( nextHeader & HeapBlockUsed )
+					break;
+
+				blockSize += HeapHeaderSize + ( nextHeader & ~3u );
+			}
+
+			if ( blockSize >= size )
+			{
+				// split off the rest if it can hold a block
+				if ( blockSize - size >= HeapHeaderSize + 4 )
+				{
+					WriteHeapHeader( offset + HeapHeaderSize + size, blockSize - size - HeapHeaderSize );
+					blockSize = size;
+				}
+
+				WriteHeapHeader( offset, blockSize | HeapBlockUsed );
+				return Result{ m_heapBase + offset + HeapHeaderSize, LoopCycles( HeapBlockCycles, blocks ) };
+			}
+
+			if ( blockSize != ( header & ~3u ) )
+				WriteHeapHeader( offset, blockSize );
+		}
+
+		offset += HeapHeaderSize + blockSize;
+	}
+
+	return Result{ 0, LoopCycles( HeapBlockCycles, blocks ) };
+}
+
+void BiosHle::Free( uint32_t address ) noexcept
+{
+	const auto block = GetHeapBlock( address );
+	if ( block.has_value() )
+		WriteHeapHeader( *block, m_memoryMap.GetRam().Read<uint32_t>( *block ) & ~HeapBlockUsed );
+}
+
+BiosHle::Result BiosHle::Calloc( uint32_t count, uint32_t size ) noexcept
+{
+	const uint64_t totalSize = uint64_t( count ) * size;
+	if ( totalSize > m_heapEnd - m_heapStart )
+		return Result{ 0, CallCycles };
+
+	Result result = Malloc( static_cast<uint32_t>( totalSize ) );
+	if ( result.value != 0 && totalSize > 0 )
+	{
+		std::memset( GetWritePointer( result.value, static_cast<uint32_t>( totalSize ) ), 0, static_cast<size_t>( totalSize ) );
+		result.cycles += LoopCycles( MemsetByteCycles, static_cast<uint32_t>( totalSize ) ) - CallCycles;
+	}
+
+	return result;
+}
+
+BiosHle::Result BiosHle::Realloc( uint32_t address, uint32_t size ) noexcept
+{
+	if ( address == 0 )
+		return Malloc( size );
+
+	const auto block = GetHeapBlock( address );
+	if ( !block.has_value() )
+		return Result{ 0, CallCycles };
+
+	if ( size == 0 )
+	{
+		Free( address );
+		return Result{ 0, CallCycles };
+	}
+
+	Result result = Malloc( size );
+	if ( result.value == 0 )
+		return result;
+
+	const uint32_t oldSize = m_memoryMap.GetRam().Read<uint32_t>( *block ) & ~3u;
+	const uint32_t copySize = std::min( oldSize, size );
+	Ram& ram = m_memoryMap.GetRam();
+	std::memmove( GetWritePointer( result.value, copySize ), ram.Data() + *block + HeapHeaderSize, copySize );
+	result.cycles += LoopCycles( MemcpyByteCycles, copySize ) - CallCycles;
+
+	Free( address );
+	return result;
+}
+
+std::optional<uint32_t> BiosHle::GetHeapBlock( uint32_t address ) const noexcept
+{
+	const uint32_t target = address - m_heapBase - HeapHeaderSize;
+	const Ram& ram = m_memoryMap.GetRam();
+
+	// only accept the start of an allocated block
+	for ( uint32_t offset = m_heapStart; offset + HeapHeaderSize <= m_heapEnd; )
+	{
+		const uint32_t header = ram.Read<uint32_t>( offset );
+		if ( offset == target )
+			return ( header & HeapBlockUsed ) ? std::optional<uint32_t>{ offset } : std::nullopt;
+
+		if ( offset > target )
+			break;
+
+		offset += HeapHeaderSize + ( header & ~3u );
+	}
+
+	return std::nullopt;
+}
+
+void BiosHle::WriteHeapHeader( uint32_t offset, uint32_t header ) noexcept
+{
+	dbExpects( offset % 4 == 0 && offset + HeapHeaderSize <= m_heapEnd );
+	m_codeCache.InvalidateRam( offset, HeapHeaderSize );
+	m_memoryMap.GetRam().Write<uint32_t>( offset, header );
+}
+
+std::optional<uint32_t> BiosHle::TestEvent( uint32_t event, bool wait ) noexcept
+{
+	if ( ( event & EventHandleMask ) != EventHandleBase )
+		return std::nullopt;
+
+	const Ram& ram = m_memoryMap.GetRam();
+	const uint32_t entry = ( event & ~EventHandleMask ) * EventControlBlockSize;
+	if ( entry + EventControlBlockSize > ram.Read<uint32_t>( EventTableSize ) )
+		return std::nullopt;
+
+	const uint32_t statusAddress = ram.Read<uint32_t>( EventTablePointer ) + entry + EventStatusOffset;
+	const uint8_t* status = GetReadPointer( statusAddress, 4 );
+	if ( !status )
+		return std::nullopt;
+
+	if ( Read32( status ) == EventStatusReady )
+	{
+		uint8_t* newStatus = GetWritePointer( statusAddress, 4 );
+		if ( !newStatus )
+			return std::nullopt;
+
+		const uint32_t busy = EventStatusBusy;
+		std::memcpy( newStatus, &busy, sizeof( busy ) );
+		return 1;
+	}
+
+	// waiting loops in the BIOS until an interrupt makes the event ready
+	if ( wait )
+		return std::nullopt;
+
+	return 0;
+}
+
+const char* BiosHle::GetFunctionName( Function function ) noexcept
+{
+	dbExpects( function < Function::Count );
+	return FunctionNames[ static_cast<size_t>( function ) ];
+}
+
+void BiosHle::LogCallCounts() const
+{
+	Log( "BIOS HLE calls:" );
+	for ( size_t i = 0; i < FunctionCount; ++i )
+		Log( "  %s: %u%s", FunctionNames[ i ], m_callCounts[ i ], m_enabled[ i ] ? "" : " (disabled)" );
+}
+
+void BiosHle::Serialize( SaveStateSerializer& serializer )
+{
+	if ( !serializer.Header( "BiosHle", 1 ) )
+		return;
+
+	serializer( m_randomSeed );
+	serializer( m_heapBase );
+	serializer( m_heapStart );
+	serializer( m_heapEnd );
+}
+
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "CPU.h"
 
 #include "BIOS.h"
+#include "CodeCache.h"
 #include "EventManager.h"
 #include "File.h"
 #include "MemoryMap.h"
@@ -9,11 +10,104 @@
 #include <stdx/assert.h>
 
 #include <fstream>
+#include <optional>
 #include <type_traits>
+#include <utility>
 
 namespace PSX
 {
 
+namespace
+{
+
+// longer loops are unlikely to be waiting on anything
+constexpr uint32_t MaxIdleLoopInstructions = 16;
+
+constexpr uint32_t RegisterBit( uint32_t index ) noexcept
+{
+	return ( index != 0 ) ? ( 1u << index ) : 0;
+}
+
+// register masks of an instruction that can appear in an idle loop
+struct IdleLoopOperands
+{
+	uint32_t reads = 0;
+	uint32_t writes = 0;
+	bool load = false;
+};
+
+// null if the instruction has side effects other than loading into a register. Branches are handled separately
+std::optional<IdleLoopOperands> GetIdleLoopOperands( Instruction instr ) noexcept
+{
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::Special:
+		{
+			switch ( static_cast<SpecialOpcode>( instr.funct() ) )
+			{
+				case SpecialOpcode::ShiftLeftLogical:
+				case SpecialOpcode::ShiftRightLogical:
+				case SpecialOpcode::ShiftRightArithmetic:
+					return IdleLoopOperands{ RegisterBit( instr.rt() ), RegisterBit( instr.rd() ) };
+
+				case SpecialOpcode::ShiftLeftLogicalVariable:
+				case SpecialOpcode::ShiftRightLogicalVariable:
+				case SpecialOpcode::ShiftRightArithmeticVariable:
+				case SpecialOpcode::AddUnsigned:
+				case SpecialOpcode::SubtractUnsigned:
+				case SpecialOpcode::BitwiseAnd:
+				case SpecialOpcode::BitwiseOr:
+				case SpecialOpcode::BitwiseXor:
+				case SpecialOpcode::BitwiseNor:
+				case SpecialOpcode::SetLessThan:
+				case SpecialOpcode::SetLessThanUnsigned:
+					return IdleLoopOperands{ RegisterBit( instr.rs() ) | RegisterBit( instr.rt() ), RegisterBit( instr.rd() ) };
+
+				default:
+					return std::nullopt;
+			}
+		}
+
+		case Opcode::AddImmediateUnsigned:
+		case Opcode::SetLessThanImmediate:
+		case Opcode::SetLessThanImmediateUnsigned:
+		case Opcode::BitwiseAndImmediate:
+		case Opcode::BitwiseOrImmediate:
+		case Opcode::BitwiseXorImmediate:
+			return IdleLoopOperands{ RegisterBit( instr.rs() ), RegisterBit( instr.rt() ) };
+
+		case Opcode::LoadUpperImmediate:
+			return IdleLoopOperands{ 0, RegisterBit( instr.rt() ) };
+
+		case Opcode::LoadByte:
+		case Opcode::LoadByteUnsigned:
+		case Opcode::LoadHalfword:
+		case Opcode::LoadHalfwordUnsigned:
+		case Opcode::LoadWord:
+			return IdleLoopOperands{ RegisterBit( instr.base() ), RegisterBit( instr.rt() ), true };
+
+		default:
+			return std::nullopt;
+	}
+}
+
+// memory that only changes when an event runs or the CPU writes to it
+bool IsIdleLoopAddress( uint32_t address ) noexcept
+{
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( physicalAddress < MemoryMap::RamMirrorSize )
+		return true;
+
+	// the scratchpad isn't accessible from KSEG1
+	if ( physicalAddress - MemoryMap::ScratchpadStart < MemoryMap::ScratchpadSize )
+		return ( address & 0xe0000000 ) != 0xa0000000;
+
+	// interrupts are only raised by events
+	return physicalAddress - MemoryMap::InterruptControlStart < MemoryMap::InterruptControlSize;
+}
+
+}
+
 void MipsR3000Cpu::Reset()
 {
 	m_currentPC = 0;
@@ -29,69 +123,854 @@ void MipsR3000Cpu::Reset()
 
 	m_cop0.Reset();
 	m_gte.Reset();
+
+	m_idleLoopStats = {};
+	m_lastFrameIdleLoopStats = {};
+
+	m_biosHle.Reset();
+	m_libraryHle.Reset();
+	m_profiler.Reset();
+
+	m_recompiler.Flush();
 }
 
 void MipsR3000Cpu::RunUntilEvent() noexcept
 {
+	// flags can change between runs. Checking them here keeps them out of the run loops
+	const uint32_t features = GetRunFeatures();
+	if ( features != m_runFeatures )
+	{
+		m_runFeatures = features;
+		m_runFunction = GetRunFunction( features );
+	}
+
+	( this->*m_runFunction )();
+
+	m_eventManager.UpdateNextEvent();
+}
+
+uint32_t MipsR3000Cpu::GetRunFeatures() const noexcept
+{
+	uint32_t features = 0;
+
+	// cached and recompiled blocks don't log instructions
+	if ( EnableCpuLogging )
+		features |= RunFeature::CpuLogging;
+	else if ( EnableRecompiler && Recompiler::IsSupported )
+		features |= RunFeature::Recompiler;
+	else if ( EnableCachedInterpreter || EnableRecompiler )
+		features |= RunFeature::CachedInterpreter;
+
+#ifdef PSX_HOOK_BIOS
+	if ( EnableBiosIntercept )
+		features |= RunFeature::BiosIntercept;
+#endif
+
+	if ( !m_bootExecutable.empty() )
+		features |= RunFeature::BootExecutable;
+
+	if ( m_profiler.IsRunning() )
+		features |= RunFeature::Profiler;
+
+	return features;
+}
+
+template <uint32_t Features>
+constexpr MipsR3000Cpu::RunFunction MipsR3000Cpu::SelectRunFunction() noexcept
+{
+	// mode bits are exclusive. Clear the redundant ones so equivalent masks share an instantiation
+	if constexpr ( Features & RunFeature::CpuLogging )
+		return &MipsR3000Cpu::RunInterpreter<Features & ~( RunFeature::CachedInterpreter | RunFeature::Recompiler )>;
+	else if constexpr ( Features & RunFeature::Recompiler )
+		return &MipsR3000Cpu::RunRecompiler<Features & ~RunFeature::CachedInterpreter>;
+	else if constexpr ( Features & RunFeature::CachedInterpreter )
+		return &MipsR3000Cpu::RunCachedInterpreter<Features>;
+	else
+		return &MipsR3000Cpu::RunInterpreter<Features>;
+}
+
+template <size_t... Features>
+constexpr std::array<MipsR3000Cpu::RunFunction, sizeof...( Features )> MipsR3000Cpu::MakeRunFunctionTable( std::index_sequence<Features...> ) noexcept
+{
+	return { SelectRunFunction<static_cast<uint32_t>( Features )>()... };
+}
+
+MipsR3000Cpu::RunFunction MipsR3000Cpu::GetRunFunction( uint32_t features ) noexcept
+{
+	static constexpr auto RunFunctions = MakeRunFunctionTable( std::make_index_sequence<RunFeature::All + 1>{} );
+
+	dbExpects( features <= RunFeature::All );
+	return RunFunctions[ features ];
+}
+
+void MipsR3000Cpu::StartProfiler( cycles_t sampleInterval )
+{
+	m_profiler.Start( sampleInterval );
+	m_recompiler.Flush();
+}
+
+void MipsR3000Cpu::StopProfiler()
+{
+	m_profiler.Stop();
+	m_recompiler.Flush();
+}
+
+void MipsR3000Cpu::InvalidateCodeCache() noexcept
+{
+	m_codeCache.InvalidateAllRam();
+}
+
+void MipsR3000Cpu::LoadBootExecutable() noexcept
+{
+	const auto exe = std::move( m_bootExecutable );
+	m_bootExecutable.clear();
+
+	if ( !LoadExecutable( exe.data(), exe.size(), *this, m_memoryMap.GetRam() ) )
+		dbLogError( "MipsR3000Cpu::LoadBootExecutable -- invalid executable. Continuing with BIOS shell" );
+}
+
+void MipsR3000Cpu::EndFrame() noexcept
+{
+	dbLogDebug( "MipsR3000Cpu::EndFrame -- idle loops detected: %u, skipped: %u, cycles skipped: %i", m_idleLoopStats.loopsDetected, m_idleLoopStats.loopsSkipped, m_idleLoopStats.cyclesSkipped );
+	m_lastFrameIdleLoopStats = m_idleLoopStats;
+	m_idleLoopStats = {};
+
+	m_gte.EndFrame();
+}
+
+template <uint32_t Features>
+void MipsR3000Cpu::CheckInterrupts() noexcept
+{
+	m_eventManager.StartRun();
+
+	while ( STDX_unlikely( m_cop0.ShouldTriggerInterrupt() ) )
+	{
+		// the exception handler may or may not modify the return address if the next instruction is a GTE command
+		// this usually results in polygon flickering
+		// to prevent this, delay the interrupt until after the GTE command
+		const auto instruction = m_memoryMap.FetchInstruction( m_pc );
+		if ( instruction.has_value() && ( instruction->value & 0xfe000000 ) != 0x4a000000 )
+		{
+			m_inDelaySlot = m_inBranch;
+			m_inBranch = false;
+
+			// update current PC now so we can save the proper return address
+			m_currentPC = m_pc;
+			RaiseException( Cop0::ExceptionCode::Interrupt );
+			return;
+		}
+
+		StepInstruction<Features>();
+
+		// checked again before the next run
+		if ( m_eventManager.ReadyForNextEvent() )
+			return;
+	}
+}
+
+template <uint32_t Features>
+void MipsR3000Cpu::RunInterpreter() noexcept
+{
+	CheckInterrupts<Features>();
+
+	while ( !m_eventManager.ReadyForNextEvent() )
+		StepInstruction<Features>();
+}
+
+template <uint32_t Features>
+inline void MipsR3000Cpu::StepInstruction() noexcept
+{
+	if constexpr ( Features & RunFeature::BootExecutable )
+	{
+		if ( m_pc == HookAddress && !m_bootExecutable.empty() )
+			LoadBootExecutable();
+	}
+
+	// the MIPS cpu is pipelined. The next instruction is fetched while the current one executes
+	// this causes instructions after branches and jumps to always be executed
+
+	m_inDelaySlot = m_inBranch;
+	m_inBranch = false;
+
+	if ( STDX_unlikely( IsKernelCallVector( m_pc ) ) )
+	{
+		if ( OnKernelCall<Features>() )
+			return;
+	}
+
+	m_currentPC = m_pc;
+	m_pc = m_nextPC;
+	m_nextPC += 4;
+
+	// CPU is pipelined so that each instruction takes 1 cycle
+	m_eventManager.AddCycles( 1 );
+	
+#ifdef PSX_HOOK_BIOS
+	if constexpr ( Features & RunFeature::BiosIntercept )
+		InterceptBios( m_currentPC );
+#endif
+
+	const auto instruction = m_memoryMap.FetchInstruction( m_currentPC );
+	if ( instruction.has_value() )
+	{
+		ExecuteInstruction<Features>( *instruction );
+
+		m_registers.Update();
+	}
+	else
+	{
+		RaiseException( Cop0::ExceptionCode::AddressErrorLoad );
+	}
+}
+
+template <uint32_t Features>
+void MipsR3000Cpu::RunCachedInterpreter() noexcept
+{
+	// blocks invalidated during the last run are no longer executing
+	m_codeCache.ReleaseInvalidatedBlocks();
+
+	// idle loop that branched back to itself in the last iteration. Events may have changed memory since the last run
+	const CodeBlock* spinningBlock = nullptr;
+
+	CheckInterrupts<Features>();
+
 	while ( !m_eventManager.ReadyForNextEvent() )
 	{
+		// blocks always end after a delay slot. We can only be in a branch if we switched from the interpreter
+		if ( STDX_unlikely( m_inBranch ) )
+		{
+			StepInstruction<Features>();
+			continue;
+		}
 
-#ifdef PSX_HOOK_EXE
-		if ( !m_exeFilename.empty() && m_pc == HookAddress )
+		if constexpr ( Features & RunFeature::BootExecutable )
 		{
-			LoadExecutable( m_exeFilename, *this, m_memoryMap.GetRam() );
-			m_exeFilename.clear();
+			if ( m_pc == HookAddress && !m_bootExecutable.empty() )
+			{
+				LoadBootExecutable();
+				continue;
+			}
 		}
+
+		const CodeBlock* lastSpinningBlock = std::exchange( spinningBlock, nullptr );
+
+		const uint32_t key = CodeCache::GetBlockKey( m_pc );
+		CodeBlock* block = m_codeCache.FindBlock( key );
+		if ( !block )
+		{
+			block = CompileBlock( m_pc );
+			if ( !block )
+			{
+				// let the interpreter raise the fetch exception
+				StepInstruction<Features>();
+				continue;
+			}
+		}
+
+#ifdef PSX_HOOK_BIOS
+		if constexpr ( Features & RunFeature::BiosIntercept )
+			InterceptBios( m_pc );
 #endif
 
-		// the MIPS cpu is pipelined. The next instruction is fetched while the current one executes
-		// this causes instructions after branches and jumps to always be executed
+		if ( STDX_unlikely( IsKernelCallVector( m_pc ) ) )
+		{
+			if ( OnKernelCall<Features>() )
+				continue;
+		}
 
-		m_inDelaySlot = m_inBranch;
-		m_inBranch = false;
+		if ( STDX_unlikely( block->libraryFunction.has_value() ) )
+		{
+			if ( OnLibraryCall<Features>( *block->libraryFunction ) )
+				continue;
+		}
+
+		if ( lastSpinningBlock == block && TrySkipIdleLoop( *block ) )
+			continue;
+
+		const uint32_t pc = m_pc;
+
+		// charge the whole block up front
+		m_eventManager.AddCycles( static_cast<cycles_t>( block->GetInstructionCount() ) );
+
+		ExecuteBlock( *block );
+
+		if ( block->idleLoop && m_pc == pc && EnableIdleLoopSkip )
+			spinningBlock = block;
+	}
+}
+
+template <uint32_t Features>
+void MipsR3000Cpu::RunRecompiler() noexcept
+{
+	// blocks invalidated during the last run are no longer executing
+	m_codeCache.ReleaseInvalidatedBlocks();
 
-		if ( STDX_unlikely( m_cop0.ShouldTriggerInterrupt() ) )
+	// exit of the last block that can jump directly into the next one
+	CodeBlockLink* lastExit = nullptr;
+
+	// idle loop that branched back to itself in the last iteration
+	const CodeBlock* spinningBlock = nullptr;
+
+	CheckInterrupts<Features>();
+
+	while ( !m_eventManager.ReadyForNextEvent() )
+	{
+		if ( STDX_unlikely( m_inBranch ) )
+		{
+			StepInstruction<Features>();
+			lastExit = nullptr;
+			continue;
+		}
+
+		if constexpr ( Features & RunFeature::BootExecutable )
+		{
+			if ( m_pc == HookAddress && !m_bootExecutable.empty() )
+			{
+				LoadBootExecutable();
+				lastExit = nullptr;
+				continue;
+			}
+		}
+
+		const CodeBlock* lastSpinningBlock = std::exchange( spinningBlock, nullptr );
+
+		const uint32_t key = CodeCache::GetBlockKey( m_pc );
+		CodeBlock* block = m_codeCache.FindBlock( key );
+		if ( !block )
+		{
+			block = CompileBlock( m_pc );
+			if ( !block )
+			{
+				StepInstruction<Features>();
+				lastExit = nullptr;
+				continue;
+			}
+		}
+
+		if ( !block->hostCode && !m_recompiler.Compile( *block, m_pc ) )
+		{
+			// out of space for native code. Start over
+			m_recompiler.Flush();
+			lastExit = nullptr;
+			continue;
+		}
+
+#ifdef PSX_HOOK_BIOS
+		if constexpr ( Features & RunFeature::BiosIntercept )
+			InterceptBios( m_pc );
+#endif
+
+		if ( STDX_unlikely( IsKernelCallVector( m_pc ) ) )
 		{
-			// the exception handler may or may not modify the return address if the next instruction is a GTE command
-			// this usually results in polygon flickering
-			// to prevent this, delay the interrupt until after the GTE command
-			const auto instruction = m_memoryMap.FetchInstruction( m_pc );
-			if ( instruction.has_value() && ( instruction->value & 0xfe000000 ) != 0x4a000000 )
+			if ( OnKernelCall<Features>() )
 			{
-				// update current PC now so we can save the proper return address
-				m_currentPC = m_pc;
-				RaiseException( Cop0::ExceptionCode::Interrupt );
+				lastExit = nullptr;
+				continue;
 			}
 		}
 
+		if ( STDX_unlikely( block->libraryFunction.has_value() ) )
+		{
+			if ( OnLibraryCall<Features>( *block->libraryFunction ) )
+			{
+				lastExit = nullptr;
+				continue;
+			}
+		}
+
+		if ( lastSpinningBlock == block && TrySkipIdleLoop( *block ) )
+		{
+			lastExit = nullptr;
+			continue;
+		}
+
+		const bool idleLoop = block->idleLoop && EnableIdleLoopSkip;
+
+		if ( STDX_unlikely( block->hostPC != m_pc ) )
+		{
+			// native code uses the PCs of the segment it was compiled for. Interpret other mirrors
+			const uint32_t pc = m_pc;
+			m_eventManager.AddCycles( static_cast<cycles_t>( block->GetInstructionCount() ) );
+			ExecuteBlock( *block );
+			lastExit = nullptr;
+
+			if ( idleLoop && m_pc == pc )
+				spinningBlock = block;
+
+			continue;
+		}
+
+		// BIOS and library calls and the exe hook must go through the dispatcher. So must idle loops, or they would spin in native code
+		const bool canLink = !IsKernelCallVector( key ) && key != CodeCache::GetBlockKey( HookAddress ) && !block->libraryFunction.has_value() && !idleLoop;
+		if ( lastExit && lastExit->source && !lastExit->target && lastExit->targetPC == m_pc && canLink )
+			m_recompiler.Link( *lastExit, *block );
+
+		lastExit = m_recompiler.Execute( *block );
+
+		// linked blocks may have run after this one. Only the loop's own exit back to its start means it is spinning
+		if ( lastExit && lastExit->source && lastExit->source->idleLoop && lastExit->source->hostPC == m_pc && lastExit->targetPC == m_pc && EnableIdleLoopSkip )
+			spinningBlock = lastExit->source;
+	}
+}
+
+CodeBlock* MipsR3000Cpu::CompileBlock( uint32_t pc )
+{
+	auto block = std::make_unique<CodeBlock>();
+	block->key = CodeCache::GetBlockKey( pc );
+
+	bool inDelaySlot = false;
+	for ( uint32_t address = pc;; address += 4 )
+	{
+		const auto instruction = m_memoryMap.FetchInstruction( address );
+		if ( !instruction.has_value() )
+			break; // the interpreter will raise the exception when we get there
+
+		const auto handler = m_profiler.IsRunning() ? DecodeProfiledHandler( *instruction ) : DecodeCachedHandler( *instruction );
+		block->instructions.push_back( { handler, *instruction } );
+
+		if ( inDelaySlot )
+			break;
+
+		const BlockEnd blockEnd = GetBlockEnd( *instruction );
+		if ( blockEnd == BlockEnd::AfterInstruction )
+			break;
+
+		if ( blockEnd == BlockEnd::AfterDelaySlot )
+		{
+			inDelaySlot = true;
+			continue;
+		}
+
+		if ( block->GetInstructionCount() >= CodeCache::MaxBlockInstructions )
+			break;
+
+		// BIOS call vectors and the exe hook must start a block so they can be intercepted
+		const uint32_t nextKey = CodeCache::GetBlockKey( address + 4 );
+		if ( IsKernelCallVector( nextKey ) || nextKey == CodeCache::GetBlockKey( HookAddress ) )
+			break;
+	}
+
+	if ( block->instructions.empty() )
+		return nullptr;
+
+	block->idleLoop = IsIdleLoop( *block );
+	if ( block->idleLoop )
+		++m_idleLoopStats.loopsDetected;
+
+	block->libraryFunction = m_libraryHle.FindFunction( pc );
+
+	return m_codeCache.InsertBlock( std::move( block ) );
+}
+
+inline void MipsR3000Cpu::ExecuteBlock( const CodeBlock& block ) noexcept
+{
+	for ( const auto& cached : block.instructions )
+	{
+		m_inDelaySlot = m_inBranch;
+		m_inBranch = false;
+
 		m_currentPC = m_pc;
 		m_pc = m_nextPC;
 		m_nextPC += 4;
 
-		// CPU is pipelined so that each instruction takes 1 cycle
-		m_eventManager.AddCycles( 1 );
-		
-#ifdef PSX_HOOK_BIOS
-		if ( EnableBiosIntercept )
-			InterceptBios( m_currentPC );
-#endif
+		cached.handler( *this, cached.instruction );
+
+		m_registers.Update();
 
-		const auto instruction = m_memoryMap.FetchInstruction( m_currentPC );
-		if ( instruction.has_value() )
+		// an exception moved the PC. The rest of the block must not execute
+		if ( STDX_unlikely( m_pc != m_currentPC + 4 ) )
+			break;
+	}
+}
+
+void MipsR3000Cpu::ExecuteReferenceInstruction( Instruction instr ) noexcept
+{
+	m_inDelaySlot = m_inBranch;
+	m_inBranch = false;
+
+	m_currentPC = m_pc;
+	m_pc = m_nextPC;
+	m_nextPC += 4;
+
+	ExecuteInstruction<0>( instr );
+
+	m_registers.Update();
+}
+
+MipsR3000Cpu::BlockEnd MipsR3000Cpu::GetBlockEnd( Instruction instr ) noexcept
+{
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::Special:
 		{
-			ExecuteInstruction( *instruction );
+			switch ( static_cast<SpecialOpcode>( instr.funct() ) )
+			{
+				case SpecialOpcode::JumpRegister:
+				case SpecialOpcode::JumpAndLinkRegister:
+					return BlockEnd::AfterDelaySlot;
+
+				case SpecialOpcode::SystemCall:
+				case SpecialOpcode::Break:
+					return BlockEnd::AfterInstruction;
 
-			m_registers.Update();
+				default:
+					return BlockEnd::None;
+			}
 		}
+
+		case Opcode::RegisterImmediate:
+		case Opcode::BranchEqual:
+		case Opcode::BranchNotEqual:
+		case Opcode::BranchLessEqualZero:
+		case Opcode::BranchGreaterThanZero:
+		case Opcode::Jump:
+		case Opcode::JumpAndLink:
+			return BlockEnd::AfterDelaySlot;
+
+		// writes to SR and RFE can unmask pending interrupts
+		case Opcode::CoprocessorUnit0:
+			return BlockEnd::AfterInstruction;
+
+		default:
+			return BlockEnd::None;
+	}
+}
+
+bool MipsR3000Cpu::IsIdleLoop( const CodeBlock& block ) noexcept
+{
+	const uint32_t count = block.GetInstructionCount();
+	if ( count < 2 || count > MaxIdleLoopInstructions )
+		return false;
+
+	// the branch must target the first instruction of the block
+	const Instruction branch = block.instructions[ count - 2 ].instruction;
+	if ( branch.immediateSigned() != -static_cast<int32_t>( count - 1 ) )
+		return false;
+
+	uint32_t branchReads = 0;
+	switch ( static_cast<Opcode>( branch.op() ) )
+	{
+		case Opcode::BranchEqual:
+		case Opcode::BranchNotEqual:
+			branchReads = RegisterBit( branch.rs() ) | RegisterBit( branch.rt() );
+			break;
+
+		case Opcode::BranchLessEqualZero:
+		case Opcode::BranchGreaterThanZero:
+			branchReads = RegisterBit( branch.rs() );
+			break;
+
+		case Opcode::RegisterImmediate:
+		{
+			// linking writes the return address every iteration
+			const auto regImm = static_cast<RegImmOpcode>( branch.rt() );
+			if ( regImm != RegImmOpcode::BranchLessThanZero && regImm != RegImmOpcode::BranchGreaterEqualZero )
+				return false;
+
+			branchReads = RegisterBit( branch.rs() );
+			break;
+		}
+
+		default:
+			return false;
+	}
+
+	std::array<IdleLoopOperands, MaxIdleLoopInstructions> operands;
+	uint32_t written = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		if ( i == count - 2 )
+		{
+			operands[ i ] = IdleLoopOperands{ branchReads, 0 };
+			continue;
+		}
+
+		const auto instrOperands = GetIdleLoopOperands( block.instructions[ i ].instruction );
+		if ( !instrOperands.has_value() )
+			return false;
+
+		// a load in the delay slot would land in the next iteration
+		if ( instrOperands->load && i == count - 1 )
+			return false;
+
+		operands[ i ] = *instrOperands;
+		written |= instrOperands->writes;
+	}
+
+	// values must not be carried between iterations. Loaded registers aren't available until after the next instruction
+	uint32_t defined = 0;
+	uint32_t pendingLoad = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		if ( operands[ i ].reads & written & ~defined )
+			return false;
+
+		defined |= pendingLoad;
+		pendingLoad = 0;
+
+		if ( operands[ i ].load )
+			pendingLoad = operands[ i ].writes;
 		else
+			defined |= operands[ i ].writes;
+	}
+
+	return true;
+}
+
+bool MipsR3000Cpu::TrySkipIdleLoop( const CodeBlock& block ) noexcept
+{
+	dbExpects( block.idleLoop );
+
+	if ( !EnableIdleLoopSkip || m_registers.GetLoadDelayIndex() != 0 )
+		return false;
+
+	// evaluate load addresses. Loaded values are unknown, so they can't be used as a base
+	std::array<uint32_t, 32> values;
+	for ( uint32_t i = 0; i < 32; ++i )
+		values[ i ] = m_registers[ i ];
+
+	uint32_t known = 0xffffffff;
+	const uint32_t branchIndex = block.GetInstructionCount() - 2;
+	for ( uint32_t i = 0; i < block.GetInstructionCount(); ++i )
+	{
+		if ( i == branchIndex )
+			continue;
+
+		const Instruction instr = block.instructions[ i ].instruction;
+		const auto operands = GetIdleLoopOperands( instr );
+		dbAssert( operands.has_value() );
+
+		if ( operands->load )
+		{
+			if ( !( known & RegisterBit( instr.base() ) ) && instr.base() != 0 )
+				return false;
+
+			if ( !IsIdleLoopAddress( values[ instr.base() ] + instr.immediateSignExtended() ) )
+				return false;
+
+			known &= ~operands->writes;
+			continue;
+		}
+
+		const bool sourceKnown = ( known & operands->reads ) == operands->reads;
+		switch ( static_cast<Opcode>( instr.op() ) )
 		{
-			RaiseException( Cop0::ExceptionCode::AddressErrorLoad );
+			case Opcode::LoadUpperImmediate:
+				values[ instr.rt() ] = instr.immediateUnsigned() << 16;
+				known |= operands->writes;
+				break;
+
+			case Opcode::BitwiseOrImmediate:
+				values[ instr.rt() ] = values[ instr.rs() ] | instr.immediateUnsigned();
+				known = sourceKnown ? ( known | operands->writes ) : ( known & ~operands->writes );
+				break;
+
+			case Opcode::AddImmediateUnsigned:
+				values[ instr.rt() ] = values[ instr.rs() ] + instr.immediateSignExtended();
+				known = sourceKnown ? ( known | operands->writes ) : ( known & ~operands->writes );
+				break;
+
+			default:
+				known &= ~operands->writes;
+				break;
 		}
+		values[ 0 ] = 0;
 	}
 
-	m_eventManager.UpdateNextEvent();
+	const cycles_t cycles = m_eventManager.SkipToNextEvent();
+	++m_idleLoopStats.loopsSkipped;
+	m_idleLoopStats.cyclesSkipped += cycles;
+	return true;
+}
+
+constexpr MipsR3000Cpu::HandlerTable MipsR3000Cpu::MakeHandlerTable() noexcept
+{
+	HandlerTable handlers{};
+	for ( auto& handler : handlers )
+		handler = &CachedHandler<&MipsR3000Cpu::IllegalInstruction>;
+
+#define OP_ENTRY( opcode ) handlers[ static_cast<size_t>( Opcode::opcode ) ] = &CachedHandler<&MipsR3000Cpu::opcode>;
+
+	OP_ENTRY( AddImmediate )
+	OP_ENTRY( AddImmediateUnsigned )
+	OP_ENTRY( BitwiseAndImmediate )
+	OP_ENTRY( BranchEqual )
+	OP_ENTRY( BranchGreaterThanZero )
+	OP_ENTRY( BranchLessEqualZero )
+	OP_ENTRY( BranchNotEqual )
+	OP_ENTRY( Jump )
+	OP_ENTRY( JumpAndLink )
+	OP_ENTRY( LoadByte )
+	OP_ENTRY( LoadByteUnsigned )
+	OP_ENTRY( LoadHalfword )
+	OP_ENTRY( LoadHalfwordUnsigned )
+	OP_ENTRY( LoadUpperImmediate )
+	OP_ENTRY( LoadWord )
+	OP_ENTRY( LoadWordLeft )
+	OP_ENTRY( LoadWordRight )
+	OP_ENTRY( BitwiseOrImmediate )
+	OP_ENTRY( StoreByte )
+	OP_ENTRY( StoreHalfword )
+	OP_ENTRY( SetLessThanImmediate )
+	OP_ENTRY( SetLessThanImmediateUnsigned )
+	OP_ENTRY( StoreWord )
+	OP_ENTRY( StoreWordLeft )
+	OP_ENTRY( StoreWordRight )
+	OP_ENTRY( BitwiseXorImmediate )
+
+#undef OP_ENTRY
+
+	for ( uint32_t z = 0; z < 4; ++z )
+	{
+		handlers[ static_cast<size_t>( Opcode::CoprocessorUnit0 ) + z ] = &CachedHandler<&MipsR3000Cpu::CoprocessorUnit>;
+		handlers[ static_cast<size_t>( Opcode::LoadWordToCoprocessor0 ) + z ] = &CachedHandler<&MipsR3000Cpu::LoadWordToCoprocessor>;
+		handlers[ static_cast<size_t>( Opcode::StoreWordFromCoprocessor0 ) + z ] = &CachedHandler<&MipsR3000Cpu::StoreWordFromCoprocessor>;
+	}
+
+#define SPECIAL_ENTRY( opcode ) handlers[ SpecialHandlerOffset + static_cast<size_t>( SpecialOpcode::opcode ) ] = &CachedHandler<&MipsR3000Cpu::opcode>;
+
+	SPECIAL_ENTRY( Add )
+	SPECIAL_ENTRY( AddUnsigned )
+	SPECIAL_ENTRY( BitwiseAnd )
+	SPECIAL_ENTRY( Break )
+	SPECIAL_ENTRY( Divide )
+	SPECIAL_ENTRY( DivideUnsigned )
+	SPECIAL_ENTRY( JumpAndLinkRegister )
+	SPECIAL_ENTRY( JumpRegister )
+	SPECIAL_ENTRY( MoveFromHi )
+	SPECIAL_ENTRY( MoveFromLo )
+	SPECIAL_ENTRY( MoveToHi )
+	SPECIAL_ENTRY( MoveToLo )
+	SPECIAL_ENTRY( Multiply )
+	SPECIAL_ENTRY( MultiplyUnsigned )
+	SPECIAL_ENTRY( BitwiseNor )
+	SPECIAL_ENTRY( BitwiseOr )
+	SPECIAL_ENTRY( ShiftLeftLogical )
+	SPECIAL_ENTRY( ShiftLeftLogicalVariable )
+	SPECIAL_ENTRY( SetLessThan )
+	SPECIAL_ENTRY( SetLessThanUnsigned )
+	SPECIAL_ENTRY( ShiftRightArithmetic )
+	SPECIAL_ENTRY( ShiftRightArithmeticVariable )
+	SPECIAL_ENTRY( ShiftRightLogical )
+	SPECIAL_ENTRY( ShiftRightLogicalVariable )
+	SPECIAL_ENTRY( Subtract )
+	SPECIAL_ENTRY( SubtractUnsigned )
+	SPECIAL_ENTRY( SystemCall )
+	SPECIAL_ENTRY( BitwiseXor )
+
+#undef SPECIAL_ENTRY
+
+	// the R3000 only decodes the link bits 0x1e and the condition bit 0x01 of rt
+	for ( uint32_t rt = 0; rt < 32; ++rt )
+	{
+		const bool link = ( rt & 0x1e ) == 0x10;
+		const bool greaterEqual = rt & 1;
+
+		auto& handler = handlers[ RegImmHandlerOffset + rt ];
+		if ( link )
+			handler = greaterEqual ? &CachedHandler<&MipsR3000Cpu::BranchGreaterEqualZeroAndLink> : &CachedHandler<&MipsR3000Cpu::BranchLessThanZeroAndLink>;
+		else
+			handler = greaterEqual ? &CachedHandler<&MipsR3000Cpu::BranchGreaterEqualZero> : &CachedHandler<&MipsR3000Cpu::BranchLessThanZero>;
+	}
+
+	return handlers;
+}
+
+inline size_t MipsR3000Cpu::GetHandlerIndex( Instruction instr ) noexcept
+{
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::Special:			return SpecialHandlerOffset + instr.funct();
+		case Opcode::RegisterImmediate:	return RegImmHandlerOffset + instr.rt();
+		default:						return instr.op();
+	}
+}
+
+CachedInstructionHandler MipsR3000Cpu::DecodeCachedHandler( Instruction instr ) noexcept
+{
+	static constexpr HandlerTable Handlers = MakeHandlerTable();
+	return Handlers[ GetHandlerIndex( instr ) ];
+}
+
+CachedInstructionHandler MipsR3000Cpu::DecodeProfiledHandler( Instruction instr ) noexcept
+{
+	switch ( GetHandlerIndex( instr ) )
+	{
+		case static_cast<size_t>( Opcode::JumpAndLink ):
+			return &CachedHandler<&MipsR3000Cpu::ProfiledJumpAndLink>;
+
+		case SpecialHandlerOffset + static_cast<size_t>( SpecialOpcode::JumpAndLinkRegister ):
+			return &CachedHandler<&MipsR3000Cpu::ProfiledJumpAndLinkRegister>;
+
+		case SpecialHandlerOffset + static_cast<size_t>( SpecialOpcode::JumpRegister ):
+			return &CachedHandler<&MipsR3000Cpu::ProfiledJumpRegister>;
+
+		default:
+			return DecodeCachedHandler( instr );
+	}
+}
+
+template <uint32_t Features>
+bool MipsR3000Cpu::OnKernelCall() noexcept
+{
+	if constexpr ( Features & RunFeature::Profiler )
+		m_profiler.OnKernelCall( m_pc, m_registers[ Registers::Temp1 ] );
+
+	if ( !TryBiosHle() )
+		return false;
+
+	// native calls return without a JR
+	if constexpr ( Features & RunFeature::Profiler )
+		m_profiler.OnJump( m_pc );
+
+	return true;
 }
 
+template <uint32_t Features>
+bool MipsR3000Cpu::OnLibraryCall( uint32_t signatureIndex ) noexcept
+{
+	if ( !EnableLibraryHle || !CanCallNatively() )
+		return false;
+
+	const auto result = m_libraryHle.Call( signatureIndex, m_pc, GetCallArguments() );
+	if ( !result.has_value() )
+		return false;
+
+	ReturnFromNativeCall( *result );
+
+	// native calls return without a JR
+	if constexpr ( Features & RunFeature::Profiler )
+		m_profiler.OnJump( m_pc );
+
+	return true;
+}
+
+bool MipsR3000Cpu::TryBiosHle() noexcept
+{
+	dbExpects( IsKernelCallVector( m_pc ) );
+
+	if ( !EnableBiosHle || EnableKernelLogging || !CanCallNatively() )
+		return false;
+
+	const auto result = m_biosHle.Call( m_pc & 0x1fffffff, m_registers[ Registers::Temp1 ], GetCallArguments() );
+	if ( !result.has_value() )
+		return false;
+
+	ReturnFromNativeCall( *result );
+	return true;
+}
+
+bool MipsR3000Cpu::CanCallNatively() const noexcept
+{
+	return m_registers.GetLoadDelayIndex() == 0 && !m_cop0.GetIsolateCache() && m_registers[ Registers::ReturnAddress ] % 4 == 0;
+}
+
+void MipsR3000Cpu::ReturnFromNativeCall( const BiosHle::Result& result ) noexcept
+{
+	m_registers.Set( Registers::Retval0, result.value );
+	SetProgramCounter( m_registers[ Registers::ReturnAddress ] );
+	m_eventManager.AddCycles( result.cycles );
+}
 
 inline void MipsR3000Cpu::InterceptBios( uint32_t pc )
 {
@@ -160,76 +1039,19 @@ inline void MipsR3000Cpu::InterceptBios( uint32_t pc )
 	}
 }
 
+template <uint32_t Features>
 inline void MipsR3000Cpu::ExecuteInstruction( Instruction instr ) noexcept
 {
-	if ( EnableCpuLogging )
+	if constexpr ( Features & RunFeature::CpuLogging )
 	{
 		std::printf( "pc(%08X): ", m_currentPC );
 		PrintDisassembly( instr );
 	}
 
-#define OP_CASE( opcode ) case Opcode::opcode:	opcode( instr );	break;
-
-	switch ( static_cast<Opcode>( instr.op() ) )
-	{
-		OP_CASE( Special )
-
-		OP_CASE( RegisterImmediate )
-
-		OP_CASE( AddImmediate )
-		OP_CASE( AddImmediateUnsigned )
-		OP_CASE( BitwiseAndImmediate )
-		OP_CASE( BranchEqual )
-		OP_CASE( BranchGreaterThanZero )
-		OP_CASE( BranchLessEqualZero )
-		OP_CASE( BranchNotEqual )
-		OP_CASE( Jump )
-		OP_CASE( JumpAndLink )
-		OP_CASE( LoadByte )
-		OP_CASE( LoadByteUnsigned )
-		OP_CASE( LoadHalfword )
-		OP_CASE( LoadHalfwordUnsigned )
-		OP_CASE( LoadUpperImmediate )
-		OP_CASE( LoadWord )
-		OP_CASE( LoadWordLeft )
-		OP_CASE( LoadWordRight )
-		OP_CASE( BitwiseOrImmediate )
-		OP_CASE( StoreByte )
-		OP_CASE( StoreHalfword )
-		OP_CASE( SetLessThanImmediate )
-		OP_CASE( SetLessThanImmediateUnsigned )
-		OP_CASE( StoreWord )
-		OP_CASE( StoreWordLeft )
-		OP_CASE( StoreWordRight )
-		OP_CASE( BitwiseXorImmediate )
-
-		case Opcode::CoprocessorUnit0:
-		case Opcode::CoprocessorUnit1:
-		case Opcode::CoprocessorUnit2:
-		case Opcode::CoprocessorUnit3:
-			CoprocessorUnit( instr );
-			break;
-
-		case Opcode::LoadWordToCoprocessor0:
-		case Opcode::LoadWordToCoprocessor1:
-		case Opcode::LoadWordToCoprocessor2:
-		case Opcode::LoadWordToCoprocessor3:
-			LoadWordToCoprocessor( instr );
-			break;
-
-		case Opcode::StoreWordFromCoprocessor0:
-		case Opcode::StoreWordFromCoprocessor1:
-		case Opcode::StoreWordFromCoprocessor2:
-		case Opcode::StoreWordFromCoprocessor3:
-			StoreWordFromCoprocessor( instr );
-			break;
-
-		default:
-			IllegalInstruction( instr );
-			break;
-	}
-
-#undef OP_CASE
+	if constexpr ( Features & RunFeature::Profiler )
+		DecodeProfiledHandler( instr )( *this, instr );
+	else
+		DecodeCachedHandler( instr )( *this, instr );
 }
 
 void MipsR3000Cpu::RaiseException( Cop0::ExceptionCode code, uint32_t coprocessor ) noexcept
@@ -295,77 +1117,6 @@ inline void MipsR3000Cpu::JumpImp( uint32_t target ) noexcept
 	CheckProgramCounterAlignment();
 }
 
-inline void MipsR3000Cpu::Special( Instruction instr ) noexcept
-{
-#define OP_CASE( opcode ) case SpecialOpcode::opcode:	opcode( instr );	break;
-
-	switch ( static_cast<SpecialOpcode>( instr.funct() ) )
-	{
-		OP_CASE( Add )
-		OP_CASE( AddUnsigned )
-		OP_CASE( BitwiseAnd )
-		OP_CASE( Break )
-		OP_CASE( Divide )
-		OP_CASE( DivideUnsigned )
-		OP_CASE( JumpAndLinkRegister )
-		OP_CASE( JumpRegister )
-		OP_CASE( MoveFromHi )
-		OP_CASE( MoveFromLo )
-		OP_CASE( MoveToHi )
-		OP_CASE( MoveToLo )
-		OP_CASE( Multiply )
-		OP_CASE( MultiplyUnsigned )
-		OP_CASE( BitwiseNor )
-		OP_CASE( BitwiseOr )
-		OP_CASE( ShiftLeftLogical )
-		OP_CASE( ShiftLeftLogicalVariable )
-		OP_CASE( SetLessThan )
-		OP_CASE( SetLessThanUnsigned )
-		OP_CASE( ShiftRightArithmetic )
-		OP_CASE( ShiftRightArithmeticVariable )
-		OP_CASE( ShiftRightLogical )
-		OP_CASE( ShiftRightLogicalVariable )
-		OP_CASE( Subtract )
-		OP_CASE( SubtractUnsigned )
-		OP_CASE( SystemCall )
-		OP_CASE( BitwiseXor )
-
-		default:
-			IllegalInstruction( instr );
-			break;
-	}
-
-#undef OP_CASE
-}
-
-inline void MipsR3000Cpu::RegisterImmediate( Instruction instr ) noexcept
-{
-	auto opcode = instr.rt();
-	opcode = ( ( ( opcode & 0x1e ) == 0x10 ) ? 0x10 : 0 ) | ( opcode & 1 );
-	switch ( static_cast<RegImmOpcode>( opcode ) )
-	{
-		case RegImmOpcode::BranchLessThanZero:
-			BranchLessThanZero( instr );
-			break;
-
-		case RegImmOpcode::BranchGreaterEqualZero:
-			BranchGreaterEqualZero( instr );
-			break;
-
-		case RegImmOpcode::BranchLessThanZeroAndLink:
-			BranchLessThanZeroAndLink( instr );
-			break;
-
-		case RegImmOpcode::BranchGreaterEqualZeroAndLink:
-			BranchGreaterEqualZeroAndLink( instr );
-			break;
-
-		default:
-			dbBreak();
-			break;
-	}
-}
-
 inline void MipsR3000Cpu::CoprocessorUnit( Instruction instr ) noexcept
 {
 	const uint32_t coprocessor = instr.z();
@@ -376,7 +1127,7 @@ inline void MipsR3000Cpu::CoprocessorUnit( Instruction instr ) noexcept
 	}
 
 	if ( coprocessor == 2 )
-		m_eventManager.StallUntilGteComplete();
+		m_gte.AddStallCycles( m_eventManager.StallUntilGteComplete() );
 
 	switch ( static_cast<CoprocessorOpcode>( instr.subop() ) )
 	{
@@ -503,6 +1254,10 @@ inline void MipsR3000Cpu::CoprocessorOperation( Instruction instr ) noexcept
 	{
 		case 0:
 			m_cop0.PrepareReturnFromException();
+
+			// restores the interrupt enable
+			if ( m_cop0.ShouldTriggerInterrupt() )
+				m_eventManager.StopRun();
 			break;
 
 		case 2:
@@ -593,6 +1348,29 @@ inline void MipsR3000Cpu::JumpRegister( Instruction instr ) noexcept
 	CheckProgramCounterAlignment();
 }
 
+void MipsR3000Cpu::ProfiledJumpAndLink( Instruction instr ) noexcept
+{
+	JumpAndLink( instr );
+	m_profiler.OnCall( m_nextPC, m_currentPC + 8 );
+}
+
+void MipsR3000Cpu::ProfiledJumpAndLinkRegister( Instruction instr ) noexcept
+{
+	// rd may overwrite rs
+	const uint32_t target = m_registers[ instr.rs() ];
+	JumpAndLinkRegister( instr );
+
+	if ( target % 4 == 0 )
+		m_profiler.OnCall( target, m_currentPC + 8 );
+}
+
+void MipsR3000Cpu::ProfiledJumpRegister( Instruction instr ) noexcept
+{
+	const uint32_t target = m_registers[ instr.rs() ];
+	JumpRegister( instr );
+	m_profiler.OnJump( target );
+}
+
 inline void MipsR3000Cpu::LoadByte( Instruction instr ) noexcept
 {
 	LoadImp<int8_t>( instr );
@@ -641,7 +1419,7 @@ inline void MipsR3000Cpu::LoadWordToCoprocessor( Instruction instr ) noexcept
 
 	if ( coprocessor == 2 )
 	{
-		m_eventManager.StallUntilGteComplete();
+		m_gte.AddStallCycles( m_eventManager.StallUntilGteComplete() );
 		m_gte.Write( instr.rt(), LoadImp<uint32_t>( address ) );
 	}
 }
@@ -733,8 +1511,19 @@ inline void MipsR3000Cpu::MoveToCoprocessor( Instruction instr ) noexcept
 	switch ( instr.z() )
 	{
 		case 0:
+		{
+			const bool wasCacheIsolated = m_cop0.GetIsolateCache();
 			m_cop0.Write( rd, value );
+
+			// the BIOS flushes the instruction cache by writing to it while isolated. Invalidate once when it's done
+			if ( wasCacheIsolated && !m_cop0.GetIsolateCache() )
+				m_codeCache.InvalidateAllRam();
+
+			// can unmask or raise software interrupts
+			if ( m_cop0.ShouldTriggerInterrupt() )
+				m_eventManager.StopRun();
 			break;
+		}
 
 		case 2:
 			m_gte.Write( rd, value );
@@ -892,7 +1681,7 @@ inline void MipsR3000Cpu::StoreWordFromCoprocessor( Instruction instr ) noexcept
 
 	if ( coprocessor == 2 )
 	{
-		m_eventManager.StallUntilGteComplete();
+		m_gte.AddStallCycles( m_eventManager.StallUntilGteComplete() );
 		m_memoryMap.Write<uint32_t>( address, m_gte.Read( instr.rt() ) );
 	}
 }
@@ -965,7 +1754,7 @@ inline void MipsR3000Cpu::IllegalInstruction( [[maybe_unused]] Instruction instr
 
 void MipsR3000Cpu::Serialize( SaveStateSerializer& serializer )
 {
-	if ( !serializer.Header( "CPU", 1 ) )
+	if ( !serializer.Header( "CPU", 2 ) )
 		return;
 
 	m_registers.Serialize( serializer );
@@ -984,6 +1773,7 @@ void MipsR3000Cpu::Serialize( SaveStateSerializer& serializer )
 
 	m_cop0.Serialize( serializer );
 	m_gte.Serialize( serializer );
+	m_biosHle.Serialize( serializer );
 }
 
 void MipsR3000Cpu::Registers::Serialize( SaveStateSerializer& serializer )
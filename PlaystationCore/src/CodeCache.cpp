@@ -0,0 +1,94 @@
+#include "CodeCache.h"
+
+#include <algorithm>
+
+namespace PSX
+{
+
+void CodeCache::Reset()
+{
+	m_blocks.clear();
+
+	for ( auto& blocks : m_pageBlocks )
+		blocks.clear();
+
+	m_pageHasCode.fill( 0 );
+
+	m_invalidatedBlocks.clear();
+}
+
+CodeBlock* CodeCache::InsertBlock( std::unique_ptr<CodeBlock> block )
+{
+	dbExpects( block );
+	dbExpects( !block->instructions.empty() );
+	dbExpects( m_blocks.find( block->key ) == m_blocks.end() );
+
+	CodeBlock* result = block.get();
+
+	if ( IsRamKey( result->key ) )
+	{
+		// blocks may wrap around the end of RAM into the next mirror
+		const uint32_t lastPage = GetLastPage( *result );
+		for ( uint32_t page = GetFirstPage( *result ); page <= lastPage; ++page )
+		{
+			m_pageBlocks[ page % RamPageCount ].push_back( result );
+			m_pageHasCode[ page % RamPageCount ] = 1;
+		}
+	}
+
+	m_blocks.emplace( result->key, std::move( block ) );
+	return result;
+}
+
+void CodeCache::InvalidatePage( uint32_t page )
+{
+	dbExpects( page < RamPageCount );
+
+	// take the list so removing blocks from other pages can't modify it while we iterate
+	auto blocks = std::move( m_pageBlocks[ page ] );
+	m_pageBlocks[ page ].clear();
+	m_pageHasCode[ page ] = 0;
+
+	for ( CodeBlock* block : blocks )
+	{
+		RemoveFromPages( block, page );
+
+		if ( m_invalidateBlockCallback )
+			m_invalidateBlockCallback( *block );
+
+		auto it = m_blocks.find( block->key );
+		dbAssert( it != m_blocks.end() );
+		m_invalidatedBlocks.push_back( std::move( it->second ) );
+		m_blocks.erase( it );
+	}
+
+	// reuse allocation
+	blocks.clear();
+	m_pageBlocks[ page ] = std::move( blocks );
+}
+
+void CodeCache::RemoveFromPages( const CodeBlock* block, uint32_t skipPage )
+{
+	const uint32_t lastPage = GetLastPage( *block );
+	for ( uint32_t page = GetFirstPage( *block ); page <= lastPage; ++page )
+	{
+		auto& blocks = m_pageBlocks[ page % RamPageCount ];
+		if ( page % RamPageCount != skipPage )
+		{
+			blocks.erase( std::remove( blocks.begin(), blocks.end(), block ), blocks.end() );
+			m_pageHasCode[ page % RamPageCount ] = !blocks.empty();
+		}
+	}
+}
+
+void CodeCache::InvalidateAllRam()
+{
+	// BIOS blocks can't go stale, so only RAM blocks need to be dropped
+	for ( uint32_t page = 0; page < RamPageCount; ++page )
+	{
+		if ( m_pageHasCode[ page ] )
+			InvalidatePage( page );
+	}
+}
+
+}
\ No newline at end of file
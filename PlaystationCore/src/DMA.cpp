@@ -1,6 +1,7 @@
 #include "DMA.h"
 
 #include "CDRomDrive.h"
+#include "CodeCache.h"
 #include "EventManager.h"
 #include "GPU.h"
 #include "InterruptControl.h"
@@ -32,6 +33,7 @@ const std::array<const char*, 7> ChannelNames
 }
 
 Dma::Dma( Ram& ram,
+	CodeCache& codeCache,
 	Gpu& gpu,
 	CDRomDrive& cdromDRive,
 	MacroblockDecoder& mdec,
@@ -39,6 +41,7 @@ Dma::Dma( Ram& ram,
 	InterruptControl& interruptControl,
 	EventManager& eventManager )
 	: m_ram{ ram }
+	, m_codeCache{ codeCache }
 	, m_gpu{ gpu }
 	, m_cdromDrive{ cdromDRive }
 	, m_mdec{ mdec }
@@ -369,7 +372,7 @@ Dma::DmaResult Dma::StartDma( Channel channel )
 	}
 
 	if ( totalCycles > 0 )
-		m_eventManager.AddCyclesAndUpdateEvents( totalCycles );
+		m_eventManager.AddSystemCyclesAndUpdateEvents( totalCycles );
 
 	switch ( result )
 	{
@@ -414,6 +417,10 @@ void Dma::TransferToRam( Channel channel, uint32_t address, uint32_t wordCount,
 
 	address &= DmaAddressMask;
 
+	// backward transfers (including the order table) end at the lowest address
+	const uint32_t firstAddress = ( addressStep == ForwardStep ) ? address : ( ( address - ( wordCount - 1 ) * 4 ) & DmaAddressMask );
+	m_codeCache.InvalidateRam( firstAddress, wordCount * 4 );
+
 	if ( channel == Channel::RamOrderTable )
 	{
 		ClearOrderTable( address, wordCount );
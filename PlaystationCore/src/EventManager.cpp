@@ -1,15 +1,19 @@
 #include "EventManager.h"
 
+#include "EventTelemetry.h"
 #include "SaveState.h"
 
 #include <stdx/assert.h>
+#include <stdx/compiler.h>
+
+#include <chrono>
 
 namespace PSX
 {
 
 namespace
 {
-	constexpr size_t npos = std::numeric_limits<size_t>::max();
+	constexpr timestamp_t MaxTimestamp = std::numeric_limits<timestamp_t>::max();
 }
 
 Event::~Event()
@@ -19,9 +23,11 @@ Event::~Event()
 
 void Event::Reset()
 {
+	m_lastUpdateTime = 0;
 	m_cyclesUntilEvent = 0;
-	m_pendingCycles = 0;
+	m_pausedCycles = 0;
 	m_active = false;
+	m_manager.ScheduleNextEvent( this );
 }
 
 void Event::UpdateEarly()
@@ -29,7 +35,7 @@ void Event::UpdateEarly()
 	if ( !m_active )
 		return;
 
-	cycles_t pendingCycles = m_pendingCycles + m_manager.GetPendingCycles();
+	cycles_t pendingCycles = GetPendingCycles();
 	while ( pendingCycles > 0 && m_active )
 	{
 		const cycles_t updateCycles = std::min( pendingCycles, m_cyclesUntilEvent );
@@ -47,7 +53,8 @@ void Event::Schedule( cycles_t cyclesFromNow )
 	if ( !m_active )
 	{
 		// timer just started, so we must delay by the manager's current pending cycles
-		m_pendingCycles = -m_manager.GetPendingCycles();
+		m_lastUpdateTime = m_manager.GetCurrentTime();
+		m_pausedCycles = 0;
 		m_active = true;
 	}
 	else if ( m_cyclesUntilEvent == cyclesFromNow )
@@ -64,10 +71,9 @@ void Event::Cancel()
 {
 	if ( m_active )
 	{
-		m_pendingCycles = 0;
 		m_cyclesUntilEvent = 0;
 		m_active = false;
-		m_manager.ScheduleNextEvent(this );
+		m_manager.ScheduleNextEvent( this );
 	}
 }
 
@@ -76,7 +82,7 @@ void Event::Pause()
 	if ( !m_active )
 		return;
 
-	m_pendingCycles += m_manager.GetPendingCycles();
+	m_pausedCycles = GetPendingCycles();
 	m_active = false;
 	m_manager.ScheduleNextEvent( this );
 }
@@ -86,7 +92,8 @@ void Event::Resume()
 	if ( m_active || m_cyclesUntilEvent == 0 )
 		return;
 
-	m_pendingCycles -= m_manager.GetPendingCycles();
+	m_lastUpdateTime = m_manager.GetCurrentTime() - m_pausedCycles;
+	m_pausedCycles = 0;
 	m_active = true;
 	m_manager.ScheduleNextEvent( this );
 }
@@ -94,7 +101,12 @@ void Event::Resume()
 cycles_t Event::GetPendingCycles() const noexcept
 {
 	dbExpects( m_active );
-	return m_pendingCycles + m_manager.GetPendingCycles();
+	return static_cast<cycles_t>( m_manager.GetCurrentTime() - m_lastUpdateTime );
+}
+
+cycles_t Event::GetLocalRemainingCycles() const noexcept
+{
+	return static_cast<cycles_t>( GetDueTime() - m_manager.m_currentTime );
 }
 
 void Event::Update( cycles_t cycles )
@@ -104,25 +116,34 @@ void Event::Update( cycles_t cycles )
 	dbExpects( cycles <= m_cyclesUntilEvent );
 
 	m_cyclesUntilEvent -= cycles;
-	m_pendingCycles -= cycles;
+	m_lastUpdateTime += cycles;
 
 	m_onUpdate( cycles );
 
 	// if event was not re-scheduled, disable it
 	if ( m_cyclesUntilEvent == 0 )
-	{
-		m_pendingCycles = 0;
 		m_active = false;
-	}
 }
 
 void Event::Serialize( SaveStateSerializer& serializer )
 {
+	// pending cycles are saved relative to the manager so states don't depend on the absolute time
+	cycles_t pendingCycles = m_active ? static_cast<cycles_t>( m_manager.m_currentTime - m_lastUpdateTime ) : m_pausedCycles;
+
 	serializer( m_cyclesUntilEvent );
-	serializer( m_pendingCycles );
+	serializer( pendingCycles );
 	serializer( m_active );
+
+	if ( serializer.Reading() )
+	{
+		m_lastUpdateTime = m_active ? m_manager.m_currentTime - pendingCycles : 0;
+		m_pausedCycles = m_active ? 0 : pendingCycles;
+		m_manager.ScheduleNextEvent( this );
+	}
 }
 
+EventManager::EventManager() = default;
+
 EventManager::~EventManager()
 {
 	dbAssert( m_events.empty() );
@@ -131,8 +152,9 @@ EventManager::~EventManager()
 EventHandle EventManager::CreateEvent( std::string name, EventUpdateCallback onUpdate )
 {
 	dbExpects( !name.empty() );
-	EventHandle event( new Event( *this, std::move( name ), std::move( onUpdate ) ) );
+	EventHandle event( new Event( *this, std::move( name ), onUpdate, m_events.size() ) );
 	m_events.push_back( event.get() );
+	m_dueTimes.push_back( MaxTimestamp );
 	return event;
 }
 
@@ -150,13 +172,15 @@ void EventManager::Reset()
 	dbLogDebug( "EventManager::Reset" );
 
 	m_pendingCycles = 0;
-	m_cyclesUntilNextEvent = 0;
 	m_cyclesUntilGteComplete = 0;
 	m_cyclesThisFrame = 0;
-	m_nextEvent = nullptr;
+	m_systemCycleFraction = 0;
+	m_stopRun = false;
 
 	for ( Event* event : m_events )
 		event->Reset();
+
+	dbAssert( !m_nextEvent );
 }
 
 void EventManager::UpdateNextEvent()
@@ -166,102 +190,164 @@ void EventManager::UpdateNextEvent()
 	if ( m_updating )
 		return; // prevent recursive updates
 
-	do
+	while ( NextEventDue() )
 	{
 		dbAssert( m_nextEvent );
 
-		if ( m_pendingCycles > 0 )
-		{
-			for ( Event* event : m_events )
-				event->AddPendingCycles( m_pendingCycles );
-
-			m_cyclesUntilGteComplete = std::max( m_cyclesUntilGteComplete - m_pendingCycles, 0 );
-
-			m_cyclesThisFrame += m_pendingCycles;
-			m_pendingCycles = 0;
-		}
+		CommitPendingCycles();
 
-		Event* event = std::exchange( m_nextEvent, nullptr );
+		Event* event = m_nextEvent;
 		dbAssert( event->IsActive() );
 		dbExpects( event->GetLocalRemainingCycles() <= 0 );
 
 		UpdateEvent( event, event->m_cyclesUntilEvent );
 
-		ScheduleNextEvent( nullptr );
+		ScheduleNextEvent( event );
+	}
+}
+
+void EventManager::CommitPendingCycles() noexcept
+{
+	if ( m_pendingCycles > 0 )
+	{
+		const int64_t systemCycles = static_cast<int64_t>( m_pendingCycles ) * m_systemCyclesPerCpuCycle + m_systemCycleFraction;
+		m_currentTime += systemCycles >> SystemCycleFractionBits;
+		m_systemCycleFraction = systemCycles & ( ( int64_t( 1 ) << SystemCycleFractionBits ) - 1 );
+
+		m_cyclesUntilGteComplete = std::max( m_cyclesUntilGteComplete - m_pendingCycles, 0 );
+
+		m_cyclesThisFrame += m_pendingCycles;
+		m_pendingCycles = 0;
 	}
-	while ( ReadyForNextEvent() );
 }
 
 void EventManager::UpdateEvent( Event* event, cycles_t cycles )
 {
 	dbAssert( !m_updating );
 	m_updating = true;
-	event->Update( cycles );
+
+	if ( STDX_unlikely( m_telemetry ) )
+		UpdateEventWithTelemetry( event, cycles );
+	else
+		event->Update( cycles );
+
 	m_updating = false;
 }
 
-void EventManager::ScheduleNextEvent( const Event* changedEvent )
+void EventManager::UpdateEventWithTelemetry( Event* event, cycles_t cycles )
 {
-	// prevent recursive scheduling
-	// event will be scheduled after update
-	if ( m_updating )
+	if ( event->m_telemetryId == Event::NoTelemetryId )
+		event->m_telemetryId = m_telemetry->RegisterEvent( event->GetName() );
+
+	const bool fired = ( cycles == event->m_cyclesUntilEvent );
+	const timestamp_t dueTime = event->GetDueTime();
+
+	const auto start = std::chrono::steady_clock::now();
+	event->Update( cycles );
+	const auto hostTime = std::chrono::steady_clock::now() - start;
+
+	if ( fired )
+		m_telemetry->RecordFire( event->m_telemetryId, static_cast<cycles_t>( GetCurrentTime() - dueTime ), hostTime );
+	else
+		m_telemetry->RecordEarlyUpdate( event->m_telemetryId, hostTime );
+}
+
+void EventManager::EnableTelemetry( bool enable )
+{
+	if ( enable == ( m_telemetry != nullptr ) )
 		return;
 
-	// early out if changed event doesn't change order
-	if ( m_nextEvent && changedEvent )
+	m_telemetry = enable ? std::make_unique<EventTelemetry>() : nullptr;
+
+	for ( Event* event : m_events )
+		event->m_telemetryId = Event::NoTelemetryId;
+}
+
+void EventManager::ScheduleNextEvent( Event* changedEvent )
+{
+	const timestamp_t dueTime = changedEvent->IsActive() ? changedEvent->GetDueTime() : MaxTimestamp;
+	m_dueTimes[ changedEvent->m_index ] = dueTime;
+
+	// the next event is found after the update
+	if ( m_updating )
 	{
-		const auto newCyclesUntilEvent = changedEvent->IsActive() ? changedEvent->GetLocalRemainingCycles() : InfiniteCycles;
-		if ( m_nextEvent == changedEvent )
-		{
-			if ( newCyclesUntilEvent < m_cyclesUntilNextEvent )
-			{
-				m_cyclesUntilNextEvent = newCyclesUntilEvent;
-				return;
-			}
-		}
-		else
-		{
-			if ( newCyclesUntilEvent >= m_cyclesUntilNextEvent )
-			{
-				return;
-			}
-		}
+		m_nextEventChanged = true;
+		return;
 	}
 
-	// schedule next event
-	const auto [minIndex, minCycles] = FindNextEvent();
-	dbAssert( minIndex != npos );
-	dbAssert( minCycles != InfiniteCycles );
+	if ( m_nextEventChanged || changedEvent == m_nextEvent || !m_nextEvent )
+	{
+		FindNextEvent();
+	}
+	else
+	{
+		// early out if changed event doesn't change order
+		const timestamp_t nextDueTime = m_dueTimes[ m_nextEvent->m_index ];
+		if ( dueTime > nextDueTime || ( dueTime == nextDueTime && changedEvent->m_index > m_nextEvent->m_index ) )
+			return;
 
-	m_nextEvent = m_events[ minIndex ];
-	dbAssert( m_nextEvent->IsActive() );
-	dbAssert( m_nextEvent->m_cyclesUntilEvent > 0 );
+		m_nextEvent = changedEvent;
+	}
 
-	m_cyclesUntilNextEvent = minCycles;
+	dbAssert( !m_nextEvent || ( m_nextEvent->IsActive() && m_nextEvent->m_cyclesUntilEvent > 0 ) );
+	UpdateCyclesUntilNextEvent();
 }
 
-std::pair<size_t, cycles_t> EventManager::FindNextEvent() const
+void EventManager::FindNextEvent()
 {
-
-	// find next event
-	size_t minIndex = npos;
-	cycles_t minCycles = InfiniteCycles;
-	for ( size_t i = 0; i < m_events.size(); ++i )
+	size_t minIndex = 0;
+	timestamp_t minDueTime = MaxTimestamp;
+	for ( size_t i = 0; i < m_dueTimes.size(); ++i )
 	{
-		auto* event = m_events[ i ];
-		dbAssert( event );
-		if ( event->IsActive() )
-		{
-			const cycles_t remainingCycles = event->GetLocalRemainingCycles();
-			if ( remainingCycles < minCycles )
-			{
-				minCycles = remainingCycles;
-				minIndex = i;
-			}
-		}
+		// selects instead of branches. The order of due times is unpredictable
+		const bool earlier = m_dueTimes[ i ] < minDueTime;
+		minDueTime = earlier ? m_dueTimes[ i ] : minDueTime;
+		minIndex = earlier ? i : minIndex;
 	}
 
-	return std::make_pair( minIndex, minCycles );
+	m_nextEvent = ( minDueTime != MaxTimestamp ) ? m_events[ minIndex ] : nullptr;
+	m_nextEventChanged = false;
+}
+
+void EventManager::UpdateCyclesUntilNextEvent() noexcept
+{
+	if ( m_stopRun )
+		m_cyclesUntilNextEvent = 0;
+	else
+		m_cyclesUntilNextEvent = m_nextEvent ? GetCpuCyclesUntil( m_nextEvent->GetLocalRemainingCycles() ) : InfiniteCycles;
+}
+
+bool EventManager::NextEventDue() const noexcept
+{
+	return m_nextEvent && GetPendingSystemCycles() >= m_nextEvent->GetLocalRemainingCycles();
+}
+
+cycles_t EventManager::GetCpuCyclesUntil( cycles_t systemCycles ) const noexcept
+{
+	const int64_t remaining = ( static_cast<int64_t>( systemCycles ) << SystemCycleFractionBits ) - m_systemCycleFraction;
+	if ( remaining <= 0 )
+		return 0;
+
+	const int64_t cpuCycles = ( remaining + m_systemCyclesPerCpuCycle - 1 ) / m_systemCyclesPerCpuCycle;
+	return static_cast<cycles_t>( std::min<int64_t>( cpuCycles, InfiniteCycles ) );
+}
+
+void EventManager::SetCpuClock( uint32_t percent ) noexcept
+{
+	dbExpects( percent > 0 );
+	dbExpects( !m_updating );
+
+	// pending cycles were run at the old clock
+	CommitPendingCycles();
+
+	m_cpuClock = percent;
+	UpdateSystemCyclesPerCpuCycle();
+	UpdateCyclesUntilNextEvent();
+}
+
+void EventManager::UpdateSystemCyclesPerCpuCycle() noexcept
+{
+	m_systemCyclesPerCpuCycle = ( ( int64_t( StockCpuClock ) << SystemCycleFractionBits ) + m_cpuClock / 2 ) / m_cpuClock;
 }
 
 void EventManager::RemoveEvent( Event* event )
@@ -269,15 +355,25 @@ void EventManager::RemoveEvent( Event* event )
 	dbExpects( event );
 	dbLogDebug( "EventManager::RemoveEvent -- [%s]", event->GetName().c_str() );
 
-	auto it = std::find( m_events.begin(), m_events.end(), event );
-	dbAssert( it != m_events.end() );
-	m_events.erase( it );
+	// the next event must not dangle
+	event->Cancel();
+
+	dbAssert( m_events[ event->m_index ] == event );
+	m_events.erase( m_events.begin() + event->m_index );
+	m_dueTimes.erase( m_dueTimes.begin() + event->m_index );
+
+	for ( size_t i = event->m_index; i < m_events.size(); ++i )
+		m_events[ i ]->m_index = i;
 }
 
 void EventManager::EndFrame()
 {
 	m_cyclesThisFrame += m_pendingCycles;
 	dbLogDebug( "EventManager::EndFrame -- CPU cycles this frame: %i", m_cyclesThisFrame );
+
+	if ( m_telemetry )
+		m_telemetry->EndFrame( m_cyclesThisFrame );
+
 	m_cyclesThisFrame = -m_pendingCycles;
 }
 
@@ -285,15 +381,22 @@ void EventManager::Serialize( SaveStateSerializer& serializer )
 {
 	dbAssert( !m_updating );
 
-	if ( !serializer.Header( "EventManager", 1 ) )
+	if ( !serializer.Header( "EventManager", 2 ) )
 		return;
 
 	serializer( m_cyclesUntilNextEvent );
 	serializer( m_pendingCycles );
 	serializer( m_cyclesUntilGteComplete );
 	serializer( m_cyclesThisFrame );
+	serializer( m_cpuClock );
+	serializer( m_systemCycleFraction );
+
+	if ( serializer.Reading() )
+		UpdateSystemCyclesPerCpuCycle();
 
-	ScheduleNextEvent( nullptr );
+	FindNextEvent();
+	m_stopRun = false;
+	UpdateCyclesUntilNextEvent();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "EventTelemetry.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <cstdio>
+#include <fstream>
+
+namespace PSX
+{
+
+namespace
+{
+
+void WriteJsonString( std::ostream& out, std::string_view str )
+{
+	out << '"';
+	for ( char c : str )
+	{
+		if ( c == '"' || c == '\\' )
+			out << '\\';
+
+		out << c;
+	}
+	out << '"';
+}
+
+}
+
+EventTelemetry::EventStats& EventTelemetry::EventStats::operator+=( const EventStats& other ) noexcept
+{
+	fires += other.fires;
+	earlyUpdates += other.earlyUpdates;
+	maxLateness = std::max( maxLateness, other.maxLateness );
+	totalLateness += other.totalLateness;
+	hostNanoseconds += other.hostNanoseconds;
+
+	for ( size_t i = 0; i < LatenessBucketCount; ++i )
+		latenessHistogram[ i ] += other.latenessHistogram[ i ];
+
+	return *this;
+}
+
+EventTelemetry::EventTelemetry( size_t maxFrames ) : m_maxFrames{ maxFrames }
+{
+	dbExpects( maxFrames > 0 );
+}
+
+uint32_t EventTelemetry::RegisterEvent( const std::string& name )
+{
+	auto [it, inserted] = m_eventIds.try_emplace( name, static_cast<uint32_t>( m_eventNames.size() ) );
+	if ( inserted )
+	{
+		m_eventNames.push_back( name );
+		m_currentFrame.events.resize( m_eventNames.size() );
+	}
+
+	return it->second;
+}
+
+EventTelemetry::EventStats& EventTelemetry::GetStats( uint32_t eventId ) noexcept
+{
+	dbExpects( eventId < m_currentFrame.events.size() );
+	return m_currentFrame.events[ eventId ];
+}
+
+void EventTelemetry::RecordFire( uint32_t eventId, cycles_t lateness, std::chrono::nanoseconds hostTime ) noexcept
+{
+	dbExpects( lateness >= 0 );
+
+	auto& stats = GetStats( eventId );
+	++stats.fires;
+	stats.maxLateness = std::max( stats.maxLateness, lateness );
+	stats.totalLateness += lateness;
+	stats.hostNanoseconds += hostTime.count();
+	++stats.latenessHistogram[ GetLatenessBucket( lateness ) ];
+}
+
+void EventTelemetry::RecordEarlyUpdate( uint32_t eventId, std::chrono::nanoseconds hostTime ) noexcept
+{
+	auto& stats = GetStats( eventId );
+	++stats.earlyUpdates;
+	stats.hostNanoseconds += hostTime.count();
+}
+
+void EventTelemetry::AddCounter( std::string_view name, int64_t value )
+{
+	auto [it, inserted] = m_counterIds.try_emplace( std::string( name ), static_cast<uint32_t>( m_counterNames.size() ) );
+	if ( inserted )
+	{
+		m_counterNames.emplace_back( name );
+		m_currentFrame.counters.resize( m_counterNames.size() );
+	}
+
+	m_currentFrame.counters[ it->second ] += value;
+}
+
+void EventTelemetry::EndFrame( cycles_t cycles )
+{
+	m_currentFrame.cycles = cycles;
+
+	if ( m_frames.size() == m_maxFrames )
+		m_frames.pop_front();
+
+	m_frames.push_back( m_currentFrame );
+
+	m_currentFrame.frame++;
+	m_currentFrame.cycles = 0;
+	std::fill( m_currentFrame.events.begin(), m_currentFrame.events.end(), EventStats{} );
+	std::fill( m_currentFrame.counters.begin(), m_currentFrame.counters.end(), 0 );
+}
+
+void EventTelemetry::Clear()
+{
+	m_frames.clear();
+	m_currentFrame.frame = 0;
+	m_currentFrame.cycles = 0;
+	std::fill( m_currentFrame.events.begin(), m_currentFrame.events.end(), EventStats{} );
+	std::fill( m_currentFrame.counters.begin(), m_currentFrame.counters.end(), 0 );
+}
+
+std::optional<uint32_t> EventTelemetry::FindEventId( std::string_view name ) const
+{
+	auto it = m_eventIds.find( std::string( name ) );
+	if ( it == m_eventIds.end() )
+		return std::nullopt;
+
+	return it->second;
+}
+
+EventTelemetry::EventStats EventTelemetry::GetTotals( uint32_t eventId ) const noexcept
+{
+	EventStats totals;
+	for ( auto& frame : m_frames )
+	{
+		// frames recorded before the event was registered have fewer entries
+		if ( eventId < frame.events.size() )
+			totals += frame.events[ eventId ];
+	}
+
+	return totals;
+}
+
+size_t EventTelemetry::GetLatenessBucket( cycles_t lateness ) noexcept
+{
+	size_t bucket = 0;
+	for ( ; lateness > 0 && bucket < LatenessBucketCount - 1; lateness >>= 1 )
+		++bucket;
+
+	return bucket;
+}
+
+cycles_t EventTelemetry::GetLatenessBucketStart( size_t bucket ) noexcept
+{
+	dbExpects( bucket < LatenessBucketCount );
+	return bucket == 0 ? 0 : cycles_t( 1 ) << ( bucket - 1 );
+}
+
+bool EventTelemetry::WriteCsv( const fs::path& filename ) const
+{
+	std::ofstream fout( filename );
+	if ( !fout.is_open() )
+	{
+		LogError( "EventTelemetry::WriteCsv -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	fout << "frame,cycles,event,fires,early_updates,max_lateness,mean_lateness,host_us";
+	for ( size_t i = 0; i < LatenessBucketCount; ++i )
+		fout << ",late_" << GetLatenessBucketStart( i ) << ( i + 1 < LatenessBucketCount ? "" : "+" );
+	fout << ",value\n";
+
+	char line[ 64 ];
+	for ( auto& frame : m_frames )
+	{
+		for ( size_t id = 0; id < frame.events.size(); ++id )
+		{
+			const auto& stats = frame.events[ id ];
+			if ( stats.fires == 0 && stats.earlyUpdates == 0 )
+				continue;
+
+			const double meanLateness = stats.fires > 0 ? static_cast<double>( stats.totalLateness ) / stats.fires : 0.0;
+			std::snprintf( line, sizeof( line ), "%.2f,%.3f", meanLateness, static_cast<double>( stats.hostNanoseconds ) / 1000.0 );
+
+			// event names don't contain quotes
+			fout << frame.frame << ',' << frame.cycles << ",\"" << m_eventNames[ id ] << "\"," << stats.fires << ',' << stats.earlyUpdates << ',' << stats.maxLateness << ',' << line;
+			for ( uint32_t count : stats.latenessHistogram )
+				fout << ',' << count;
+			fout << ",\n";
+		}
+
+		// counters only fill the value column
+		for ( size_t id = 0; id < frame.counters.size(); ++id )
+		{
+			if ( frame.counters[ id ] == 0 )
+				continue;
+
+			fout << frame.frame << ',' << frame.cycles << ",\"" << m_counterNames[ id ] << "\"," << std::string( 5 + LatenessBucketCount, ',' ) << frame.counters[ id ] << '\n';
+		}
+	}
+
+	return true;
+}
+
+bool EventTelemetry::WriteJson( const fs::path& filename ) const
+{
+	std::ofstream fout( filename );
+	if ( !fout.is_open() )
+	{
+		LogError( "EventTelemetry::WriteJson -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	fout << "{\n\t\"events\": [";
+	for ( size_t id = 0; id < m_eventNames.size(); ++id )
+	{
+		fout << ( id > 0 ? ", " : "" );
+		WriteJsonString( fout, m_eventNames[ id ] );
+	}
+
+	fout << "],\n\t\"counters\": [";
+	for ( size_t id = 0; id < m_counterNames.size(); ++id )
+	{
+		fout << ( id > 0 ? ", " : "" );
+		WriteJsonString( fout, m_counterNames[ id ] );
+	}
+
+	fout << "],\n\t\"latenessBuckets\": [";
+	for ( size_t i = 0; i < LatenessBucketCount; ++i )
+		fout << ( i > 0 ? ", " : "" ) << GetLatenessBucketStart( i );
+
+	fout << "],\n\t\"frames\": [";
+	bool firstFrame = true;
+	for ( auto& frame : m_frames )
+	{
+		fout << ( firstFrame ? "\n" : ",\n" ) << "\t\t{ \"frame\": " << frame.frame << ", \"cycles\": " << frame.cycles << ", \"events\": {";
+		firstFrame = false;
+
+		bool firstEvent = true;
+		for ( size_t id = 0; id < frame.events.size(); ++id )
+		{
+			const auto& stats = frame.events[ id ];
+			if ( stats.fires == 0 && stats.earlyUpdates == 0 )
+				continue;
+
+			fout << ( firstEvent ? "\n\t\t\t" : ",\n\t\t\t" );
+			firstEvent = false;
+
+			WriteJsonString( fout, m_eventNames[ id ] );
+			fout << ": { \"fires\": " << stats.fires
+				<< ", \"earlyUpdates\": " << stats.earlyUpdates
+				<< ", \"maxLateness\": " << stats.maxLateness
+				<< ", \"totalLateness\": " << stats.totalLateness
+				<< ", \"hostNanoseconds\": " << stats.hostNanoseconds
+				<< ", \"latenessHistogram\": [";
+
+			for ( size_t i = 0; i < LatenessBucketCount; ++i )
+				fout << ( i > 0 ? ", " : "" ) << stats.latenessHistogram[ i ];
+
+			fout << "] }";
+		}
+
+		fout << ( firstEvent ? "}" : "\n\t\t}" ) << ", \"counters\": {";
+
+		bool firstCounter = true;
+		for ( size_t id = 0; id < frame.counters.size(); ++id )
+		{
+			if ( frame.counters[ id ] == 0 )
+				continue;
+
+			fout << ( firstCounter ? " " : ", " );
+			firstCounter = false;
+
+			WriteJsonString( fout, m_counterNames[ id ] );
+			fout << ": " << frame.counters[ id ];
+		}
+
+		fout << ( firstCounter ? "} }" : " } }" );
+	}
+
+	fout << ( firstFrame ? "]\n}\n" : "\n\t]\n}\n" );
+	return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "Fastmem.h"
+
+#include "MemoryMap.h"
+#include "RAM.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#ifdef PSX_FASTMEM
+#include "X64Emitter.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <array>
+#include <new>
+#endif
+
+namespace PSX
+{
+
+#ifdef PSX_FASTMEM
+
+namespace
+{
+
+// segments that mirror the first 512MB of physical memory. KSEG2 is never mapped
+constexpr std::array<uint32_t, 3> SegmentBases{ 0x00000000, 0x80000000, 0xa0000000 };
+
+Fastmem* s_instance = nullptr;
+struct sigaction s_previousAction;
+
+void SignalHandler( int sig, siginfo_t* info, void* context )
+{
+	auto* ucontext = static_cast<ucontext_t*>( context );
+	const auto pc = static_cast<uintptr_t>( ucontext->uc_mcontext.gregs[ REG_RIP ] );
+
+	// returning re-executes the access site, which now jumps to its slow path
+	if ( s_instance && s_instance->HandleFault( reinterpret_cast<uintptr_t>( info->si_addr ), pc ) )
+		return;
+
+	if ( s_previousAction.sa_flags & SA_SIGINFO )
+	{
+		s_previousAction.sa_sigaction( sig, info, context );
+	}
+	else if ( s_previousAction.sa_handler != SIG_DFL && s_previousAction.sa_handler != SIG_IGN )
+	{
+		s_previousAction.sa_handler( sig );
+	}
+	else
+	{
+		// let the fault happen again with the default action
+		signal( sig, SIG_DFL );
+	}
+}
+
+}
+
+Fastmem::~Fastmem()
+{
+	Destroy();
+}
+
+bool Fastmem::Initialize()
+{
+	dbExpects( m_base == nullptr );
+
+	if ( s_instance )
+	{
+		LogError( "Fastmem::Initialize -- fault handler is already in use" );
+		return false;
+	}
+
+	m_ramFile = memfd_create( "psx-ram", MFD_CLOEXEC );
+	if ( m_ramFile < 0 || ftruncate( m_ramFile, RamSize ) != 0 )
+	{
+		LogError( "Fastmem::Initialize -- failed to create RAM file" );
+		Destroy();
+		return false;
+	}
+
+	void* view = mmap( nullptr, RamSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_ramFile, 0 );
+	if ( view == MAP_FAILED )
+	{
+		LogError( "Fastmem::Initialize -- failed to map RAM" );
+		Destroy();
+		return false;
+	}
+	m_ram = new( view ) Ram();
+
+	void* window = mmap( nullptr, WindowSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if ( window == MAP_FAILED )
+	{
+		LogError( "Fastmem::Initialize -- failed to reserve address space" );
+		Destroy();
+		return false;
+	}
+	m_base = static_cast<uint8_t*>( window );
+
+	for ( uint32_t segment : SegmentBases )
+	{
+		for ( uint32_t mirror = 0; mirror < MemoryMap::RamMirrorSize; mirror += RamSize )
+		{
+			void* address = m_base + segment + mirror;
+			if ( mmap( address, RamSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, m_ramFile, 0 ) == MAP_FAILED )
+			{
+				LogError( "Fastmem::Initialize -- failed to map RAM mirror [%X]", segment + mirror );
+				Destroy();
+				return false;
+			}
+		}
+	}
+
+	struct sigaction action{};
+	action.sa_sigaction = SignalHandler;
+	action.sa_flags = SA_SIGINFO;
+	sigemptyset( &action.sa_mask );
+	if ( sigaction( SIGSEGV, &action, &s_previousAction ) != 0 )
+	{
+		LogError( "Fastmem::Initialize -- failed to install fault handler" );
+		Destroy();
+		return false;
+	}
+	s_instance = this;
+
+	return true;
+}
+
+void Fastmem::Destroy() noexcept
+{
+	if ( s_instance == this )
+	{
+		sigaction( SIGSEGV, &s_previousAction, nullptr );
+		s_instance = nullptr;
+	}
+
+	// unmapping the window also removes the RAM mirrors inside it
+	if ( m_base )
+	{
+		munmap( m_base, WindowSize );
+		m_base = nullptr;
+	}
+
+	if ( m_ram )
+	{
+		munmap( m_ram, RamSize );
+		m_ram = nullptr;
+	}
+
+	if ( m_ramFile >= 0 )
+	{
+		close( m_ramFile );
+		m_ramFile = -1;
+	}
+
+	m_accessSites.clear();
+}
+
+void Fastmem::AddAccessSite( uint8_t* site, const uint8_t* slowPath )
+{
+	m_accessSites.insert_or_assign( reinterpret_cast<uintptr_t>( site ), slowPath );
+}
+
+bool Fastmem::HandleFault( uintptr_t faultAddress, uintptr_t pc ) noexcept
+{
+	const auto base = reinterpret_cast<uintptr_t>( m_base );
+	if ( faultAddress < base || faultAddress - base >= WindowSize )
+		return false;
+
+	auto it = m_accessSites.find( pc );
+	if ( it == m_accessSites.end() )
+		return false;
+
+	// I/O accesses tend to repeat at the same site, so it keeps using the slow path from now on
+	X64Emitter emitter( reinterpret_cast<uint8_t*>( pc ), AccessSiteSize );
+	emitter.Jump( it->second );
+	dbAssert( !emitter.HasOverflowed() );
+
+	return true;
+}
+
+#else
+
+Fastmem::~Fastmem() = default;
+
+bool Fastmem::Initialize()
+{
+	return false;
+}
+
+void Fastmem::Destroy() noexcept {}
+
+void Fastmem::AddAccessSite( uint8_t*, const uint8_t* ) {}
+
+bool Fastmem::HandleFault( uintptr_t, uintptr_t ) noexcept
+{
+	return false;
+}
+
+#endif
+
+}
\ No newline at end of file
@@ -3,25 +3,39 @@
 #include "CPU.h"
 #include "RAM.h"
 
+#include <cstring>
 #include <fstream>
 
 namespace PSX
 {
 
-bool LoadExecutable( const fs::path& filename, PSX::MipsR3000Cpu& cpu, PSX::Ram& ram )
+std::optional<std::vector<uint8_t>> ReadExecutableFile( const fs::path& filename )
 {
 	std::ifstream fin( filename, std::ios::binary );
 	if ( !fin.is_open() )
 	{
 		dbBreakMessage( "failed to open executable file" );
 		dbBreak();
-		return false;
+		return std::nullopt;
 	}
 
 	fin.seekg( 0, std::ios_base::end );
 	const size_t fileSize = static_cast<size_t>( fin.tellg() );
 	fin.seekg( 0, std::ios_base::beg );
 
+	std::vector<uint8_t> data( fileSize );
+	fin.read( reinterpret_cast<char*>( data.data() ), fileSize );
+	if ( !fin )
+	{
+		dbLogError( "failed to read executable file [%s]", filename.c_str() );
+		return std::nullopt;
+	}
+
+	return data;
+}
+
+bool LoadExecutable( const uint8_t* data, size_t fileSize, PSX::MipsR3000Cpu& cpu, PSX::Ram& ram )
+{
 	if ( ( fileSize / 0x800 < 2 ) || ( fileSize % 0x800 != 0 ) )
 	{
 		dbLogError( "file size must be a multiple of 0x800 greater than 1 [%x]", static_cast<uint32_t>( fileSize ) );
@@ -30,7 +44,7 @@ bool LoadExecutable( const fs::path& filename, PSX::MipsR3000Cpu& cpu, PSX::Ram&
 	}
 
 	PSX::ExeHeader header;
-	fin.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
+	std::memcpy( &header, data, sizeof( header ) );
 
 	if ( header.id != PSX::ExeHeader::Id )
 	{
@@ -58,7 +72,8 @@ bool LoadExecutable( const fs::path& filename, PSX::MipsR3000Cpu& cpu, PSX::Ram&
 
 	// TODO: zero fill
 
-	fin.read( (char*)ram.Data() + physicalRamDest, header.fileSize );
+	std::memcpy( ram.Data() + physicalRamDest, data + sizeof( header ), header.fileSize );
+	cpu.InvalidateCodeCache();
 
 	cpu.DebugSetProgramCounter( header.programCounter );
 
@@ -70,7 +85,7 @@ bool LoadExecutable( const fs::path& filename, PSX::MipsR3000Cpu& cpu, PSX::Ram&
 		cpu.DebugSetRegister( 30, header.stackPointerBase ); // TODO: is this right?
 	}
 
-	dbLog( "loaded %s", filename.c_str() );
+	dbLog( "loaded executable [entry %x]", header.programCounter );
 
 	return true;
 }
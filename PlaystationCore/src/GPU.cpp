@@ -945,13 +945,26 @@ void Gpu::WriteGP1( uint32_t value ) noexcept
 
 uint32_t Gpu::GpuStatus() noexcept
 {
-	// update the CRT state if it can affect the even/odd status bit
+	// the even/odd status bit can only change on a new scanline
 	cycles_t fractionalCycles = m_crtState.fractionalCycles;
 	const cycles_t currentGpuCycleInScanline = m_crtState.cycleInScanline + ConvertCpuToGpuCycles( m_crtEvent->GetPendingCycles(), fractionalCycles );
-	if ( currentGpuCycleInScanline >= m_crtConstants.cyclesPerScanline )
+	if ( currentGpuCycleInScanline < m_crtConstants.cyclesPerScanline )
+		return m_status.value;
+
+	// GPUSTAT is polled in tight loops. Compute the bit from the current scanline instead of updating the CRT state,
+	// unless the interlace field flipped or the CRT event is due
+	const uint32_t scanline = m_crtState.scanline + static_cast<uint32_t>( currentGpuCycleInScanline / m_crtConstants.cyclesPerScanline );
+	if ( scanline >= m_crtConstants.totalScanlines || m_crtEvent->GetRemainingCycles() <= 0 )
+	{
 		m_crtEvent->UpdateEarly();
+		return m_status.value;
+	}
 
-	return m_status.value;
+	const bool vblank = scanline < m_verDisplayRangeStart || scanline >= m_verDisplayRangeEnd;
+
+	Status status = m_status;
+	status.evenOddVblank = !vblank && ( status.Is480iMode() ? (bool)status.interlaceField : (bool)( scanline & 1u ) );
+	return status.value;
 }
 
 void Gpu::UpdateDmaRequest() noexcept
@@ -1657,7 +1670,7 @@ void Gpu::UpdateCrtCycles( cycles_t cpuCycles ) noexcept
 		m_crtState.scanline += curScanlinesToDraw;
 		dbAssert( m_crtState.scanline <= m_crtConstants.totalScanlines );
 
-		if ( prevScanline < m_verDisplayRangeStart && m_crtState.scanline >= std::min( m_verDisplayRangeEnd, m_crtConstants.totalScanlines ) )
+		if ( prevScanline < m_verDisplayRangeStart && m_crtState.scanline >= std::min( m_verDisplayRangeEnd, m_crtConstants.totalScanlines ) && m_verDisplayRangeStart < m_verDisplayRangeEnd )
 		{
 			// skipped over vertical display range, set vblank to false
 			m_crtState.vblank = false;
@@ -1711,32 +1724,56 @@ void Gpu::ScheduleCrtEvent() noexcept
 	// schedule dot timer
 	if ( !dotTimer.IsUsingSystemClock() && !dotTimer.IsPaused() )
 	{
-		const cycles_t cyclesUntilIrq = dotTimer.GetTicksUntilIrq() * m_crtState.dotClockDivider - m_crtState.dotFraction;
-		gpuCycles = std::min( gpuCycles, cyclesUntilIrq );
+		const auto ticksUntilIrq = dotTimer.GetTicksUntilIrq();
+		if ( ticksUntilIrq != InfiniteCycles )
+		{
+			const cycles_t cyclesUntilIrq = ticksUntilIrq * m_crtState.dotClockDivider - m_crtState.dotFraction;
+			gpuCycles = std::min( gpuCycles, cyclesUntilIrq );
+		}
 	}
 
+	// ranges ending past the scanline or frame change blanking when it wraps
+	const cycles_t horDisplayStart = std::min<cycles_t>( m_horDisplayRangeStart, m_crtConstants.cyclesPerScanline );
+	const cycles_t horDisplayEnd = std::min<cycles_t>( m_horDisplayRangeEnd, m_crtConstants.cyclesPerScanline );
+	const uint32_t verDisplayStart = std::min<uint32_t>( m_verDisplayRangeStart, m_crtConstants.totalScanlines );
+	const uint32_t verDisplayEnd = std::min<uint32_t>( m_verDisplayRangeEnd, m_crtConstants.totalScanlines );
+
 	// schedule hblank timer or dot timer sync
 	if ( dotTimer.GetSyncEnable() )
 	{
-		const cycles_t cyclesUntilHBlankChange = UnitsUntilRangeChange<cycles_t>( m_crtState.cycleInScanline, m_horDisplayRangeStart, m_horDisplayRangeEnd, m_crtConstants.cyclesPerScanline );
+		// a new display range can leave hblank out of date until the next update
+		const bool hblank = m_crtState.cycleInScanline < m_horDisplayRangeStart || m_crtState.cycleInScanline >= m_horDisplayRangeEnd;
+		const cycles_t cyclesUntilHBlankChange = ( hblank != m_crtState.hblank ) ? 1 : UnitsUntilRangeChange<cycles_t>( m_crtState.cycleInScanline, horDisplayStart, horDisplayEnd, m_crtConstants.cyclesPerScanline );
 		gpuCycles = std::min( gpuCycles, cyclesUntilHBlankChange );
 	}
 	else if ( !hblankTimer.IsUsingSystemClock() && !hblankTimer.IsPaused() )
 	{
-		const cycles_t cyclesUntilHBlank = UnitsUntilTrigger<cycles_t>( m_crtState.cycleInScanline, m_horDisplayRangeEnd, m_crtConstants.cyclesPerScanline );
-		gpuCycles = std::min( gpuCycles, cyclesUntilHBlank );
+		// hblanks are counted when the CRT state is updated, so only the IRQ needs an event
+		const auto ticksUntilIrq = hblankTimer.GetTicksUntilIrq();
+		if ( ticksUntilIrq != InfiniteCycles )
+		{
+			const cycles_t cyclesUntilIrq = UnitsUntilTrigger<cycles_t>( m_crtState.cycleInScanline, horDisplayEnd, m_crtConstants.cyclesPerScanline ) +
+				static_cast<cycles_t>( ticksUntilIrq - 1 ) * m_crtConstants.cyclesPerScanline;
+			gpuCycles = std::min( gpuCycles, cyclesUntilIrq );
+		}
 	}
 
 	// schedule vblank or hblank timer sync
 	uint32_t scanlinesUntilChange = 0;
 	if ( hblankTimer.GetSyncEnable() )
 	{
-		scanlinesUntilChange = UnitsUntilRangeChange<uint32_t>( m_crtState.scanline, m_verDisplayRangeStart, m_verDisplayRangeEnd, m_crtConstants.totalScanlines );
+		scanlinesUntilChange = UnitsUntilRangeChange<uint32_t>( m_crtState.scanline, verDisplayStart, verDisplayEnd, m_crtConstants.totalScanlines );
 	}
 	else
 	{
-		scanlinesUntilChange = UnitsUntilTrigger<uint32_t>( m_crtState.scanline, m_verDisplayRangeEnd, m_crtConstants.totalScanlines );
+		scanlinesUntilChange = UnitsUntilTrigger<uint32_t>( m_crtState.scanline, verDisplayEnd, m_crtConstants.totalScanlines );
 	}
+
+	// vblank is updated on the next scanline when a new display range leaves it out of date
+	const bool vblank = m_crtState.scanline < m_verDisplayRangeStart || m_crtState.scanline >= m_verDisplayRangeEnd;
+	if ( vblank != m_crtState.vblank )
+		scanlinesUntilChange = 1;
+
 	const cycles_t cyclesUntilVBlankChange = scanlinesUntilChange * m_crtConstants.cyclesPerScanline - m_crtState.cycleInScanline;
 	gpuCycles = std::min( gpuCycles, cyclesUntilVBlankChange );
 
@@ -1840,18 +1877,23 @@ void Gpu::Serialize( SaveStateSerializer& serializer )
 	{
 		m_renderer.Reset();
 
-		UpdateCrtDisplay();
-
 		// restore vram texture before restoring mask bits
 		m_renderer.UpdateVRam( 0, 0, VRamWidth, VRamHeight, m_vram.get() );
 
-		m_renderer.SetTextureWindow( m_textureWindowMaskX, m_textureWindowMaskY, m_textureWindowOffsetX, m_textureWindowOffsetY );
-		m_renderer.SetDrawArea( m_drawAreaLeft, m_drawAreaTop, m_drawAreaRight, m_drawAreaBottom );
-		m_renderer.SetSemiTransparencyMode( m_status.GetSemiTransparencyMode() );
-		m_renderer.SetMaskBits( m_status.setMaskOnDraw, m_status.checkMaskOnDraw );
-		m_renderer.SetColorDepth( m_status.GetDisplayAreaColorDepth() );
-		m_renderer.SetDisplayEnable( !m_status.displayDisable );
+		SyncRendererState();
 	}
 }
 
+void Gpu::SyncRendererState()
+{
+	UpdateCrtDisplay();
+
+	m_renderer.SetTextureWindow( m_textureWindowMaskX, m_textureWindowMaskY, m_textureWindowOffsetX, m_textureWindowOffsetY );
+	m_renderer.SetDrawArea( m_drawAreaLeft, m_drawAreaTop, m_drawAreaRight, m_drawAreaBottom );
+	m_renderer.SetSemiTransparencyMode( m_status.GetSemiTransparencyMode() );
+	m_renderer.SetMaskBits( m_status.setMaskOnDraw, m_status.checkMaskOnDraw );
+	m_renderer.SetColorDepth( m_status.GetDisplayAreaColorDepth() );
+	m_renderer.SetDisplayEnable( !m_status.displayDisable );
+}
+
 } // namespace PSX
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <stdx/bit.h>
 
 #include <algorithm>
+#include <chrono>
 
 #define GTE_LOG_COMMANDS true
 
@@ -26,6 +27,9 @@ inline void PushBack( Buffer& buffer, T value )
 	buffer.back() = value;
 }
 
+// reverses the order of the 3 row flags from a matrix kernel. MAC1 has the highest flag bit
+constexpr uint32_t ReverseRowFlags[ 8 ] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
 template <typename T>
 constexpr uint32_t SignExtend16( T value ) noexcept
 {
@@ -80,6 +84,15 @@ void GTE::Reset()
 	m_zScaleFactor4 = 0;
 
 	m_errorFlags = 0;
+
+	m_stats = {};
+	m_lastFrameStats = {};
+}
+
+void GTE::EndFrame() noexcept
+{
+	m_lastFrameStats = m_stats;
+	m_stats = {};
 }
 
 uint32_t GTE::Read( uint32_t index ) const noexcept
@@ -366,8 +379,27 @@ void GTE::Write( uint32_t index, uint32_t value ) noexcept
 
 cycles_t GTE::ExecuteCommand( uint32_t commandValue ) noexcept
 {
-	Command command{ commandValue };
+	const Command command{ commandValue };
+	++m_stats.commands[ command.opcode ];
+
+	cycles_t commandCycles;
+	if ( EnableHostTiming )
+	{
+		const auto start = std::chrono::steady_clock::now();
+		commandCycles = ExecuteCommandImp( command );
+		m_stats.hostNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count();
+	}
+	else
+	{
+		commandCycles = ExecuteCommandImp( command );
+	}
+
+	m_stats.commandCycles += commandCycles;
+	return commandCycles;
+}
 
+cycles_t GTE::ExecuteCommandImp( Command command ) noexcept
+{
 	m_errorFlags = 0;
 
 	const shift_t sf = command.sf ? 12 : 0;
@@ -378,14 +410,12 @@ cycles_t GTE::ExecuteCommand( uint32_t commandValue ) noexcept
 	switch ( static_cast<Opcode>( command.opcode ) )
 	{
 		case Opcode::RotateTranslatePerspectiveSingle:
-			RotateTranslatePerspectiveTransformation( m_vectors[ 0 ], sf, lm, true );
+			RotateTranslatePerspectiveTransformation( 1, sf, lm );
 			commandCycles = 15;
 			break;
 
 		case Opcode::RotateTranslatePerspectiveTriple:
-			RotateTranslatePerspectiveTransformation( m_vectors[ 0 ], sf, lm, false );
-			RotateTranslatePerspectiveTransformation( m_vectors[ 1 ], sf, lm, false );
-			RotateTranslatePerspectiveTransformation( m_vectors[ 2 ], sf, lm, true );
+			RotateTranslatePerspectiveTransformation( 3, sf, lm );
 			commandCycles = 23;
 			break;
 
@@ -473,38 +503,32 @@ cycles_t GTE::ExecuteCommand( uint32_t commandValue ) noexcept
 		}
 
 		case Opcode::NormalColorSingle:
-			NormalizeColor<false, false, false>( m_vectors[ 0 ], sf, lm );
+			NormalizeColor<false, false, false>( 1, sf, lm );
 			commandCycles = 14;
 			break;
 
 		case Opcode::NormalColorTriple:
-			NormalizeColor<false, false, false>( m_vectors[ 0 ], sf, lm );
-			NormalizeColor<false, false, false>( m_vectors[ 1 ], sf, lm );
-			NormalizeColor<false, false, false>( m_vectors[ 2 ], sf, lm );
+			NormalizeColor<false, false, false>( 3, sf, lm );
 			commandCycles = 30;
 			break;
 
 		case Opcode::NormalColorColorSingle:
-			NormalizeColor<true, false, true>( m_vectors[ 0 ], sf, lm );
+			NormalizeColor<true, false, true>( 1, sf, lm );
 			commandCycles = 17;
 			break;
 
 		case Opcode::NormalColorColorTriple:
-			NormalizeColor<true, false, true>( m_vectors[ 0 ], sf, lm );
-			NormalizeColor<true, false, true>( m_vectors[ 1 ], sf, lm );
-			NormalizeColor<true, false, true>( m_vectors[ 2 ], sf, lm );
+			NormalizeColor<true, false, true>( 3, sf, lm );
 			commandCycles = 39;
 			break;
 
 		case Opcode::NormalColorDepthCueSingle:
-			NormalizeColor<true, true, true>( m_vectors[ 0 ], sf, lm );
+			NormalizeColor<true, true, true>( 1, sf, lm );
 			commandCycles = 19;
 			break;
 
 		case Opcode::NormalColorDepthCueTriple:
-			NormalizeColor<true, true, true>( m_vectors[ 0 ], sf, lm );
-			NormalizeColor<true, true, true>( m_vectors[ 1 ], sf, lm );
-			NormalizeColor<true, true, true>( m_vectors[ 2 ], sf, lm );
+			NormalizeColor<true, true, true>( 3, sf, lm );
 			commandCycles = 44;
 			break;
 
@@ -570,7 +594,7 @@ cycles_t GTE::ExecuteCommand( uint32_t commandValue ) noexcept
 		}
 
 		default:
-			dbLogWarning( "GTE::ExecuteCommand -- invalid opcode [%X]", command.opcode );
+			dbLogWarning( "GTE::ExecuteCommandImp -- invalid opcode [%X]", command.opcode );
 			break;
 	}
 
@@ -580,6 +604,36 @@ cycles_t GTE::ExecuteCommand( uint32_t commandValue ) noexcept
 	return commandCycles;
 }
 
+const char* GTE::GetOpcodeName( uint32_t opcode ) noexcept
+{
+	switch ( static_cast<Opcode>( opcode ) )
+	{
+		case Opcode::RotateTranslatePerspectiveSingle:	return "RTPS";
+		case Opcode::RotateTranslatePerspectiveTriple:	return "RTPT";
+		case Opcode::MultiplyVectorMatrixVectorAdd:		return "MVMVA";
+		case Opcode::DepthCueColorLight:				return "DCPL";
+		case Opcode::DepthCueingSingle:					return "DPCS";
+		case Opcode::DepthCueingTriple:					return "DPCT";
+		case Opcode::InterpolateFarColor:				return "INTPL";
+		case Opcode::SquareIR:							return "SQR";
+		case Opcode::NormalColorSingle:					return "NCS";
+		case Opcode::NormalColorTriple:					return "NCT";
+		case Opcode::NormalColorDepthCueSingle:			return "NCDS";
+		case Opcode::NormalColorDepthCueTriple:			return "NCDT";
+		case Opcode::NormalColorColorSingle:			return "NCCS";
+		case Opcode::NormalColorColorTriple:			return "NCCT";
+		case Opcode::ColorDepthCue:						return "CDP";
+		case Opcode::ColorColor:						return "CC";
+		case Opcode::NormalClipping:					return "NCLIP";
+		case Opcode::Average3Z:							return "AVSZ3";
+		case Opcode::Average4Z:							return "AVSZ4";
+		case Opcode::OuterProduct:						return "OP";
+		case Opcode::GeneralInterpolation:				return "GPF";
+		case Opcode::GeneralInterpolationBase:			return "GPL";
+	}
+
+	return nullptr;
+}
 
 template <size_t Bits>
 inline void GTE::CheckOverflow( int64_t value, uint32_t overflowFlag, uint32_t underflowFlag ) noexcept
@@ -708,46 +762,39 @@ void GTE::SetOrderTableZ( int32_t z ) noexcept
 
 #define CMOAE( index, value ) CheckMacOverflowAndExtend<(index)>( (value) )
 
-void GTE::Transform( const Matrix& m, const Vector16& v, shift_t sf, bool lm ) noexcept
+void GTE::MultiplyMatrixVectors( const Matrix& m, const Vector16* vectors, const Vector32& t, int64_t* results, size_t count ) noexcept
 {
-	int64_t result[ 3 ];
+	static_assert( sizeof( Vector16 ) == 3 * sizeof( int16_t ) );
+	static_assert( ErrorFlag::MAC1Overflow == ErrorFlag::MAC3Overflow << 2 && ErrorFlag::MAC1Underflow == ErrorFlag::MAC3Underflow << 2 );
 
-#define MULT( N ) result[N] = CMOAE( N+1, CMOAE( N+1, CMOAE( N+1, int64_t( m[N][0] ) * v[0] ) + int64_t( m[N][1] ) * v[1] ) + int64_t( m[N][2] ) * v[2] )
-	MULT( 0 );
-	MULT( 1 );
-	MULT( 2 );
-#undef MULT
+	const uint32_t flags = m_multiplyMatrixVectors( m.elements.data(), &vectors->x, &t.x, results, count );
 
-	SetMACAndIR<1>( result[ 0 ], sf, lm );
-	SetMACAndIR<2>( result[ 1 ], sf, lm );
-	SetMACAndIR<3>( result[ 2 ], sf, lm );
+	m_errorFlags |= ReverseRowFlags[ ( flags >> GteKernels::OverflowShift ) & 0x7 ] * ErrorFlag::MAC3Overflow;
+	m_errorFlags |= ReverseRowFlags[ ( flags >> GteKernels::UnderflowShift ) & 0x7 ] * ErrorFlag::MAC3Underflow;
 }
 
-void GTE::Transform( const Matrix& m, const Vector16& v, const Vector32& t, shift_t sf, bool lm ) noexcept
+void GTE::SetTransformResult( const int64_t result[ 3 ], shift_t sf, bool lm ) noexcept
 {
-	int64_t result[ 3 ];
-
-#define MULT( N ) result[N] = CMOAE( N+1, CMOAE( N+1, CMOAE( N+1,( int64_t( t[N] ) << 12 ) + int64_t( m[N][0] ) * v[0] ) + int64_t( m[N][1] ) * v[1] ) + int64_t( m[N][2] ) * v[2] )
-	MULT( 0 );
-	MULT( 1 );
-	MULT( 2 );
-#undef MULT
-
 	SetMACAndIR<1>( result[ 0 ], sf, lm );
 	SetMACAndIR<2>( result[ 1 ], sf, lm );
 	SetMACAndIR<3>( result[ 2 ], sf, lm );
 }
 
-int64_t GTE::TransformRTP( const Matrix& m, const Vector16& v, const Vector32& t, shift_t sf, bool lm ) noexcept
+void GTE::Transform( const Matrix& m, const Vector16& v, shift_t sf, bool lm ) noexcept
 {
-	int64_t result[ 3 ];
+	// adding a zero translation doesn't change the flags
+	Transform( m, v, Vector32{ 0 }, sf, lm );
+}
 
-#define MULT( N ) result[N] = CMOAE( N+1, CMOAE( N+1, CMOAE( N+1,( int64_t( t[N] ) << 12 ) + int64_t( m[N][0] ) * v[0] ) + int64_t( m[N][1] ) * v[1] ) + int64_t( m[N][2] ) * v[2] )
-	MULT( 0 );
-	MULT( 1 );
-	MULT( 2 );
-#undef MULT
+void GTE::Transform( const Matrix& m, const Vector16& v, const Vector32& t, shift_t sf, bool lm ) noexcept
+{
+	int64_t result[ 3 ];
+	MultiplyMatrixVectors( m, &v, t, result, 1 );
+	SetTransformResult( result, sf, lm );
+}
 
+int64_t GTE::SetTransformResultRTP( const int64_t result[ 3 ], shift_t sf, bool lm ) noexcept
+{
 	SetMACAndIR<1>( result[ 0 ], sf, lm );
 	SetMACAndIR<2>( result[ 1 ], sf, lm );
 	SetMAC<3>( result[ 2 ], sf );
@@ -808,48 +855,70 @@ void GTE::PushColorFromMAC( bool lm ) noexcept
 	SetIR<3>( m_mac123.z, lm );
 }
 
-void GTE::RotateTranslatePerspectiveTransformation( const Vector16& vector, shift_t sf, bool lm, bool setMAC0 ) noexcept
+void GTE::RotateTranslatePerspectiveTransformation( size_t count, shift_t sf, bool lm ) noexcept
 {
 	// nocash says perspective transformation ignores lm bit, but JaCzekanski GTE tests require it 
 
-	const int64_t resultZ = TransformRTP( m_rotation, vector, m_translation, sf, lm );
+	// the rotations don't depend on each other, so they are multiplied together
+	int64_t results[ 3 * 3 ];
+	MultiplyMatrixVectors( m_rotation, m_vectors.data(), m_translation, results, count );
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const int64_t resultZ = SetTransformResultRTP( results + i * 3, sf, lm );
 
-	PushScreenZ( static_cast<int32_t>( resultZ >> 12 ) );
+		PushScreenZ( static_cast<int32_t>( resultZ >> 12 ) );
 
 #if GTE_USE_UNR_DIVISION
-	const int64_t unrResult = UNRDivide( m_projectionPlaneDistance, m_screenZFifo.back() );
+		const int64_t unrResult = UNRDivide( m_projectionPlaneDistance, m_screenZFifo.back() );
 #else
-	const int64_t unrResult = FastDivide( m_projectionPlaneDistance, m_screenZFifo.back() );
+		const int64_t unrResult = FastDivide( m_projectionPlaneDistance, m_screenZFifo.back() );
 #endif
 
-	const int32_t screenX = static_cast<int32_t>( SetMAC0( unrResult * m_ir123.x + m_screenOffset.x ) >> 16 );
-	const int32_t screenY = static_cast<int32_t>( SetMAC0( unrResult * m_ir123.y + m_screenOffset.y ) >> 16 );
-	PushScreenXY( screenX, screenY );
+		const int32_t screenX = static_cast<int32_t>( SetMAC0( unrResult * m_ir123.x + m_screenOffset.x ) >> 16 );
+		const int32_t screenY = static_cast<int32_t>( SetMAC0( unrResult * m_ir123.y + m_screenOffset.y ) >> 16 );
+		PushScreenXY( screenX, screenY );
 
-	if ( setMAC0 )
-	{
-		const int64_t mac0 = SetMAC0( unrResult * int64_t( m_depthQueueParamA ) + int64_t( m_depthQueueParamB ) );
-		SetIR0( static_cast<int32_t>( mac0 >> 12 ) );
+		if ( i == count - 1 )
+		{
+			const int64_t mac0 = SetMAC0( unrResult * int64_t( m_depthQueueParamA ) + int64_t( m_depthQueueParamB ) );
+			SetIR0( static_cast<int32_t>( mac0 >> 12 ) );
+		}
 	}
 }
 
 template <bool MultiplyColorIR, bool LerpFarColor, bool ShiftMAC>
-void GTE::NormalizeColor( const Vector16& normal, shift_t sf, bool lm ) noexcept
+void GTE::NormalizeColor( size_t count, shift_t sf, bool lm ) noexcept
 {
-	Transform( m_lightMatrix, normal, sf, lm );
+	// each vector only depends on its own results, so each matrix is multiplied with all vectors together.
+	// MAC and IR end up the same since the last vector is finished last
+	int64_t results[ 3 * 3 ];
+	MultiplyMatrixVectors( m_lightMatrix, m_vectors.data(), Vector32{ 0 }, results, count );
 
-	Transform( m_colorMatrix, m_ir123, m_backgroundColor, sf, lm );
+	std::array<Vector16, 3> lights;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		SetTransformResult( results + i * 3, sf, lm );
+		lights[ i ] = m_ir123;
+	}
 
-	if constexpr ( MultiplyColorIR )
-		MultiplyColorWithIR( m_color );
+	MultiplyMatrixVectors( m_colorMatrix, lights.data(), m_backgroundColor, results, count );
 
-	if constexpr ( LerpFarColor )
-		LerpFarColorWithMAC( sf );
+	for ( size_t i = 0; i < count; ++i )
+	{
+		SetTransformResult( results + i * 3, sf, lm );
 
-	if constexpr ( ShiftMAC )
-		ShiftMACRight( sf );
+		if constexpr ( MultiplyColorIR )
+			MultiplyColorWithIR( m_color );
 
-	PushColorFromMAC( lm );
+		if constexpr ( LerpFarColor )
+			LerpFarColorWithMAC( sf );
+
+		if constexpr ( ShiftMAC )
+			ShiftMACRight( sf );
+
+		PushColorFromMAC( lm );
+	}
 }
 
 
@@ -0,0 +1,191 @@
+#include "GpuCapture.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <cstring>
+
+namespace PSX
+{
+
+namespace
+{
+
+constexpr size_t RecordAlignment = 4;
+
+constexpr size_t AlignPayloadSize( size_t size ) noexcept
+{
+	return ( size + RecordAlignment - 1 ) & ~( RecordAlignment - 1 );
+}
+
+}
+
+GpuCaptureRenderer::GpuCaptureRenderer( std::unique_ptr<Renderer> renderer ) : m_renderer{ std::move( renderer ) }
+{
+	dbExpects( m_renderer );
+}
+
+GpuCaptureRenderer::~GpuCaptureRenderer()
+{
+	StopCapture();
+}
+
+bool GpuCaptureRenderer::StartCapture( const fs::path& filename, uint32_t frameCount )
+{
+	dbExpects( frameCount > 0 );
+	StopCapture();
+
+	m_file.open( filename, std::ios::binary );
+	if ( !m_file.is_open() )
+	{
+		LogError( "GpuCaptureRenderer::StartCapture -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	m_header = GpuCaptureHeader{};
+	m_framesRemaining = frameCount;
+	m_file.write( reinterpret_cast<const char*>( &m_header ), sizeof( m_header ) );
+
+	// the renderer already has this state, so it is only recorded
+	auto vram = std::make_unique<uint16_t[]>( VRamWidth * VRamHeight );
+	m_renderer->ReadVRam( 0, 0, VRamWidth, VRamHeight, vram.get() );
+
+	m_recordOnly = true;
+	Reset();
+	UpdateVRam( 0, 0, VRamWidth, VRamHeight, vram.get() );
+	SetRealColor( m_renderer->GetRealColor() );
+	m_recordOnly = false;
+
+	Log( "Started GPU capture of %u frames to %s", frameCount, filename.string().c_str() );
+	return true;
+}
+
+void GpuCaptureRenderer::StopCapture()
+{
+	if ( !m_file.is_open() )
+		return;
+
+	m_file.seekp( 0 );
+	m_file.write( reinterpret_cast<const char*>( &m_header ), sizeof( m_header ) );
+	m_file.close();
+
+	Log( "Finished GPU capture with %u frames and %u commands", m_header.frameCount, m_header.commandCount );
+}
+
+void GpuCaptureRenderer::DisplayFrame()
+{
+	m_renderer->DisplayFrame();
+
+	if ( m_file.is_open() )
+	{
+		WriteRecord( RenderCommand::DisplayFrame, nullptr, 0 );
+		++m_header.frameCount;
+
+		if ( --m_framesRemaining == 0 )
+			StopCapture();
+	}
+}
+
+void* GpuCaptureRenderer::BeginCommand( RenderCommand command, size_t payloadSize )
+{
+	m_command = command;
+	m_payload.resize( payloadSize );
+	return m_payload.data();
+}
+
+void GpuCaptureRenderer::EndCommand()
+{
+	if ( !m_recordOnly )
+		ExecuteRenderCommand( *m_renderer, m_command, m_payload.data() );
+
+	if ( m_file.is_open() )
+		WriteRecord( m_command, m_payload.data(), m_payload.size() );
+}
+
+void GpuCaptureRenderer::WriteRecord( RenderCommand command, const void* payload, size_t payloadSize )
+{
+	const GpuCaptureRecord record{ command, 0, static_cast<uint32_t>( payloadSize ) };
+	m_file.write( reinterpret_cast<const char*>( &record ), sizeof( record ) );
+	m_file.write( static_cast<const char*>( payload ), payloadSize );
+
+	static constexpr char Padding[ RecordAlignment ] = {};
+	m_file.write( Padding, AlignPayloadSize( payloadSize ) - payloadSize );
+
+	++m_header.commandCount;
+}
+
+bool GpuCaptureReader::Load( const fs::path& filename )
+{
+	const auto filenameStr = filename.string();
+
+	std::ifstream fin( filename, std::ios::binary );
+	if ( !fin.is_open() )
+	{
+		LogError( "GpuCaptureReader::Load -- cannot open %s", filenameStr.c_str() );
+		return false;
+	}
+
+	fin.seekg( 0, std::ios::end );
+	const auto fileSize = static_cast<size_t>( fin.tellg() );
+	fin.seekg( 0, std::ios::beg );
+
+	if ( fileSize < sizeof( GpuCaptureHeader ) )
+	{
+		LogError( "GpuCaptureReader::Load -- %s is too small", filenameStr.c_str() );
+		return false;
+	}
+
+	fin.read( reinterpret_cast<char*>( &m_header ), sizeof( m_header ) );
+	if ( m_header.magic != GpuCaptureHeader::Magic || m_header.version != GpuCaptureHeader::CurrentVersion )
+	{
+		LogError( "GpuCaptureReader::Load -- %s is not a version %u GPU capture", filenameStr.c_str(), GpuCaptureHeader::CurrentVersion );
+		return false;
+	}
+
+	m_data.resize( fileSize - sizeof( GpuCaptureHeader ) );
+	fin.read( m_data.data(), m_data.size() );
+	m_position = 0;
+
+	// validate once so replay doesn't have to
+	uint32_t commandCount = 0;
+	for ( size_t position = 0; position < m_data.size(); ++commandCount )
+	{
+		GpuCaptureRecord record;
+		if ( m_data.size() - position < sizeof( record ) )
+			break;
+
+		std::memcpy( &record, m_data.data() + position, sizeof( record ) );
+		position += sizeof( record );
+
+		const void* payload = m_data.data() + position;
+		if ( m_data.size() - position < record.payloadSize || !IsValidRenderCommand( record.command, payload, record.payloadSize ) )
+		{
+			LogError( "GpuCaptureReader::Load -- invalid command %u in %s", commandCount, filenameStr.c_str() );
+			m_data.clear();
+			return false;
+		}
+
+		position += AlignPayloadSize( record.payloadSize );
+	}
+
+	if ( commandCount != m_header.commandCount )
+		LogWarning( "GpuCaptureReader::Load -- %s has %u of %u commands", filenameStr.c_str(), commandCount, m_header.commandCount );
+
+	return true;
+}
+
+bool GpuCaptureReader::Next( RenderCommand& command, const void*& payload ) noexcept
+{
+	if ( m_position >= m_data.size() || m_data.size() - m_position < sizeof( GpuCaptureRecord ) )
+		return false;
+
+	GpuCaptureRecord record;
+	std::memcpy( &record, m_data.data() + m_position, sizeof( record ) );
+
+	command = record.command;
+	payload = m_data.data() + m_position + sizeof( record );
+	m_position += sizeof( record ) + AlignPayloadSize( record.payloadSize );
+	return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "GteKernels.h"
+
+#include "Defs.h"
+
+#include <stdx/assert.h>
+#include <stdx/compiler.h>
+
+#include <algorithm>
+
+#ifdef PSX_GTE_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined( PSX_GTE_SIMD ) && !defined( _MSC_VER )
+#define GTE_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#else
+#define GTE_TARGET( isa )
+#endif
+
+namespace PSX::GteKernels
+{
+
+namespace
+{
+
+constexpr int64_t MacMin = -( int64_t( 1 ) << 43 );
+constexpr int64_t MacMax = ( int64_t( 1 ) << 43 ) - 1;
+
+inline int64_t AddAndExtend( int64_t sum, int64_t product, uint32_t row, uint32_t& flags ) noexcept
+{
+	sum += product;
+
+	if ( STDX_unlikely( sum > MacMax ) )
+		flags |= 1u << ( OverflowShift + row );
+
+	if ( STDX_unlikely( sum < MacMin ) )
+		flags |= 1u << ( UnderflowShift + row );
+
+	return SignExtend<44, int64_t>( sum );
+}
+
+uint32_t MultiplyMatrixVectorsScalar( const int16_t* matrix, const int16_t* vectors, const int32_t* translation, int64_t* results, size_t count ) noexcept
+{
+	uint32_t flags = 0;
+	for ( size_t v = 0; v < count; ++v )
+	{
+		const int16_t* vector = vectors + v * 3;
+		for ( uint32_t row = 0; row < 3; ++row )
+		{
+			const int16_t* m = matrix + row * 3;
+			int64_t sum = AddAndExtend( int64_t( translation[ row ] ) << 12, int64_t( m[ 0 ] ) * vector[ 0 ], row, flags );
+			sum = AddAndExtend( sum, int64_t( m[ 1 ] ) * vector[ 1 ], row, flags );
+			results[ v * 3 + row ] = AddAndExtend( sum, int64_t( m[ 2 ] ) * vector[ 2 ], row, flags );
+		}
+	}
+	return flags;
+}
+
+#ifdef PSX_GTE_SIMD
+
+// the SIMD kernels keep exact 64 bit partial sums. While every partial sum fits in 44 bits, sign extension changes nothing and no flags are set.
+// Otherwise the whole batch is recomputed by the scalar kernel for the exact wrapping and flags. Games rarely overflow the accumulators.
+// A partial sum fits if adding 2^43 leaves the bits above 44 clear
+
+constexpr int64_t RangeBias = int64_t( 1 ) << 43;
+constexpr int64_t OutOfRangeMask = ~( ( int64_t( 1 ) << 44 ) - 1 );
+
+// gathers the first two matrix columns from the first 8 elements. Each column is padded to 4 words with 0
+GTE_TARGET( "sse4.1" ) inline __m128i ShuffleColumns01( __m128i rows ) noexcept
+{
+	return _mm_shuffle_epi8( rows, _mm_setr_epi8( 0, 1, 6, 7, 12, 13, -1, -1, 2, 3, 8, 9, 14, 15, -1, -1 ) );
+}
+
+GTE_TARGET( "sse4.1" ) inline __m128i ShuffleColumn2( __m128i rows, int16_t m22 ) noexcept
+{
+	return _mm_insert_epi16( _mm_shuffle_epi8( rows, _mm_setr_epi8( 4, 5, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 ) ), m22, 2 );
+}
+
+GTE_TARGET( "sse4.1" ) inline __m128i LoadTranslation( const int32_t* translation ) noexcept
+{
+	return _mm_insert_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( translation ) ), translation[ 2 ], 2 );
+}
+
+// rows 0 and 1 share a register, row 2 uses the low lane of another
+GTE_TARGET( "sse4.1" ) uint32_t MultiplyMatrixVectorsSse41( const int16_t* matrix, const int16_t* vectors, const int32_t* translation, int64_t* results, size_t count ) noexcept
+{
+	// the matrix is 9 elements, so loading the first 8 stays in bounds
+	const __m128i rows = _mm_loadu_si128( reinterpret_cast<const __m128i*>( matrix ) );
+	const __m128i columns01 = ShuffleColumns01( rows );
+	const __m128i column2 = ShuffleColumn2( rows, matrix[ 8 ] );
+
+	const __m128i m0Rows01 = _mm_cvtepi16_epi64( columns01 );
+	const __m128i m0Row2 = _mm_cvtepi16_epi64( _mm_srli_si128( columns01, 4 ) );
+	const __m128i m1Rows01 = _mm_cvtepi16_epi64( _mm_srli_si128( columns01, 8 ) );
+	const __m128i m1Row2 = _mm_cvtepi16_epi64( _mm_srli_si128( columns01, 12 ) );
+	const __m128i m2Rows01 = _mm_cvtepi16_epi64( column2 );
+	const __m128i m2Row2 = _mm_cvtepi16_epi64( _mm_srli_si128( column2, 4 ) );
+
+	const __m128i translationWords = LoadTranslation( translation );
+	const __m128i translationRows01 = _mm_slli_epi64( _mm_cvtepi32_epi64( translationWords ), 12 );
+	const __m128i translationRow2 = _mm_slli_epi64( _mm_cvtepi32_epi64( _mm_srli_si128( translationWords, 8 ) ), 12 );
+
+	const __m128i bias = _mm_set1_epi64x( RangeBias );
+	__m128i biasedSums = _mm_setzero_si128();
+
+	for ( size_t v = 0; v < count; ++v )
+	{
+		const int16_t* vector = vectors + v * 3;
+		const __m128i v0 = _mm_set1_epi32( vector[ 0 ] );
+		const __m128i v1 = _mm_set1_epi32( vector[ 1 ] );
+		const __m128i v2 = _mm_set1_epi32( vector[ 2 ] );
+
+		const __m128i sum0Rows01 = _mm_add_epi64( translationRows01, _mm_mul_epi32( m0Rows01, v0 ) );
+		const __m128i sum1Rows01 = _mm_add_epi64( sum0Rows01, _mm_mul_epi32( m1Rows01, v1 ) );
+		const __m128i sum2Rows01 = _mm_add_epi64( sum1Rows01, _mm_mul_epi32( m2Rows01, v2 ) );
+
+		const __m128i sum0Row2 = _mm_add_epi64( translationRow2, _mm_mul_epi32( m0Row2, v0 ) );
+		const __m128i sum1Row2 = _mm_add_epi64( sum0Row2, _mm_mul_epi32( m1Row2, v1 ) );
+		const __m128i sum2Row2 = _mm_add_epi64( sum1Row2, _mm_mul_epi32( m2Row2, v2 ) );
+
+		biasedSums = _mm_or_si128( biasedSums, _mm_or_si128(
+			_mm_or_si128( _mm_add_epi64( sum0Rows01, bias ), _mm_add_epi64( sum1Rows01, bias ) ),
+			_mm_or_si128( _mm_add_epi64( sum2Rows01, bias ), _mm_add_epi64( sum0Row2, bias ) ) ) );
+		biasedSums = _mm_or_si128( biasedSums, _mm_or_si128( _mm_add_epi64( sum1Row2, bias ), _mm_add_epi64( sum2Row2, bias ) ) );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( results + v * 3 ), sum2Rows01 );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( results + v * 3 + 2 ), sum2Row2 );
+	}
+
+	if ( STDX_unlikely( !_mm_testz_si128( biasedSums, _mm_set1_epi64x( OutOfRangeMask ) ) ) )
+		return MultiplyMatrixVectorsScalar( matrix, vectors, translation, results, count );
+
+	return 0;
+}
+
+// one row per lane. The fourth lane stays 0
+GTE_TARGET( "avx2" ) uint32_t MultiplyMatrixVectorsAvx2( const int16_t* matrix, const int16_t* vectors, const int32_t* translation, int64_t* results, size_t count ) noexcept
+{
+	const __m128i rows = _mm_loadu_si128( reinterpret_cast<const __m128i*>( matrix ) );
+	const __m128i columns01 = ShuffleColumns01( rows );
+
+	const __m256i m0 = _mm256_cvtepi16_epi64( columns01 );
+	const __m256i m1 = _mm256_cvtepi16_epi64( _mm_srli_si128( columns01, 8 ) );
+	const __m256i m2 = _mm256_cvtepi16_epi64( ShuffleColumn2( rows, matrix[ 8 ] ) );
+	const __m256i translationRows = _mm256_slli_epi64( _mm256_cvtepi32_epi64( LoadTranslation( translation ) ), 12 );
+
+	const __m256i bias = _mm256_set1_epi64x( RangeBias );
+	__m256i biasedSums = _mm256_setzero_si256();
+
+	for ( size_t v = 0; v < count; ++v )
+	{
+		const int16_t* vector = vectors + v * 3;
+		const __m256i sum0 = _mm256_add_epi64( translationRows, _mm256_mul_epi32( m0, _mm256_set1_epi32( vector[ 0 ] ) ) );
+		const __m256i sum1 = _mm256_add_epi64( sum0, _mm256_mul_epi32( m1, _mm256_set1_epi32( vector[ 1 ] ) ) );
+		const __m256i sum2 = _mm256_add_epi64( sum1, _mm256_mul_epi32( m2, _mm256_set1_epi32( vector[ 2 ] ) ) );
+
+		biasedSums = _mm256_or_si256( biasedSums, _mm256_or_si256( _mm256_add_epi64( sum0, bias ), _mm256_or_si256( _mm256_add_epi64( sum1, bias ), _mm256_add_epi64( sum2, bias ) ) ) );
+
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( results + v * 3 ), _mm256_castsi256_si128( sum2 ) );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( results + v * 3 + 2 ), _mm256_extracti128_si256( sum2, 1 ) );
+	}
+
+	if ( STDX_unlikely( !_mm256_testz_si256( biasedSums, _mm256_set1_epi64x( OutOfRangeMask ) ) ) )
+		return MultiplyMatrixVectorsScalar( matrix, vectors, translation, results, count );
+
+	return 0;
+}
+
+void CpuId( int leaf, int subleaf, int registers[ 4 ] ) noexcept
+{
+#ifdef _MSC_VER
+	__cpuidex( registers, leaf, subleaf );
+#else
+	__cpuid_count( leaf, subleaf, registers[ 0 ], registers[ 1 ], registers[ 2 ], registers[ 3 ] );
+#endif
+}
+
+// AVX state has to be enabled by the OS
+bool OsSavesAvxState() noexcept
+{
+#ifdef _MSC_VER
+	return ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+#else
+	uint32_t eax, edx;
+	__asm__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+	return ( eax & 0x6 ) == 0x6;
+#endif
+}
+
+InstructionSet DetectInstructionSet() noexcept
+{
+	int registers[ 4 ];
+	CpuId( 0, 0, registers );
+	const int maxLeaf = registers[ 0 ];
+
+	CpuId( 1, 0, registers );
+	const bool sse41 = registers[ 2 ] & ( 1 << 19 );
+	const bool osxsave = registers[ 2 ] & ( 1 << 27 );
+	const bool avx = registers[ 2 ] & ( 1 << 28 );
+
+	bool avx2 = false;
+	if ( maxLeaf >= 7 && osxsave && avx && OsSavesAvxState() )
+	{
+		CpuId( 7, 0, registers );
+		avx2 = registers[ 1 ] & ( 1 << 5 );
+	}
+
+	if ( avx2 && sse41 )
+		return InstructionSet::Avx2;
+
+	return sse41 ? InstructionSet::Sse41 : InstructionSet::Scalar;
+}
+
+#else
+
+InstructionSet DetectInstructionSet() noexcept
+{
+	return InstructionSet::Scalar;
+}
+
+#endif
+
+} // namespace
+
+InstructionSet GetHostInstructionSet() noexcept
+{
+	static const InstructionSet hostInstructionSet = DetectInstructionSet();
+	return hostInstructionSet;
+}
+
+MultiplyMatrixVectorsFunction GetMultiplyMatrixVectors( InstructionSet instructionSet ) noexcept
+{
+	switch ( std::min( instructionSet, GetHostInstructionSet() ) )
+	{
+#ifdef PSX_GTE_SIMD
+		case InstructionSet::Avx2:
+			return &MultiplyMatrixVectorsAvx2;
+
+		case InstructionSet::Sse41:
+			return &MultiplyMatrixVectorsSse41;
+#endif
+
+		default:
+			return &MultiplyMatrixVectorsScalar;
+	}
+}
+
+const char* GetInstructionSetName( InstructionSet instructionSet ) noexcept
+{
+	switch ( instructionSet )
+	{
+		case InstructionSet::Scalar:	return "Scalar";
+		case InstructionSet::Sse41:		return "SSE4.1";
+		case InstructionSet::Avx2:		return "AVX2";
+	}
+
+	dbBreak();
+	return "Unknown";
+}
+
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "InterruptControl.h"
 
+#include "EventManager.h"
 #include "SaveState.h"
 
 namespace PSX
@@ -33,12 +34,23 @@ void InterruptControl::Write( uint32_t index, uint32_t value ) noexcept
 			break;
 
 		case 1:
+		{
 			dbLogDebug( "InterruptControl::Write -- interrupt mask [%X]", value );
+			const bool wasPending = PendingInterrupt();
 			m_mask = value & WriteMask;
+
+			if ( !wasPending && PendingInterrupt() )
+				OnInterruptPending();
 			break;
+		}
 	}
 }
 
+void InterruptControl::OnInterruptPending() noexcept
+{
+	m_eventManager.StopRun();
+}
+
 void InterruptControl::Serialize( SaveStateSerializer& serializer )
 {
 	if ( !serializer.Header( "InterruptControl", 1 ) )
@@ -0,0 +1,295 @@
+#include "Iso9660.h"
+
+#include "CDRom.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+#include <stdx/string.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace PSX
+{
+
+namespace
+{
+
+constexpr uint32_t SectorSize = CDRom::DataBytesPerSector;
+
+constexpr uint32_t PrimaryVolumeDescriptorSector = 16;
+constexpr std::string_view StandardId = "CD001";
+
+constexpr uint32_t RootDirectoryRecordOffset = 156;
+
+// directory record field offsets
+constexpr uint32_t RecordExtentOffset = 2;
+constexpr uint32_t RecordSizeOffset = 10;
+constexpr uint32_t RecordFlagsOffset = 25;
+constexpr uint32_t RecordNameLengthOffset = 32;
+constexpr uint32_t RecordNameOffset = 33;
+
+constexpr uint8_t DirectoryFlag = 0x02;
+
+// guards against reading the whole disc through a corrupt record
+constexpr uint32_t MaxFileSize = 16 * 1024 * 1024;
+
+struct DirectoryRecord
+{
+	uint32_t extent = 0;
+	uint32_t size = 0;
+	bool directory = false;
+};
+
+uint32_t ReadUInt32( const uint8_t* data ) noexcept
+{
+	// both-endian fields. Use the little endian half
+	return data[ 0 ] | ( data[ 1 ] << 8 ) | ( data[ 2 ] << 16 ) | ( static_cast<uint32_t>( data[ 3 ] ) << 24 );
+}
+
+DirectoryRecord ReadDirectoryRecord( const uint8_t* data ) noexcept
+{
+	DirectoryRecord record;
+	record.extent = ReadUInt32( data + RecordExtentOffset );
+	record.size = ReadUInt32( data + RecordSizeOffset );
+	record.directory = ( data[ RecordFlagsOffset ] & DirectoryFlag ) != 0;
+	return record;
+}
+
+// strip the ";1" version and the trailing '.' of names without an extension
+std::string_view GetBaseName( std::string_view name ) noexcept
+{
+	const auto versionPos = name.find( ';' );
+	if ( versionPos != std::string_view::npos )
+		name = name.substr( 0, versionPos );
+
+	if ( !name.empty() && name.back() == '.' )
+		name.remove_suffix( 1 );
+
+	return name;
+}
+
+bool IsPathSeparator( char c ) noexcept
+{
+	return c == '\\' || c == '/';
+}
+
+bool IsSpace( char c ) noexcept
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+class IsoReader
+{
+public:
+	explicit IsoReader( CDRom& cdrom ) : m_cdrom{ cdrom }, m_savedPosition{ cdrom.GetCurrentSeekSector() } {}
+
+	~IsoReader()
+	{
+		m_cdrom.Seek( m_savedPosition );
+	}
+
+	IsoReader( const IsoReader& ) = delete;
+	IsoReader& operator=( const IsoReader& ) = delete;
+
+	std::optional<DirectoryRecord> FindFile( std::string_view path );
+
+	std::optional<std::vector<uint8_t>> ReadFile( const DirectoryRecord& record );
+
+private:
+	// user data of the sector at the logical block address. Valid until the next read
+	const uint8_t* ReadSector( uint32_t lba );
+
+	std::optional<DirectoryRecord> FindInDirectory( const DirectoryRecord& directory, std::string_view name );
+
+private:
+	CDRom& m_cdrom;
+	CDRom::LogicalSector m_savedPosition;
+	CDRom::Sector m_sector;
+};
+
+const uint8_t* IsoReader::ReadSector( uint32_t lba )
+{
+	// logical block 0 starts after the pregap of the first track
+	if ( !m_cdrom.Seek( lba + CDRom::PregapLength ) || !m_cdrom.ReadSector( m_sector ) )
+		return nullptr;
+
+	switch ( m_sector.header.mode )
+	{
+		case 1:		return m_sector.mode1.data.data();
+		case 2:		return m_sector.mode2.form1.data.data();
+
+		default:
+			dbLogWarning( "IsoReader::ReadSector -- sector %u is not a data sector [%u]", lba, m_sector.header.mode );
+			return nullptr;
+	}
+}
+
+std::optional<DirectoryRecord> IsoReader::FindFile( std::string_view path )
+{
+	const uint8_t* descriptor = ReadSector( PrimaryVolumeDescriptorSector );
+	if ( !descriptor || descriptor[ 0 ] != 1 || std::memcmp( descriptor + 1, StandardId.data(), StandardId.size() ) != 0 )
+	{
+		LogWarning( "IsoReader::FindFile -- disc has no ISO9660 primary volume descriptor" );
+		return std::nullopt;
+	}
+
+	DirectoryRecord record = ReadDirectoryRecord( descriptor + RootDirectoryRecordOffset );
+
+	while ( !path.empty() )
+	{
+		const auto separator = std::find_if( path.begin(), path.end(), IsPathSeparator );
+		const auto nameLength = static_cast<size_t>( separator - path.begin() );
+		const auto name = path.substr( 0, nameLength );
+		path.remove_prefix( std::min( nameLength + 1, path.size() ) );
+
+		if ( name.empty() )
+			continue;
+
+		if ( !record.directory )
+			return std::nullopt;
+
+		auto child = FindInDirectory( record, GetBaseName( name ) );
+		if ( !child )
+			return std::nullopt;
+
+		record = *child;
+	}
+
+	return record;
+}
+
+std::optional<DirectoryRecord> IsoReader::FindInDirectory( const DirectoryRecord& directory, std::string_view name )
+{
+	const uint32_t sectorCount = ( directory.size + SectorSize - 1 ) / SectorSize;
+	for ( uint32_t i = 0; i < sectorCount; ++i )
+	{
+		const uint8_t* data = ReadSector( directory.extent + i );
+		if ( !data )
+			return std::nullopt;
+
+		// records don't cross sector boundaries. A zero length pads to the next sector
+		uint32_t offset = 0;
+		while ( offset < SectorSize && data[ offset ] != 0 )
+		{
+			const uint32_t recordLength = data[ offset ];
+			if ( recordLength < RecordNameOffset || offset + recordLength > SectorSize || RecordNameOffset + data[ offset + RecordNameLengthOffset ] > recordLength )
+			{
+				LogWarning( "IsoReader::FindInDirectory -- invalid directory record in sector %u", directory.extent + i );
+				return std::nullopt;
+			}
+
+			const std::string_view recordName( reinterpret_cast<const char*>( data + offset + RecordNameOffset ), data[ offset + RecordNameLengthOffset ] );
+			if ( stdx::iequals( GetBaseName( recordName ), name ) )
+				return ReadDirectoryRecord( data + offset );
+
+			offset += recordLength;
+		}
+	}
+
+	return std::nullopt;
+}
+
+std::optional<std::vector<uint8_t>> IsoReader::ReadFile( const DirectoryRecord& record )
+{
+	if ( record.directory || record.size > MaxFileSize )
+		return std::nullopt;
+
+	std::vector<uint8_t> file( record.size );
+
+	for ( uint32_t offset = 0; offset < record.size; offset += SectorSize )
+	{
+		const uint8_t* data = ReadSector( record.extent + offset / SectorSize );
+		if ( !data )
+			return std::nullopt;
+
+		std::copy_n( data, std::min( SectorSize, record.size - offset ), file.data() + offset );
+	}
+
+	return file;
+}
+
+// value of BOOT in SYSTEM.CNF with the device prefix removed
+std::optional<std::string> ParseBootPath( std::string_view config )
+{
+	while ( !config.empty() )
+	{
+		const auto lineEnd = config.find( '\n' );
+		auto line = config.substr( 0, lineEnd );
+		config.remove_prefix( lineEnd == std::string_view::npos ? config.size() : lineEnd + 1 );
+
+		while ( !line.empty() && IsSpace( line.front() ) )
+			line.remove_prefix( 1 );
+
+		constexpr std::string_view BootKey = "BOOT";
+		if ( line.size() < BootKey.size() || !stdx::iequals( line.substr( 0, BootKey.size() ), BootKey ) )
+			continue;
+
+		line.remove_prefix( BootKey.size() );
+		while ( !line.empty() && IsSpace( line.front() ) )
+			line.remove_prefix( 1 );
+
+		if ( line.empty() || line.front() != '=' )
+			continue;
+
+		line.remove_prefix( 1 );
+		while ( !line.empty() && IsSpace( line.front() ) )
+			line.remove_prefix( 1 );
+
+		// arguments can follow the path
+		line = line.substr( 0, static_cast<size_t>( std::find_if( line.begin(), line.end(), IsSpace ) - line.begin() ) );
+
+		// "cdrom:\PATH;1" or "cdrom0:\PATH;1"
+		const auto devicePos = line.find( ':' );
+		if ( devicePos != std::string_view::npos )
+			line.remove_prefix( devicePos + 1 );
+
+		if ( !line.empty() )
+			return std::string( line );
+	}
+
+	return std::nullopt;
+}
+
+}
+
+std::optional<std::vector<uint8_t>> ReadIsoFile( CDRom& cdrom, std::string_view path )
+{
+	IsoReader reader( cdrom );
+
+	auto record = reader.FindFile( path );
+	if ( !record )
+		return std::nullopt;
+
+	return reader.ReadFile( *record );
+}
+
+std::optional<std::vector<uint8_t>> ReadBootExecutable( CDRom& cdrom )
+{
+	std::string bootPath = "PSX.EXE";
+
+	if ( auto config = ReadIsoFile( cdrom, "SYSTEM.CNF" ) )
+	{
+		auto path = ParseBootPath( std::string_view( reinterpret_cast<const char*>( config->data() ), config->size() ) );
+		if ( !path )
+		{
+			LogWarning( "ReadBootExecutable -- SYSTEM.CNF has no BOOT entry" );
+			return std::nullopt;
+		}
+
+		bootPath = std::move( *path );
+	}
+
+	auto exe = ReadIsoFile( cdrom, bootPath );
+	if ( !exe )
+	{
+		LogWarning( "ReadBootExecutable -- cannot read %s", bootPath.c_str() );
+		return std::nullopt;
+	}
+
+	Log( "ReadBootExecutable -- %s", bootPath.c_str() );
+	return exe;
+}
+
+}
\ No newline at end of file
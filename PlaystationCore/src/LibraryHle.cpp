@@ -0,0 +1,335 @@
+#include "LibraryHle.h"
+
+#include "MemoryMap.h"
+#include "RAM.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+namespace PSX
+{
+
+namespace
+{
+
+std::string_view ReadToken( std::string_view& line )
+{
+	size_t start = 0;
+	while ( start < line.size() && std::isspace( static_cast<unsigned char>( line[ start ] ) ) )
+		++start;
+
+	size_t end = start;
+	while ( end < line.size() && !std::isspace( static_cast<unsigned char>( line[ end ] ) ) )
+		++end;
+
+	const auto token = line.substr( start, end - start );
+	line.remove_prefix( end );
+	return token;
+}
+
+struct Replacement
+{
+	const char* name;
+	BiosHle::Function function;
+	uint32_t call; // kernel call number. rand and srand share a function
+};
+
+const Replacement Replacements[]
+{
+	{ "memcpy", BiosHle::Function::Memcpy, 0x2a },
+	{ "memset", BiosHle::Function::Memset, 0x2b },
+	{ "bzero", BiosHle::Function::Bzero, 0x28 },
+	{ "strcmp", BiosHle::Function::Strcmp, 0x17 },
+	{ "strlen", BiosHle::Function::Strlen, 0x1b },
+	{ "strcpy", BiosHle::Function::Strcpy, 0x19 },
+	{ "rand", BiosHle::Function::Rand, 0x2f },
+	{ "srand", BiosHle::Function::Rand, 0x30 },
+};
+
+const Replacement* FindReplacement( std::string_view name )
+{
+	for ( const auto& replacement : Replacements )
+	{
+		if ( name == replacement.name )
+			return &replacement;
+	}
+
+	return nullptr;
+}
+
+const char* GetReplacementName( BiosHle::Function function, uint32_t call )
+{
+	for ( const auto& replacement : Replacements )
+	{
+		if ( replacement.function == function && replacement.call == call )
+			return replacement.name;
+	}
+
+	return BiosHle::GetFunctionName( function );
+}
+
+constexpr uint32_t LuiOpcode = 0x0f;
+constexpr uint32_t AddiuOpcode = 0x09;
+
+// the opcode and registers of an instruction, without its immediate
+constexpr uint32_t OpcodeAndRegistersMask = 0xffff0000;
+
+constexpr uint32_t GetOpcode( uint32_t word ) noexcept
+{
+	return word >> 26;
+}
+
+// lb through swr
+constexpr bool IsLoadOrStore( uint32_t word ) noexcept
+{
+	return GetOpcode( word ) >= 0x20 && GetOpcode( word ) <= 0x2e;
+}
+
+// a first word that is a lui with a relocated immediate is looked up by its opcode and register
+constexpr bool IsRelocatedKey( uint32_t word, uint32_t mask ) noexcept
+{
+	return mask == OpcodeAndRegistersMask && GetOpcode( word ) == LuiOpcode;
+}
+
+}
+
+LibraryHle::LibraryHle( MemoryMap& memoryMap, BiosHle& biosHle )
+	: m_memoryMap{ memoryMap }
+	, m_biosHle{ biosHle }
+{}
+
+void LibraryHle::Reset()
+{
+	m_foundFunctions.clear();
+}
+
+bool LibraryHle::LoadSignatures( const fs::path& filename )
+{
+	std::ifstream fin( filename );
+	if ( !fin.is_open() )
+	{
+		LogError( "LibraryHle::LoadSignatures -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	std::string line;
+	for ( size_t lineNumber = 1; std::getline( fin, line ); ++lineNumber )
+	{
+		std::string_view text = line;
+		text = text.substr( 0, text.find( '#' ) );
+
+		std::string_view rest = text;
+		if ( ReadToken( rest ).empty() )
+			continue;
+
+		Signature signature;
+		if ( !ParseSignature( text, signature ) )
+		{
+			LogError( "LibraryHle::LoadSignatures -- invalid signature at %s:%zu", filename.string().c_str(), lineNumber );
+			return false;
+		}
+
+		const auto index = static_cast<uint32_t>( m_signatures.size() );
+		m_signaturesByFirstWord.emplace( signature.words.front(), index );
+		m_signatures.push_back( std::move( signature ) );
+	}
+
+	Log( "Loaded %zu library signatures", m_signatures.size() );
+	return true;
+}
+
+bool LibraryHle::ParseSignature( std::string_view line, Signature& signature ) const
+{
+	const auto name = ReadToken( line );
+	const auto replacement = FindReplacement( ReadToken( line ) );
+	if ( name.empty() || !replacement )
+		return false;
+
+	signature.name = name;
+	signature.function = replacement->function;
+	signature.call = replacement->call;
+
+	for ( auto token = ReadToken( line ); !token.empty(); token = ReadToken( line ) )
+	{
+		if ( token.size() != 8 || signature.words.size() == MaxSignatureWords )
+			return false;
+
+		uint32_t word = 0;
+		uint32_t mask = 0;
+		for ( const char c : token )
+		{
+			word <<= 4;
+			mask <<= 4;
+
+			if ( c == '.' )
+				continue;
+
+			if ( !std::isxdigit( static_cast<unsigned char>( c ) ) )
+				return false;
+
+			word |= static_cast<uint32_t>( std::isdigit( static_cast<unsigned char>( c ) ) ? ( c - '0' ) : ( std::tolower( c ) - 'a' + 10 ) );
+			mask |= 0xf;
+		}
+
+		signature.words.push_back( word );
+		signature.masks.push_back( mask );
+	}
+
+	// the first word is the lookup key
+	if ( signature.words.empty() || ( signature.masks.front() != 0xffffffff && !IsRelocatedKey( signature.words.front(), signature.masks.front() ) ) )
+		return false;
+
+	return signature.function != BiosHle::Function::Rand || FindSeedRelocation( signature );
+}
+
+bool LibraryHle::FindSeedRelocation( Signature& signature ) noexcept
+{
+	// the seed is addressed by a relocated lui and the first load, store or addiu based on its register
+	for ( uint32_t high = 0; high < signature.words.size(); ++high )
+	{
+		if ( signature.masks[ high ] != OpcodeAndRegistersMask || GetOpcode( signature.words[ high ] ) != LuiOpcode )
+			continue;
+
+		const uint32_t reg = ( signature.words[ high ] >> 16 ) & 0x1f;
+		for ( uint32_t low = high + 1; low < signature.words.size(); ++low )
+		{
+			const uint32_t word = signature.words[ low ];
+			if ( signature.masks[ low ] != OpcodeAndRegistersMask || ( ( word >> 21 ) & 0x1f ) != reg )
+				continue;
+
+			if ( IsLoadOrStore( word ) || GetOpcode( word ) == AddiuOpcode )
+			{
+				signature.seedHighIndex = high;
+				signature.seedLowIndex = low;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool LibraryHle::Matches( const Signature& signature, uint32_t address ) const noexcept
+{
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( physicalAddress >= MemoryMap::RamMirrorSize )
+		return false;
+
+	const uint32_t offset = physicalAddress % RamSize;
+	const size_t size = signature.words.size() * 4;
+	if ( size > RamSize - offset )
+		return false;
+
+	const Ram& ram = m_memoryMap.GetRam();
+	for ( size_t i = 0; i < signature.words.size(); ++i )
+	{
+		if ( ( ram.Read<uint32_t>( static_cast<uint32_t>( offset + i * 4 ) ) & signature.masks[ i ] ) != signature.words[ i ] )
+			return false;
+	}
+
+	return true;
+}
+
+std::optional<uint32_t> LibraryHle::FindFunction( uint32_t address ) noexcept
+{
+	const uint32_t physicalAddress = address & 0x1fffffff;
+	if ( m_signatures.empty() || physicalAddress >= MemoryMap::RamMirrorSize || ( address % 4 ) != 0 )
+		return std::nullopt;
+
+	const uint32_t offset = physicalAddress % RamSize;
+	const uint32_t firstWord = m_memoryMap.GetRam().Read<uint32_t>( offset );
+
+	// the first loaded signature wins. Equal keys aren't kept in insertion order
+	std::optional<uint32_t> match;
+	auto findMatch = [ & ]( uint32_t key )
+	{
+		const auto [ first, last ] = m_signaturesByFirstWord.equal_range( key );
+		for ( auto it = first; it != last; ++it )
+		{
+			if ( ( !match.has_value() || it->second < *match ) && Matches( m_signatures[ it->second ], address ) )
+				match = it->second;
+		}
+	};
+
+	findMatch( firstWord );
+	if ( GetOpcode( firstWord ) == LuiOpcode )
+		findMatch( firstWord & OpcodeAndRegistersMask );
+
+	if ( match.has_value() )
+	{
+		// keep the call count when the block is recompiled
+		auto [ it, inserted ] = m_foundFunctions.try_emplace( offset, FoundFunction{ *match } );
+		if ( !inserted && it->second.signature != *match )
+			it->second = FoundFunction{ *match };
+	}
+
+	return match;
+}
+
+std::optional<BiosHle::Result> LibraryHle::Call( uint32_t signatureIndex, uint32_t address, const std::array<uint32_t, 4>& args ) noexcept
+{
+	dbExpects( signatureIndex < m_signatures.size() );
+	const Signature& signature = m_signatures[ signatureIndex ];
+
+	// the code may have been overwritten since the block was compiled without touching the block, like by DMA
+	if ( !signature.enabled || !Matches( signature, address ) )
+		return std::nullopt;
+
+	const uint32_t offset = ( address & 0x1fffffff ) % RamSize;
+
+	uint32_t seedAddress = 0;
+	if ( signature.seedLowIndex != 0 )
+	{
+		const Ram& ram = m_memoryMap.GetRam();
+		const uint32_t high = ram.Read<uint32_t>( offset + signature.seedHighIndex * 4 ) << 16;
+		const auto low = static_cast<int16_t>( ram.Read<uint32_t>( offset + signature.seedLowIndex * 4 ) );
+		seedAddress = high + static_cast<uint32_t>( low );
+	}
+
+	const auto result = m_biosHle.CallLibraryFunction( signature.function, signature.call, seedAddress, args );
+	if ( result.has_value() )
+	{
+		auto it = m_foundFunctions.find( offset );
+		if ( it != m_foundFunctions.end() )
+			++it->second.calls;
+	}
+
+	return result;
+}
+
+bool LibraryHle::SetEnabled( std::string_view name, bool enable ) noexcept
+{
+	bool found = false;
+	for ( auto& signature : m_signatures )
+	{
+		if ( signature.name == name )
+		{
+			signature.enabled = enable;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+void LibraryHle::LogReport() const
+{
+	if ( m_signatures.empty() )
+		return;
+
+	std::vector<std::pair<uint32_t, FoundFunction>> functions( m_foundFunctions.begin(), m_foundFunctions.end() );
+	std::sort( functions.begin(), functions.end(), []( const auto& lhs, const auto& rhs ) { return lhs.first < rhs.first; } );
+
+	Log( "Library functions found: %zu", functions.size() );
+	for ( const auto& [ offset, function ] : functions )
+	{
+		const Signature& signature = m_signatures[ function.signature ];
+		Log( "  %08X %s (%s): %u%s", 0x80000000 | offset, signature.name.c_str(), GetReplacementName( signature.function, signature.call ), function.calls, signature.enabled ? "" : " (disabled)" );
+	}
+}
+
+}
\ No newline at end of file
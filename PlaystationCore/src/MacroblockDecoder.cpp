@@ -111,7 +111,7 @@ uint32_t MacroblockDecoder::ReadData()
 		if ( m_outputBlockEvent->IsActive() )
 		{
 			dbLogWarning( "MacroblockDecoder::ReadData -- output fifo is empty, stalling CPU until data is processed" );
-			m_eventManager.AddCyclesAndUpdateEvents( m_outputBlockEvent->GetRemainingCycles() );
+			m_eventManager.AddSystemCyclesAndUpdateEvents( m_outputBlockEvent->GetRemainingCycles() );
 		}
 		else
 		{
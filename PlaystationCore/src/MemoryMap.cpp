@@ -2,6 +2,7 @@
 
 #include "BIOS.h"
 #include "CDRomDrive.h"
+#include "CodeCache.h"
 #include "ControllerPorts.h"
 #include "DMA.h"
 #include "DualSerialPort.h"
@@ -18,6 +19,8 @@
 #include "SaveState.h"
 #include "Timers.h"
 
+#include <algorithm>
+
 namespace PSX
 {
 
@@ -35,6 +38,46 @@ void MemoryMap::Reset()
 {
 	m_memoryControl.Reset();
 	m_icacheFlags.fill( ICacheFlags() );
+	UpdatePageCycles();
+}
+
+void MemoryMap::MapPages() noexcept
+{
+	// RAM mirrors fill the first 8MB
+	for ( uint32_t start = RamStart; start < RamMirrorSize; start += RamSize )
+		MapPages( start, RamSize, m_ram.Data(), Page::Writable | Page::Ram, RamReadCycles );
+
+	MapPages( ScratchpadStart, ScratchpadSize, m_scratchpad.Data(), Page::Writable, ScratchpadReadCycles );
+	MapPages( BiosStart, BiosSize, m_bios.Data(), 0, 0 );
+
+	UpdatePageCycles();
+}
+
+void MemoryMap::MapPages( uint32_t start, uint32_t size, uint8_t* memory, uint8_t flags, cycles_t readCycles ) noexcept
+{
+	dbExpects( start % PageSize == 0 );
+
+	for ( uint32_t offset = 0; offset < size; offset += PageSize )
+	{
+		auto& page = m_pages[ ( start + offset ) / PageSize ];
+		page.memory = memory + offset;
+		page.size = static_cast<uint16_t>( std::min( size - offset, PageSize ) );
+		page.flags = flags;
+		page.readCycles.fill( static_cast<uint8_t>( readCycles ) );
+	}
+}
+
+void MemoryMap::UpdatePageCycles() noexcept
+{
+	const std::array<uint8_t, 3> biosCycles
+	{
+		static_cast<uint8_t>( m_memoryControl.GetAccessCycles<uint8_t>( MemoryControl::DelaySizeType::Bios ) ),
+		static_cast<uint8_t>( m_memoryControl.GetAccessCycles<uint16_t>( MemoryControl::DelaySizeType::Bios ) ),
+		static_cast<uint8_t>( m_memoryControl.GetAccessCycles<uint32_t>( MemoryControl::DelaySizeType::Bios ) )
+	};
+
+	for ( uint32_t address = BiosStart; address < BiosStart + BiosSize; address += PageSize )
+		m_pages[ address / PageSize ].readCycles = biosCycles;
 }
 
 template <typename T, bool ReadMode>
@@ -48,11 +91,38 @@ void MemoryMap::Access( uint32_t address, T& value ) noexcept
 	// convert virtual address to physical address
 	address &= RegionMasks[ address >> 29 ];
 
+	// fast path for memory backed pages
+	if ( STDX_likely( address < PageCount * PageSize ) )
+	{
+		const Page& page = m_pages[ address / PageSize ];
+		const uint32_t offset = address % PageSize;
+		if ( STDX_likely( offset < page.size ) )
+		{
+			static constexpr size_t cyclesIndex = sizeof( T ) <= 2 ? sizeof( T ) - 1 : 2;
+
+			if constexpr ( ReadMode )
+			{
+				value = *reinterpret_cast<const T*>( page.memory + offset );
+				m_eventManager.AddCycles( page.readCycles[ cyclesIndex ] );
+			}
+			else if ( page.flags & Page::Writable )
+			{
+				*reinterpret_cast<T*>( page.memory + offset ) = value;
+
+				if ( page.flags & Page::Ram )
+					m_codeCache.InvalidateRam( address % RamSize, sizeof( T ) );
+			}
+			return;
+		}
+	}
+
 	if ( address <= RamMirrorSize ) // ram starts at 0
 	{
 		AccessMemory<T, ReadMode>( m_ram, address % RamSize, value );
 		if constexpr ( ReadMode )
 			cycles = RamReadCycles;
+		else
+			m_codeCache.InvalidateRam( address % RamSize, sizeof( T ) );
 	}
 	else if ( Within( address, BiosStart, BiosSize ) )
 	{
@@ -71,6 +141,9 @@ void MemoryMap::Access( uint32_t address, T& value ) noexcept
 	else if ( Within( address, MemControlStart, MemControlSize ) )
 	{
 		AccessComponent32<T, ReadMode>( m_memoryControl, address - MemControlStart, value );
+
+		if constexpr ( !ReadMode )
+			UpdatePageCycles();
 	}
 	else if ( Within( address, ControllerStart, ControllerSize ) )
 	{
@@ -381,6 +454,13 @@ bool MemoryMap::CheckAndPrefetchICache( uint32_t address ) noexcept
 	return cached;
 }
 
+void MemoryMap::WriteICache( uint32_t address, uint32_t ) noexcept
+{
+	dbExpects( address / 16 < m_icacheFlags.size() );
+	m_icacheFlags[ address / 16 ].valid = 0;
+	// TODO: write to icache
+}
+
 std::optional<Instruction> MemoryMap::FetchInstruction( uint32_t address ) noexcept
 {
 	dbExpects( address % 4 == 0 );
@@ -436,6 +516,9 @@ void MemoryMap::Serialize( SaveStateSerializer& serializer )
 	}
 
 	m_memoryControl.Serialize( serializer );
+
+	if ( serializer.Reading() )
+		UpdatePageCycles();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "NullRenderer.h"
+
+#include <stdx/assert.h>
+
+#include <algorithm>
+#include <array>
+
+namespace PSX
+{
+
+NullRenderer::NullRenderer()
+	: m_vram{ std::make_unique<uint16_t[]>( VRamWidth * VRamHeight ) }
+{}
+
+void NullRenderer::Reset()
+{
+	std::fill_n( m_vram.get(), VRamWidth * VRamHeight, uint16_t( 0 ) );
+
+	m_targetDisplayArea = {};
+	m_aspectRatio = 0.0f;
+
+	m_forceMaskBit = 0;
+	m_checkMaskBit = false;
+}
+
+void NullRenderer::SetMaskBits( bool setMask, bool checkMask )
+{
+	m_forceMaskBit = setMask ? MaskBit : 0;
+	m_checkMaskBit = checkMask;
+}
+
+void NullRenderer::SetDisplayArea( const DisplayArea&, const DisplayArea& targetDisplayArea, float aspectRatio )
+{
+	m_targetDisplayArea = targetDisplayArea;
+	m_aspectRatio = aspectRatio;
+}
+
+void NullRenderer::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		for ( uint32_t x = 0; x < width; ++x )
+			WritePixel( left + x, top + y, *pixels++ );
+	}
+}
+
+void NullRenderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+
+	for ( uint32_t y = top; y < top + height; ++y )
+	{
+		for ( uint32_t x = left; x < left + width; ++x )
+			vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ] = VRamPixel( x, y );
+	}
+}
+
+void NullRenderer::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+
+	// not affected by the mask settings
+	const auto color = static_cast<uint16_t>( ( r >> 3 ) | ( ( g >> 3 ) << 5 ) | ( ( b >> 3 ) << 10 ) );
+	for ( uint32_t y = top; y < top + height; ++y )
+	{
+		for ( uint32_t x = left; x < left + width; ++x )
+			VRamPixel( x, y ) = color;
+	}
+}
+
+void NullRenderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height )
+{
+	std::array<uint16_t, VRamWidth> row;
+	width = std::min( width, VRamWidth );
+
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		for ( uint32_t x = 0; x < width; ++x )
+			row[ x ] = VRamPixel( srcX + x, srcY + y );
+
+		for ( uint32_t x = 0; x < width; ++x )
+			WritePixel( destX + x, destY + y, row[ x ] );
+	}
+}
+
+}
\ No newline at end of file
@@ -1,4 +1,4 @@
-#include "Renderer.h"
+#include "OpenGLRenderer.h"
 
 #include "ClutShader.h"
 #include "DisplayShader.h"
@@ -34,7 +34,7 @@ constexpr GLint GetPixelStoreAlignment( uint32_t x, uint32_t w ) noexcept
 
 }
 
-bool Renderer::Initialize( SDL_Window* window )
+bool OpenGLRenderer::Initialize( SDL_Window* window )
 {
 	dbExpects( window );
 	m_window = window;
@@ -119,7 +119,7 @@ bool Renderer::Initialize( SDL_Window* window )
 	return true;
 }
 
-void Renderer::InitializeVRamFramebuffers()
+void OpenGLRenderer::InitializeVRamFramebuffers()
 {
 	// VRAM draw texture
 	m_vramDrawFramebuffer = Render::Framebuffer::Create();
@@ -139,7 +139,7 @@ void Renderer::InitializeVRamFramebuffers()
 	m_vramReadFramebuffer.Unbind();
 }
 
-constexpr Renderer::Rect Renderer::GetWrappedBounds( uint32_t left, uint32_t top, uint32_t width, uint32_t height ) noexcept
+constexpr OpenGLRenderer::Rect OpenGLRenderer::GetWrappedBounds( uint32_t left, uint32_t top, uint32_t width, uint32_t height ) noexcept
 {
 	if ( left + width > VRamWidth )
 	{
@@ -156,7 +156,7 @@ constexpr Renderer::Rect Renderer::GetWrappedBounds( uint32_t left, uint32_t top
 	return Rect::FromExtents( left, top, width, height );
 }
 
-void Renderer::Reset()
+void OpenGLRenderer::Reset()
 {
 	// clear VRAM textures
 
@@ -203,7 +203,7 @@ void Renderer::Reset()
 
 	m_vertices.clear();
 
-	ResetDirtyArea();
+	m_dirtyTiles.Clear();
 	m_textureArea = {};
 	m_clutArea = {};
 
@@ -212,7 +212,7 @@ void Renderer::Reset()
 	RestoreRenderState();
 }
 
-bool Renderer::SetResolutionScale( uint32_t scale )
+bool OpenGLRenderer::SetResolutionScale( uint32_t scale )
 {
 	if ( scale < 1 || scale > MaxResolutionScale )
 		return false;
@@ -253,7 +253,7 @@ bool Renderer::SetResolutionScale( uint32_t scale )
 	return true;
 }
 
-void Renderer::SetViewport( uint32_t left, uint32_t top, uint32_t width, uint32_t height )
+void OpenGLRenderer::SetViewport( uint32_t left, uint32_t top, uint32_t width, uint32_t height )
 {
 	glViewport(
 		static_cast<GLint>( left * m_resolutionScale ),
@@ -262,7 +262,7 @@ void Renderer::SetViewport( uint32_t left, uint32_t top, uint32_t width, uint32_
 		static_cast<GLsizei>( height * m_resolutionScale ) );
 }
 
-void Renderer::SetScissor( uint32_t left, uint32_t top, uint32_t width, uint32_t height )
+void OpenGLRenderer::SetScissor( uint32_t left, uint32_t top, uint32_t width, uint32_t height )
 {
 	glScissor(
 		static_cast<GLint>( left * m_resolutionScale ),
@@ -271,7 +271,7 @@ void Renderer::SetScissor( uint32_t left, uint32_t top, uint32_t width, uint32_t
 		static_cast<GLsizei>( height * m_resolutionScale ) );
 }
 
-void Renderer::EnableVRamView( bool enable )
+void OpenGLRenderer::EnableVRamView( bool enable )
 {
 	if ( !m_viewVRam && enable )
 	{
@@ -288,7 +288,7 @@ void Renderer::EnableVRamView( bool enable )
 	m_viewVRam = enable;
 }
 
-void Renderer::SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY )
+void OpenGLRenderer::SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY )
 {
 	if ( m_texWindowMaskX != maskX || m_texWindowMaskY != maskY || m_texWindowOffsetX != offsetX || m_texWindowOffsetY != offsetY )
 	{
@@ -305,7 +305,7 @@ void Renderer::SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offset
 	}
 }
 
-void Renderer::SetDrawArea( GLint left, GLint top, GLint right, GLint bottom )
+void OpenGLRenderer::SetDrawArea( int32_t left, int32_t top, int32_t right, int32_t bottom )
 {
 	const Rect newDrawArea( left, top, right, bottom );
 	if ( m_drawArea != newDrawArea )
@@ -317,14 +317,14 @@ void Renderer::SetDrawArea( GLint left, GLint top, GLint right, GLint bottom )
 	}
 }
 
-void Renderer::SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMode )
+void OpenGLRenderer::SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMode )
 {
 	if ( m_semiTransparencyMode != semiTransparencyMode )
 	{
 		if ( m_semiTransparencyEnabled )
 			DrawBatch();
 
-		dbLogDebug( "Renderer::SetSemiTransparencyMode -- [%i]", (int)semiTransparencyMode );
+		dbLogDebug( "OpenGLRenderer::SetSemiTransparencyMode -- [%i]", (int)semiTransparencyMode );
 		dbLogDebug( "\tenabled: %s", m_semiTransparencyEnabled ? "true" : "false" );
 
 		m_semiTransparencyMode = semiTransparencyMode;
@@ -334,7 +334,7 @@ void Renderer::SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMod
 	}
 }
 
-void Renderer::SetMaskBits( bool setMask, bool checkMask )
+void OpenGLRenderer::SetMaskBits( bool setMask, bool checkMask )
 {
 	if ( m_forceMaskBit != setMask || m_checkMaskBit != checkMask )
 	{
@@ -346,13 +346,13 @@ void Renderer::SetMaskBits( bool setMask, bool checkMask )
 	}
 }
 
-void Renderer::EnableSemiTransparency( bool enabled )
+void OpenGLRenderer::EnableSemiTransparency( bool enabled )
 {
 	if ( m_semiTransparencyEnabled != enabled )
 	{
 		DrawBatch();
 
-		dbLogDebug( "Renderer::EnableSemiTransparency -- [%s]", enabled ? "true" : "false" );
+		dbLogDebug( "OpenGLRenderer::EnableSemiTransparency -- [%s]", enabled ? "true" : "false" );
 		if ( enabled )
 			dbLogDebug( "\tsemiTransparencyMode: %u", (int)m_semiTransparencyMode );
 
@@ -361,27 +361,27 @@ void Renderer::EnableSemiTransparency( bool enabled )
 	}
 }
 
-void Renderer::GrowDirtyArea( const Rect& bounds ) noexcept
+void OpenGLRenderer::GrowDirtyArea( const Rect& bounds ) noexcept
 {
 	// check if bounds should cover pending batched polygons
-	if ( m_dirtyArea.Intersects( bounds ) )
+	if ( m_dirtyTiles.Intersects( bounds ) )
 		DrawBatch();
 
-	m_dirtyArea.Grow( bounds );
+	m_dirtyTiles.Add( bounds );
 
 	// check if bounds will overwrite current texture data
 	if ( IntersectsTextureData( bounds ) )
 		DrawBatch();
 }
 
-void Renderer::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels )
+void OpenGLRenderer::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels )
 {
 	dbExpects( left < VRamWidth );
 	dbExpects( top < VRamHeight );
 	dbExpects( width > 0 );
 	dbExpects( height > 0 );
 
-	dbLogDebug( "Renderer::UpdateVRam -- pos: %u, %u, size: %u, %u", left, top, width, height );
+	dbLogDebug( "OpenGLRenderer::UpdateVRam -- pos: %u, %u, size: %u, %u", left, top, width, height );
 
 	const auto updateBounds = GetWrappedBounds( left, top, width, height );
 	GrowDirtyArea( updateBounds );
@@ -458,17 +458,17 @@ void Renderer::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t
 	dbCheckRenderErrors();
 }
 
-void Renderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram )
+void OpenGLRenderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram )
 {
 	dbExpects( left < VRamWidth );
 	dbExpects( top < VRamHeight );
 	dbExpects( width > 0 );
 	dbExpects( height > 0 );
 
-	dbLogDebug( "Renderer::ReadVRam -- pos: %u, %u, size: %u, %u", left, top, width, height );
+	dbLogDebug( "OpenGLRenderer::ReadVRam -- pos: %u, %u, size: %u, %u", left, top, width, height );
 
 	const auto readBounds = GetWrappedBounds( left, top, width, height );
-	if ( m_dirtyArea.Intersects( readBounds ) )
+	if ( m_dirtyTiles.Intersects( readBounds ) )
 		DrawBatch();
 
 	const GLint readWidth = readBounds.GetWidth();
@@ -505,7 +505,7 @@ void Renderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t h
 	dbCheckRenderErrors();
 }
 
-void Renderer::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b )
+void OpenGLRenderer::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b )
 {
 	dbExpects( left < VRamWidth );
 	dbExpects( top < VRamHeight );
@@ -573,7 +573,7 @@ void Renderer::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t h
 	UpdateScissorRect();
 }
 
-void Renderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height )
+void OpenGLRenderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height )
 {
 	// TODO: handle wrapped copy
 	dbExpects( srcX + width <= VRamWidth );
@@ -584,11 +584,11 @@ void Renderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t
 	const auto srcBounds = Rect::FromExtents( srcX, srcY, width, height );
 	const auto destBounds = Rect::FromExtents( destX, destY, width, height );
 
-	if ( m_dirtyArea.Intersects( srcBounds ) )
+	if ( m_dirtyTiles.Intersects( srcBounds ) )
 	{
 		// update read texture if src area is dirty
-		UpdateReadTexture();
-		m_dirtyArea.Grow( destBounds );
+		UpdateReadTexture( srcBounds );
+		m_dirtyTiles.Add( destBounds );
 	}
 	else
 	{
@@ -609,7 +609,7 @@ void Renderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t
 	RestoreRenderState();
 }
 
-void Renderer::SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither )
+void OpenGLRenderer::SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither )
 {
 	if ( m_realColor )
 		dither = false;
@@ -665,18 +665,23 @@ void Renderer::SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither )
 	}
 
 	// update read texture if texpage or clut area is dirty
-	if ( IntersectsTextureData( m_dirtyArea ) )
-		UpdateReadTexture();
+	if ( UsingTexture() )
+	{
+		UpdateReadTexture( m_textureArea );
+
+		if ( UsingClut() )
+			UpdateReadTexture( m_clutArea );
+	}
 }
 
-void Renderer::SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio )
+void OpenGLRenderer::SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio )
 {
 	m_vramDisplayArea = vramDisplayArea;
 	m_targetDisplayArea = targetDisplayArea;
 	m_aspectRatio = aspectRatio;
 }
 
-void Renderer::SetRealColor( bool realColor )
+void OpenGLRenderer::SetRealColor( bool realColor )
 {
 	if ( m_realColor != realColor )
 	{
@@ -685,7 +690,7 @@ void Renderer::SetRealColor( bool realColor )
 	}
 }
 
-void Renderer::UpdateScissorRect()
+void OpenGLRenderer::UpdateScissorRect()
 {
 	const auto width = std::max<int>( m_drawArea.right - m_drawArea.left + 1, 0 );
 	const auto height = std::max<int>( m_drawArea.bottom - m_drawArea.top + 1, 0 );
@@ -693,7 +698,7 @@ void Renderer::UpdateScissorRect()
 	dbCheckRenderErrors();
 }
 
-void Renderer::UpdateBlendMode()
+void OpenGLRenderer::UpdateBlendMode()
 {
 	if ( m_semiTransparencyEnabled )
 	{
@@ -735,13 +740,13 @@ void Renderer::UpdateBlendMode()
 	dbCheckRenderErrors();
 }
 
-void Renderer::UpdateMaskBits()
+void OpenGLRenderer::UpdateMaskBits()
 {
 	glUniform1i( m_setMaskBitLoc, m_forceMaskBit );
 	glDepthFunc( m_checkMaskBit ? GL_LEQUAL : GL_ALWAYS );
 }
 
-void Renderer::PushTriangle( Vertex vertices[ 3 ], bool semiTransparent )
+void OpenGLRenderer::PushTriangle( Vertex vertices[ 3 ], bool semiTransparent )
 {
 	if ( !IsDrawAreaValid() )
 		return;
@@ -752,24 +757,29 @@ void Renderer::PushTriangle( Vertex vertices[ 3 ], bool semiTransparent )
 
 	EnableSemiTransparency( semiTransparent );
 
+	// mark the tiles the triangle can draw to. The draw area is inclusive
+	const auto [ minX, maxX ] = std::minmax( { vertices[ 0 ].position.x, vertices[ 1 ].position.x, vertices[ 2 ].position.x } );
+	const auto [ minY, maxY ] = std::minmax( { vertices[ 0 ].position.y, vertices[ 1 ].position.y, vertices[ 2 ].position.y } );
+	m_dirtyTiles.Add( Rect(
+		std::max<int32_t>( minX, m_drawArea.left ),
+		std::max<int32_t>( minY, m_drawArea.top ),
+		std::min<int32_t>( maxX, m_drawArea.right ) + 1,
+		std::min<int32_t>( maxY, m_drawArea.bottom ) + 1 ) );
+
 	// set triangle depth
 	UpdateCurrentDepth();
-	std::for_each_n( vertices, 3, [this]( auto& v )
-		{ 
-			m_dirtyArea.Grow( v.position.x, v.position.y );
-			v.position.z = m_currentDepth;
-		} );
+	std::for_each_n( vertices, 3, [this]( auto& v ) { v.position.z = m_currentDepth; } );
 
 	m_vertices.insert( m_vertices.end(), vertices, vertices + 3 );
 }
 
-void Renderer::PushQuad( Vertex vertices[ 4 ], bool semiTransparent )
+void OpenGLRenderer::PushQuad( Vertex vertices[ 4 ], bool semiTransparent )
 {
 	PushTriangle( vertices, semiTransparent );
 	PushTriangle( vertices + 1, semiTransparent );
 }
 
-void Renderer::DrawBatch()
+void OpenGLRenderer::DrawBatch()
 {
 	if ( m_vertices.empty() )
 		return;
@@ -803,7 +813,7 @@ void Renderer::DrawBatch()
 	m_vertices.clear();
 }
 
-void Renderer::ResetDepthBuffer()
+void OpenGLRenderer::ResetDepthBuffer()
 {
 	DrawBatch();
 
@@ -824,7 +834,7 @@ void Renderer::ResetDepthBuffer()
 	RestoreRenderState();
 }
 
-void Renderer::UpdateCurrentDepth()
+void OpenGLRenderer::UpdateCurrentDepth()
 {
 	if ( m_checkMaskBit )
 	{
@@ -835,9 +845,9 @@ void Renderer::UpdateCurrentDepth()
 	}
 }
 
-void Renderer::UpdateReadTexture()
+void OpenGLRenderer::UpdateReadTexture( const Rect& area )
 {
-	if ( m_dirtyArea.Empty() )
+	if ( !m_dirtyTiles.Intersects( area ) )
 		return;
 
 	DrawBatch();
@@ -845,21 +855,23 @@ void Renderer::UpdateReadTexture()
 	m_vramReadFramebuffer.Bind( Render::FramebufferBinding::Draw );
 	glDisable( GL_SCISSOR_TEST );
 
-	const auto blitArea = m_dirtyArea * m_resolutionScale;
-	glBlitFramebuffer( 
-		blitArea.left, blitArea.top, blitArea.right, blitArea.bottom,
-		blitArea.left, blitArea.top, blitArea.right, blitArea.bottom,
-		GL_COLOR_BUFFER_BIT, GL_NEAREST );
+	// only copy dirty tiles, merged into as few blits as possible
+	m_dirtyTiles.Extract( area, [this]( const Rect& tiles )
+		{
+			const auto blitArea = tiles * m_resolutionScale;
+			glBlitFramebuffer(
+				blitArea.left, blitArea.top, blitArea.right, blitArea.bottom,
+				blitArea.left, blitArea.top, blitArea.right, blitArea.bottom,
+				GL_COLOR_BUFFER_BIT, GL_NEAREST );
+		} );
 
 	m_vramDrawFramebuffer.Bind( Render::FramebufferBinding::Draw );
 	glEnable( GL_SCISSOR_TEST );
 
 	dbCheckRenderErrors();
-
-	ResetDirtyArea();
 }
 
-void Renderer::RestoreRenderState()
+void OpenGLRenderer::RestoreRenderState()
 {
 	m_vramDrawVAO.Bind();
 	m_vramDrawFramebuffer.Bind();
@@ -891,7 +903,7 @@ void Renderer::RestoreRenderState()
 	dbCheckRenderErrors();
 }
 
-Surface Renderer::ReadDisplayTexture()
+Surface OpenGLRenderer::ReadDisplayTexture()
 {
 	int width = 0;
 	int height = 0;
@@ -922,7 +934,7 @@ Surface Renderer::ReadDisplayTexture()
 	return Surface{ std::unique_ptr<char[]>( pixels ), (uint32_t)width, (uint32_t)height, 24, pitch, 0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000 };
 }
 
-void Renderer::DisplayFrame()
+void OpenGLRenderer::DisplayFrame()
 {
 	DrawBatch();
 
@@ -1012,16 +1024,8 @@ void Renderer::DisplayFrame()
 	const float displayWidth = static_cast<float>( srcWidth );
 	const float displayHeight = m_viewVRam ? static_cast<float>( srcHeight ) : ( displayWidth / m_aspectRatio );
 
-	float renderScale = std::min( winWidth / displayWidth, winHeight / displayHeight );
-	if ( !m_stretchToFit )
-		renderScale = std::max( 1.0f, std::floor( renderScale ) );
-
-	const int renderWidth = static_cast<int>( displayWidth * renderScale );
-	const int renderHeight = static_cast<int>( displayHeight * renderScale );
-	const int renderX = ( winWidth - renderWidth ) / 2;
-	const int renderY = ( winHeight - renderHeight ) / 2;
-
-	glViewport( renderX, renderY, renderWidth, renderHeight );
+	const auto viewport = FitDisplayToWindow( displayWidth, displayHeight, winWidth, winHeight, m_stretchToFit );
+	glViewport( viewport.x, viewport.y, viewport.width, viewport.height );
 	glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
 
 	dbCheckRenderErrors();
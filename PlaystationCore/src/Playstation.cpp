@@ -4,40 +4,125 @@
 #include "BIOS.h"
 #include "CDRom.h"
 #include "CDRomDrive.h"
+#include "CodeCache.h"
 #include "Controller.h"
 #include "ControllerPorts.h"
 #include "CPU.h"
 #include "DMA.h"
 #include "DualSerialPort.h"
 #include "EventManager.h"
+#include "EventTelemetry.h"
+#include "Fastmem.h"
 #include "File.h"
 #include "GPU.h"
+#include "GpuCapture.h"
+#include "GteKernels.h"
+#include "Iso9660.h"
 #include "MacroblockDecoder.h"
 #include "MemoryControl.h"
+#include "NullRenderer.h"
+#include "OpenGLRenderer.h"
 #include "RAM.h"
 #include "Renderer.h"
 #include "SaveState.h"
 #include "SerialPort.h"
+#include "SoftwareRenderer.h"
 #include "SPU.h"
+#include "ThreadedRenderer.h"
 #include "Timers.h"
 
 namespace PSX
 {
 
+namespace
+{
+
+void AddGteCounters( EventTelemetry& telemetry, const GTE::Stats& stats )
+{
+	for ( uint32_t opcode = 0; opcode < GTE::OpcodeCount; ++opcode )
+	{
+		if ( stats.commands[ opcode ] == 0 )
+			continue;
+
+		const char* name = GTE::GetOpcodeName( opcode );
+		telemetry.AddCounter( name ? std::string( "gte." ) + name : "gte.invalid", stats.commands[ opcode ] );
+	}
+
+	telemetry.AddCounter( "gte.command_cycles", stats.commandCycles );
+	telemetry.AddCounter( "gte.stall_cycles", stats.stallCycles );
+	telemetry.AddCounter( "gte.host_ns", stats.hostNanoseconds );
+}
+
+}
+
 Playstation::Playstation() = default;
 Playstation::~Playstation() = default;
 
 bool Playstation::Initialize( SDL_Window* window, const fs::path& biosFilename )
 {
-	m_renderer = std::make_unique<Renderer>();
-	if ( !m_renderer->Initialize( window ) )
+	return InitializeInternal( window, biosFilename, true );
+}
+
+bool Playstation::InitializeHeadless( RendererType rendererType, const fs::path& biosFilename )
+{
+	m_rendererType = rendererType;
+	return InitializeInternal( nullptr, biosFilename, false );
+}
+
+bool Playstation::InitializeInternal( SDL_Window* window, const fs::path& biosFilename, bool openAudioDevice )
+{
+	if ( m_rendererType == RendererType::Null )
 	{
-		LogError( "Failed to initialize renderer" );
-		return false;
+		m_renderer = std::make_unique<NullRenderer>();
+	}
+	else if ( m_rendererType == RendererType::Software )
+	{
+		auto renderer = std::make_unique<SoftwareRenderer>();
+		if ( !renderer->Initialize( window ) )
+		{
+			LogError( "Failed to initialize software renderer" );
+			return false;
+		}
+		m_renderer = std::move( renderer );
+	}
+	else
+	{
+		if ( !window )
+		{
+			LogError( "OpenGL renderer requires a window" );
+			return false;
+		}
+
+		auto renderer = std::make_unique<OpenGLRenderer>();
+		if ( !renderer->Initialize( window ) )
+		{
+			LogError( "Failed to initialize renderer" );
+			return false;
+		}
+		m_renderer = std::move( renderer );
+	}
+
+	if ( m_useThreadedRenderer )
+	{
+		auto renderer = std::make_unique<ThreadedRenderer>();
+		if ( !renderer->Initialize( std::move( m_renderer ), window ) )
+		{
+			LogError( "Failed to initialize render thread" );
+			return false;
+		}
+		m_renderer = std::move( renderer );
+	}
+
+	// outermost so captures are written on this thread in call order
+	if ( m_useGpuCapture )
+	{
+		auto renderer = std::make_unique<GpuCaptureRenderer>( std::move( m_renderer ) );
+		m_gpuCapture = renderer.get();
+		m_renderer = std::move( renderer );
 	}
 
 	m_audioQueue = std::make_unique<AudioQueue>();
-	if ( !m_audioQueue->Initialize() )
+	if ( !( openAudioDevice ? m_audioQueue->Initialize() : m_audioQueue->InitializeWithoutDevice() ) )
 	{
 		LogError( "Failed to initialize audio queue" );
 		return false;
@@ -50,10 +135,30 @@ bool Playstation::Initialize( SDL_Window* window, const fs::path& biosFilename )
 		return false;
 	}
 
-	m_ram = std::make_unique<Ram>();
+	if constexpr ( Fastmem::IsSupported )
+	{
+		m_fastmem = std::make_unique<Fastmem>();
+		if ( !m_fastmem->Initialize() )
+		{
+			LogWarning( "Failed to initialize fastmem" );
+			m_fastmem.reset();
+		}
+	}
+
+	if ( m_fastmem )
+	{
+		m_ram = &m_fastmem->GetRam();
+	}
+	else
+	{
+		m_ramStorage = std::make_unique<Ram>();
+		m_ram = m_ramStorage.get();
+	}
+
+	m_codeCache = std::make_unique<CodeCache>();
 	m_scratchpad = std::make_unique<Scratchpad>();
-	m_interruptControl = std::make_unique<InterruptControl>();
 	m_eventManager = std::make_unique<EventManager>();
+	m_interruptControl = std::make_unique<InterruptControl>( *m_eventManager );
 	m_mdec = std::make_unique<MacroblockDecoder>( *m_eventManager );
 
 	m_timers = std::make_unique<Timers>( *m_interruptControl, *m_eventManager );
@@ -64,15 +169,19 @@ bool Playstation::Initialize( SDL_Window* window, const fs::path& biosFilename )
 
 	m_spu = std::make_unique<Spu>( *m_cdromDrive, *m_interruptControl, *m_eventManager, *m_audioQueue );
 
-	m_dma = std::make_unique<Dma>( *m_ram, *m_gpu, *m_cdromDrive, *m_mdec, *m_spu, *m_interruptControl, *m_eventManager );
+	m_dma = std::make_unique<Dma>( *m_ram, *m_codeCache, *m_gpu, *m_cdromDrive, *m_mdec, *m_spu, *m_interruptControl, *m_eventManager );
 
 	m_controllerPorts = std::make_unique<ControllerPorts>( *m_interruptControl, *m_eventManager );
 
 	m_serialPort = std::make_unique<SerialPort>();
 
-	m_memoryMap = std::make_unique<MemoryMap>( *m_eventManager, *m_bios, *m_cdromDrive, *m_controllerPorts, *m_dma, *m_gpu, *m_interruptControl, *m_mdec, *m_ram, *m_scratchpad, *m_serialPort, *m_spu, *m_timers );
+	m_memoryMap = std::make_unique<MemoryMap>( *m_eventManager, *m_bios, *m_cdromDrive, *m_codeCache, *m_controllerPorts, *m_dma, *m_gpu, *m_interruptControl, *m_mdec, *m_ram, *m_scratchpad, *m_serialPort, *m_spu, *m_timers );
+
+	m_cpu = std::make_unique<MipsR3000Cpu>( *m_memoryMap, *m_interruptControl, *m_eventManager, *m_codeCache );
 
-	m_cpu = std::make_unique<MipsR3000Cpu>( *m_memoryMap, *m_interruptControl, *m_eventManager );
+	m_cpu->SetFastmem( m_fastmem.get() );
+
+	Log( "GTE matrix kernels: %s", GteKernels::GetInstructionSetName( GteKernels::GetHostInstructionSet() ) );
 
 	// resolve circular dependancies
 	m_timers->SetGpu( *m_gpu );
@@ -98,6 +207,7 @@ void Playstation::Reset()
 	m_memoryMap->Reset();
 	m_cpu->Reset();
 	m_ram->Fill( 0 );
+	m_codeCache->Reset();
 	m_renderer->Reset();
 	m_scratchpad->Fill( 0 );
 	m_serialPort->Reset();
@@ -113,6 +223,16 @@ void Playstation::Reset()
 	m_audioQueue->Clear();
 	m_audioQueue->SetPaused( false );
 	m_audioQueue->PushSilenceFrames( m_audioQueue->GetDeviceBufferSize() / 2 );
+
+	// a hooked executable takes priority over the disc
+	CDRom* cdrom = m_cdromDrive->GetCDRom();
+	if ( m_fastBoot && cdrom && !m_cpu->HasBootExecutable() )
+	{
+		if ( auto exe = ReadBootExecutable( *cdrom ) )
+			m_cpu->SetBootExecutable( std::move( *exe ) );
+		else
+			LogWarning( "Fast boot failed. Running BIOS intro" );
+	}
 }
 
 void Playstation::SetController( size_t slot, Controller* controller )
@@ -130,6 +250,11 @@ void Playstation::RunFrame()
 	while ( !m_gpu->GetDisplayFrame() )
 		m_cpu->RunUntilEvent();
 
+	// frame stats are added to telemetry before it ends the frame
+	m_cpu->EndFrame();
+	if ( auto* telemetry = m_eventManager->GetTelemetry() )
+		AddGteCounters( *telemetry, m_cpu->GetGte().GetStats() );
+
 	m_eventManager->EndFrame();
 	m_spu->EndFrame();
 	m_gpu->ResetDisplayFrame();
@@ -146,9 +271,14 @@ CDRom* Playstation::GetCDRom()
 	return m_cdromDrive->GetCDRom();
 }
 
-void Playstation::HookExe( fs::path filename )
+bool Playstation::HookExe( const fs::path& filename )
 {
-	m_cpu->SetHookExecutable( std::move( filename ) );
+	auto exe = ReadExecutableFile( filename );
+	if ( !exe )
+		return false;
+
+	m_cpu->SetBootExecutable( std::move( *exe ) );
+	return true;
 }
 
 float Playstation::GetRefreshRate() const
@@ -156,6 +286,21 @@ float Playstation::GetRefreshRate() const
 	return m_gpu->GetRefreshRate();
 }
 
+bool Playstation::StartGpuCapture( const fs::path& filename, uint32_t frameCount )
+{
+	if ( !m_gpuCapture )
+	{
+		LogError( "GPU capture is not enabled" );
+		return false;
+	}
+
+	if ( !m_gpuCapture->StartCapture( filename, frameCount ) )
+		return false;
+
+	m_gpu->SyncRendererState();
+	return true;
+}
+
 bool Playstation::Serialize( SaveStateSerializer& serializer )
 {
 	if ( !serializer.Header( "PSX", 1 ) )
@@ -165,6 +310,9 @@ bool Playstation::Serialize( SaveStateSerializer& serializer )
 	serializer( m_ram->Data(), m_ram->Size() );
 	serializer( m_scratchpad->Data(), m_scratchpad->Size() );
 
+	if ( serializer.Reading() )
+		m_codeCache->Reset();
+
 	m_cdromDrive->Serialize( serializer );
 	m_controllerPorts->Serialize( serializer );
 	m_dma->Serialize( serializer );
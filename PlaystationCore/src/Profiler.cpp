@@ -0,0 +1,182 @@
+#include "Profiler.h"
+
+#include "BIOS.h"
+#include "CPU.h"
+#include "EventManager.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace PSX
+{
+
+Profiler::Profiler( MipsR3000Cpu& cpu, EventManager& eventManager )
+	: m_cpu{ cpu }
+	, m_eventManager{ eventManager }
+	, m_callStack( MaxCallDepth )
+{}
+
+Profiler::~Profiler()
+{
+	Stop();
+}
+
+void Profiler::Start( cycles_t sampleInterval )
+{
+	dbExpects( sampleInterval > 0 );
+	m_sampleInterval = sampleInterval;
+
+	if ( !m_sampleEvent )
+	{
+		m_sampleEvent = m_eventManager.CreateEvent( "Profiler sample", [this]( cycles_t )
+			{
+				Sample();
+				m_sampleEvent->Schedule( m_sampleInterval );
+			} );
+	}
+
+	m_callDepth = 0;
+	m_sampleEvent->Schedule( m_sampleInterval );
+}
+
+void Profiler::Stop()
+{
+	if ( !m_sampleEvent )
+		return;
+
+	// the event manager must not be left pointing at the event
+	m_sampleEvent->Cancel();
+	m_sampleEvent.reset();
+	m_callDepth = 0;
+
+	if ( m_droppedCalls > 0 )
+		LogWarning( "Profiler::Stop -- %u calls exceeded the maximum call depth", m_droppedCalls );
+}
+
+void Profiler::Reset()
+{
+	m_callDepth = 0;
+
+	// the event manager reset cancelled the event
+	if ( m_sampleEvent )
+		m_sampleEvent->Schedule( m_sampleInterval );
+}
+
+void Profiler::Clear()
+{
+	m_stackSamples.clear();
+	m_addressSamples.clear();
+	m_sampleCount = 0;
+	m_droppedCalls = 0;
+}
+
+void Profiler::OnKernelCall( uint32_t vector, uint32_t call ) noexcept
+{
+	// kernel calls go through a stub that jumps to the vector, so the stub's frame is the kernel function
+	if ( m_callDepth > 0 )
+		m_callStack[ m_callDepth - 1 ].id = MakeKernelFrame( vector, call );
+}
+
+uint32_t Profiler::MakeKernelFrame( uint32_t vector, uint32_t call ) noexcept
+{
+	return ( ( vector & 0xff ) << 16 ) | ( ( call & 0xff ) << 4 ) | 1;
+}
+
+std::string Profiler::GetFrameName( uint32_t frame )
+{
+	char name[ 64 ];
+
+	if ( frame & 1 )
+	{
+		const uint32_t vector = ( frame >> 16 ) & 0xff;
+		const uint32_t call = ( frame >> 4 ) & 0xff;
+		const char table = static_cast<char>( 'A' + ( vector - 0xa0 ) / 0x10 );
+		const char* functionName = GetKernelFunctionName( vector, call );
+		std::snprintf( name, sizeof( name ), "%c(%02X) %s", table, call, functionName ? functionName : "unknown" );
+	}
+	else
+	{
+		std::snprintf( name, sizeof( name ), "%08X", frame );
+	}
+
+	return name;
+}
+
+void Profiler::Sample()
+{
+	// blocks are charged up front, so samples can land on a kernel vector before the dispatcher names the call
+	const uint32_t pc = m_cpu.GetPC();
+	if ( MipsR3000Cpu::IsKernelCallVector( pc ) )
+		OnKernelCall( pc, m_cpu.m_registers[ MipsR3000Cpu::Registers::Temp1 ] );
+
+	m_sampleStack.clear();
+	for ( uint32_t i = 0; i < m_callDepth; ++i )
+		m_sampleStack.push_back( m_callStack[ i ].id );
+
+	++m_stackSamples[ m_sampleStack ];
+
+	auto& address = m_addressSamples[ pc ];
+	++address.count;
+	address.frame = ( m_callDepth > 0 ) ? m_callStack[ m_callDepth - 1 ].id : 0;
+
+	++m_sampleCount;
+}
+
+bool Profiler::WriteCollapsedStacks( const fs::path& filename ) const
+{
+	std::ofstream fout( filename );
+	if ( !fout.is_open() )
+	{
+		LogError( "Profiler::WriteCollapsedStacks -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	for ( auto& [stack, count] : m_stackSamples )
+	{
+		// samples outside any tracked call still need a root frame
+		fout << "psx";
+		for ( uint32_t frame : stack )
+			fout << ';' << GetFrameName( frame );
+
+		fout << ' ' << count << '\n';
+	}
+
+	return true;
+}
+
+bool Profiler::WriteHotAddresses( const fs::path& filename, size_t count ) const
+{
+	std::ofstream fout( filename );
+	if ( !fout.is_open() )
+	{
+		LogError( "Profiler::WriteHotAddresses -- cannot open %s", filename.string().c_str() );
+		return false;
+	}
+
+	std::vector<std::pair<uint32_t, AddressSamples>> addresses( m_addressSamples.begin(), m_addressSamples.end() );
+	count = std::min( count, addresses.size() );
+	std::partial_sort( addresses.begin(), addresses.begin() + count, addresses.end(), []( auto& lhs, auto& rhs )
+		{
+			return lhs.second.count > rhs.second.count;
+		} );
+
+	char line[ 128 ];
+	std::snprintf( line, sizeof( line ), "%u samples\n\n%10s %7s  %-8s  %s\n", m_sampleCount, "samples", "percent", "address", "function" );
+	fout << line;
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const auto& [pc, samples] = addresses[ i ];
+		const float percent = 100.0f * static_cast<float>( samples.count ) / static_cast<float>( m_sampleCount );
+		std::snprintf( line, sizeof( line ), "%10u %6.2f%%  %08X  ", samples.count, percent, pc );
+		fout << line << ( samples.frame ? GetFrameName( samples.frame ) : "-" ) << '\n';
+	}
+
+	return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,1252 @@
+#include "Recompiler.h"
+
+#include "CPU.h"
+#include "EventManager.h"
+#include "Fastmem.h"
+#include "MemoryMap.h"
+#include "X64Emitter.h"
+
+#include <stdx/assert.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace PSX
+{
+
+namespace
+{
+
+// upper bounds on emitted code, checked before compiling so blocks never run out of space
+constexpr size_t MaxHostBytesPerInstruction = 512; // includes out of line paths for loads and stores
+constexpr size_t MaxHostBytesPerBlock = 256;
+
+constexpr size_t ThunkSize = 64;
+constexpr size_t BlockAlignment = 16;
+
+uint8_t* AllocateExecutableMemory( size_t size )
+{
+#ifdef _WIN32
+	return static_cast<uint8_t*>( VirtualAlloc( nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE ) );
+#else
+	void* memory = mmap( nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	return ( memory != MAP_FAILED ) ? static_cast<uint8_t*>( memory ) : nullptr;
+#endif
+}
+
+void FreeExecutableMemory( uint8_t* memory, size_t size )
+{
+#ifdef _WIN32
+	(void)size;
+	VirtualFree( memory, 0, MEM_RELEASE );
+#else
+	munmap( memory, size );
+#endif
+}
+
+bool IsBranch( Instruction instr ) noexcept
+{
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::Special:
+		{
+			const auto funct = static_cast<SpecialOpcode>( instr.funct() );
+			return funct == SpecialOpcode::JumpRegister || funct == SpecialOpcode::JumpAndLinkRegister;
+		}
+
+		case Opcode::RegisterImmediate:
+		case Opcode::BranchEqual:
+		case Opcode::BranchNotEqual:
+		case Opcode::BranchLessEqualZero:
+		case Opcode::BranchGreaterThanZero:
+		case Opcode::Jump:
+		case Opcode::JumpAndLink:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// loads and coprocessor moves write GPRs through the load delay slot
+bool MayLoad( Instruction instr ) noexcept
+{
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::LoadByte:
+		case Opcode::LoadByteUnsigned:
+		case Opcode::LoadHalfword:
+		case Opcode::LoadHalfwordUnsigned:
+		case Opcode::LoadWord:
+		case Opcode::LoadWordLeft:
+		case Opcode::LoadWordRight:
+		case Opcode::CoprocessorUnit0:
+		case Opcode::CoprocessorUnit1:
+		case Opcode::CoprocessorUnit2:
+		case Opcode::CoprocessorUnit3:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+}
+
+class Recompiler::BlockCompiler
+{
+public:
+	using Reg = X64Emitter::Reg;
+
+	BlockCompiler( Recompiler& recompiler, CodeBlock& block, uint32_t pc, X64Emitter& emitter )
+		: m_recompiler{ recompiler }
+		, m_cpu{ recompiler.m_cpu }
+		, m_block{ block }
+		, m_startPC{ pc }
+		, m_emit{ emitter }
+		, m_lockstep{ recompiler.m_cpu.EnableRecompilerLockstep }
+		, m_profiling{ recompiler.m_cpu.m_profiler.IsRunning() }
+	{}
+
+	void Compile();
+
+private:
+	int32_t Offset( const void* member ) const noexcept
+	{
+		return static_cast<int32_t>( static_cast<const uint8_t*>( member ) - reinterpret_cast<const uint8_t*>( &m_cpu ) );
+	}
+
+	int32_t RegisterOffset( uint32_t index ) const noexcept
+	{
+		dbExpects( index < 32 );
+		return Offset( &m_cpu.m_registers.m_registers[ index ] );
+	}
+
+	void LoadRegister( Reg dest, uint32_t index ) noexcept
+	{
+		if ( index == 0 )
+			m_emit.AluRegReg32( X64Emitter::Xor, dest, dest );
+		else
+			m_emit.MovRegMem32( dest, X64Emitter::RBX, RegisterOffset( index ) );
+	}
+
+	void StoreRegister( uint32_t index, Reg src ) noexcept
+	{
+		if ( index != 0 )
+			m_emit.MovMemReg32( X64Emitter::RBX, RegisterOffset( index ), src );
+	}
+
+	void StorePC( const uint32_t& member, uint32_t value ) noexcept
+	{
+		m_emit.MovMemImm32( X64Emitter::RBX, Offset( &member ), value );
+	}
+
+	// equivalent of Registers::Set followed by Registers::Update for instructions that don't load
+	void CompleteInlineWrite( uint32_t destRegister ) noexcept;
+
+	// Registers::Update
+	void UpdateLoadDelay() noexcept;
+
+	// pipeline state after executing the instruction at pc outside of a delay slot
+	void MaterializeSequential( uint32_t pc ) noexcept;
+
+	void EmitInstruction( size_t index, bool inDelaySlot ) noexcept;
+
+	bool EmitInline( Instruction instr ) noexcept;
+
+	// loads and stores through the fastmem window
+	bool EmitMemoryAccess( const CachedInstruction& cached, uint32_t pc, bool inDelaySlot ) noexcept;
+
+	void EmitFallback( const CachedInstruction& cached ) noexcept;
+
+	// returns the number of possible static targets written to targets
+	size_t EmitBranch( size_t index, bool hasDelaySlot, uint32_t targets[ 2 ] ) noexcept;
+
+	void EmitDelaySlotPipeline( uint32_t pc ) noexcept;
+
+	// push and pop the profiler's shadow call stack without leaving compiled code
+	void EmitProfilerCall( uint32_t target, uint32_t returnAddress ) noexcept;
+	void EmitProfilerReturn() noexcept;
+
+	void EmitLockstepBegin() noexcept;
+
+	void EmitLockstepVerify( Instruction instr ) noexcept;
+
+	void EmitLinkExit( uint32_t targetPC ) noexcept;
+
+	uint32_t GetPC( size_t index ) const noexcept { return m_startPC + static_cast<uint32_t>( index * 4 ); }
+
+private:
+	// code emitted after the block for rare cases of inline loads and stores
+	struct ColdPath
+	{
+		enum class Type
+		{
+			Read,
+			Write,
+			AddressError
+		};
+
+		Type type = Type::Read;
+		X64Emitter::Label entry;
+		X64Emitter::Label resume;
+
+		// Read and Write
+		uint8_t* accessSite = nullptr;
+		const void* function = nullptr;
+
+		// AddressError
+		const CachedInstruction* cached = nullptr;
+		uint32_t pc = 0;
+		bool materialize = false;
+		bool pipelineFlagsKnown = false;
+	};
+
+	size_t AddColdPath( ColdPath::Type type ) noexcept
+	{
+		m_coldPaths.emplace_back().type = type;
+		return m_coldPaths.size() - 1;
+	}
+
+	void EmitColdPath( ColdPath& cold ) noexcept;
+
+private:
+	Recompiler& m_recompiler;
+	MipsR3000Cpu& m_cpu;
+	CodeBlock& m_block;
+	const uint32_t m_startPC;
+	X64Emitter& m_emit;
+	const bool m_lockstep;
+	const bool m_profiling; // calls are recorded for the profiler
+
+	X64Emitter::Label m_exitToDispatcher;
+
+	bool m_loadDelayPending = true; // a load from the previous block may still be in flight
+	bool m_pipelineFlagsKnown = false; // m_inBranch and m_inDelaySlot are false in memory
+	bool m_materialized = false; // pipeline state in memory matches m_materializedPC
+	uint32_t m_materializedPC = 0;
+	bool m_branchDestinationInRax = false; // branch skipped updating the pipeline, the delay slot does it
+
+	std::vector<ColdPath> m_coldPaths;
+};
+
+void Recompiler::BlockCompiler::Compile()
+{
+	const size_t count = m_block.instructions.size();
+	dbExpects( count > 0 );
+
+	// charge the whole block up front, like the cached interpreter
+	m_emit.MovRegPtr( X64Emitter::RAX, &m_recompiler.m_eventManager.m_pendingCycles );
+	m_emit.AluMemImm32( X64Emitter::Add, X64Emitter::RAX, 0, static_cast<uint32_t>( count ) );
+
+	size_t index = 0;
+	for ( ; index < count; ++index )
+	{
+		if ( IsBranch( m_block.instructions[ index ].instruction ) )
+			break;
+
+		EmitInstruction( index, false );
+	}
+
+	if ( index == count )
+	{
+		// block was cut short without a branch
+		MaterializeSequential( GetPC( count - 1 ) );
+		EmitLinkExit( GetPC( count ) );
+	}
+	else if ( index + 1 == count )
+	{
+		// delay slot couldn't be fetched. The dispatcher has to step through it, starting at pc + 4
+		MaterializeSequential( GetPC( index ) );
+		uint32_t targets[ 2 ];
+		EmitBranch( index, false, targets );
+		m_emit.Jump( m_exitToDispatcher );
+	}
+	else
+	{
+		dbAssert( index + 2 == count );
+
+		uint32_t targets[ 2 ];
+		const size_t targetCount = EmitBranch( index, true, targets );
+
+		const Instruction delaySlot = m_block.instructions[ index + 1 ].instruction;
+		EmitDelaySlotPipeline( GetPC( index + 1 ) );
+		EmitInstruction( index + 1, true );
+
+		if ( IsBranch( delaySlot ) )
+		{
+			// branch in a delay slot leaves the CPU in a branch
+			m_emit.Jump( m_exitToDispatcher );
+		}
+		else
+		{
+			// a fallback instruction in the delay slot may have raised an exception, so always check the destination
+			X64Emitter::Label exits[ 2 ];
+			m_emit.MovRegMem32( X64Emitter::RAX, X64Emitter::RBX, Offset( &m_cpu.m_pc ) );
+			for ( size_t i = 0; i < targetCount; ++i )
+			{
+				m_emit.AluRegImm32( X64Emitter::Cmp, X64Emitter::RAX, targets[ i ] );
+				m_emit.Jump( X64Emitter::Equal, exits[ i ] );
+			}
+			m_emit.Jump( m_exitToDispatcher );
+
+			for ( size_t i = 0; i < targetCount; ++i )
+			{
+				m_emit.Bind( exits[ i ] );
+				EmitLinkExit( targets[ i ] );
+			}
+		}
+	}
+
+	m_emit.Bind( m_exitToDispatcher );
+	m_emit.AluRegReg32( X64Emitter::Xor, X64Emitter::RAX, X64Emitter::RAX );
+	m_emit.Jump( m_recompiler.m_exit );
+
+	for ( auto& cold : m_coldPaths )
+		EmitColdPath( cold );
+}
+
+void Recompiler::BlockCompiler::CompleteInlineWrite( uint32_t destRegister ) noexcept
+{
+	if ( !m_loadDelayPending )
+		return;
+
+	// apply the delayed load unless this instruction just overwrote the same register
+	X64Emitter::Label done;
+	m_emit.MovRegMem32( X64Emitter::RCX, X64Emitter::RBX, Offset( &m_cpu.m_registers.m_loadDelay.index ) );
+	m_emit.TestRegReg32( X64Emitter::RCX, X64Emitter::RCX );
+	m_emit.Jump( X64Emitter::Equal, done );
+	if ( destRegister != 0 )
+	{
+		m_emit.AluRegImm32( X64Emitter::Cmp, X64Emitter::RCX, destRegister );
+		m_emit.Jump( X64Emitter::Equal, done );
+	}
+	m_emit.MovRegMem32( X64Emitter::RDX, X64Emitter::RBX, Offset( &m_cpu.m_registers.m_loadDelay.value ) );
+	m_emit.MovMemIndexReg32( X64Emitter::RBX, X64Emitter::RCX, RegisterOffset( 0 ), X64Emitter::RDX );
+	m_emit.Bind( done );
+	m_emit.MovMemImm32( X64Emitter::RBX, Offset( &m_cpu.m_registers.m_loadDelay.index ), 0 );
+
+	m_loadDelayPending = false;
+}
+
+void Recompiler::BlockCompiler::UpdateLoadDelay() noexcept
+{
+	auto& registers = m_cpu.m_registers;
+	static_assert( sizeof( registers.m_loadDelay ) == 8 );
+
+	X64Emitter::Label done;
+	m_emit.MovRegMem32( X64Emitter::RAX, X64Emitter::RBX, Offset( &registers.m_loadDelay.index ) );
+	m_emit.TestRegReg32( X64Emitter::RAX, X64Emitter::RAX );
+	m_emit.Jump( X64Emitter::Equal, done );
+	m_emit.MovRegMem32( X64Emitter::RCX, X64Emitter::RBX, Offset( &registers.m_loadDelay.value ) );
+	m_emit.MovMemIndexReg32( X64Emitter::RBX, X64Emitter::RAX, RegisterOffset( 0 ), X64Emitter::RCX );
+	m_emit.Bind( done );
+	m_emit.MovRegMem64( X64Emitter::RAX, X64Emitter::RBX, Offset( &registers.m_newLoadDelay ) );
+	m_emit.MovMemReg64( X64Emitter::RBX, Offset( &registers.m_loadDelay ), X64Emitter::RAX );
+	m_emit.MovMemImm32( X64Emitter::RBX, Offset( &registers.m_newLoadDelay.index ), 0 );
+}
+
+void Recompiler::BlockCompiler::MaterializeSequential( uint32_t pc ) noexcept
+{
+	if ( m_materialized && m_materializedPC == pc )
+		return;
+
+	StorePC( m_cpu.m_currentPC, pc );
+	StorePC( m_cpu.m_pc, pc + 4 );
+	StorePC( m_cpu.m_nextPC, pc + 8 );
+
+	if ( !m_pipelineFlagsKnown )
+	{
+		m_emit.MovMemImm8( X64Emitter::RBX, Offset( &m_cpu.m_inBranch ), 0 );
+		m_emit.MovMemImm8( X64Emitter::RBX, Offset( &m_cpu.m_inDelaySlot ), 0 );
+		m_pipelineFlagsKnown = true;
+	}
+
+	m_materialized = true;
+	m_materializedPC = pc;
+}
+
+void Recompiler::BlockCompiler::EmitInstruction( size_t index, bool inDelaySlot ) noexcept
+{
+	const CachedInstruction& cached = m_block.instructions[ index ];
+	const uint32_t pc = GetPC( index );
+
+	// branches in delay slots are rare enough to leave to the interpreter
+	const bool canInline = !IsBranch( cached.instruction );
+
+	// lockstep compares against the state in memory, so it must always be up to date.
+	// The delay slot state is saved before its pipeline update
+	if ( canInline && m_lockstep && !inDelaySlot )
+	{
+		MaterializeSequential( pc - 4 );
+		EmitLockstepBegin();
+	}
+
+	if ( canInline && ( EmitInline( cached.instruction ) || EmitMemoryAccess( cached, pc, inDelaySlot ) ) )
+	{
+		if ( !inDelaySlot )
+			m_materialized = false;
+
+		if ( m_lockstep )
+		{
+			if ( !inDelaySlot )
+				MaterializeSequential( pc );
+
+			EmitLockstepVerify( cached.instruction );
+		}
+		return;
+	}
+
+	if ( !inDelaySlot )
+		MaterializeSequential( pc );
+
+	EmitFallback( cached );
+
+	if ( !inDelaySlot )
+	{
+		// an exception moved the PC. The rest of the block must not execute
+		m_emit.AluMemImm32( X64Emitter::Cmp, X64Emitter::RBX, Offset( &m_cpu.m_pc ), pc + 4 );
+		m_emit.Jump( X64Emitter::NotEqual, m_exitToDispatcher );
+	}
+}
+
+bool Recompiler::BlockCompiler::EmitInline( Instruction instr ) noexcept
+{
+	using E = X64Emitter;
+
+	// every inline instruction computes its result into eax
+	auto RegisterRegister = [&]( E::AluOp op )
+	{
+		if ( instr.rd() != 0 )
+		{
+			LoadRegister( E::RAX, instr.rs() );
+			LoadRegister( E::RCX, instr.rt() );
+			m_emit.AluRegReg32( op, E::RAX, E::RCX );
+			StoreRegister( instr.rd(), E::RAX );
+		}
+		CompleteInlineWrite( instr.rd() );
+	};
+
+	auto RegisterImmediate = [&]( E::AluOp op, uint32_t imm )
+	{
+		if ( instr.rt() != 0 )
+		{
+			LoadRegister( E::RAX, instr.rs() );
+			m_emit.AluRegImm32( op, E::RAX, imm );
+			StoreRegister( instr.rt(), E::RAX );
+		}
+		CompleteInlineWrite( instr.rt() );
+	};
+
+	auto SetLessThan = [&]( E::Condition condition, bool immediate )
+	{
+		const uint32_t dest = immediate ? instr.rt() : instr.rd();
+		if ( dest != 0 )
+		{
+			LoadRegister( E::RAX, instr.rs() );
+			if ( immediate )
+			{
+				m_emit.AluRegImm32( E::Cmp, E::RAX, instr.immediateSignExtended() );
+			}
+			else
+			{
+				LoadRegister( E::RCX, instr.rt() );
+				m_emit.AluRegReg32( E::Cmp, E::RAX, E::RCX );
+			}
+			m_emit.SetRegCondition32( condition, E::RAX );
+			StoreRegister( dest, E::RAX );
+		}
+		CompleteInlineWrite( dest );
+	};
+
+	auto Shift = [&]( E::ShiftOp op, bool variable )
+	{
+		if ( instr.rd() != 0 )
+		{
+			LoadRegister( E::RAX, instr.rt() );
+			if ( variable )
+			{
+				// x86 masks the shift amount to 5 bits, same as the R3000
+				LoadRegister( E::RCX, instr.rs() );
+				m_emit.ShiftRegCl32( op, E::RAX );
+			}
+			else
+			{
+				m_emit.ShiftRegImm32( op, E::RAX, static_cast<uint8_t>( instr.shamt() ) );
+			}
+			StoreRegister( instr.rd(), E::RAX );
+		}
+		CompleteInlineWrite( instr.rd() );
+	};
+
+	auto MoveFrom = [&]( const uint32_t& source )
+	{
+		if ( instr.rd() != 0 )
+		{
+			m_emit.MovRegMem32( E::RAX, E::RBX, Offset( &source ) );
+			StoreRegister( instr.rd(), E::RAX );
+		}
+		CompleteInlineWrite( instr.rd() );
+	};
+
+	auto MoveTo = [&]( uint32_t& dest )
+	{
+		LoadRegister( E::RAX, instr.rs() );
+		m_emit.MovMemReg32( E::RBX, Offset( &dest ), E::RAX );
+		CompleteInlineWrite( 0 );
+	};
+
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::Special:
+		{
+			switch ( static_cast<SpecialOpcode>( instr.funct() ) )
+			{
+				case SpecialOpcode::AddUnsigned:					RegisterRegister( E::Add );			return true;
+				case SpecialOpcode::SubtractUnsigned:				RegisterRegister( E::Sub );			return true;
+				case SpecialOpcode::BitwiseAnd:						RegisterRegister( E::And );			return true;
+				case SpecialOpcode::BitwiseOr:						RegisterRegister( E::Or );			return true;
+				case SpecialOpcode::BitwiseXor:						RegisterRegister( E::Xor );			return true;
+				case SpecialOpcode::SetLessThan:					SetLessThan( E::Less, false );		return true;
+				case SpecialOpcode::SetLessThanUnsigned:			SetLessThan( E::Below, false );		return true;
+				case SpecialOpcode::ShiftLeftLogical:				Shift( E::Shl, false );				return true;
+				case SpecialOpcode::ShiftRightLogical:				Shift( E::Shr, false );				return true;
+				case SpecialOpcode::ShiftRightArithmetic:			Shift( E::Sar, false );				return true;
+				case SpecialOpcode::ShiftLeftLogicalVariable:		Shift( E::Shl, true );				return true;
+				case SpecialOpcode::ShiftRightLogicalVariable:		Shift( E::Shr, true );				return true;
+				case SpecialOpcode::ShiftRightArithmeticVariable:	Shift( E::Sar, true );				return true;
+				case SpecialOpcode::MoveFromHi:						MoveFrom( m_cpu.m_hi );				return true;
+				case SpecialOpcode::MoveFromLo:						MoveFrom( m_cpu.m_lo );				return true;
+				case SpecialOpcode::MoveToHi:						MoveTo( m_cpu.m_hi );				return true;
+				case SpecialOpcode::MoveToLo:						MoveTo( m_cpu.m_lo );				return true;
+
+				case SpecialOpcode::BitwiseNor:
+				{
+					if ( instr.rd() != 0 )
+					{
+						LoadRegister( E::RAX, instr.rs() );
+						LoadRegister( E::RCX, instr.rt() );
+						m_emit.AluRegReg32( E::Or, E::RAX, E::RCX );
+						m_emit.NotReg32( E::RAX );
+						StoreRegister( instr.rd(), E::RAX );
+					}
+					CompleteInlineWrite( instr.rd() );
+					return true;
+				}
+
+				default:
+					return false;
+			}
+		}
+
+		case Opcode::AddImmediateUnsigned:			RegisterImmediate( E::Add, instr.immediateSignExtended() );		return true;
+		case Opcode::BitwiseAndImmediate:			RegisterImmediate( E::And, instr.immediateUnsigned() );			return true;
+		case Opcode::BitwiseOrImmediate:			RegisterImmediate( E::Or, instr.immediateUnsigned() );			return true;
+		case Opcode::BitwiseXorImmediate:			RegisterImmediate( E::Xor, instr.immediateUnsigned() );			return true;
+		case Opcode::SetLessThanImmediate:			SetLessThan( E::Less, true );									return true;
+		case Opcode::SetLessThanImmediateUnsigned:	SetLessThan( E::Below, true );									return true;
+
+		case Opcode::LoadUpperImmediate:
+		{
+			if ( instr.rt() != 0 )
+				m_emit.MovMemImm32( E::RBX, RegisterOffset( instr.rt() ), instr.immediateUnsigned() << 16 );
+
+			CompleteInlineWrite( instr.rt() );
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+bool Recompiler::BlockCompiler::EmitMemoryAccess( const CachedInstruction& cached, uint32_t pc, bool inDelaySlot ) noexcept
+{
+	using E = X64Emitter;
+
+	// lockstep would repeat the access, which isn't safe for I/O
+	if ( !m_recompiler.m_fastmem || m_lockstep )
+		return false;
+
+	const Instruction instr = cached.instruction;
+
+	uint32_t size = 0;
+	bool store = false;
+	bool signExtend = false;
+	const void* function = nullptr;
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::LoadByte:				size = 1;	signExtend = true;	function = reinterpret_cast<const void*>( &Recompiler::ReadMemory<int8_t> );		break;
+		case Opcode::LoadByteUnsigned:		size = 1;						function = reinterpret_cast<const void*>( &Recompiler::ReadMemory<uint8_t> );		break;
+		case Opcode::LoadHalfword:			size = 2;	signExtend = true;	function = reinterpret_cast<const void*>( &Recompiler::ReadMemory<int16_t> );		break;
+		case Opcode::LoadHalfwordUnsigned:	size = 2;						function = reinterpret_cast<const void*>( &Recompiler::ReadMemory<uint16_t> );		break;
+		case Opcode::LoadWord:				size = 4;						function = reinterpret_cast<const void*>( &Recompiler::ReadMemory<uint32_t> );		break;
+		case Opcode::StoreByte:				size = 1;	store = true;		function = reinterpret_cast<const void*>( &Recompiler::WriteMemory<uint8_t> );		break;
+		case Opcode::StoreHalfword:			size = 2;	store = true;		function = reinterpret_cast<const void*>( &Recompiler::WriteMemory<uint16_t> );	break;
+		case Opcode::StoreWord:				size = 4;	store = true;		function = reinterpret_cast<const void*>( &Recompiler::WriteMemory<uint32_t> );	break;
+
+		default:
+			return false;
+	}
+
+	// address in eax
+	LoadRegister( E::RAX, instr.base() );
+	if ( instr.immediateSignExtended() != 0 )
+		m_emit.AluRegImm32( E::Add, E::RAX, instr.immediateSignExtended() );
+
+	// unaligned accesses raise an exception through the interpreter before any state changes
+	if ( size > 1 )
+	{
+		const size_t error = AddColdPath( ColdPath::Type::AddressError );
+		m_coldPaths[ error ].cached = &cached;
+		m_coldPaths[ error ].pc = pc;
+		m_coldPaths[ error ].materialize = !inDelaySlot;
+		m_coldPaths[ error ].pipelineFlagsKnown = m_pipelineFlagsKnown;
+
+		m_emit.TestRegImm32( E::RAX, size - 1 );
+		m_emit.Jump( E::NotEqual, m_coldPaths[ error ].entry );
+	}
+
+	const size_t slow = AddColdPath( store ? ColdPath::Type::Write : ColdPath::Type::Read );
+	m_coldPaths[ slow ].function = function;
+
+	// stored value in edx. Loads retire the previous load delay now, stores after the access
+	if ( store )
+		LoadRegister( E::RDX, instr.rt() );
+	else
+		CompleteInlineWrite( instr.rt() );
+
+	// the interpreter handles cache isolation
+	static_assert( Cop0::SystemStatus::IsolateCache == ( 1u << 16 ) );
+	m_emit.TestMemImm8( E::RBX, Offset( &m_cpu.m_cop0.m_systemStatus ) + 2, 1 );
+	m_emit.Jump( E::NotEqual, m_coldPaths[ slow ].entry );
+
+	if ( store )
+	{
+		// stores to pages with code go through the memory map so blocks are invalidated
+		m_emit.MovRegReg32( E::RCX, E::RAX );
+		m_emit.ShiftRegImm32( E::Shr, E::RCX, 12 );
+		m_emit.AluRegImm32( E::And, E::RCX, CodeCache::RamPageCount - 1 );
+		m_emit.MovRegPtr( E::R8, m_recompiler.m_codeCache.GetRamPageCodeFlags() );
+		m_emit.CmpMemIndexImm8( E::R8, E::RCX, 0 );
+		m_emit.Jump( E::NotEqual, m_coldPaths[ slow ].entry );
+	}
+
+	m_emit.MovRegPtr( E::RCX, m_recompiler.m_fastmem->GetBase() );
+
+	// faults here are patched into a jump to the slow path
+	uint8_t* site = m_emit.GetCursor();
+	switch ( size )
+	{
+		case 1:
+			if ( store )
+				m_emit.MovMemIndexReg8( E::RCX, E::RAX, E::RDX );
+			else
+				m_emit.MovxRegMemIndex8( E::RDX, E::RCX, E::RAX, signExtend );
+			break;
+
+		case 2:
+			if ( store )
+				m_emit.MovMemIndexReg16( E::RCX, E::RAX, E::RDX );
+			else
+				m_emit.MovxRegMemIndex16( E::RDX, E::RCX, E::RAX, signExtend );
+			break;
+
+		case 4:
+			if ( store )
+				m_emit.MovMemIndexReg32( E::RCX, E::RAX, E::RDX );
+			else
+				m_emit.MovRegMemIndex32( E::RDX, E::RCX, E::RAX );
+			break;
+	}
+
+	const size_t accessSize = static_cast<size_t>( m_emit.GetCursor() - site );
+	if ( accessSize < Fastmem::AccessSiteSize )
+		m_emit.Nop( Fastmem::AccessSiteSize - accessSize );
+
+	m_coldPaths[ slow ].accessSite = site;
+
+	// only RAM is mapped. The slow path gets its cycles from the memory map
+	if ( !store )
+	{
+		m_emit.MovRegPtr( E::RCX, &m_recompiler.m_eventManager.m_pendingCycles );
+		m_emit.AluMemImm32( E::Add, E::RCX, 0, MemoryMap::RamReadCycles );
+	}
+
+	m_emit.Bind( m_coldPaths[ slow ].resume );
+
+	if ( store )
+	{
+		CompleteInlineWrite( 0 );
+	}
+	else if ( instr.rt() != 0 )
+	{
+		// same as Registers::Load followed by Registers::Update
+		auto& registers = m_cpu.m_registers;
+		m_emit.MovMemReg32( E::RBX, Offset( &registers.m_loadDelay.value ), E::RDX );
+		m_emit.MovMemImm32( E::RBX, Offset( &registers.m_loadDelay.index ), instr.rt() );
+		m_loadDelayPending = true;
+	}
+
+	return true;
+}
+
+void Recompiler::BlockCompiler::EmitColdPath( ColdPath& cold ) noexcept
+{
+	using E = X64Emitter;
+
+	m_emit.Bind( cold.entry );
+
+	switch ( cold.type )
+	{
+		case ColdPath::Type::Read:
+		{
+			m_recompiler.m_fastmem->AddAccessSite( cold.accessSite, m_emit.GetCursor() );
+			m_emit.MovRegReg32( E::Arg1, E::RAX );
+			m_emit.MovRegReg64( E::Arg0, E::RBX );
+			m_emit.Call( cold.function );
+			m_emit.MovRegReg32( E::RDX, E::RAX );
+			m_emit.Jump( cold.resume );
+			break;
+		}
+
+		case ColdPath::Type::Write:
+		{
+			m_recompiler.m_fastmem->AddAccessSite( cold.accessSite, m_emit.GetCursor() );
+			if ( E::Arg2 != E::RDX )
+				m_emit.MovRegReg32( E::Arg2, E::RDX );
+
+			m_emit.MovRegReg32( E::Arg1, E::RAX );
+			m_emit.MovRegReg64( E::Arg0, E::RBX );
+			m_emit.Call( cold.function );
+			m_emit.Jump( cold.resume );
+			break;
+		}
+
+		case ColdPath::Type::AddressError:
+		{
+			// same state as MaterializeSequential at the time of the access
+			if ( cold.materialize )
+			{
+				StorePC( m_cpu.m_currentPC, cold.pc );
+				StorePC( m_cpu.m_pc, cold.pc + 4 );
+				StorePC( m_cpu.m_nextPC, cold.pc + 8 );
+
+				if ( !cold.pipelineFlagsKnown )
+				{
+					m_emit.MovMemImm8( E::RBX, Offset( &m_cpu.m_inBranch ), 0 );
+					m_emit.MovMemImm8( E::RBX, Offset( &m_cpu.m_inDelaySlot ), 0 );
+				}
+			}
+
+			m_emit.MovRegReg64( E::Arg0, E::RBX );
+			m_emit.MovRegImm32( E::Arg1, cold.cached->instruction.value );
+			m_emit.Call( reinterpret_cast<const void*>( cold.cached->handler ) );
+			UpdateLoadDelay();
+			m_emit.Jump( m_exitToDispatcher );
+			break;
+		}
+	}
+}
+
+void Recompiler::BlockCompiler::EmitFallback( const CachedInstruction& cached ) noexcept
+{
+	m_emit.MovRegReg64( X64Emitter::Arg0, X64Emitter::RBX );
+	m_emit.MovRegImm32( X64Emitter::Arg1, cached.instruction.value );
+	m_emit.Call( reinterpret_cast<const void*>( cached.handler ) );
+
+	const bool mayLoad = MayLoad( cached.instruction );
+	if ( m_loadDelayPending || mayLoad )
+		UpdateLoadDelay();
+
+	m_loadDelayPending = mayLoad;
+}
+
+size_t Recompiler::BlockCompiler::EmitBranch( size_t index, bool hasDelaySlot, uint32_t targets[ 2 ] ) noexcept
+{
+	using E = X64Emitter;
+
+	const CachedInstruction& cached = m_block.instructions[ index ];
+	const Instruction instr = cached.instruction;
+	const uint32_t pc = GetPC( index );
+
+	const uint32_t notTaken = pc + 8;
+	const uint32_t branchTarget = ( pc + 4 ) + ( instr.offset() << 2 );
+	const uint32_t jumpTarget = ( ( pc + 4 ) & 0xf0000000 ) | instr.target();
+
+	if ( m_lockstep )
+	{
+		MaterializeSequential( pc - 4 );
+		EmitLockstepBegin();
+	}
+
+	// the delay slot pipeline update overwrites everything except the destination
+	const bool fuseWithDelaySlot = hasDelaySlot && !m_lockstep;
+
+	// destination is in eax
+	auto SetDestination = [&]( bool link )
+	{
+		if ( fuseWithDelaySlot )
+		{
+			m_branchDestinationInRax = true;
+		}
+		else
+		{
+			m_emit.MovMemReg32( E::RBX, Offset( &m_cpu.m_nextPC ), E::RAX );
+			m_emit.MovMemImm8( E::RBX, Offset( &m_cpu.m_inBranch ), 1 );
+		}
+
+		// return address is written even if the branch is not taken
+		if ( link )
+			m_emit.MovMemImm32( E::RBX, RegisterOffset( MipsR3000Cpu::Registers::ReturnAddress ), notTaken );
+
+		CompleteInlineWrite( link ? static_cast<uint32_t>( MipsR3000Cpu::Registers::ReturnAddress ) : 0 );
+	};
+
+	auto ConditionalBranch = [&]( E::Condition condition, bool compareRegisters, bool link )
+	{
+		LoadRegister( E::RAX, instr.rs() );
+		if ( compareRegisters )
+		{
+			LoadRegister( E::RCX, instr.rt() );
+			m_emit.AluRegReg32( E::Cmp, E::RAX, E::RCX );
+		}
+		else
+		{
+			m_emit.AluRegImm32( E::Cmp, E::RAX, 0 );
+		}
+
+		m_emit.MovRegImm32( E::RAX, notTaken );
+		m_emit.MovRegImm32( E::RCX, branchTarget );
+		m_emit.CmovRegReg32( condition, E::RAX, E::RCX );
+		SetDestination( link );
+
+		targets[ 0 ] = branchTarget;
+		targets[ 1 ] = notTaken;
+		return ( branchTarget != notTaken ) ? size_t( 2 ) : size_t( 1 );
+	};
+
+	auto Jump = [&]( bool link )
+	{
+		m_emit.MovRegImm32( E::RAX, jumpTarget );
+		SetDestination( link );
+
+		targets[ 0 ] = jumpTarget;
+		return size_t( 1 );
+	};
+
+	size_t targetCount = 0;
+	bool handled = true;
+	switch ( static_cast<Opcode>( instr.op() ) )
+	{
+		case Opcode::BranchEqual:				targetCount = ConditionalBranch( E::Equal, true, false );			break;
+		case Opcode::BranchNotEqual:			targetCount = ConditionalBranch( E::NotEqual, true, false );		break;
+		case Opcode::BranchLessEqualZero:		targetCount = ConditionalBranch( E::LessEqual, false, false );		break;
+		case Opcode::BranchGreaterThanZero:		targetCount = ConditionalBranch( E::Greater, false, false );		break;
+		case Opcode::Jump:						targetCount = Jump( false );										break;
+		case Opcode::JumpAndLink:
+			if ( m_profiling )
+				EmitProfilerCall( jumpTarget, notTaken );
+
+			targetCount = Jump( true );
+			break;
+
+		case Opcode::RegisterImmediate:
+		{
+			// same decoding as the interpreter's REGIMM handlers
+			const bool link = ( instr.rt() & 0x1e ) == 0x10;
+			const bool greaterEqual = instr.rt() & 1;
+			targetCount = ConditionalBranch( greaterEqual ? E::GreaterEqual : E::Less, false, link );
+			break;
+		}
+
+		default:
+			handled = false;
+			break;
+	}
+
+	if ( handled )
+	{
+		m_materialized = false;
+
+		if ( m_lockstep )
+		{
+			StorePC( m_cpu.m_currentPC, pc );
+			StorePC( m_cpu.m_pc, pc + 4 );
+			m_emit.MovMemImm8( E::RBX, Offset( &m_cpu.m_inDelaySlot ), 0 );
+			EmitLockstepVerify( instr );
+		}
+		return targetCount;
+	}
+
+	// register jumps have no static target and need an alignment check
+	MaterializeSequential( pc );
+
+	const bool isReturn = static_cast<Opcode>( instr.op() ) == Opcode::Special &&
+		static_cast<SpecialOpcode>( instr.funct() ) == SpecialOpcode::JumpRegister &&
+		instr.rs() == MipsR3000Cpu::Registers::ReturnAddress;
+
+	if ( m_profiling && isReturn )
+	{
+		// the return is tracked inline, so the plain handler does the jump
+		EmitProfilerReturn();
+		EmitFallback( CachedInstruction{ MipsR3000Cpu::DecodeCachedHandler( instr ), instr } );
+	}
+	else
+	{
+		EmitFallback( cached );
+	}
+
+	m_emit.AluMemImm32( E::Cmp, E::RBX, Offset( &m_cpu.m_pc ), pc + 4 );
+	m_emit.Jump( E::NotEqual, m_exitToDispatcher );
+	m_materialized = false;
+	return 0;
+}
+
+void Recompiler::BlockCompiler::EmitDelaySlotPipeline( uint32_t pc ) noexcept
+{
+	if ( m_lockstep )
+		EmitLockstepBegin();
+
+	// same as MipsR3000Cpu::ExecuteBlock, with the PC being the branch destination
+	m_emit.MovMemImm8( X64Emitter::RBX, Offset( &m_cpu.m_inDelaySlot ), 1 );
+	m_emit.MovMemImm8( X64Emitter::RBX, Offset( &m_cpu.m_inBranch ), 0 );
+	StorePC( m_cpu.m_currentPC, pc );
+	if ( !m_branchDestinationInRax )
+		m_emit.MovRegMem32( X64Emitter::RAX, X64Emitter::RBX, Offset( &m_cpu.m_nextPC ) );
+
+	m_emit.MovMemReg32( X64Emitter::RBX, Offset( &m_cpu.m_pc ), X64Emitter::RAX );
+	m_emit.AluRegImm32( X64Emitter::Add, X64Emitter::RAX, 4 );
+	m_emit.MovMemReg32( X64Emitter::RBX, Offset( &m_cpu.m_nextPC ), X64Emitter::RAX );
+
+	m_pipelineFlagsKnown = false;
+	m_materialized = false;
+}
+
+void Recompiler::BlockCompiler::EmitProfilerCall( uint32_t target, uint32_t returnAddress ) noexcept
+{
+	using E = X64Emitter;
+	const Profiler& profiler = m_cpu.m_profiler;
+
+	static_assert( sizeof( Profiler::Frame ) == 8 && offsetof( Profiler::Frame, returnAddress ) == 4 );
+
+	// same as Profiler::OnCall
+	E::Label full;
+	E::Label done;
+	m_emit.MovRegMem32( E::RAX, E::RBX, Offset( &profiler.m_callDepth ) );
+	m_emit.AluRegImm32( E::Cmp, E::RAX, static_cast<uint32_t>( Profiler::MaxCallDepth ) );
+	m_emit.Jump( E::AboveEqual, full );
+	m_emit.MovRegImm64( E::RDX, ( static_cast<uint64_t>( returnAddress ) << 32 ) | target );
+	m_emit.MovRegPtr( E::RCX, profiler.m_callStack.data() );
+	m_emit.MovMemIndexReg64( E::RCX, E::RAX, 0, E::RDX );
+	m_emit.AluRegImm32( E::Add, E::RAX, 1 );
+	m_emit.MovMemReg32( E::RBX, Offset( &profiler.m_callDepth ), E::RAX );
+	m_emit.Jump( done );
+	m_emit.Bind( full );
+	m_emit.AluMemImm32( E::Add, E::RBX, Offset( &profiler.m_droppedCalls ), 1 );
+	m_emit.Bind( done );
+}
+
+void Recompiler::BlockCompiler::EmitProfilerReturn() noexcept
+{
+	using E = X64Emitter;
+	const Profiler& profiler = m_cpu.m_profiler;
+
+	// pops the top frame when returning to it. Anything else, like skipped frames, goes through Profiler::OnJump
+	E::Label miss;
+	E::Label done;
+	LoadRegister( E::RDX, MipsR3000Cpu::Registers::ReturnAddress );
+	m_emit.MovRegMem32( E::RAX, E::RBX, Offset( &profiler.m_callDepth ) );
+	m_emit.TestRegReg32( E::RAX, E::RAX );
+	m_emit.Jump( E::Equal, done );
+	m_emit.MovRegPtr( E::RCX, profiler.m_callStack.data() );
+	m_emit.CmpRegMemIndex32( E::RDX, E::RCX, E::RAX, -4 ); // return address of frame depth - 1
+	m_emit.Jump( E::NotEqual, miss );
+	m_emit.AluRegImm32( E::Sub, E::RAX, 1 );
+	m_emit.MovMemReg32( E::RBX, Offset( &profiler.m_callDepth ), E::RAX );
+	m_emit.Jump( done );
+	m_emit.Bind( miss );
+	m_emit.MovRegReg64( E::Arg0, E::RBX );
+	if ( E::Arg1 != E::RDX )
+		m_emit.MovRegReg32( E::Arg1, E::RDX );
+	m_emit.Call( reinterpret_cast<const void*>( &Recompiler::ProfileJump ) );
+	m_emit.Bind( done );
+}
+
+void Recompiler::BlockCompiler::EmitLockstepBegin() noexcept
+{
+	m_emit.MovRegPtr( X64Emitter::Arg0, &m_recompiler );
+	m_emit.Call( reinterpret_cast<const void*>( &Recompiler::LockstepBegin ) );
+}
+
+void Recompiler::BlockCompiler::EmitLockstepVerify( Instruction instr ) noexcept
+{
+	m_emit.MovRegPtr( X64Emitter::Arg0, &m_recompiler );
+	m_emit.MovRegImm32( X64Emitter::Arg1, instr.value );
+	m_emit.Call( reinterpret_cast<const void*>( &Recompiler::LockstepVerify ) );
+}
+
+void Recompiler::BlockCompiler::EmitLinkExit( uint32_t targetPC ) noexcept
+{
+	using E = X64Emitter;
+
+	auto link = std::make_unique<CodeBlockLink>();
+	link->source = &m_block;
+	link->targetPC = targetPC;
+
+	// stop when the next event is due or the run was stopped for an interrupt
+	m_emit.MovRegPtr( E::RAX, &m_recompiler.m_eventManager.m_pendingCycles );
+	m_emit.MovRegMem32( E::RAX, E::RAX, 0 );
+	m_emit.MovRegPtr( E::RCX, &m_recompiler.m_eventManager.m_cyclesUntilNextEvent );
+	m_emit.AluRegMem32( E::Cmp, E::RAX, E::RCX, 0 );
+	m_emit.Jump( E::GreaterEqual, m_exitToDispatcher );
+
+	// jumps to the next instruction until linked
+	link->jumpOperand = m_emit.Jump( m_emit.GetCursor() + 5 );
+	link->unlinkedTarget = m_emit.GetCursor();
+
+	m_emit.MovRegPtr( E::RAX, link.get() );
+	m_emit.Jump( m_recompiler.m_exit );
+
+	m_block.exitLinks.push_back( std::move( link ) );
+}
+
+Recompiler::Recompiler( MipsR3000Cpu& cpu, CodeCache& codeCache, EventManager& eventManager )
+	: m_cpu{ cpu }
+	, m_codeCache{ codeCache }
+	, m_eventManager{ eventManager }
+{
+	m_codeCache.SetInvalidateBlockCallback( [this]( CodeBlock& block ) { Unlink( block ); } );
+}
+
+Recompiler::~Recompiler()
+{
+	m_codeCache.SetInvalidateBlockCallback( nullptr );
+
+	if ( m_codeBuffer )
+		FreeExecutableMemory( m_codeBuffer, CodeBufferSize );
+}
+
+void Recompiler::Flush()
+{
+	m_codeCache.Reset();
+
+	if ( m_fastmem )
+		m_fastmem->ClearAccessSites();
+
+	if ( m_codeBuffer )
+		m_codeCursor = m_codeBuffer + ThunkSize;
+}
+
+bool Recompiler::Compile( CodeBlock& block, uint32_t pc )
+{
+	dbExpects( block.hostCode == nullptr );
+	dbExpects( CodeCache::GetBlockKey( pc ) == block.key );
+
+	if ( !m_codeBuffer )
+	{
+		// allocated on first use so the interpreters don't pay for it
+		m_codeBuffer = AllocateExecutableMemory( CodeBufferSize );
+		dbAssert( m_codeBuffer );
+		m_codeEnd = m_codeBuffer + CodeBufferSize;
+		EmitThunks();
+		m_codeCursor = m_codeBuffer + ThunkSize;
+	}
+
+	const size_t maxSize = MaxHostBytesPerBlock + block.instructions.size() * MaxHostBytesPerInstruction * ( m_cpu.EnableRecompilerLockstep ? 2 : 1 );
+	if ( static_cast<size_t>( m_codeEnd - m_codeCursor ) < maxSize )
+		return false;
+
+	X64Emitter emitter( m_codeCursor, maxSize );
+	BlockCompiler compiler( *this, block, pc, emitter );
+	compiler.Compile();
+	dbAssert( !emitter.HasOverflowed() );
+
+	block.hostCode = m_codeCursor;
+	block.hostPC = pc;
+
+	const size_t size = ( emitter.GetSize() + BlockAlignment - 1 ) & ~( BlockAlignment - 1 );
+	m_codeCursor += size;
+	return true;
+}
+
+CodeBlockLink* Recompiler::Execute( const CodeBlock& block ) noexcept
+{
+	dbExpects( block.hostCode );
+	return m_enter( &m_cpu, block.hostCode );
+}
+
+void Recompiler::Link( CodeBlockLink& link, CodeBlock& target ) noexcept
+{
+	dbExpects( link.source );
+	dbExpects( !link.target );
+	dbExpects( target.hostCode && target.hostPC == link.targetPC );
+
+	X64Emitter::PatchRel32( link.jumpOperand, target.hostCode );
+	link.target = &target;
+	target.incomingLinks.push_back( &link );
+}
+
+void Recompiler::SetFastmem( Fastmem* fastmem )
+{
+	// existing blocks were compiled for the previous window
+	Flush();
+	m_fastmem = fastmem;
+}
+
+void Recompiler::EmitThunks()
+{
+	X64Emitter emitter( m_codeBuffer, ThunkSize );
+
+	// CodeBlockLink* enter( MipsR3000Cpu* cpu, const uint8_t* code )
+	// rbx holds the cpu for the lifetime of the native code. Blocks jump between each other without touching the stack
+	m_enter = reinterpret_cast<EnterFunction>( emitter.GetCursor() );
+	emitter.Push( X64Emitter::RBX );
+	emitter.AluRegImm64( X64Emitter::Sub, X64Emitter::RSP, 32 ); // shadow space for calls, keeps the stack 16 byte aligned
+	emitter.MovRegReg64( X64Emitter::RBX, X64Emitter::Arg0 );
+	emitter.JumpReg( X64Emitter::Arg1 );
+
+	m_exit = emitter.GetCursor();
+	emitter.AluRegImm64( X64Emitter::Add, X64Emitter::RSP, 32 );
+	emitter.Pop( X64Emitter::RBX );
+	emitter.Ret();
+
+	dbAssert( !emitter.HasOverflowed() );
+}
+
+void Recompiler::Unlink( CodeBlock& block ) noexcept
+{
+	for ( CodeBlockLink* link : block.incomingLinks )
+		Unpatch( *link );
+
+	block.incomingLinks.clear();
+
+	// the block may still be executing. Make sure it returns to the dispatcher
+	for ( auto& link : block.exitLinks )
+	{
+		if ( link->target )
+		{
+			auto& incoming = link->target->incomingLinks;
+			incoming.erase( std::remove( incoming.begin(), incoming.end(), link.get() ), incoming.end() );
+			Unpatch( *link );
+		}
+		link->source = nullptr;
+	}
+}
+
+void Recompiler::Unpatch( CodeBlockLink& link ) noexcept
+{
+	X64Emitter::PatchRel32( link.jumpOperand, link.unlinkedTarget );
+	link.target = nullptr;
+}
+
+template <typename T>
+uint32_t Recompiler::ReadMemory( MipsR3000Cpu& cpu, uint32_t address ) noexcept
+{
+	using ExtendedType = std::conditional_t<std::is_signed_v<T>, int32_t, uint32_t>;
+	return static_cast<uint32_t>( static_cast<ExtendedType>( cpu.LoadImp<T>( address ) ) );
+}
+
+template <typename T>
+void Recompiler::WriteMemory( MipsR3000Cpu& cpu, uint32_t address, uint32_t value ) noexcept
+{
+	cpu.StoreImp<T>( address, static_cast<T>( value ) );
+}
+
+Recompiler::CpuState Recompiler::CaptureState() const noexcept
+{
+	const auto& registers = m_cpu.m_registers;
+
+	CpuState state;
+	state.registers = registers.m_registers;
+	state.loadDelayIndex = registers.m_loadDelay.index;
+	state.loadDelayValue = registers.m_loadDelay.value;
+	state.newLoadDelayIndex = registers.m_newLoadDelay.index;
+	state.newLoadDelayValue = registers.m_newLoadDelay.value;
+	state.hi = m_cpu.m_hi;
+	state.lo = m_cpu.m_lo;
+	state.currentPC = m_cpu.m_currentPC;
+	state.pc = m_cpu.m_pc;
+	state.nextPC = m_cpu.m_nextPC;
+	state.inBranch = m_cpu.m_inBranch;
+	state.inDelaySlot = m_cpu.m_inDelaySlot;
+	return state;
+}
+
+void Recompiler::RestoreState( const CpuState& state ) noexcept
+{
+	auto& registers = m_cpu.m_registers;
+
+	registers.m_registers = state.registers;
+	registers.m_loadDelay.index = state.loadDelayIndex;
+	registers.m_loadDelay.value = state.loadDelayValue;
+	registers.m_newLoadDelay.index = state.newLoadDelayIndex;
+	registers.m_newLoadDelay.value = state.newLoadDelayValue;
+	m_cpu.m_hi = state.hi;
+	m_cpu.m_lo = state.lo;
+	m_cpu.m_currentPC = state.currentPC;
+	m_cpu.m_pc = state.pc;
+	m_cpu.m_nextPC = state.nextPC;
+	m_cpu.m_inBranch = state.inBranch;
+	m_cpu.m_inDelaySlot = state.inDelaySlot;
+}
+
+bool Recompiler::StatesMatch( const CpuState& lhs, const CpuState& rhs ) noexcept
+{
+	// values of empty load delays don't matter
+	auto LoadDelaysMatch = []( uint32_t lhsIndex, uint32_t lhsValue, uint32_t rhsIndex, uint32_t rhsValue )
+	{
+		return lhsIndex == rhsIndex && ( lhsIndex == 0 || lhsValue == rhsValue );
+	};
+
+	return lhs.registers == rhs.registers &&
+		LoadDelaysMatch( lhs.loadDelayIndex, lhs.loadDelayValue, rhs.loadDelayIndex, rhs.loadDelayValue ) &&
+		LoadDelaysMatch( lhs.newLoadDelayIndex, lhs.newLoadDelayValue, rhs.newLoadDelayIndex, rhs.newLoadDelayValue ) &&
+		lhs.hi == rhs.hi &&
+		lhs.lo == rhs.lo &&
+		lhs.currentPC == rhs.currentPC &&
+		lhs.pc == rhs.pc &&
+		lhs.nextPC == rhs.nextPC &&
+		lhs.inBranch == rhs.inBranch &&
+		lhs.inDelaySlot == rhs.inDelaySlot;
+}
+
+void Recompiler::ProfileJump( MipsR3000Cpu& cpu, uint32_t target ) noexcept
+{
+	cpu.m_profiler.OnJump( target );
+}
+
+void Recompiler::LockstepBegin( Recompiler& recompiler ) noexcept
+{
+	recompiler.m_lockstepState = recompiler.CaptureState();
+}
+
+void Recompiler::LockstepVerify( Recompiler& recompiler, uint32_t instruction ) noexcept
+{
+	const CpuState native = recompiler.CaptureState();
+
+	// run the same instruction through the interpreter from the saved state
+	recompiler.RestoreState( recompiler.m_lockstepState );
+	recompiler.m_cpu.ExecuteReferenceInstruction( Instruction{ instruction } );
+	const CpuState reference = recompiler.CaptureState();
+
+	if ( !StatesMatch( native, reference ) )
+	{
+		dbLogError( "Recompiler::LockstepVerify -- mismatch at %08X [%08X]", reference.currentPC, instruction );
+		dbBreak();
+	}
+
+	// continue with the interpreter's result
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,355 @@
+#include "RenderCommands.h"
+
+#include <stdx/assert.h>
+
+#include <cstring>
+#include <type_traits>
+
+namespace PSX
+{
+
+namespace
+{
+
+struct TextureWindowArgs
+{
+	uint32_t maskX;
+	uint32_t maskY;
+	uint32_t offsetX;
+	uint32_t offsetY;
+};
+
+struct DrawAreaArgs
+{
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+};
+
+struct MaskBitsArgs
+{
+	bool setMask;
+	bool checkMask;
+};
+
+struct DrawModeArgs
+{
+	TexPage texPage;
+	ClutAttribute clut;
+	bool dither;
+};
+
+struct DisplayAreaArgs
+{
+	Renderer::DisplayArea vramDisplayArea;
+	Renderer::DisplayArea targetDisplayArea;
+	float aspectRatio;
+};
+
+struct VRamAreaArgs
+{
+	uint32_t left;
+	uint32_t top;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct FillVRamArgs
+{
+	VRamAreaArgs area;
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+};
+
+struct CopyVRamArgs
+{
+	uint32_t srcX;
+	uint32_t srcY;
+	uint32_t destX;
+	uint32_t destY;
+	uint32_t width;
+	uint32_t height;
+};
+
+template <size_t VertexCount>
+struct PrimitiveArgs
+{
+	Vertex vertices[ VertexCount ];
+	bool semiTransparent;
+};
+
+template <typename T>
+T ReadPayload( const void* payload ) noexcept
+{
+	static_assert( std::is_trivially_copyable_v<T> );
+	T value;
+	std::memcpy( &value, payload, sizeof( T ) );
+	return value;
+}
+
+// size of the arguments before any trailing data
+constexpr size_t GetArgsSize( RenderCommand command ) noexcept
+{
+	switch ( command )
+	{
+		case RenderCommand::Reset:						return 0;
+		case RenderCommand::SetTextureWindow:			return sizeof( TextureWindowArgs );
+		case RenderCommand::SetDrawArea:				return sizeof( DrawAreaArgs );
+		case RenderCommand::SetSemiTransparencyMode:	return sizeof( SemiTransparencyMode );
+		case RenderCommand::SetMaskBits:				return sizeof( MaskBitsArgs );
+		case RenderCommand::SetDrawMode:				return sizeof( DrawModeArgs );
+		case RenderCommand::SetColorDepth:				return sizeof( DisplayAreaColorDepth );
+		case RenderCommand::SetDisplayEnable:			return sizeof( bool );
+		case RenderCommand::SetRealColor:				return sizeof( bool );
+		case RenderCommand::SetDisplayArea:				return sizeof( DisplayAreaArgs );
+		case RenderCommand::UpdateVRam:					return sizeof( VRamAreaArgs );
+		case RenderCommand::FillVRam:					return sizeof( FillVRamArgs );
+		case RenderCommand::CopyVRam:					return sizeof( CopyVRamArgs );
+		case RenderCommand::PushTriangle:				return sizeof( PrimitiveArgs<3> );
+		case RenderCommand::PushQuad:					return sizeof( PrimitiveArgs<4> );
+		case RenderCommand::DisplayFrame:				return 0;
+		case RenderCommand::Count:						break;
+	}
+	return 0;
+}
+
+}
+
+const char* GetRenderCommandName( RenderCommand command ) noexcept
+{
+	switch ( command )
+	{
+		case RenderCommand::Reset:						return "Reset";
+		case RenderCommand::SetTextureWindow:			return "SetTextureWindow";
+		case RenderCommand::SetDrawArea:				return "SetDrawArea";
+		case RenderCommand::SetSemiTransparencyMode:	return "SetSemiTransparencyMode";
+		case RenderCommand::SetMaskBits:				return "SetMaskBits";
+		case RenderCommand::SetDrawMode:				return "SetDrawMode";
+		case RenderCommand::SetColorDepth:				return "SetColorDepth";
+		case RenderCommand::SetDisplayEnable:			return "SetDisplayEnable";
+		case RenderCommand::SetRealColor:				return "SetRealColor";
+		case RenderCommand::SetDisplayArea:				return "SetDisplayArea";
+		case RenderCommand::UpdateVRam:					return "UpdateVRam";
+		case RenderCommand::FillVRam:					return "FillVRam";
+		case RenderCommand::CopyVRam:					return "CopyVRam";
+		case RenderCommand::PushTriangle:				return "PushTriangle";
+		case RenderCommand::PushQuad:					return "PushQuad";
+		case RenderCommand::DisplayFrame:				return "DisplayFrame";
+		case RenderCommand::Count:						break;
+	}
+	return "Unknown";
+}
+
+bool IsValidRenderCommand( RenderCommand command, const void* payload, size_t payloadSize ) noexcept
+{
+	if ( command >= RenderCommand::Count || payloadSize < GetArgsSize( command ) )
+		return false;
+
+	if ( command != RenderCommand::UpdateVRam )
+		return payloadSize == GetArgsSize( command );
+
+	const auto args = ReadPayload<VRamAreaArgs>( payload );
+	if ( args.left >= VRamWidth || args.top >= VRamHeight || args.width > VRamWidth || args.height > VRamHeight )
+		return false;
+
+	return payloadSize == sizeof( VRamAreaArgs ) + size_t( args.width ) * args.height * sizeof( uint16_t );
+}
+
+void ExecuteRenderCommand( Renderer& renderer, RenderCommand command, const void* payload )
+{
+	switch ( command )
+	{
+		case RenderCommand::Reset:
+			renderer.Reset();
+			break;
+
+		case RenderCommand::SetTextureWindow:
+		{
+			const auto args = ReadPayload<TextureWindowArgs>( payload );
+			renderer.SetTextureWindow( args.maskX, args.maskY, args.offsetX, args.offsetY );
+			break;
+		}
+
+		case RenderCommand::SetDrawArea:
+		{
+			const auto args = ReadPayload<DrawAreaArgs>( payload );
+			renderer.SetDrawArea( args.left, args.top, args.right, args.bottom );
+			break;
+		}
+
+		case RenderCommand::SetSemiTransparencyMode:
+			renderer.SetSemiTransparencyMode( ReadPayload<SemiTransparencyMode>( payload ) );
+			break;
+
+		case RenderCommand::SetMaskBits:
+		{
+			const auto args = ReadPayload<MaskBitsArgs>( payload );
+			renderer.SetMaskBits( args.setMask, args.checkMask );
+			break;
+		}
+
+		case RenderCommand::SetDrawMode:
+		{
+			const auto args = ReadPayload<DrawModeArgs>( payload );
+			renderer.SetDrawMode( args.texPage, args.clut, args.dither );
+			break;
+		}
+
+		case RenderCommand::SetColorDepth:
+			renderer.SetColorDepth( ReadPayload<DisplayAreaColorDepth>( payload ) );
+			break;
+
+		case RenderCommand::SetDisplayEnable:
+			renderer.SetDisplayEnable( ReadPayload<bool>( payload ) );
+			break;
+
+		case RenderCommand::SetRealColor:
+			renderer.SetRealColor( ReadPayload<bool>( payload ) );
+			break;
+
+		case RenderCommand::SetDisplayArea:
+		{
+			const auto args = ReadPayload<DisplayAreaArgs>( payload );
+			renderer.SetDisplayArea( args.vramDisplayArea, args.targetDisplayArea, args.aspectRatio );
+			break;
+		}
+
+		case RenderCommand::UpdateVRam:
+		{
+			const auto args = ReadPayload<VRamAreaArgs>( payload );
+			const auto* pixels = reinterpret_cast<const uint16_t*>( static_cast<const char*>( payload ) + sizeof( VRamAreaArgs ) );
+			renderer.UpdateVRam( args.left, args.top, args.width, args.height, pixels );
+			break;
+		}
+
+		case RenderCommand::FillVRam:
+		{
+			const auto args = ReadPayload<FillVRamArgs>( payload );
+			renderer.FillVRam( args.area.left, args.area.top, args.area.width, args.area.height, args.r, args.g, args.b );
+			break;
+		}
+
+		case RenderCommand::CopyVRam:
+		{
+			const auto args = ReadPayload<CopyVRamArgs>( payload );
+			renderer.CopyVRam( args.srcX, args.srcY, args.destX, args.destY, args.width, args.height );
+			break;
+		}
+
+		case RenderCommand::PushTriangle:
+		{
+			auto args = ReadPayload<PrimitiveArgs<3>>( payload );
+			renderer.PushTriangle( args.vertices, args.semiTransparent );
+			break;
+		}
+
+		case RenderCommand::PushQuad:
+		{
+			auto args = ReadPayload<PrimitiveArgs<4>>( payload );
+			renderer.PushQuad( args.vertices, args.semiTransparent );
+			break;
+		}
+
+		case RenderCommand::DisplayFrame:
+			renderer.DisplayFrame();
+			break;
+
+		case RenderCommand::Count:
+			dbBreak();
+			break;
+	}
+}
+
+template <typename T>
+void RenderCommandEncoder::PushCommand( RenderCommand command, const T& payload )
+{
+	static_assert( std::is_trivially_copyable_v<T> );
+	std::memcpy( BeginCommand( command, sizeof( T ) ), &payload, sizeof( T ) );
+	EndCommand();
+}
+
+void RenderCommandEncoder::Reset()
+{
+	BeginCommand( RenderCommand::Reset, 0 );
+	EndCommand();
+}
+
+void RenderCommandEncoder::SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY )
+{
+	PushCommand( RenderCommand::SetTextureWindow, TextureWindowArgs{ maskX, maskY, offsetX, offsetY } );
+}
+
+void RenderCommandEncoder::SetDrawArea( int32_t left, int32_t top, int32_t right, int32_t bottom )
+{
+	PushCommand( RenderCommand::SetDrawArea, DrawAreaArgs{ left, top, right, bottom } );
+}
+
+void RenderCommandEncoder::SetSemiTransparencyMode( SemiTransparencyMode semiTransparencyMode )
+{
+	PushCommand( RenderCommand::SetSemiTransparencyMode, semiTransparencyMode );
+}
+
+void RenderCommandEncoder::SetMaskBits( bool setMask, bool checkMask )
+{
+	PushCommand( RenderCommand::SetMaskBits, MaskBitsArgs{ setMask, checkMask } );
+}
+
+void RenderCommandEncoder::SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither )
+{
+	PushCommand( RenderCommand::SetDrawMode, DrawModeArgs{ texPage, clut, dither } );
+}
+
+void RenderCommandEncoder::SetColorDepth( DisplayAreaColorDepth colorDepth )
+{
+	PushCommand( RenderCommand::SetColorDepth, colorDepth );
+}
+
+void RenderCommandEncoder::SetDisplayEnable( bool enable )
+{
+	PushCommand( RenderCommand::SetDisplayEnable, enable );
+}
+
+void RenderCommandEncoder::SetRealColor( bool realColor )
+{
+	PushCommand( RenderCommand::SetRealColor, realColor );
+}
+
+void RenderCommandEncoder::SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio )
+{
+	PushCommand( RenderCommand::SetDisplayArea, DisplayAreaArgs{ vramDisplayArea, targetDisplayArea, aspectRatio } );
+}
+
+void RenderCommandEncoder::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels )
+{
+	const size_t pixelsSize = size_t( width ) * height * sizeof( uint16_t );
+	auto* payload = static_cast<char*>( BeginCommand( RenderCommand::UpdateVRam, sizeof( VRamAreaArgs ) + pixelsSize ) );
+
+	const VRamAreaArgs args{ left, top, width, height };
+	std::memcpy( payload, &args, sizeof( args ) );
+	std::memcpy( payload + sizeof( args ), pixels, pixelsSize );
+	EndCommand();
+}
+
+void RenderCommandEncoder::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b )
+{
+	PushCommand( RenderCommand::FillVRam, FillVRamArgs{ { left, top, width, height }, r, g, b } );
+}
+
+void RenderCommandEncoder::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height )
+{
+	PushCommand( RenderCommand::CopyVRam, CopyVRamArgs{ srcX, srcY, destX, destY, width, height } );
+}
+
+void RenderCommandEncoder::PushTriangle( Vertex vertices[ 3 ], bool semiTransparent )
+{
+	PushCommand( RenderCommand::PushTriangle, PrimitiveArgs<3>{ { vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] }, semiTransparent } );
+}
+
+void RenderCommandEncoder::PushQuad( Vertex vertices[ 4 ], bool semiTransparent )
+{
+	PushCommand( RenderCommand::PushQuad, PrimitiveArgs<4>{ { vertices[ 0 ], vertices[ 1 ], vertices[ 2 ], vertices[ 3 ] }, semiTransparent } );
+}
+
+}
\ No newline at end of file
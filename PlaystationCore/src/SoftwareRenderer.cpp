@@ -0,0 +1,583 @@
+#include "SoftwareRenderer.h"
+
+#include "DisplayShader.h"
+
+#include <stdx/assert.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace PSX
+{
+
+namespace
+{
+
+constexpr std::array<std::array<int32_t, 4>, 4> DitherTable
+{ {
+	{ -4, 0, -3, 1 },
+	{ 2, -2, 3, -1 },
+	{ -3, 1, -4, 0 },
+	{ 3, -1, 2, -2 }
+} };
+
+constexpr int64_t FloorDivide( int64_t numerator, int64_t denominator ) noexcept
+{
+	const int64_t quotient = numerator / denominator;
+	return ( numerator % denominator != 0 && ( numerator < 0 ) != ( denominator < 0 ) ) ? quotient - 1 : quotient;
+}
+
+constexpr uint16_t Convert24To15( uint8_t r, uint8_t g, uint8_t b ) noexcept
+{
+	return static_cast<uint16_t>( ( r >> 3 ) | ( ( g >> 3 ) << 5 ) | ( ( b >> 3 ) << 10 ) );
+}
+
+constexpr uint8_t Convert5To8( uint32_t c ) noexcept
+{
+	return static_cast<uint8_t>( ( c * 255 + 15 ) / 31 );
+}
+
+// barycentric weight of the vertex opposite to the edge. Doubles as the numerator of interpolated attributes
+struct EdgeFunction
+{
+	EdgeFunction( const Position& a, const Position& b, int32_t x, int32_t y ) noexcept
+		: stepX{ a.y - b.y }
+		, stepY{ b.x - a.x }
+		, value{ static_cast<int64_t>( b.x - a.x ) * ( y - a.y ) - static_cast<int64_t>( b.y - a.y ) * ( x - a.x ) }
+		// pixels on top and left edges are drawn, pixels on bottom and right edges belong to the neighbouring triangle
+		, minValue{ ( ( a.y == b.y && b.x > a.x ) || b.y < a.y ) ? 0 : 1 }
+	{}
+
+	int32_t stepX;
+	int32_t stepY;
+	int64_t value;
+	int32_t minValue;
+};
+
+// attribute interpolated over the triangle as a numerator of the doubled triangle area
+struct Attribute
+{
+	Attribute( int32_t a0, int32_t a1, int32_t a2, const EdgeFunction& w0, const EdgeFunction& w1, const EdgeFunction& w2 ) noexcept
+		: stepX{ static_cast<int64_t>( a0 ) * w0.stepX + static_cast<int64_t>( a1 ) * w1.stepX + static_cast<int64_t>( a2 ) * w2.stepX }
+		, stepY{ static_cast<int64_t>( a0 ) * w0.stepY + static_cast<int64_t>( a1 ) * w1.stepY + static_cast<int64_t>( a2 ) * w2.stepY }
+		, value{ a0 * w0.value + a1 * w1.value + a2 * w2.value }
+	{}
+
+	int64_t stepX;
+	int64_t stepY;
+	int64_t value;
+};
+
+}
+
+SoftwareRenderer::SoftwareRenderer()
+	: m_vram{ std::make_unique<uint16_t[]>( VRamWidth * VRamHeight ) }
+{}
+
+bool SoftwareRenderer::Initialize( SDL_Window* window )
+{
+	m_window = window;
+	if ( !window )
+		return true;
+
+	m_noAttributeVAO = Render::VertexArrayObject::Create();
+
+	m_displayShader = Render::Shader::Compile( DisplayVertexShader, DisplayFragmentShader );
+	dbAssert( m_displayShader.Valid() );
+
+	m_displayTexture = Render::Texture2D::Create();
+	m_displayTexture.SetLinearFilering( true );
+
+	return true;
+}
+
+void SoftwareRenderer::Reset()
+{
+	std::fill_n( m_vram.get(), VRamWidth * VRamHeight, uint16_t( 0 ) );
+
+	m_vramDisplayArea = {};
+	m_targetDisplayArea = {};
+	m_aspectRatio = 0.0f;
+
+	m_colorDepth = DisplayAreaColorDepth::B15;
+	m_displayEnable = false;
+
+	m_drawAreaLeft = 0;
+	m_drawAreaTop = 0;
+	m_drawAreaRight = 0;
+	m_drawAreaBottom = 0;
+
+	m_semiTransparencyMode = SemiTransparencyMode::Blend;
+
+	m_forceMaskBit = 0;
+	m_checkMaskBit = false;
+	m_dither = false;
+
+	m_texPage.value = 0;
+	m_texPage.textureDisable = true;
+	m_clut.value = 0;
+
+	SetTextureWindow( 0, 0, 0, 0 );
+}
+
+void SoftwareRenderer::EnableVRamView( bool enable )
+{
+	if ( m_window )
+	{
+		if ( !m_viewVRam && enable )
+		{
+			SDL_GetWindowSize( m_window, &m_cachedWindowWidth, &m_cachedWindowHeight );
+			SDL_SetWindowSize( m_window, VRamWidth, VRamHeight );
+			SDL_SetWindowResizable( m_window, SDL_FALSE );
+		}
+		else if ( m_viewVRam && !enable )
+		{
+			SDL_SetWindowSize( m_window, m_cachedWindowWidth, m_cachedWindowHeight );
+			SDL_SetWindowResizable( m_window, SDL_TRUE );
+		}
+	}
+
+	m_viewVRam = enable;
+}
+
+void SoftwareRenderer::SetTextureWindow( uint32_t maskX, uint32_t maskY, uint32_t offsetX, uint32_t offsetY )
+{
+	// masked bits of the texture coordinate are replaced by the offset. Both are in 8 pixel steps
+	m_texWindowAndX = ~( maskX * 8 ) & 0xff;
+	m_texWindowAndY = ~( maskY * 8 ) & 0xff;
+	m_texWindowOrX = ( offsetX & maskX ) * 8;
+	m_texWindowOrY = ( offsetY & maskY ) * 8;
+}
+
+void SoftwareRenderer::SetDrawArea( int32_t left, int32_t top, int32_t right, int32_t bottom )
+{
+	m_drawAreaLeft = std::max( left, 0 );
+	m_drawAreaTop = std::max( top, 0 );
+	m_drawAreaRight = std::min<int32_t>( right, VRamWidth - 1 );
+	m_drawAreaBottom = std::min<int32_t>( bottom, VRamHeight - 1 );
+}
+
+void SoftwareRenderer::SetMaskBits( bool setMask, bool checkMask )
+{
+	m_forceMaskBit = setMask ? MaskBit : 0;
+	m_checkMaskBit = checkMask;
+}
+
+void SoftwareRenderer::SetDrawMode( TexPage texPage, ClutAttribute clut, bool dither )
+{
+	m_texPage = texPage;
+	m_clut = clut;
+	m_dither = dither;
+
+	// 5-6   Semi Transparency     (0=B/2+F/2, 1=B+F, 2=B-F, 3=B+F/4)   ;GPUSTAT.5-6
+	m_semiTransparencyMode = static_cast<SemiTransparencyMode>( texPage.semiTransparencymode );
+}
+
+void SoftwareRenderer::SetDisplayArea( const DisplayArea& vramDisplayArea, const DisplayArea& targetDisplayArea, float aspectRatio )
+{
+	m_vramDisplayArea = vramDisplayArea;
+	m_targetDisplayArea = targetDisplayArea;
+	m_aspectRatio = aspectRatio;
+}
+
+void SoftwareRenderer::UpdateVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, const uint16_t* pixels )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+	dbExpects( width > 0 );
+	dbExpects( height > 0 );
+
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		for ( uint32_t x = 0; x < width; ++x )
+			WritePixel( left + x, top + y, *pixels++ );
+	}
+}
+
+void SoftwareRenderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+	dbExpects( width > 0 );
+	dbExpects( height > 0 );
+
+	for ( uint32_t y = top; y < top + height; ++y )
+	{
+		for ( uint32_t x = left; x < left + width; ++x )
+			vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ] = VRamPixel( x, y );
+	}
+}
+
+void SoftwareRenderer::FillVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b )
+{
+	dbExpects( left < VRamWidth );
+	dbExpects( top < VRamHeight );
+	dbExpects( width > 0 );
+	dbExpects( height > 0 );
+
+	// not affected by the mask settings and clears the mask bit
+	const uint16_t color = Convert24To15( r, g, b );
+	for ( uint32_t y = top; y < top + height; ++y )
+	{
+		for ( uint32_t x = left; x < left + width; ++x )
+			VRamPixel( x, y ) = color;
+	}
+}
+
+void SoftwareRenderer::CopyVRam( uint32_t srcX, uint32_t srcY, uint32_t destX, uint32_t destY, uint32_t width, uint32_t height )
+{
+	// rows are read before they are written, so overlapping copies within a row don't repeat pixels
+	std::array<uint16_t, VRamWidth> row;
+	width = std::min( width, VRamWidth );
+
+	for ( uint32_t y = 0; y < height; ++y )
+	{
+		for ( uint32_t x = 0; x < width; ++x )
+			row[ x ] = VRamPixel( srcX + x, srcY + y );
+
+		for ( uint32_t x = 0; x < width; ++x )
+			WritePixel( destX + x, destY + y, row[ x ] );
+	}
+}
+
+uint16_t SoftwareRenderer::SampleTexture( uint32_t u, uint32_t v ) const noexcept
+{
+	u = ( u & m_texWindowAndX ) | m_texWindowOrX;
+	v = ( v & m_texWindowAndY ) | m_texWindowOrY;
+
+	const uint32_t pageX = m_texPage.texturePageBaseX * TexturePageBaseXMult;
+	const uint32_t pageY = m_texPage.texturePageBaseY * TexturePageBaseYMult + v;
+
+	auto read = [this]( uint32_t x, uint32_t y )
+	{
+		return m_vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ];
+	};
+
+	const uint32_t clutX = m_clut.x * ClutBaseXMult;
+	const uint32_t clutY = m_clut.y * ClutBaseYMult;
+
+	switch ( static_cast<TexturePageColors>( m_texPage.texturePageColors ) )
+	{
+		case TexturePageColors::B4:
+		{
+			const uint32_t index = ( read( pageX + u / 4, pageY ) >> ( ( u % 4 ) * 4 ) ) & 0xf;
+			return read( clutX + index, clutY );
+		}
+
+		case TexturePageColors::B8:
+		{
+			const uint32_t index = ( read( pageX + u / 2, pageY ) >> ( ( u % 2 ) * 8 ) ) & 0xff;
+			return read( clutX + index, clutY );
+		}
+
+		default:
+			return read( pageX + u, pageY );
+	}
+}
+
+uint16_t SoftwareRenderer::Blend( uint16_t back, uint16_t front ) const noexcept
+{
+	uint16_t result = front & MaskBit;
+	for ( uint32_t shift = 0; shift < 15; shift += 5 )
+	{
+		const int32_t b = ( back >> shift ) & 0x1f;
+		const int32_t f = ( front >> shift ) & 0x1f;
+
+		int32_t c = 0;
+		switch ( m_semiTransparencyMode )
+		{
+			case SemiTransparencyMode::Blend:			c = ( b + f ) / 2;				break;
+			case SemiTransparencyMode::Add:				c = std::min( b + f, 0x1f );	break;
+			case SemiTransparencyMode::ReverseSubtract:	c = std::max( b - f, 0 );		break;
+			case SemiTransparencyMode::AddQuarter:		c = std::min( b + f / 4, 0x1f );	break;
+		}
+
+		result |= static_cast<uint16_t>( c << shift );
+	}
+	return result;
+}
+
+template <bool Textured, bool SemiTransparent, bool Dither>
+void SoftwareRenderer::DrawTriangle( const Vertex& v0, const Vertex& v1, const Vertex& v2 ) noexcept
+{
+	const Position& p0 = v0.position;
+	const Position& p1 = v1.position;
+	const Position& p2 = v2.position;
+
+	// doubled signed area. The caller orders the vertices so it is positive
+	const int64_t area = static_cast<int64_t>( p1.x - p0.x ) * ( p2.y - p0.y ) - static_cast<int64_t>( p1.y - p0.y ) * ( p2.x - p0.x );
+	dbAssert( area > 0 );
+
+	// pixel centers are sampled at integer coordinates
+	const int32_t minX = std::max<int32_t>( std::min( { p0.x, p1.x, p2.x } ), m_drawAreaLeft );
+	const int32_t maxX = std::min<int32_t>( std::max( { p0.x, p1.x, p2.x } ), m_drawAreaRight );
+	const int32_t minY = std::max<int32_t>( std::min( { p0.y, p1.y, p2.y } ), m_drawAreaTop );
+	const int32_t maxY = std::min<int32_t>( std::max( { p0.y, p1.y, p2.y } ), m_drawAreaBottom );
+	if ( minX > maxX || minY > maxY )
+		return;
+
+	EdgeFunction w0( p1, p2, minX, minY );
+	EdgeFunction w1( p2, p0, minX, minY );
+	EdgeFunction w2( p0, p1, minX, minY );
+
+	Attribute r( v0.color.r, v1.color.r, v2.color.r, w0, w1, w2 );
+	Attribute g( v0.color.g, v1.color.g, v2.color.g, w0, w1, w2 );
+	Attribute b( v0.color.b, v1.color.b, v2.color.b, w0, w1, w2 );
+	Attribute u( v0.texCoord.u, v1.texCoord.u, v2.texCoord.u, w0, w1, w2 );
+	Attribute v( v0.texCoord.v, v1.texCoord.v, v2.texCoord.v, w0, w1, w2 );
+
+	// colors are rounded, texture coordinates are truncated
+	auto roundColor = [area]( int64_t value ) { return static_cast<int32_t>( ( 2 * value + area ) / ( 2 * area ) ); };
+
+	for ( int32_t y = minY; y <= maxY; ++y )
+	{
+		int64_t e0 = w0.value;
+		int64_t e1 = w1.value;
+		int64_t e2 = w2.value;
+		int64_t rValue = r.value;
+		int64_t gValue = g.value;
+		int64_t bValue = b.value;
+		int64_t uValue = u.value;
+		int64_t vValue = v.value;
+
+		for ( int32_t x = minX; x <= maxX; ++x )
+		{
+			if ( e0 >= w0.minValue && e1 >= w1.minValue && e2 >= w2.minValue )
+			{
+				std::array<int32_t, 3> color{ roundColor( rValue ), roundColor( gValue ), roundColor( bValue ) };
+				uint16_t texel = 0;
+
+				if constexpr ( Textured )
+				{
+					const auto texU = static_cast<uint32_t>( FloorDivide( uValue, area ) ) & 0xff;
+					const auto texV = static_cast<uint32_t>( FloorDivide( vValue, area ) ) & 0xff;
+					texel = SampleTexture( texU, texV );
+
+					// modulate 5 bit texel by 8 bit color where 128 is the texel's brightness
+					for ( uint32_t i = 0; i < 3; ++i )
+						color[ i ] = ( ( ( texel >> ( i * 5 ) ) & 0x1f ) * color[ i ] ) >> 4;
+				}
+
+				// texel 0 is fully transparent
+				if ( !Textured || texel != 0 )
+				{
+					const int32_t ditherOffset = Dither ? DitherTable[ y % 4 ][ x % 4 ] : 0;
+
+					uint16_t pixel = texel & MaskBit;
+					for ( uint32_t i = 0; i < 3; ++i )
+						pixel |= static_cast<uint16_t>( ( std::clamp( color[ i ] + ditherOffset, 0, 0xff ) >> 3 ) << ( i * 5 ) );
+
+					// textured pixels are semi transparent if the texel's mask bit is set
+					if ( SemiTransparent && ( !Textured || ( texel & MaskBit ) ) )
+						pixel = Blend( VRamPixel( x, y ), pixel );
+
+					WritePixel( x, y, pixel );
+				}
+			}
+
+			e0 += w0.stepX;
+			e1 += w1.stepX;
+			e2 += w2.stepX;
+			rValue += r.stepX;
+			gValue += g.stepX;
+			bValue += b.stepX;
+			uValue += u.stepX;
+			vValue += v.stepX;
+		}
+
+		w0.value += w0.stepY;
+		w1.value += w1.stepY;
+		w2.value += w2.stepY;
+		r.value += r.stepY;
+		g.value += g.stepY;
+		b.value += b.stepY;
+		u.value += u.stepY;
+		v.value += v.stepY;
+	}
+}
+
+void SoftwareRenderer::PushTriangle( Vertex vertices[ 3 ], bool semiTransparent )
+{
+	const Position& p0 = vertices[ 0 ].position;
+	const Position& p1 = vertices[ 1 ].position;
+	const Position& p2 = vertices[ 2 ].position;
+
+	const int64_t area = static_cast<int64_t>( p1.x - p0.x ) * ( p2.y - p0.y ) - static_cast<int64_t>( p1.y - p0.y ) * ( p2.x - p0.x );
+	if ( area == 0 )
+		return;
+
+	const Vertex& v0 = vertices[ 0 ];
+	const Vertex& v1 = ( area > 0 ) ? vertices[ 1 ] : vertices[ 2 ];
+	const Vertex& v2 = ( area > 0 ) ? vertices[ 2 ] : vertices[ 1 ];
+
+	// primitives carry their own texture page
+	m_texPage = v0.texPage;
+	m_clut = v0.clut;
+
+	const bool textured = !v0.texPage.textureDisable;
+
+	using DrawFunction = void ( SoftwareRenderer::* )( const Vertex&, const Vertex&, const Vertex& ) noexcept;
+	static constexpr DrawFunction DrawFunctions[ 2 ][ 2 ][ 2 ]
+	{
+		{
+			{ &SoftwareRenderer::DrawTriangle<false, false, false>, &SoftwareRenderer::DrawTriangle<false, false, true> },
+			{ &SoftwareRenderer::DrawTriangle<false, true, false>, &SoftwareRenderer::DrawTriangle<false, true, true> }
+		},
+		{
+			{ &SoftwareRenderer::DrawTriangle<true, false, false>, &SoftwareRenderer::DrawTriangle<true, false, true> },
+			{ &SoftwareRenderer::DrawTriangle<true, true, false>, &SoftwareRenderer::DrawTriangle<true, true, true> }
+		}
+	};
+
+	( this->*DrawFunctions[ textured ][ semiTransparent ][ m_dither ] )( v0, v1, v2 );
+}
+
+void SoftwareRenderer::PushQuad( Vertex vertices[ 4 ], bool semiTransparent )
+{
+	PushTriangle( vertices, semiTransparent );
+	PushTriangle( vertices + 1, semiTransparent );
+}
+
+std::vector<uint8_t> SoftwareRenderer::ConvertDisplayArea( uint32_t& width, uint32_t& height ) const
+{
+	auto read = [this]( uint32_t x, uint32_t y )
+	{
+		return m_vram[ ( x & VRamWidthMask ) + ( y & VRamHeightMask ) * VRamWidth ];
+	};
+
+	if ( m_viewVRam )
+	{
+		width = VRamWidth;
+		height = VRamHeight;
+		std::vector<uint8_t> pixels( width * height * 3 );
+		uint8_t* dest = pixels.data();
+		for ( uint32_t y = 0; y < height; ++y )
+		{
+			for ( uint32_t x = 0; x < width; ++x )
+			{
+				const uint16_t color = read( x, y );
+				*dest++ = Convert5To8( color & 0x1f );
+				*dest++ = Convert5To8( ( color >> 5 ) & 0x1f );
+				*dest++ = Convert5To8( ( color >> 10 ) & 0x1f );
+			}
+		}
+		return pixels;
+	}
+
+	width = m_targetDisplayArea.width;
+	height = m_targetDisplayArea.height;
+	std::vector<uint8_t> pixels( width * height * 3 );
+	if ( !m_displayEnable )
+		return pixels;
+
+	// the display area is placed at its offset in the target area
+	const uint32_t copyWidth = std::min( m_vramDisplayArea.width, width - std::min( m_targetDisplayArea.x, width ) );
+	const uint32_t copyHeight = std::min( m_vramDisplayArea.height, height - std::min( m_targetDisplayArea.y, height ) );
+
+	for ( uint32_t y = 0; y < copyHeight; ++y )
+	{
+		uint8_t* dest = pixels.data() + ( ( m_targetDisplayArea.y + y ) * width + m_targetDisplayArea.x ) * 3;
+		const uint32_t srcY = m_vramDisplayArea.y + y;
+
+		for ( uint32_t x = 0; x < copyWidth; ++x )
+		{
+			if ( m_colorDepth == DisplayAreaColorDepth::B24 )
+			{
+				// 3 bytes per pixel packed into 16 bit VRAM
+				const uint32_t srcX = m_vramDisplayArea.x + ( x * 3 ) / 2;
+				const uint16_t sample1 = read( srcX, srcY );
+				const uint16_t sample2 = read( srcX + 1, srcY );
+				if ( x % 2 == 0 )
+				{
+					*dest++ = static_cast<uint8_t>( sample1 );
+					*dest++ = static_cast<uint8_t>( sample1 >> 8 );
+					*dest++ = static_cast<uint8_t>( sample2 );
+				}
+				else
+				{
+					*dest++ = static_cast<uint8_t>( sample1 >> 8 );
+					*dest++ = static_cast<uint8_t>( sample2 );
+					*dest++ = static_cast<uint8_t>( sample2 >> 8 );
+				}
+			}
+			else
+			{
+				const uint16_t color = read( m_vramDisplayArea.x + x, srcY );
+				*dest++ = Convert5To8( color & 0x1f );
+				*dest++ = Convert5To8( ( color >> 5 ) & 0x1f );
+				*dest++ = Convert5To8( ( color >> 10 ) & 0x1f );
+			}
+		}
+	}
+
+	return pixels;
+}
+
+Surface SoftwareRenderer::ReadDisplayTexture()
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	const auto pixels = ConvertDisplayArea( width, height );
+	if ( width == 0 || height == 0 )
+		return {};
+
+	const uint32_t BytesPerPixel = 3;
+	const uint32_t pitch = ( width + ( width % 2 ) ) * BytesPerPixel;
+
+	auto surfacePixels = std::make_unique<char[]>( pitch * height );
+	for ( uint32_t y = 0; y < height; ++y )
+		std::copy_n( pixels.data() + y * width * BytesPerPixel, width * BytesPerPixel, surfacePixels.get() + y * pitch );
+
+	return Surface{ std::move( surfacePixels ), width, height, 24, pitch, 0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000 };
+}
+
+void SoftwareRenderer::DisplayFrame()
+{
+	if ( !m_window )
+		return;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	auto pixels = ConvertDisplayArea( width, height );
+
+	// OpenGL textures start at the bottom row
+	const uint32_t pitch = width * 3;
+	for ( uint32_t y = 0; y < height / 2; ++y )
+		std::swap_ranges( pixels.data() + y * pitch, pixels.data() + ( y + 1 ) * pitch, pixels.data() + ( height - 1 - y ) * pitch );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	m_displayTexture.UpdateImage( Render::InternalFormat::RGB, static_cast<GLsizei>( width ), static_cast<GLsizei>( height ), Render::PixelFormat::RGB, Render::PixelType::UByte, pixels.empty() ? nullptr : pixels.data() );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	int winWidth = 0;
+	int winHeight = 0;
+	SDL_GetWindowSize( m_window, &winWidth, &winHeight );
+
+	// clear window
+	glViewport( 0, 0, winWidth, winHeight );
+	glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+	glClear( GL_COLOR_BUFFER_BIT );
+
+	if ( width > 0 && height > 0 && m_aspectRatio > 0.0f )
+	{
+		// render to window
+		m_noAttributeVAO.Bind();
+		m_displayShader.Bind();
+		m_displayTexture.Bind();
+
+		const float displayWidth = static_cast<float>( m_viewVRam ? VRamWidth : m_vramDisplayArea.width );
+		const float displayHeight = m_viewVRam ? static_cast<float>( VRamHeight ) : ( displayWidth / m_aspectRatio );
+
+		const auto viewport = FitDisplayToWindow( displayWidth, displayHeight, winWidth, winHeight, m_stretchToFit );
+		glViewport( viewport.x, viewport.y, viewport.width, viewport.height );
+		glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+	}
+
+	dbCheckRenderErrors();
+
+	SDL_GL_SwapWindow( m_window );
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "ThreadedRenderer.h"
+
+#include <stdx/assert.h>
+#include <stdx/log.h>
+
+#include <cstring>
+#include <type_traits>
+
+namespace PSX
+{
+
+enum class ThreadedRenderer::Control : uint16_t
+{
+	Render,
+	Call, // runs a function while the producer waits
+	Wrap, // rest of the buffer is padding
+	Stop
+};
+
+namespace
+{
+
+struct CallArgs
+{
+	void ( *function )( void* context );
+	void* context;
+};
+
+constexpr size_t CommandAlignment = 8;
+
+constexpr size_t AlignCommandSize( size_t size ) noexcept
+{
+	return ( size + CommandAlignment - 1 ) & ~( CommandAlignment - 1 );
+}
+
+template <typename T>
+T ReadPayload( const void* payload ) noexcept
+{
+	static_assert( std::is_trivially_copyable_v<T> );
+	T value;
+	std::memcpy( &value, payload, sizeof( T ) );
+	return value;
+}
+
+}
+
+ThreadedRenderer::~ThreadedRenderer()
+{
+	if ( m_renderThread.joinable() )
+	{
+		ReserveCommand( Control::Stop, RenderCommand::Count, 0 );
+		EndCommand();
+		m_renderThread.join();
+
+		// give the context back to the window's thread
+		if ( m_glContext )
+			SDL_GL_MakeCurrent( m_window, m_glContext );
+	}
+}
+
+bool ThreadedRenderer::Initialize( std::unique_ptr<Renderer> renderer, SDL_Window* window )
+{
+	dbExpects( renderer );
+	dbExpects( !m_renderThread.joinable() );
+
+	m_renderer = std::move( renderer );
+	m_window = window;
+	m_buffer = std::make_unique<uint64_t[]>( BufferSize / sizeof( uint64_t ) );
+
+	// a context can only be current on one thread
+	if ( window )
+	{
+		m_glContext = SDL_GL_GetCurrentContext();
+		if ( m_glContext && SDL_GL_MakeCurrent( window, nullptr ) != 0 )
+		{
+			LogError( "ThreadedRenderer::Initialize -- cannot release GL context [%s]", SDL_GetError() );
+			m_glContext = nullptr;
+			return false;
+		}
+	}
+
+	m_renderThread = std::thread( &ThreadedRenderer::RenderThreadMain, this );
+	return true;
+}
+
+void* ThreadedRenderer::BeginCommand( RenderCommand command, size_t payloadSize )
+{
+	return ReserveCommand( Control::Render, command, payloadSize );
+}
+
+void* ThreadedRenderer::ReserveCommand( Control control, RenderCommand command, size_t payloadSize )
+{
+	const size_t size = AlignCommandSize( sizeof( CommandHeader ) + payloadSize );
+	dbExpects( size <= BufferSize );
+
+	// only this thread writes the write position
+	size_t writePosition = m_writePosition.load( std::memory_order_relaxed );
+	size_t offset = writePosition % BufferSize;
+
+	// commands are contiguous
+	const size_t padding = ( offset + size > BufferSize ) ? ( BufferSize - offset ) : 0;
+
+	WaitForRenderThread( [this, writePosition, required = padding + size]
+		{
+			return BufferSize - ( writePosition - m_readPosition.load() ) >= required;
+		} );
+
+	auto* buffer = reinterpret_cast<char*>( m_buffer.get() );
+
+	if ( padding > 0 )
+	{
+		const CommandHeader wrap{ Control::Wrap, RenderCommand::Count, static_cast<uint32_t>( padding ) };
+		std::memcpy( buffer + offset, &wrap, sizeof( wrap ) );
+		writePosition += padding;
+		offset = 0;
+	}
+
+	const CommandHeader header{ control, command, static_cast<uint32_t>( size ) };
+	std::memcpy( buffer + offset, &header, sizeof( header ) );
+
+	m_pendingWritePosition = writePosition + size;
+	return buffer + offset + sizeof( CommandHeader );
+}
+
+void ThreadedRenderer::EndCommand() noexcept
+{
+	m_writePosition.store( m_pendingWritePosition );
+
+	if ( m_renderThreadWaiting.load() )
+	{
+		std::lock_guard lock{ m_mutex };
+		m_commandsAvailable.notify_one();
+	}
+}
+
+template <typename Predicate>
+void ThreadedRenderer::WaitForRenderThread( Predicate done ) const
+{
+	if ( done() )
+		return;
+
+	// the render thread notifies when it sees the flag after advancing the read position
+	std::unique_lock lock{ m_mutex };
+	m_producerWaiting.store( true );
+	m_commandsExecuted.wait( lock, done );
+	m_producerWaiting.store( false );
+}
+
+template <typename F>
+void ThreadedRenderer::RunOnRenderThread( F&& function )
+{
+	using Function = std::remove_reference_t<F>;
+	const CallArgs args{ []( void* context ) { ( *static_cast<Function*>( context ) )(); }, &function };
+	std::memcpy( ReserveCommand( Control::Call, RenderCommand::Count, sizeof( args ) ), &args, sizeof( args ) );
+	EndCommand();
+	Flush();
+}
+
+void ThreadedRenderer::Flush() const
+{
+	const size_t writePosition = m_writePosition.load( std::memory_order_relaxed );
+	WaitForRenderThread( [this, writePosition] { return m_readPosition.load() == writePosition; } );
+}
+
+void ThreadedRenderer::RenderThreadMain()
+{
+	if ( m_glContext )
+		SDL_GL_MakeCurrent( m_window, m_glContext );
+
+	const auto* buffer = reinterpret_cast<const char*>( m_buffer.get() );
+	size_t readPosition = m_readPosition.load( std::memory_order_relaxed );
+
+	for ( bool running = true; running; )
+	{
+		auto hasCommands = [this, &readPosition] { return m_writePosition.load() != readPosition; };
+		if ( !hasCommands() )
+		{
+			std::unique_lock lock{ m_mutex };
+			m_renderThreadWaiting.store( true );
+			m_commandsAvailable.wait( lock, hasCommands );
+			m_renderThreadWaiting.store( false );
+		}
+
+		const char* command = buffer + readPosition % BufferSize;
+		const auto header = ReadPayload<CommandHeader>( command );
+		running = ExecuteCommand( header, command + sizeof( CommandHeader ) );
+
+		// the command's memory can be reused from here
+		readPosition += header.size;
+		m_readPosition.store( readPosition );
+
+		if ( m_producerWaiting.load() )
+		{
+			std::lock_guard lock{ m_mutex };
+			m_commandsExecuted.notify_one();
+		}
+	}
+
+	// GL objects are deleted with their context current
+	m_renderer.reset();
+
+	if ( m_glContext )
+		SDL_GL_MakeCurrent( m_window, nullptr );
+}
+
+bool ThreadedRenderer::ExecuteCommand( const CommandHeader& header, const void* payload )
+{
+	switch ( header.control )
+	{
+		case Control::Render:
+			ExecuteRenderCommand( *m_renderer, header.command, payload );
+			break;
+
+		case Control::Call:
+		{
+			const auto args = ReadPayload<CallArgs>( payload );
+			args.function( args.context );
+			break;
+		}
+
+		case Control::Wrap:
+			break;
+
+		case Control::Stop:
+			return false;
+	}
+
+	return true;
+}
+
+void ThreadedRenderer::EnableVRamView( bool enable )
+{
+	// resizes the window, which belongs to this thread
+	Flush();
+	m_renderer->EnableVRamView( enable );
+}
+
+bool ThreadedRenderer::IsVRamViewEnabled() const
+{
+	Flush();
+	return m_renderer->IsVRamViewEnabled();
+}
+
+bool ThreadedRenderer::GetRealColor() const
+{
+	Flush();
+	return m_renderer->GetRealColor();
+}
+
+void ThreadedRenderer::ReadVRam( uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint16_t* vram )
+{
+	RunOnRenderThread( [&] { m_renderer->ReadVRam( left, top, width, height, vram ); } );
+}
+
+void ThreadedRenderer::DisplayFrame()
+{
+	RunOnRenderThread( [this] { m_renderer->DisplayFrame(); } );
+}
+
+uint32_t ThreadedRenderer::GetResolutionScale() const noexcept
+{
+	Flush();
+	return m_renderer->GetResolutionScale();
+}
+
+bool ThreadedRenderer::SetResolutionScale( uint32_t scale )
+{
+	bool result = false;
+	RunOnRenderThread( [&] { result = m_renderer->SetResolutionScale( scale ); } );
+	return result;
+}
+
+uint32_t ThreadedRenderer::GetTargetTextureWidth() const noexcept
+{
+	Flush();
+	return m_renderer->GetTargetTextureWidth();
+}
+
+uint32_t ThreadedRenderer::GetTargetTextureHeight() const noexcept
+{
+	Flush();
+	return m_renderer->GetTargetTextureHeight();
+}
+
+Surface ThreadedRenderer::ReadDisplayTexture()
+{
+	Surface surface;
+	RunOnRenderThread( [&] { surface = m_renderer->ReadDisplayTexture(); } );
+	return surface;
+}
+
+}
\ No newline at end of file
@@ -103,7 +103,7 @@ uint32_t Timer::GetTicksUntilIrq() const noexcept
 
 	uint32_t minTicks = InfiniteCycles;
 
-	if ( !m_paused )
+	if ( !m_paused && CanSignalIrq() )
 	{
 		if ( m_mode.irqOnTarget )
 		{
@@ -122,6 +122,60 @@ uint32_t Timer::GetTicksUntilIrq() const noexcept
 	return minTicks;
 }
 
+bool Timer::CanSignalIrq() const noexcept
+{
+	if ( m_irq && !m_mode.irqRepeat )
+		return false;
+
+	// a one-shot toggle only signals when the request bit flips from 1 to 0
+	return !m_mode.irqToggle || m_mode.irqRepeat || m_mode.noInterruptRequest;
+}
+
+uint32_t Timer::PeekCounter( uint32_t ticks ) const noexcept
+{
+	if ( m_paused )
+		return m_counter;
+
+	dbAssert( ticks <= GetTicksUntilIrq() );
+
+	bool reachedTarget;
+	bool reachedMax;
+	return AdvanceCounter( ticks, reachedTarget, reachedMax );
+}
+
+uint32_t Timer::AdvanceCounter( uint32_t ticks, bool& reachedTarget, bool& reachedMax ) const noexcept
+{
+	uint32_t counter = m_counter + ticks;
+	reachedTarget = false;
+	reachedMax = false;
+
+	// a counter at or past the target has to wrap before it reaches the target again
+	if ( m_counter >= m_target )
+	{
+		if ( counter < 0xffff )
+			return counter;
+
+		reachedMax = true;
+		counter -= 0xffff;
+	}
+
+	if ( counter >= m_target )
+	{
+		reachedTarget = true;
+
+		if ( m_mode.resetCounter && m_target > 0 )
+			counter %= m_target;
+	}
+
+	if ( counter >= 0xffff )
+	{
+		reachedMax = true;
+		counter %= 0xffffu;
+	}
+
+	return counter;
+}
+
 bool Timer::Update( uint32_t ticks ) noexcept
 {
 	if ( m_paused )
@@ -132,25 +186,22 @@ bool Timer::Update( uint32_t ticks ) noexcept
 
 	dbAssert( ticks <= GetTicksUntilIrq() );
 
-	const auto oldCounter = m_counter;
-	m_counter += ticks;
+	bool reachedTarget;
+	bool reachedMax;
+	m_counter = AdvanceCounter( ticks, reachedTarget, reachedMax );
 
 	bool irq = false;
 
-	if ( m_counter >= m_target && ( oldCounter < m_target || m_target == 0 ) )
+	if ( reachedTarget )
 	{
 		m_mode.reachedTarget = true;
 		irq |= m_mode.irqOnTarget;
-
-		if ( m_mode.resetCounter && m_target > 0 )
-			m_counter %= m_target;
 	}
 
-	if ( m_counter >= 0xffff )
+	if ( reachedMax )
 	{
 		m_mode.reachedMax = true;
 		irq |= m_mode.irqOnMax;
-		m_counter %= 0xffffu;
 	}
 
 	if ( irq )
@@ -235,6 +286,26 @@ void Timers::UpdateEventsEarly( uint32_t timerIndex )
 	m_timerEvent->UpdateEarly();
 }
 
+std::optional<uint32_t> Timers::TryPeekCounter( uint32_t timerIndex ) const noexcept
+{
+	const auto& timer = m_timers[ timerIndex ];
+
+	// counters clocked or synced by the GPU are only current after a CRT update
+	if ( timerIndex < 2 && ( timer.GetSyncEnable() || !timer.IsUsingSystemClock() ) )
+		return std::nullopt;
+
+	// nothing elapsed, or the IRQ is due and has to be signalled first
+	if ( m_timerEvent->GetRemainingCycles() <= 0 )
+		return std::nullopt;
+
+	const cycles_t cycles = m_timerEvent->GetPendingCycles();
+
+	if ( timerIndex == 2 && !timer.IsUsingSystemClock() )
+		return timer.PeekCounter( static_cast<uint32_t>( cycles + m_cyclesDiv8Remainder ) / 8 );
+
+	return timer.PeekCounter( static_cast<uint32_t>( cycles ) );
+}
+
 uint32_t Timers::Read( uint32_t offset ) noexcept
 {
 	const uint32_t timerIndex = offset / 4;
@@ -250,10 +321,20 @@ uint32_t Timers::Read( uint32_t offset ) noexcept
 	switch ( static_cast<TimerRegister>( offset % 4 ) )
 	{
 		case TimerRegister::Counter:
-			UpdateEventsEarly( timerIndex );
-			value = timer.GetCounter();
+		{
+			// counters are polled in tight loops. Don't update and reschedule the timers unless an IRQ could be due
+			if ( auto counter = TryPeekCounter( timerIndex ) )
+			{
+				value = *counter;
+			}
+			else
+			{
+				UpdateEventsEarly( timerIndex );
+				value = timer.GetCounter();
+			}
 			// counter gets read too often to log
 			break;
+		}
 
 		case TimerRegister::Mode:
 			UpdateEventsEarly( timerIndex );
@@ -285,6 +366,10 @@ void Timers::Write( uint32_t offset, uint32_t value ) noexcept
 
 	auto& timer = m_timers[ timerIndex ];
 
+	// the CRT is only updated on demand, so it has to be current before a mode write switches to a GPU clock or sync
+	if ( timerIndex < 2 && static_cast<TimerRegister>( offset % 4 ) == TimerRegister::Mode )
+		m_gpu->UpdateCrtEventEarly();
+
 	UpdateEventsEarly( timerIndex );
 
 	switch ( static_cast<TimerRegister>( offset % 4 ) )
@@ -411,7 +496,7 @@ void Timers::ScheduleNextIrq() noexcept
 		}
 	}
 
-	// timers need to be scheduled even if an IRQ won't happen
+	// the event stays scheduled without an IRQ so its pending cycles can be used to peek the counters
 	m_timerEvent->Schedule( minCycles );
 }
 